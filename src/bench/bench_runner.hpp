@@ -0,0 +1,124 @@
+#ifndef SLNN_BENCH_BENCH_RUNNER_HPP_
+#define SLNN_BENCH_BENCH_RUNNER_HPP_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace slnn{
+
+struct BenchResult
+{
+    std::string name;
+    unsigned long long iterations;
+    double ns_per_op;
+    double tokens_per_op; // 0 if the case has no token notion
+    double get_tokens_per_sec() const { return tokens_per_op > 0. ? tokens_per_op * 1e9 / ns_per_op : 0.; }
+};
+
+/**
+ * a tiny micro-benchmark runner .
+ * every case is warmed up once , then the iteration number is doubled until one batch runs at least `min_time_ms` ,
+ * ns/op is taken from that batch .
+ * cases are selected by substring `filter` (empty for all) .
+ */
+class BenchRunner
+{
+public:
+    BenchRunner(double min_time_ms, const std::string &filter) : min_time_ms(min_time_ms), filter(filter){}
+    bool is_selected(const std::string &name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+    // `fn()` runs one operation , `tokens_per_op` is the number of tokens one operation processes
+    template <typename Fn>
+    void run(const std::string &name, double tokens_per_op, Fn fn);
+    const std::vector<BenchResult>& get_results() const { return results; }
+    void print_result(std::ostream &os, const BenchResult &result) const;
+    void write_json(std::ostream &os) const;
+    // keep a value alive so the computation producing it isn't optimized away
+    template <typename T>
+    static void do_not_optimize(const T &val){ sink ^= static_cast<unsigned long long>(val); }
+private:
+    static std::string escape_json(const std::string &str);
+    static volatile unsigned long long sink;
+    double min_time_ms;
+    std::string filter;
+    std::vector<BenchResult> results;
+};
+
+/*************** inline implementation ***************/
+
+// header-only , the single bench translation unit holds the definition
+volatile unsigned long long BenchRunner::sink = 0;
+
+template <typename Fn>
+inline
+void BenchRunner::run(const std::string &name, double tokens_per_op, Fn fn)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    if( !is_selected(name) ){ return; }
+    fn(); // warm up (allocations , lazy initialization)
+    unsigned long long nr_iter = 1;
+    double elapsed_ns = 0.;
+    while( true )
+    {
+        Clock::time_point start = Clock::now();
+        for( unsigned long long i = 0; i < nr_iter; ++i ){ fn(); }
+        elapsed_ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        if( elapsed_ns >= min_time_ms * 1e6 || nr_iter >= (1ULL << 40) ){ break; }
+        nr_iter *= 2;
+    }
+    results.push_back(BenchResult{ name, nr_iter, elapsed_ns / nr_iter, tokens_per_op });
+    print_result(std::cout, results.back());
+}
+
+inline
+void BenchRunner::print_result(std::ostream &os, const BenchResult &result) const
+{
+    std::ostringstream tokens_oss;
+    if( result.tokens_per_op > 0. ){ tokens_oss << std::fixed << std::setprecision(0) << result.get_tokens_per_sec(); }
+    else{ tokens_oss << "-"; }
+    os << std::left << std::setw(48) << result.name << std::right
+        << std::setw(12) << result.iterations << " iters "
+        << std::setw(16) << std::fixed << std::setprecision(1) << result.ns_per_op << " ns/op "
+        << std::setw(14) << tokens_oss.str() << " tokens/s" << std::endl;
+}
+
+inline
+std::string BenchRunner::escape_json(const std::string &str)
+{
+    std::string escaped;
+    for( char c : str )
+    {
+        if( c == '"' || c == '\\' ){ escaped += '\\'; }
+        escaped += c;
+    }
+    return escaped;
+}
+
+inline
+void BenchRunner::write_json(std::ostream &os) const
+{
+    os << "{\n  \"min_time_ms\": " << min_time_ms << ",\n"
+        << "  \"compiler\": \"" << escape_json(__VERSION__) << "\",\n"
+        << "  \"benchmarks\": [";
+    for( size_t i = 0; i < results.size(); ++i )
+    {
+        const BenchResult &result = results[i];
+        os << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << escape_json(result.name) << "\""
+            << ", \"iterations\": " << result.iterations
+            << std::fixed << std::setprecision(3)
+            << ", \"ns_per_op\": " << result.ns_per_op
+            << ", \"tokens_per_op\": " << result.tokens_per_op
+            << ", \"tokens_per_sec\": " << result.get_tokens_per_sec() << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+} // end of namespace slnn
+
+#endif
@@ -0,0 +1,355 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <memory>
+
+#include <boost/program_options.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "cnn/cnn.h"
+#include "cnn/dict.h"
+#include "cnn/lstm.h"
+#include "utils/general.hpp"
+#include "utils/typedeclaration.h"
+#include "utils/utf8processing.hpp"
+#include "utils/frozen_dict.hpp"
+#include "modelmodule/layers.h"
+#include "modelmodule/hyper_output_layers.h"
+#include "postagger/postagger_module/pos_feature_extractor.h"
+#include "segmentor/cws_module/lexicon_feature.h"
+#include "bench_runner.hpp"
+
+using namespace std;
+using namespace slnn;
+namespace po = boost::program_options;
+
+static const string ProgramHeader = "SLNN micro-benchmarks for hot components";
+static const int CNNRandomSeed = 1234;
+
+namespace {
+
+/**
+ * synthetic data , fixed seed so every run measures the same input .
+ */
+struct SyntheticData
+{
+    explicit SyntheticData(unsigned seed) : rng(seed){}
+
+    // CJK unified ideographs from a `nr_chars` vocabulary
+    string random_char(unsigned nr_chars)
+    {
+        unsigned code_point = 0x4E00 + rng() % nr_chars;
+        string utf8_char;
+        utf8_char += static_cast<char>(0xE0 | (code_point >> 12));
+        utf8_char += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        utf8_char += static_cast<char>(0x80 | (code_point & 0x3F));
+        return utf8_char;
+    }
+    string random_word(unsigned nr_chars)
+    {
+        unsigned word_len = 1 + rng() % 4;
+        string word;
+        for( unsigned i = 0; i < word_len; ++i ){ word += random_char(nr_chars); }
+        return word;
+    }
+    Seq random_word_seq(unsigned len, unsigned nr_chars)
+    {
+        Seq word_seq(len);
+        for( string &word : word_seq ){ word = random_word(nr_chars); }
+        return word_seq;
+    }
+    IndexSeq random_index_seq(unsigned len, unsigned nr_vals)
+    {
+        IndexSeq index_seq(len);
+        for( Index &val : index_seq ){ val = static_cast<Index>(rng() % nr_vals); }
+        return index_seq;
+    }
+    vector<vector<float>> random_input_values(unsigned len, unsigned dim)
+    {
+        uniform_real_distribution<float> dist(-1.f, 1.f);
+        vector<vector<float>> values(len, vector<float>(dim));
+        for( vector<float> &row : values )
+        {
+            for( float &val : row ){ val = dist(rng); }
+        }
+        return values;
+    }
+    mt19937 rng;
+};
+
+const unsigned NrChars = 3000;
+
+// `cnn::expr::input` keeps a pointer to the values , so `values` should outlive the graph
+vector<cnn::expr::Expression> build_input_exprs(cnn::ComputationGraph &cg, const vector<vector<float>> &values)
+{
+    vector<cnn::expr::Expression> exprs;
+    exprs.reserve(values.size());
+    for( const vector<float> &row : values )
+    {
+        exprs.push_back(cnn::expr::input(cg, { static_cast<unsigned>(row.size()) }, row));
+    }
+    return exprs;
+}
+
+void bench_utf8(BenchRunner &runner)
+{
+    SyntheticData data(1);
+    for( unsigned nr_chars : { 10U, 50U, 200U } )
+    {
+        string line;
+        for( unsigned i = 0; i < nr_chars; ++i ){ line += data.random_char(NrChars); }
+        Seq char_seq;
+        runner.run("utf8_str2char_seq/len=" + to_string(nr_chars), nr_chars, [&]()
+        {
+            UTF8Processing::utf8_str2char_seq(line, char_seq);
+            BenchRunner::do_not_optimize(char_seq.size());
+        });
+    }
+}
+
+void bench_dict(BenchRunner &runner)
+{
+    SyntheticData data(2);
+    Seq words = data.random_word_seq(20000, NrChars);
+    cnn::Dict dict;
+    for( const string &word : words ){ dict.Convert(word); }
+    dict.Freeze();
+    dict.SetUnk("<UNK>");
+    FrozenDict frozen_dict;
+    frozen_dict.build(dict, dict.Convert("<UNK>"));
+    Seq queries = data.random_word_seq(1000, NrChars);
+    runner.run("dict/cnn_dict_convert", queries.size(), [&]()
+    {
+        Index sum = 0;
+        for( const string &word : queries ){ sum += dict.Convert(word); }
+        BenchRunner::do_not_optimize(sum);
+    });
+    runner.run("dict/frozen_dict_convert", queries.size(), [&]()
+    {
+        Index sum = 0;
+        for( const string &word : queries ){ sum += frozen_dict.convert(word); }
+        BenchRunner::do_not_optimize(sum);
+    });
+    runner.run("dict/cnn_dict_convert_id2word", queries.size(), [&]()
+    {
+        size_t len_sum = 0;
+        for( unsigned i = 0; i < queries.size(); ++i ){ len_sum += dict.Convert(static_cast<int>(i)).size(); }
+        BenchRunner::do_not_optimize(len_sum);
+    });
+}
+
+void bench_feature_extraction(BenchRunner &runner)
+{
+    SyntheticData data(3);
+    Seq word_seq = data.random_word_seq(30, NrChars);
+    POSFeature::POSFeatureGroupSeq pos_feature_seq;
+    runner.run("POSFeatureExtractor::extract/len=30", word_seq.size(), [&]()
+    {
+        POSFeatureExtractor::extract(word_seq, pos_feature_seq);
+        BenchRunner::do_not_optimize(pos_feature_seq.size());
+    });
+
+    LexiconFeature lexicon_feature(5);
+    for( unsigned i = 0; i < 5000; ++i ){ lexicon_feature.count_word_frequency(data.random_word_seq(20, NrChars)); }
+    lexicon_feature.build_lexicon();
+    Seq char_seq;
+    for( unsigned i = 0; i < 50; ++i ){ char_seq.push_back(data.random_char(NrChars)); }
+    LexiconFeatureDataSeq lexicon_feature_seq;
+    runner.run("LexiconFeature::extract/len=50", char_seq.size(), [&]()
+    {
+        lexicon_feature.extract(char_seq, lexicon_feature_seq);
+        BenchRunner::do_not_optimize(lexicon_feature_seq.size());
+    });
+}
+
+void bench_birnn(BenchRunner &runner)
+{
+    SyntheticData data(4);
+    for( unsigned dim : { 50U, 100U } )
+    {
+        cnn::Model m;
+        BILSTMLayer birnn_layer(&m, 1, dim, dim);
+        for( unsigned len : { 10U, 50U, 200U } )
+        {
+            string suffix = "/len=" + to_string(len) + ",dim=" + to_string(dim);
+            vector<vector<float>> input_values = data.random_input_values(len, dim);
+            runner.run("BIRNNLayer<LSTM>::forward" + suffix, len, [&]()
+            {
+                cnn::ComputationGraph cg;
+                birnn_layer.new_graph(cg);
+                birnn_layer.start_new_sequence();
+                vector<cnn::expr::Expression> inputs = build_input_exprs(cg, input_values),
+                    l2r_outputs,
+                    r2l_outputs;
+                birnn_layer.build_graph(inputs, l2r_outputs, r2l_outputs);
+                // the last node is the one to forward
+                cnn::expr::sum_cols(cnn::expr::concatenate_cols(l2r_outputs)) +
+                    cnn::expr::sum_cols(cnn::expr::concatenate_cols(r2l_outputs));
+                BenchRunner::do_not_optimize(cnn::as_vector(cg.forward())[0] != 0.f);
+            });
+            runner.run("BIRNNLayer<LSTM>::forward_backward" + suffix, len, [&]()
+            {
+                cnn::ComputationGraph cg;
+                birnn_layer.new_graph(cg);
+                birnn_layer.start_new_sequence();
+                vector<cnn::expr::Expression> inputs = build_input_exprs(cg, input_values),
+                    l2r_outputs,
+                    r2l_outputs;
+                birnn_layer.build_graph(inputs, l2r_outputs, r2l_outputs);
+                cnn::expr::sum_elems(
+                    cnn::expr::sum_cols(cnn::expr::concatenate_cols(l2r_outputs)) +
+                    cnn::expr::sum_cols(cnn::expr::concatenate_cols(r2l_outputs)));
+                BenchRunner::do_not_optimize(cnn::as_scalar(cg.forward()) != 0.f);
+                cg.backward();
+            });
+        }
+    }
+}
+
+void bench_merge(BenchRunner &runner)
+{
+    SyntheticData data(5);
+    const unsigned len = 50,
+        dim = 100,
+        hidden_dim = 100;
+    cnn::Model m;
+    Merge3Layer merge_layer(&m, dim, dim, dim, hidden_dim);
+    vector<vector<float>> input_values = data.random_input_values(len, dim);
+    runner.run("Merge3Layer::build_graph/len=50,dim=100", len, [&]()
+    {
+        cnn::ComputationGraph cg;
+        merge_layer.new_graph(cg);
+        vector<cnn::expr::Expression> inputs = build_input_exprs(cg, input_values),
+            merged;
+        merged.reserve(len);
+        for( unsigned i = 0; i < len; ++i ){ merged.push_back(merge_layer.build_graph(inputs[i], inputs[i], inputs[i])); }
+        cnn::expr::sum(merged);
+        BenchRunner::do_not_optimize(cnn::as_vector(cg.forward())[0] != 0.f);
+    });
+}
+
+void bench_output(BenchRunner &runner)
+{
+    SyntheticData data(6);
+    const unsigned len = 50,
+        input_dim = 100,
+        hidden_dim = 100,
+        tag_emb_dim = 20;
+    for( unsigned tag_num : { 4U, 30U } )
+    {
+        string suffix = "/len=50,tags=" + to_string(tag_num);
+        IndexSeq gold_seq = data.random_index_seq(len, tag_num);
+        vector<vector<float>> input_values = data.random_input_values(len, input_dim);
+        cnn::Model m;
+        CRFOutput crf_output(&m, tag_emb_dim, input_dim, input_dim, hidden_dim, tag_num, 0.f);
+        PretagOutput pretag_output(&m, tag_emb_dim, input_dim, input_dim, hidden_dim, tag_num, 0.f);
+        runner.run("CRFOutput::build_output_loss" + suffix, len, [&]()
+        {
+            cnn::ComputationGraph cg;
+            crf_output.new_graph(cg);
+            vector<cnn::expr::Expression> inputs = build_input_exprs(cg, input_values);
+            crf_output.build_output_loss(inputs, inputs, gold_seq);
+            BenchRunner::do_not_optimize(cnn::as_scalar(cg.forward()) != 0.f);
+            cg.backward();
+        });
+        IndexSeq pred_seq;
+        runner.run("CRFOutput::build_output(decode)" + suffix, len, [&]()
+        {
+            cnn::ComputationGraph cg;
+            crf_output.new_graph(cg);
+            vector<cnn::expr::Expression> inputs = build_input_exprs(cg, input_values);
+            crf_output.build_output(inputs, inputs, pred_seq);
+            BenchRunner::do_not_optimize(pred_seq.size());
+        });
+        runner.run("PretagOutput::build_output(decode)" + suffix, len, [&]()
+        {
+            cnn::ComputationGraph cg;
+            pretag_output.new_graph(cg);
+            vector<cnn::expr::Expression> inputs = build_input_exprs(cg, input_values);
+            pretag_output.build_output(inputs, inputs, pred_seq);
+            BenchRunner::do_not_optimize(pred_seq.size());
+        });
+    }
+}
+
+void bench_model_io(BenchRunner &runner)
+{
+    cnn::Model m;
+    BILSTMLayer birnn_layer(&m, 2, 100, 100);
+    m.add_lookup_parameters(20000, { 50 });
+    string model_str;
+    {
+        ostringstream oss;
+        boost::archive::text_oarchive to(oss);
+        to << m;
+        model_str = oss.str();
+    }
+    runner.run("cnn::Model::save(text)", 0., [&]()
+    {
+        ostringstream oss;
+        boost::archive::text_oarchive to(oss);
+        to << m;
+        BenchRunner::do_not_optimize(oss.tellp() > 0);
+    });
+    runner.run("cnn::Model::load(text)", 0., [&]()
+    {
+        istringstream iss(model_str);
+        boost::archive::text_iarchive ti(iss);
+        ti >> m;
+        BenchRunner::do_not_optimize(m.parameters_list().size());
+    });
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    string program_name = argv[0];
+    po::options_description op_des = po::options_description(ProgramHeader + "\n"
+        "run micro-benchmarks and print ns/op and tokens/s . options are as following");
+    op_des.add_options()
+        ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("filter", po::value<string>()->default_value(""), "only run the cases whose name contains the string . empty for all .")
+        ("min_time_ms", po::value<double>()->default_value(200.), "the minimal time (ms) a case is measured for .")
+        ("json", po::value<string>(), "write the results as JSON to the path .")
+        ("help,h", "show help information");
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).run(), var_map);
+    po::notify(var_map);
+    if( var_map.count("help") )
+    {
+        cerr << op_des << endl;
+        return 0;
+    }
+    int cnn_argc;
+    shared_ptr<char *> cnn_argv;
+    unsigned cnn_mem = 0;
+    if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>(); }
+    build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+
+    BenchRunner runner(var_map["min_time_ms"].as<double>(), var_map["filter"].as<string>());
+    bench_utf8(runner);
+    bench_dict(runner);
+    bench_feature_extraction(runner);
+    bench_birnn(runner);
+    bench_merge(runner);
+    bench_output(runner);
+    bench_model_io(runner);
+
+    if( var_map.count("json") )
+    {
+        string json_path = var_map["json"].as<string>();
+        ofstream json_os(json_path);
+        if( !json_os ){ fatal_error("failed to open json path at '" + json_path + "'"); }
+        runner.write_json(json_os);
+        BOOST_LOG_TRIVIAL(info) << "benchmark results are written to `" << json_path << "` .";
+    }
+    return 0;
+}
@@ -0,0 +1,403 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+
+#include <boost/program_options.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/log/trivial.hpp>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+#include "synthetic_corpus.hpp"
+
+using namespace std;
+using namespace slnn;
+namespace po = boost::program_options;
+
+static const string ProgramHeader = "SLNN end-to-end scaling harness with synthetic corpora";
+
+namespace {
+
+struct ProcessResult
+{
+    string status; // "ok" , "failed" or "timeout"
+    int exit_code;
+    double wall_seconds;
+    long peak_rss_kb;
+};
+
+/**
+ * run `args` as a child process , stdout and stderr go to `log_path` .
+ * wall time is measured outside , peak RSS is from the child's rusage .
+ */
+ProcessResult run_process(const vector<string> &args, const string &log_path, unsigned timeout_seconds)
+{
+#ifdef _WIN32
+    throw std::runtime_error("running model binaries is only supported on POSIX systems .");
+#else
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    pid_t pid = fork();
+    if( pid < 0 ){ throw std::runtime_error("failed to fork ."); }
+    if( pid == 0 )
+    {
+        int log_fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if( log_fd >= 0 )
+        {
+            dup2(log_fd, STDOUT_FILENO);
+            dup2(log_fd, STDERR_FILENO);
+            close(log_fd);
+        }
+        vector<char*> argv;
+        for( const string &arg : args ){ argv.push_back(const_cast<char*>(arg.c_str())); }
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    ProcessResult result{ "ok", 0, 0., 0 };
+    int status = 0;
+    struct rusage usage;
+    bool is_timeout = false;
+    while( true )
+    {
+        pid_t ret = wait4(pid, &status, WNOHANG, &usage);
+        if( ret == pid ){ break; }
+        if( ret < 0 ){ throw std::runtime_error("failed to wait the child process ."); }
+        if( timeout_seconds > 0 && !is_timeout &&
+            Clock::now() - start > std::chrono::seconds(timeout_seconds) )
+        {
+            kill(pid, SIGKILL);
+            is_timeout = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    result.wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.peak_rss_kb = usage.ru_maxrss; // KB on linux
+    if( is_timeout ){ result.status = "timeout"; }
+    else if( WIFEXITED(status) )
+    {
+        result.exit_code = WEXITSTATUS(status);
+        if( result.exit_code != 0 ){ result.status = "failed"; }
+    }
+    else
+    {
+        result.exit_code = WIFSIGNALED(status) ? -WTERMSIG(status) : -1;
+        result.status = "failed";
+    }
+    return result;
+#endif
+}
+
+void make_directory(const string &dir_path)
+{
+#ifdef _WIN32
+    throw std::runtime_error("running model binaries is only supported on POSIX systems .");
+#else
+    if( mkdir(dir_path.c_str(), 0755) != 0 && errno != EEXIST )
+    {
+        throw std::runtime_error("failed to create directory `" + dir_path + "` .");
+    }
+#endif
+}
+
+vector<unsigned> parse_unsigned_list(const string &list_str)
+{
+    vector<string> items;
+    boost::split(items, list_str, boost::is_any_of(","), boost::token_compress_on);
+    vector<unsigned> vals;
+    for( const string &item : items )
+    {
+        if( !item.empty() ){ vals.push_back(static_cast<unsigned>(std::stoul(item))); }
+    }
+    if( vals.empty() ){ throw std::runtime_error("empty list `" + list_str + "` ."); }
+    return vals;
+}
+
+vector<string> split_args(const string &args_str)
+{
+    vector<string> args;
+    boost::split(args, args_str, boost::is_any_of(" \t"), boost::token_compress_on);
+    args.erase(std::remove(args.begin(), args.end(), string()), args.end());
+    return args;
+}
+
+void add_corpus_options(po::options_description &op_des)
+{
+    op_des.add_options()
+        ("format", po::value<string>()->default_value("pos"), "corpus format : [cws, pos, ner] .")
+        ("len_dist", po::value<string>()->default_value("lognormal"), "sentence length distribution : [fixed, uniform, normal, lognormal] .")
+        ("len_stddev", po::value<unsigned>()->default_value(12), "standard deviation (half width for uniform) of sentence length .")
+        ("max_len", po::value<unsigned>()->default_value(1000), "sentences are clipped to this length .")
+        ("nr_train_sents", po::value<unsigned>()->default_value(2000), "the number of training sentences .")
+        ("nr_devel_sents", po::value<unsigned>()->default_value(200), "the number of devel sentences .")
+        ("nr_raw_sents", po::value<unsigned>()->default_value(500), "the number of raw sentences for predict .")
+        ("word2vec_dim", po::value<unsigned>()->default_value(0), "also generate a word2vec embedding with the dimension (pos , ner) , 0 for no .")
+        ("seed", po::value<unsigned>()->default_value(1234), "random seed of the generator .");
+}
+
+SyntheticCorpusConfig build_corpus_config(const po::variables_map &var_map, unsigned mean_len, unsigned vocab_size, unsigned tag_num)
+{
+    SyntheticCorpusConfig config;
+    config.format = SyntheticCorpusConfig::parse_format(var_map["format"].as<string>());
+    config.len_dist = SyntheticCorpusConfig::parse_len_dist(var_map["len_dist"].as<string>());
+    config.mean_len = mean_len;
+    config.len_stddev = var_map["len_stddev"].as<unsigned>();
+    config.max_len = var_map["max_len"].as<unsigned>();
+    config.vocab_size = vocab_size;
+    config.tag_num = tag_num;
+    config.seed = var_map["seed"].as<unsigned>();
+    return config;
+}
+
+struct CorpusFiles
+{
+    string train_path,
+        devel_path,
+        raw_path,
+        raw_one_path, // the first raw sentence only , for the single sentence latency
+        word2vec_path;
+    size_t nr_train_tokens,
+        nr_devel_tokens,
+        nr_raw_tokens;
+};
+
+CorpusFiles generate_corpus(const SyntheticCorpusConfig &config, const po::variables_map &var_map, const string &prefix)
+{
+    SyntheticCorpusGenerator generator(config);
+    CorpusFiles files;
+    files.train_path = prefix + ".train";
+    files.devel_path = prefix + ".devel";
+    files.raw_path = prefix + ".raw";
+    files.raw_one_path = prefix + ".raw1";
+    auto open_output = [](const string &path) -> ofstream
+    {
+        ofstream os(path);
+        if( !os ){ throw std::runtime_error("failed to open `" + path + "` ."); }
+        return os;
+    };
+    {
+        ofstream os = open_output(files.train_path);
+        files.nr_train_tokens = generator.write_annotated(os, var_map["nr_train_sents"].as<unsigned>());
+    }
+    {
+        ofstream os = open_output(files.devel_path);
+        files.nr_devel_tokens = generator.write_annotated(os, var_map["nr_devel_sents"].as<unsigned>());
+    }
+    {
+        ofstream os = open_output(files.raw_path);
+        files.nr_raw_tokens = generator.write_raw(os, var_map["nr_raw_sents"].as<unsigned>());
+    }
+    {
+        ifstream is(files.raw_path);
+        string first_line;
+        getline(is, first_line);
+        ofstream os = open_output(files.raw_one_path);
+        os << first_line << "\n";
+    }
+    unsigned word2vec_dim = var_map["word2vec_dim"].as<unsigned>();
+    if( word2vec_dim > 0 )
+    {
+        files.word2vec_path = prefix + ".w2v";
+        ofstream os = open_output(files.word2vec_path);
+        generator.write_word2vec(os, word2vec_dim);
+    }
+    return files;
+}
+
+int generate_process(int argc, char *argv[], const string &program_name)
+{
+    po::options_description op_des = po::options_description(ProgramHeader + "\n"
+        "Generate one synthetic corpus .\n"
+        "using `" + program_name + " generate <options>` . options are as following");
+    op_des.add_options()
+        ("output_prefix", po::value<string>(), "[required] files are written to <prefix>.train/.devel/.raw(/.w2v) .")
+        ("mean_len", po::value<unsigned>()->default_value(25), "mean sentence length (characters for cws , words for others) .")
+        ("vocab_size", po::value<unsigned>()->default_value(5000), "distinct characters for cws , distinct words for others .")
+        ("tag_num", po::value<unsigned>()->default_value(30), "tag number (ignored for cws , 1 + 2 * entity types for ner) .")
+        ("help,h", "show help information");
+    add_corpus_options(op_des);
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).run(), var_map);
+    po::notify(var_map);
+    if( var_map.count("help") || !var_map.count("output_prefix") )
+    {
+        cerr << op_des << endl;
+        return var_map.count("help") ? 0 : 1;
+    }
+    SyntheticCorpusConfig config = build_corpus_config(var_map, var_map["mean_len"].as<unsigned>(),
+        var_map["vocab_size"].as<unsigned>(), var_map["tag_num"].as<unsigned>());
+    CorpusFiles files = generate_corpus(config, var_map, var_map["output_prefix"].as<string>());
+    BOOST_LOG_TRIVIAL(info) << "synthetic corpus generated : train " << files.nr_train_tokens << " tokens , devel "
+        << files.nr_devel_tokens << " tokens , raw " << files.nr_raw_tokens << " tokens .";
+    return 0;
+}
+
+void write_json_record(ostream &os, const SyntheticCorpusConfig &config, const string &stage,
+    const ProcessResult &result, size_t nr_tokens, unsigned nr_sents)
+{
+    double tokens_per_sec = result.wall_seconds > 0. ? nr_tokens / result.wall_seconds : 0.;
+    os << "{\"format\": \"" << SyntheticCorpusConfig::format_name(config.format) << "\""
+        << ", \"mean_len\": " << config.mean_len
+        << ", \"vocab_size\": " << config.vocab_size
+        << ", \"tag_num\": " << config.tag_num
+        << ", \"stage\": \"" << stage << "\""
+        << ", \"status\": \"" << result.status << "\""
+        << ", \"exit_code\": " << result.exit_code
+        << std::fixed << std::setprecision(3)
+        << ", \"wall_seconds\": " << result.wall_seconds
+        << ", \"peak_rss_mb\": " << result.peak_rss_kb / 1024.
+        << ", \"tokens\": " << nr_tokens
+        << ", \"tokens_per_sec\": " << tokens_per_sec
+        << ", \"ms_per_sent\": " << (nr_sents > 0 ? result.wall_seconds * 1000. / nr_sents : 0.)
+        << "}" << endl;
+}
+
+int sweep_process(int argc, char *argv[], const string &program_name)
+{
+    po::options_description op_des = po::options_description(ProgramHeader + "\n"
+        "Sweep corpus shapes , run `train` , `devel` and `predict` of a model binary for every shape .\n"
+        "using `" + program_name + " sweep <options>` . options are as following");
+    op_des.add_options()
+        ("binary", po::value<string>(), "[required] the path of the model binary .")
+        ("rnn_type", po::value<string>()->default_value("lstm"), "rnn type passed to the binary : [lstm, gru, rnn] .")
+        ("work_dir", po::value<string>()->default_value("slnn_scaling_work"), "directory for corpora , models , outputs and logs (its parent should exist) .")
+        ("results", po::value<string>()->default_value("slnn_scaling_results.jsonl"), "the path of results , one JSON record per stage .")
+        ("sweep_len", po::value<string>()->default_value("20,100,500"), "mean sentence lengths to sweep , separated by comma .")
+        ("sweep_vocab", po::value<string>()->default_value("5000"), "vocabulary sizes to sweep , separated by comma .")
+        ("sweep_tags", po::value<string>()->default_value("30"), "tag numbers to sweep , separated by comma (ignored for cws) .")
+        ("max_epoch", po::value<unsigned>()->default_value(1), "training epochs .")
+        ("cnn-mem", po::value<unsigned>()->default_value(512), "pre-allocated memory pool for CNN library (MB) , passed to the binary .")
+        ("timeout", po::value<unsigned>()->default_value(3600), "seconds a stage may run before it is killed , 0 for no limit .")
+        ("train_args", po::value<string>()->default_value(""), "extra arguments for `train` , separated by space .")
+        ("help,h", "show help information");
+    add_corpus_options(op_des);
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).run(), var_map);
+    po::notify(var_map);
+    if( var_map.count("help") || !var_map.count("binary") )
+    {
+        cerr << op_des << endl;
+        return var_map.count("help") ? 0 : 1;
+    }
+    string binary = var_map["binary"].as<string>(),
+        rnn_type = var_map["rnn_type"].as<string>(),
+        work_dir = var_map["work_dir"].as<string>(),
+        results_path = var_map["results"].as<string>(),
+        cnn_mem = to_string(var_map["cnn-mem"].as<unsigned>());
+    unsigned max_epoch = var_map["max_epoch"].as<unsigned>(),
+        timeout = var_map["timeout"].as<unsigned>(),
+        nr_devel_sents = var_map["nr_devel_sents"].as<unsigned>(),
+        nr_raw_sents = var_map["nr_raw_sents"].as<unsigned>();
+    vector<unsigned> lens = parse_unsigned_list(var_map["sweep_len"].as<string>()),
+        vocab_sizes = parse_unsigned_list(var_map["sweep_vocab"].as<string>()),
+        tag_nums = parse_unsigned_list(var_map["sweep_tags"].as<string>());
+    vector<string> train_args = split_args(var_map["train_args"].as<string>());
+    if( SyntheticCorpusConfig::parse_format(var_map["format"].as<string>()) == SyntheticCorpusConfig::Format::CWS )
+    {
+        tag_nums.assign(1, 4); // BMES
+    }
+    make_directory(work_dir);
+    ofstream results_os(results_path);
+    if( !results_os ){ throw std::runtime_error("failed to open results path at `" + results_path + "` ."); }
+
+    for( unsigned mean_len : lens )
+    {
+        for( unsigned vocab_size : vocab_sizes )
+        {
+            for( unsigned tag_num : tag_nums )
+            {
+                SyntheticCorpusConfig config = build_corpus_config(var_map, mean_len, vocab_size, tag_num);
+                string shape_name = "len" + to_string(mean_len) + "_vocab" + to_string(vocab_size) + "_tags" + to_string(tag_num),
+                    prefix = work_dir + "/" + shape_name,
+                    model_path = prefix + ".model";
+                BOOST_LOG_TRIVIAL(info) << "== shape " << shape_name << " : generating corpus .";
+                CorpusFiles files = generate_corpus(config, var_map, prefix);
+
+                vector<string> train_cmd = { binary, "train", rnn_type, "--cnn-mem", cnn_mem,
+                    "--training_data", files.train_path, "--devel_data", files.devel_path,
+                    "--max_epoch", to_string(max_epoch), "--model", model_path };
+                if( !files.word2vec_path.empty() )
+                {
+                    train_cmd.push_back("--word2vec_embedding");
+                    train_cmd.push_back(files.word2vec_path);
+                }
+                train_cmd.insert(train_cmd.end(), train_args.begin(), train_args.end());
+                // training throughput counts every epoch , devel during training is included in the wall time
+                ProcessResult train_result = run_process(train_cmd, prefix + ".train.log", timeout);
+                write_json_record(results_os, config, "train", train_result, files.nr_train_tokens * max_epoch, 0);
+                BOOST_LOG_TRIVIAL(info) << "train : " << train_result.status << " , " << train_result.wall_seconds << " s , "
+                    << train_result.peak_rss_kb / 1024 << " MB peak RSS .";
+                if( train_result.status != "ok" ){ continue; } // a shape which can't be trained is already the answer
+
+                ProcessResult devel_result = run_process({ binary, "devel", rnn_type, "--cnn-mem", cnn_mem,
+                    "--devel_data", files.devel_path, "--model", model_path }, prefix + ".devel.log", timeout);
+                write_json_record(results_os, config, "devel", devel_result, files.nr_devel_tokens, nr_devel_sents);
+
+                ProcessResult predict_result = run_process({ binary, "predict", rnn_type, "--cnn-mem", cnn_mem,
+                    "--raw_data", files.raw_path, "--model", model_path, "--output", prefix + ".predict" },
+                    prefix + ".predict.log", timeout);
+                write_json_record(results_os, config, "predict", predict_result, files.nr_raw_tokens, nr_raw_sents);
+                // one sentence end-to-end , including process start and model loading
+                ProcessResult predict_one_result = run_process({ binary, "predict", rnn_type, "--cnn-mem", cnn_mem,
+                    "--raw_data", files.raw_one_path, "--model", model_path, "--output", prefix + ".predict1" },
+                    prefix + ".predict1.log", timeout);
+                write_json_record(results_os, config, "predict_one", predict_one_result, 0, 1);
+                BOOST_LOG_TRIVIAL(info) << "predict : " << predict_result.status << " , "
+                    << (predict_result.wall_seconds > 0. ? files.nr_raw_tokens / predict_result.wall_seconds : 0.) << " tokens/s , "
+                    << predict_result.peak_rss_kb / 1024 << " MB peak RSS , single sentence "
+                    << predict_one_result.wall_seconds * 1000. << " ms .";
+            }
+        }
+    }
+    BOOST_LOG_TRIVIAL(info) << "sweep done , results are written to `" << results_path << "` .";
+    return 0;
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    string program_name = argv[0];
+    ostringstream oss;
+    oss << ProgramHeader << "\n"
+        << "usage : " << program_name << " [generate|sweep] <options>" << "\n"
+        << "generate : write one synthetic corpus (cws BMES , pos , ner BIO) .\n"
+        << "sweep : generate corpora over a grid of shapes , run train / devel / predict of a model binary ,\n"
+        << "        and record throughput , peak RSS and latency .";
+    string usage = oss.str();
+    if( argc < 2 )
+    {
+        cerr << usage << "\n";
+        return 1;
+    }
+    string task = argv[1];
+    try
+    {
+        if( task == "generate" ){ return generate_process(argc - 1, argv + 1, program_name); }
+        else if( task == "sweep" ){ return sweep_process(argc - 1, argv + 1, program_name); }
+        cerr << "unknown task `" << task << "` .\n" << usage << "\n";
+        return 1;
+    }
+    catch( const std::exception &e )
+    {
+        BOOST_LOG_TRIVIAL(fatal) << e.what();
+        return 1;
+    }
+}
@@ -0,0 +1,371 @@
+#ifndef SLNN_BENCH_SYNTHETIC_CORPUS_HPP_
+#define SLNN_BENCH_SYNTHETIC_CORPUS_HPP_
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace slnn{
+
+struct SyntheticCorpusConfig
+{
+    enum class Format{ CWS, POS, NER };
+    enum class LengthDistribution{ Fixed, Uniform, Normal, LogNormal };
+
+    Format format = Format::POS;
+    LengthDistribution len_dist = LengthDistribution::LogNormal;
+    unsigned mean_len = 25; // characters for CWS , words for POS / NER
+    unsigned len_stddev = 12;
+    unsigned max_len = 1000;
+    unsigned vocab_size = 5000; // distinct characters for CWS , distinct words for POS / NER
+    unsigned tag_num = 30; // ignored for CWS (BMES) , 1 + 2 * entity types for NER (BIO)
+    unsigned seed = 1234;
+
+    static Format parse_format(const std::string &format_name);
+    static std::string format_name(Format format);
+    static LengthDistribution parse_len_dist(const std::string &dist_name);
+};
+
+/**
+ * generate synthetic annotated corpora in the formats the readers accept :
+ *   CWS : words separated by space (tags are BMES of the segmentation) , raw line is the characters without space ;
+ *   POS : `word_TAG` separated by tab , raw line is words separated by tab ;
+ *   NER : `word/pos#TAG` separated by tab with BIO tags , raw line is `word_pos` separated by tab .
+ * unit frequency follows Zipf's law , every word has a preferred tag (with some ambiguity) ,
+ * so a model can still learn something and decoding isn't degenerate .
+ * the output only depends on the config , so a sweep can be reproduced .
+ */
+class SyntheticCorpusGenerator
+{
+public:
+    explicit SyntheticCorpusGenerator(const SyntheticCorpusConfig &config);
+    // return the number of tokens (characters for CWS , words for POS / NER)
+    size_t write_annotated(std::ostream &os, unsigned nr_sents);
+    size_t write_raw(std::ostream &os, unsigned nr_sents);
+    // word2vec text format , for models which need a fixed embedding
+    void write_word2vec(std::ostream &os, unsigned dim);
+private:
+    struct Token
+    {
+        unsigned word_id;
+        std::string tag;
+    };
+    unsigned sample_length();
+    void generate_sentence(std::vector<Token> &sent);
+    void generate_cws_sentence(std::vector<Token> &sent, unsigned nr_chars);
+    void generate_ner_sentence(std::vector<Token> &sent, unsigned nr_words);
+    std::string get_word(unsigned word_id) const;
+    size_t count_tokens(const std::vector<Token> &sent) const;
+    static std::string code_point2utf8(unsigned code_point);
+
+    SyntheticCorpusConfig config;
+    std::mt19937 rng;
+    std::discrete_distribution<unsigned> unit_dist; // Zipf over characters (CWS) or words
+    std::vector<std::string> cws_words; // CWS only , words built from characters
+    std::discrete_distribution<unsigned> cws_word_dist;
+};
+
+/*************** inline implementation ***************/
+
+namespace synthetic_corpus_inner{
+const unsigned CWSWordsPerChar = 4;
+const unsigned NrNERPOSTags = 30;
+const double AmbiguousTagProb = 0.1;
+const double EntityStartProb = 0.15;
+const unsigned CJKBegin = 0x4E00;
+const unsigned CJKSize = 0x9FA5 - 0x4E00 + 1;
+
+inline
+std::vector<double> zipf_weights(unsigned size)
+{
+    std::vector<double> weights(std::max(size, 1U));
+    for( size_t i = 0; i < weights.size(); ++i ){ weights[i] = 1. / (i + 1); }
+    return weights;
+}
+
+inline
+unsigned mix_hash(unsigned val)
+{
+    val ^= val >> 16;
+    val *= 0x7feb352dU;
+    val ^= val >> 15;
+    val *= 0x846ca68bU;
+    val ^= val >> 16;
+    return val;
+}
+} // end of namespace synthetic_corpus_inner
+
+inline
+SyntheticCorpusConfig::Format SyntheticCorpusConfig::parse_format(const std::string &format_name)
+{
+    if( format_name == "cws" ){ return Format::CWS; }
+    else if( format_name == "pos" ){ return Format::POS; }
+    else if( format_name == "ner" ){ return Format::NER; }
+    throw std::runtime_error("unknown corpus format `" + format_name + "` , should be one of [cws, pos, ner] .");
+}
+
+inline
+std::string SyntheticCorpusConfig::format_name(Format format)
+{
+    switch( format )
+    {
+    case Format::CWS: return "cws";
+    case Format::POS: return "pos";
+    default: return "ner";
+    }
+}
+
+inline
+SyntheticCorpusConfig::LengthDistribution SyntheticCorpusConfig::parse_len_dist(const std::string &dist_name)
+{
+    if( dist_name == "fixed" ){ return LengthDistribution::Fixed; }
+    else if( dist_name == "uniform" ){ return LengthDistribution::Uniform; }
+    else if( dist_name == "normal" ){ return LengthDistribution::Normal; }
+    else if( dist_name == "lognormal" ){ return LengthDistribution::LogNormal; }
+    throw std::runtime_error("unknown length distribution `" + dist_name + "` , should be one of [fixed, uniform, normal, lognormal] .");
+}
+
+inline
+SyntheticCorpusGenerator::SyntheticCorpusGenerator(const SyntheticCorpusConfig &config)
+    :config(config), rng(config.seed)
+{
+    using namespace synthetic_corpus_inner;
+    if( config.vocab_size == 0 || config.mean_len == 0 || config.max_len == 0 )
+    {
+        throw std::runtime_error("vocabulary size , mean length and max length of synthetic corpus should be > 0 .");
+    }
+    if( config.format != SyntheticCorpusConfig::Format::CWS && config.tag_num < (config.format == SyntheticCorpusConfig::Format::NER ? 3U : 1U) )
+    {
+        throw std::runtime_error("tag number is too small for the corpus format .");
+    }
+    std::vector<double> weights = zipf_weights(config.vocab_size);
+    unit_dist = std::discrete_distribution<unsigned>(weights.begin(), weights.end());
+    if( config.format == SyntheticCorpusConfig::Format::CWS )
+    {
+        if( config.vocab_size > CJKSize ){ throw std::runtime_error("CWS vocabulary size should be <= " + std::to_string(CJKSize) + " ."); }
+        // word length 1 : 2 : 3 : 4 ~ 30% : 50% : 12% : 8% , roughly as news text
+        std::discrete_distribution<unsigned> word_len_dist({ 30., 50., 12., 8. });
+        unsigned nr_words = config.vocab_size * CWSWordsPerChar;
+        cws_words.reserve(nr_words);
+        for( unsigned i = 0; i < nr_words; ++i )
+        {
+            unsigned word_len = word_len_dist(rng) + 1;
+            std::string word;
+            for( unsigned j = 0; j < word_len; ++j ){ word += code_point2utf8(CJKBegin + unit_dist(rng)); }
+            cws_words.push_back(word);
+        }
+        std::vector<double> word_weights = zipf_weights(nr_words);
+        cws_word_dist = std::discrete_distribution<unsigned>(word_weights.begin(), word_weights.end());
+    }
+}
+
+inline
+std::string SyntheticCorpusGenerator::code_point2utf8(unsigned code_point)
+{
+    // only BMP characters are generated
+    std::string utf8_char;
+    utf8_char += static_cast<char>(0xE0 | (code_point >> 12));
+    utf8_char += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    utf8_char += static_cast<char>(0x80 | (code_point & 0x3F));
+    return utf8_char;
+}
+
+inline
+unsigned SyntheticCorpusGenerator::sample_length()
+{
+    using LengthDistribution = SyntheticCorpusConfig::LengthDistribution;
+    double mean = config.mean_len,
+        stddev = config.len_stddev,
+        len = mean;
+    switch( config.len_dist )
+    {
+    case LengthDistribution::Fixed:
+        break;
+    case LengthDistribution::Uniform:
+        len = std::uniform_real_distribution<double>(std::max(1., mean - stddev), mean + stddev + 1.)(rng);
+        break;
+    case LengthDistribution::Normal:
+        len = std::normal_distribution<double>(mean, stddev)(rng);
+        break;
+    case LengthDistribution::LogNormal:
+    {
+        // parameters giving the expected mean and standard deviation
+        double sigma2 = std::log(1. + stddev * stddev / (mean * mean));
+        len = std::lognormal_distribution<double>(std::log(mean) - sigma2 / 2., std::sqrt(sigma2))(rng);
+        break;
+    }
+    }
+    return static_cast<unsigned>(std::min(std::max(len, 1.), static_cast<double>(config.max_len)));
+}
+
+inline
+void SyntheticCorpusGenerator::generate_cws_sentence(std::vector<Token> &sent, unsigned nr_chars)
+{
+    // the last word may exceed the length a little , it keeps every word complete
+    unsigned len = 0;
+    while( len < nr_chars )
+    {
+        unsigned word_id = cws_word_dist(rng);
+        sent.push_back(Token{ word_id, "" });
+        len += cws_words[word_id].size() / 3;
+    }
+}
+
+inline
+void SyntheticCorpusGenerator::generate_ner_sentence(std::vector<Token> &sent, unsigned nr_words)
+{
+    using namespace synthetic_corpus_inner;
+    unsigned nr_entity_types = (config.tag_num - 1) / 2;
+    std::bernoulli_distribution entity_start(EntityStartProb);
+    std::uniform_int_distribution<unsigned> entity_len_dist(1, 3);
+    while( sent.size() < nr_words )
+    {
+        unsigned word_id = unit_dist(rng);
+        if( !entity_start(rng) )
+        {
+            sent.push_back(Token{ word_id, "O" });
+            continue;
+        }
+        // entity type is decided by the first word , so it's learnable
+        std::string entity_type = "E" + std::to_string(mix_hash(word_id) % nr_entity_types);
+        unsigned entity_len = std::min(entity_len_dist(rng), static_cast<unsigned>(nr_words - sent.size()));
+        sent.push_back(Token{ word_id, "B-" + entity_type });
+        for( unsigned i = 1; i < entity_len; ++i ){ sent.push_back(Token{ unit_dist(rng), "I-" + entity_type }); }
+    }
+}
+
+inline
+void SyntheticCorpusGenerator::generate_sentence(std::vector<Token> &sent)
+{
+    using namespace synthetic_corpus_inner;
+    sent.clear();
+    unsigned len = sample_length();
+    switch( config.format )
+    {
+    case SyntheticCorpusConfig::Format::CWS:
+        generate_cws_sentence(sent, len);
+        break;
+    case SyntheticCorpusConfig::Format::NER:
+        generate_ner_sentence(sent, len);
+        break;
+    case SyntheticCorpusConfig::Format::POS:
+    {
+        std::bernoulli_distribution ambiguous(AmbiguousTagProb);
+        std::uniform_int_distribution<unsigned> tag_dist(0, config.tag_num - 1);
+        for( unsigned i = 0; i < len; ++i )
+        {
+            unsigned word_id = unit_dist(rng),
+                tag_id = ambiguous(rng) ? tag_dist(rng) : mix_hash(word_id) % config.tag_num;
+            sent.push_back(Token{ word_id, "T" + std::to_string(tag_id) });
+        }
+        break;
+    }
+    }
+}
+
+inline
+std::string SyntheticCorpusGenerator::get_word(unsigned word_id) const
+{
+    if( config.format == SyntheticCorpusConfig::Format::CWS ){ return cws_words[word_id]; }
+    return "w" + std::to_string(word_id);
+}
+
+inline
+size_t SyntheticCorpusGenerator::count_tokens(const std::vector<Token> &sent) const
+{
+    if( config.format != SyntheticCorpusConfig::Format::CWS ){ return sent.size(); }
+    size_t nr_chars = 0;
+    for( const Token &token : sent ){ nr_chars += cws_words[token.word_id].size() / 3; }
+    return nr_chars;
+}
+
+inline
+size_t SyntheticCorpusGenerator::write_annotated(std::ostream &os, unsigned nr_sents)
+{
+    using namespace synthetic_corpus_inner;
+    std::vector<Token> sent;
+    size_t nr_tokens = 0;
+    for( unsigned sent_idx = 0; sent_idx < nr_sents; ++sent_idx )
+    {
+        generate_sentence(sent);
+        nr_tokens += count_tokens(sent);
+        for( size_t i = 0; i < sent.size(); ++i )
+        {
+            const Token &token = sent[i];
+            switch( config.format )
+            {
+            case SyntheticCorpusConfig::Format::CWS:
+                os << (i == 0 ? "" : " ") << get_word(token.word_id);
+                break;
+            case SyntheticCorpusConfig::Format::POS:
+                os << (i == 0 ? "" : "\t") << get_word(token.word_id) << "_" << token.tag;
+                break;
+            case SyntheticCorpusConfig::Format::NER:
+                os << (i == 0 ? "" : "\t") << get_word(token.word_id) << "/p" << mix_hash(token.word_id + 1) % NrNERPOSTags
+                    << "#" << token.tag;
+                break;
+            }
+        }
+        os << "\n";
+    }
+    if( !os ){ throw std::runtime_error("failed to write synthetic corpus ."); }
+    return nr_tokens;
+}
+
+inline
+size_t SyntheticCorpusGenerator::write_raw(std::ostream &os, unsigned nr_sents)
+{
+    using namespace synthetic_corpus_inner;
+    std::vector<Token> sent;
+    size_t nr_tokens = 0;
+    for( unsigned sent_idx = 0; sent_idx < nr_sents; ++sent_idx )
+    {
+        generate_sentence(sent);
+        nr_tokens += count_tokens(sent);
+        for( size_t i = 0; i < sent.size(); ++i )
+        {
+            const Token &token = sent[i];
+            switch( config.format )
+            {
+            case SyntheticCorpusConfig::Format::CWS:
+                os << get_word(token.word_id);
+                break;
+            case SyntheticCorpusConfig::Format::POS:
+                os << (i == 0 ? "" : "\t") << get_word(token.word_id);
+                break;
+            case SyntheticCorpusConfig::Format::NER:
+                os << (i == 0 ? "" : "\t") << get_word(token.word_id) << "_p" << mix_hash(token.word_id + 1) % NrNERPOSTags;
+                break;
+            }
+        }
+        os << "\n";
+    }
+    if( !os ){ throw std::runtime_error("failed to write synthetic corpus ."); }
+    return nr_tokens;
+}
+
+inline
+void SyntheticCorpusGenerator::write_word2vec(std::ostream &os, unsigned dim)
+{
+    if( config.format == SyntheticCorpusConfig::Format::CWS )
+    {
+        throw std::runtime_error("word2vec embedding is only generated for word level corpus (pos , ner) .");
+    }
+    std::uniform_real_distribution<float> value_dist(-0.5f, 0.5f);
+    os << config.vocab_size << " " << dim << "\n";
+    for( unsigned word_id = 0; word_id < config.vocab_size; ++word_id )
+    {
+        os << get_word(word_id);
+        for( unsigned i = 0; i < dim; ++i ){ os << " " << value_dist(rng); }
+        os << "\n";
+    }
+    if( !os ){ throw std::runtime_error("failed to write synthetic word2vec embedding ."); }
+}
+
+} // end of namespace slnn
+
+#endif
@@ -31,35 +31,33 @@ std::string ContextFeature::get_feature_info() const
 
 void ContextFeature::extract(const IndexSeq &seq, ContextFeatureDataSeq &context_feature_data_seq)
 {
-    using std::swap;
     int sent_len = seq.size();
-    ContextFeatureDataSeq tmp_feature_data_seq(sent_len,
-        ContextFeatureData(context_size));
+    context_feature_data_seq.resize(sent_len, context_size);
     for( Index i = 0; i < sent_len; ++i )
     {
-        ContextFeatureData &feature_data = tmp_feature_data_seq.at(i);
+        Index *feature_data = context_feature_data_seq.row_data(i);
         unsigned feature_idx = 0 ;
         for( Index left_context_offset = 1 ; left_context_offset <= context_left_size ; ++left_context_offset )
         {
             int word_pos = i - left_context_offset;
-            feature_data.at(feature_idx) = (word_pos < 0 ? WordSOSId : seq.at(word_pos)) ;
+            feature_data[feature_idx] = (word_pos < 0 ? WordSOSId : seq.at(word_pos)) ;
             ++feature_idx;
         }
         for( Index right_context_offset = 1 ; right_context_offset <= context_right_size; ++right_context_offset )
         {
             int word_pos = i + right_context_offset;
-            feature_data.at(feature_idx) = ( word_pos >= sent_len ? WordEOSId : seq.at(word_pos) );
+            feature_data[feature_idx] = ( word_pos >= sent_len ? WordEOSId : seq.at(word_pos) );
             ++feature_idx;
         }
     }
-    swap(context_feature_data_seq, tmp_feature_data_seq);
 }
 
 void ContextFeature::debug_context_feature_seq(const ContextFeatureDataSeq &context_feature_data_seq)
 {
     std::cerr << "context feature output for DEBUG.\n";
-    for( const ContextFeatureData &fdata : context_feature_data_seq )
+    for( size_t pos = 0; pos < context_feature_data_seq.size(); ++pos )
     {
+        ContextFeatureData fdata = context_feature_data_seq[pos];
         assert(fdata.size() > 0);
         std::cerr << fdata[0];
         for( size_t i = 1; i < fdata.size(); ++i )
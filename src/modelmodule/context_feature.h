@@ -4,13 +4,82 @@
 #include <vector>
 #include <sstream>
 #include <iostream>
+#include <stdexcept>
 #include "cnn/cnn.h"
 #include "utils/typedeclaration.h"
 #include "utils/dict_wrapper.hpp"
 namespace slnn{
 
-using ContextFeatureData = std::vector<Index>;
-using ContextFeatureDataSeq = std::vector<ContextFeatureData>;
+/**
+ * read-only view of the context ids of one token (a row of `ContextFeatureDataSeq`) .
+ */
+struct ContextFeatureData
+{
+    ContextFeatureData(const Index *ids, unsigned sz) : ids(ids), sz(sz){}
+    size_t size() const { return sz; }
+    Index operator[](size_t i) const { return ids[i]; }
+    Index at(size_t i) const;
+    const Index* begin() const { return ids; }
+    const Index* end() const { return ids + sz; }
+private:
+    const Index *ids;
+    unsigned sz;
+};
+
+/**
+ * context ids of a sentence , stored in ONE contiguous buffer with fixed stride (the context size) .
+ * a sentence costs one allocation instead of one per token , and assigning to a reused instance
+ * (e.g. the UNK-replaced scratch copy in training) does not allocate once its capacity is enough .
+ */
+class ContextFeatureDataSeq
+{
+public:
+    ContextFeatureDataSeq() : seq_len(0), stride(0){}
+    void resize(size_t seq_len, unsigned stride);
+    void assign(const Index *flat_ids, size_t seq_len, unsigned stride);
+    size_t size() const { return seq_len; }
+    bool empty() const { return 0 == seq_len; }
+    unsigned get_stride() const { return stride; }
+    ContextFeatureData operator[](size_t i) const { return ContextFeatureData(ids.data() + i * stride, stride); }
+    ContextFeatureData at(size_t i) const;
+    Index* row_data(size_t i){ return ids.data() + i * stride; }
+    std::vector<Index>& get_flat_ids(){ return ids; }
+    const std::vector<Index>& get_flat_ids() const { return ids; }
+private:
+    size_t seq_len;
+    unsigned stride;
+    std::vector<Index> ids;
+};
+
+inline
+Index ContextFeatureData::at(size_t i) const
+{
+    if( i >= sz ){ throw std::out_of_range("context feature data index out of range ."); }
+    return ids[i];
+}
+
+inline
+void ContextFeatureDataSeq::resize(size_t seq_len, unsigned stride)
+{
+    this->seq_len = seq_len;
+    this->stride = stride;
+    ids.resize(seq_len * stride);
+}
+
+inline
+void ContextFeatureDataSeq::assign(const Index *flat_ids, size_t seq_len, unsigned stride)
+{
+    this->seq_len = seq_len;
+    this->stride = stride;
+    ids.assign(flat_ids, flat_ids + seq_len * stride);
+}
+
+inline
+ContextFeatureData ContextFeatureDataSeq::at(size_t i) const
+{
+    if( i >= seq_len ){ throw std::out_of_range("context feature data sequence index out of range ."); }
+    return (*this)[i];
+}
 
 class ContextFeature
 {
@@ -22,9 +91,10 @@ public:
     ContextFeature(DictWrapper &dict_wrapper, unsigned context_left_size=0, unsigned context_right_size=0, unsigned word_dim=0);
     void set_parameters(unsigned context_left_size, unsigned context_right_size, unsigned word_dim);
     unsigned get_feature_dim() const { return context_size * word_dim; }
+    unsigned get_context_left_size() const { return context_left_size; }
+    unsigned get_context_right_size() const { return context_right_size; }
     
     void extract(const IndexSeq &seq, ContextFeatureDataSeq &context_feature_seq);
-    void random_replace_with_unk(const ContextFeatureData &context_feature_data, ContextFeatureData &replaced_feature_data);
     void random_replace_with_unk(const ContextFeatureDataSeq &context_feature_data_seq, 
         ContextFeatureDataSeq &replaced_feature_data_seq);
     std::string get_feature_info() const;
@@ -51,26 +121,13 @@ void ContextFeature::replace_wordid_with_unk(Index &wordid)
     if( WordSOSId != wordid && WordEOSId != wordid ){ wordid = rwrapper.ConvertProbability(wordid); }
 }
 
-inline 
-void ContextFeature::random_replace_with_unk(const ContextFeatureData &context_feature_data, ContextFeatureData &replaced_feature_data)
-{
-    using std::swap;
-    ContextFeatureData tmp_rep_data(context_feature_data);
-    for( Index &wordid : tmp_rep_data ){ replace_wordid_with_unk(wordid); }
-    swap(replaced_feature_data, tmp_rep_data);
-}
-
 inline 
 void ContextFeature::random_replace_with_unk(const ContextFeatureDataSeq &context_feature_data_seq,
     ContextFeatureDataSeq &replaced_feature_data_seq)
 {
-    using std::swap;
-    ContextFeatureDataSeq tmp_rep_seq(context_feature_data_seq);
-    for( ContextFeatureData &fdata : tmp_rep_seq )
-    {
-        for( Index &wordid : fdata ){ replace_wordid_with_unk(wordid); }
-    }
-    swap(replaced_feature_data_seq, tmp_rep_seq);
+    // copy into the (reused) output buffer , then replace in place . the same object is OK for in and out .
+    replaced_feature_data_seq = context_feature_data_seq;
+    for( Index &wordid : replaced_feature_data_seq.get_flat_ids() ){ replace_wordid_with_unk(wordid); }
 }
 
 template <typename Archive>
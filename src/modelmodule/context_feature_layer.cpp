@@ -6,7 +6,21 @@ ContextFeatureLayer::ContextFeatureLayer(cnn::Model *m, cnn::LookupParameters *w
     :word_lookup_param(word_lookup_param),
     pcg(nullptr),
     word_sos_param(m->add_parameters(word_lookup_param->dim)),
-    word_eos_param(m->add_parameters(word_lookup_param->dim))
+    word_eos_param(m->add_parameters(word_lookup_param->dim)),
+    context_left_size(0),
+    context_right_size(0),
+    is_window_known(false)
 {}
 
-} // end of namespace slnn
\ No newline at end of file
+ContextFeatureLayer::ContextFeatureLayer(cnn::Model *m, cnn::LookupParameters *word_lookup_param,
+    const ContextFeature &context_feature)
+    :word_lookup_param(word_lookup_param),
+    pcg(nullptr),
+    word_sos_param(m->add_parameters(word_lookup_param->dim)),
+    word_eos_param(m->add_parameters(word_lookup_param->dim)),
+    context_left_size(context_feature.get_context_left_size()),
+    context_right_size(context_feature.get_context_right_size()),
+    is_window_known(true)
+{}
+
+} // end of namespace slnn
@@ -6,25 +6,43 @@
 #include "context_feature.h"
 namespace slnn{
 
+/**
+ * context feature layer .
+ * `build_feature_exprs` / `build_window_feature_exprs` look up every position of the sentence ONCE
+ * into a padded sequence [SOS * left , w_0 ... w_{n-1} , EOS * right] , and every context window
+ * is concatenated from the shared expressions (same order as `ContextFeature::extract`) ,
+ * instead of looking up (left + right) words for every token .
+ * window size is only known when constructed with the `ContextFeature` ,
+ * otherwise `build_feature_exprs` falls back to build every token separately .
+ */
 struct ContextFeatureLayer
 {
     ContextFeatureLayer(cnn::Model *m, cnn::LookupParameters *word_lookup_param);
+    ContextFeatureLayer(cnn::Model *m, cnn::LookupParameters *word_lookup_param, const ContextFeature &context_feature);
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression build_feature_expr(const ContextFeatureData &context_feature_data);
-    
+
     void build_feature_exprs(const ContextFeatureDataSeq &context_feature_data_seq,
         std::vector<cnn::expr::Expression> &context_feature_exprs);
+    void build_window_feature_exprs(const IndexSeq &word_seq, std::vector<cnn::expr::Expression> &context_feature_exprs);
 private:
     cnn::expr::Expression build_word_expr(Index word_id);
+    bool is_window_data(const ContextFeatureDataSeq &context_feature_data_seq) const;
     cnn::LookupParameters *word_lookup_param;
     cnn::ComputationGraph *pcg;
     cnn::Parameters *word_sos_param;
     cnn::Parameters *word_eos_param;
     cnn::expr::Expression word_sos_expr;
     cnn::expr::Expression word_eos_expr;
+    unsigned context_left_size;
+    unsigned context_right_size;
+    bool is_window_known;
+    std::vector<cnn::expr::Expression> context_word_exprs; // buffer for `build_feature_expr`
+    IndexSeq window_word_seq; // buffer , word id at every position recovered from context data
+    std::vector<cnn::expr::Expression> padded_word_exprs; // buffer , shared lookup of the padded sequence
 };
 
-inline 
+inline
 void ContextFeatureLayer::new_graph(cnn::ComputationGraph &cg)
 {
     pcg = &cg;
@@ -32,7 +50,7 @@ void ContextFeatureLayer::new_graph(cnn::ComputationGraph &cg)
     word_eos_expr = cnn::expr::parameter(cg, word_eos_param);
 }
 
-inline 
+inline
 cnn::expr::Expression ContextFeatureLayer::build_word_expr(Index word_id)
 {
     if( word_id == ContextFeature::WordSOSId ){ return word_sos_expr ; }
@@ -40,17 +58,12 @@ cnn::expr::Expression ContextFeatureLayer::build_word_expr(Index word_id)
     else { return cnn::expr::lookup(*pcg, word_lookup_param, word_id); }
 }
 
-inline 
+inline
 cnn::expr::Expression ContextFeatureLayer::build_feature_expr(const ContextFeatureData &context_feature_data)
 {
-    // this may can be optimized ! 
-    // context_feature_data.size() always the same , and contxt_word_exprs may be declaration as static or member variable
-    // but we give up ! 
-    // it should not be the key factor of speed .
-    // for static and member variable , we may get some diffeculties when multi-threads
-    // for constant context_feature_data.size() , we need the information from the ContextFeature instance.
+    // context_word_exprs is a member buffer , so the layer instance should not be shared between threads .
     size_t sz = context_feature_data.size();
-    std::vector<cnn::expr::Expression> context_word_exprs(sz); 
+    context_word_exprs.resize(sz);
     for( unsigned i = 0 ; i < sz ; ++i )
     {
         context_word_exprs.at(i) = build_word_expr(context_feature_data.at(i));
@@ -58,18 +71,60 @@ cnn::expr::Expression ContextFeatureLayer::build_feature_expr(const ContextFeatu
     return cnn::expr::concatenate(context_word_exprs);
 }
 
-inline 
+inline
+bool ContextFeatureLayer::is_window_data(const ContextFeatureDataSeq &context_feature_data_seq) const
+{
+    return is_window_known && context_left_size + context_right_size > 0 &&
+        context_feature_data_seq.get_stride() == context_left_size + context_right_size;
+}
+
+inline
 void ContextFeatureLayer::build_feature_exprs(const ContextFeatureDataSeq &context_feature_data_seq,
     std::vector<cnn::expr::Expression> &context_feature_exprs)
 {
-    using std::swap;
     unsigned seq_len = context_feature_data_seq.size();
-    std::vector<cnn::expr::Expression> tmp_context_feature_exprs(seq_len);
+    if( !is_window_data(context_feature_data_seq) )
+    {
+        context_feature_exprs.resize(seq_len);
+        for( unsigned i = 0; i < seq_len; ++i )
+        {
+            context_feature_exprs.at(i) = build_feature_expr(context_feature_data_seq.at(i));
+        }
+        return;
+    }
+    // recover the word at every position from its neighbours' context data :
+    // position p is the left-1 context of p+1 , or the right-1 context of p-1 .
+    // a position referenced by no window keeps the SOS id , which needs no lookup .
+    window_word_seq.assign(seq_len, ContextFeature::WordSOSId);
+    for( unsigned p = 0; p < seq_len; ++p )
+    {
+        if( context_left_size > 0 && p + 1 < seq_len ){ window_word_seq[p] = context_feature_data_seq[p + 1][0]; }
+        else if( context_right_size > 0 && p > 0 ){ window_word_seq[p] = context_feature_data_seq[p - 1][context_left_size]; }
+    }
+    build_window_feature_exprs(window_word_seq, context_feature_exprs);
+}
+
+inline
+void ContextFeatureLayer::build_window_feature_exprs(const IndexSeq &word_seq,
+    std::vector<cnn::expr::Expression> &context_feature_exprs)
+{
+    unsigned seq_len = word_seq.size();
+    unsigned left = context_left_size,
+        right = context_right_size;
+    padded_word_exprs.resize(left + seq_len + right);
+    for( unsigned i = 0; i < left; ++i ){ padded_word_exprs[i] = word_sos_expr; }
+    for( unsigned i = 0; i < seq_len; ++i ){ padded_word_exprs[left + i] = build_word_expr(word_seq[i]); }
+    for( unsigned i = 0; i < right; ++i ){ padded_word_exprs[left + seq_len + i] = word_eos_expr; }
+    context_word_exprs.resize(left + right);
+    context_feature_exprs.resize(seq_len);
     for( unsigned i = 0; i < seq_len; ++i )
     {
-        tmp_context_feature_exprs.at(i) = build_feature_expr(context_feature_data_seq.at(i));
+        unsigned center = left + i; // position i in padded sequence
+        unsigned feature_idx = 0;
+        for( unsigned offset = 1; offset <= left; ++offset ){ context_word_exprs[feature_idx++] = padded_word_exprs[center - offset]; }
+        for( unsigned offset = 1; offset <= right; ++offset ){ context_word_exprs[feature_idx++] = padded_word_exprs[center + offset]; }
+        context_feature_exprs[i] = cnn::expr::concatenate(context_word_exprs);
     }
-    swap(context_feature_exprs, tmp_context_feature_exprs);
 }
 
 } // end of namespace slnn
@@ -0,0 +1,302 @@
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+#include <boost/log/trivial.hpp>
+#include "fixed_embedding_table.h"
+
+namespace slnn{
+
+const unsigned FixedEmbeddingTable::PQMaxNrCentroids;
+
+FixedEmbeddingTable::Storage FixedEmbeddingTable::parse_storage(const std::string &name)
+{
+    if( name == "float" ){ return Storage::Float32; }
+    else if( name == "fp16" ){ return Storage::Float16; }
+    else if( name == "bf16" ){ return Storage::BFloat16; }
+    else if( name == "pq" ){ return Storage::ProductQuantized; }
+    throw std::runtime_error("unknown fixed embedding storage `" + name + "` , should be one of [float, fp16, bf16, pq] .");
+}
+
+std::string FixedEmbeddingTable::storage_name(Storage storage)
+{
+    switch( storage )
+    {
+    case Storage::Float16: return "fp16";
+    case Storage::BFloat16: return "bf16";
+    case Storage::ProductQuantized: return "pq";
+    default: return "float";
+    }
+}
+
+void FixedEmbeddingTable::set_pq_param(unsigned nr_subspaces, unsigned nr_kmeans_iter)
+{
+    this->nr_subspaces = nr_subspaces;
+    this->nr_kmeans_iter = nr_kmeans_iter;
+}
+
+void FixedEmbeddingTable::resize(unsigned vocab_size, unsigned dim)
+{
+    this->vocab_size = vocab_size;
+    this->dim = dim;
+    if( storage == Storage::ProductQuantized )
+    {
+        values.clear();
+        building_rows.assign(static_cast<size_t>(vocab_size) * dim, 0.f);
+        if( nr_subspaces == 0 ){ nr_subspaces = std::max(dim / 4, 1U); }
+        nr_subspaces = std::min(nr_subspaces, dim);
+        build_subspace_offsets();
+    }
+    else{ values.assign(static_cast<size_t>(vocab_size) * dim, 0); }
+}
+
+void FixedEmbeddingTable::build_subspace_offsets()
+{
+    // sub-space sizes differ by at most 1
+    subspace_offsets.resize(nr_subspaces + 1);
+    for( unsigned s = 0; s <= nr_subspaces; ++s )
+    {
+        subspace_offsets[s] = static_cast<unsigned>(static_cast<unsigned long long>(dim) * s / nr_subspaces);
+    }
+}
+
+void FixedEmbeddingTable::set_row(Index id, const std::vector<float> &row)
+{
+    if( id < 0 || static_cast<unsigned>(id) >= vocab_size || row.size() != dim )
+    {
+        throw std::runtime_error("fixed embedding row out of range .");
+    }
+    if( storage == Storage::ProductQuantized )
+    {
+        std::copy(row.begin(), row.end(), building_rows.begin() + static_cast<size_t>(id) * dim);
+        return;
+    }
+    uint16_t *dst = values.data() + static_cast<size_t>(id) * dim;
+    for( unsigned i = 0; i < dim; ++i )
+    {
+        dst[i] = storage == Storage::BFloat16 ? float2bfloat16(row[i]) : float2half(row[i]);
+    }
+}
+
+void FixedEmbeddingTable::finish_building()
+{
+    if( storage != Storage::ProductQuantized ){ return; }
+    std::vector<float> rows;
+    rows.swap(building_rows);
+    train_codebooks(rows);
+}
+
+void FixedEmbeddingTable::train_codebooks(std::vector<float> &rows)
+{
+    // k-means on a strided sample of rows for every sub-space , then encode all rows
+    const size_t MaxNrSamples = 256 * PQMaxNrCentroids;
+    unsigned nr_centroids = std::min(vocab_size, PQMaxNrCentroids);
+    size_t nr_samples = std::min(static_cast<size_t>(vocab_size), MaxNrSamples);
+    std::vector<unsigned> sample_ids(nr_samples);
+    for( size_t i = 0; i < nr_samples; ++i ){ sample_ids[i] = static_cast<unsigned>(i * vocab_size / nr_samples); }
+    codebooks.assign(static_cast<size_t>(PQMaxNrCentroids) * dim, 0.f);
+    codes.assign(static_cast<size_t>(vocab_size) * nr_subspaces, 0);
+    if( nr_centroids == 0 ){ return; }
+    std::vector<unsigned> assignment(nr_samples),
+        cluster_size(nr_centroids);
+    std::vector<double> cluster_sum;
+    double total_error = 0.,
+        total_norm = 0.;
+    for( unsigned s = 0; s < nr_subspaces; ++s )
+    {
+        unsigned offset = subspace_offsets[s],
+            sub_dim = subspace_offsets[s + 1] - offset;
+        float *centroids = codebooks.data() + static_cast<size_t>(PQMaxNrCentroids) * offset;
+        auto sub_row = [&rows, offset, this](size_t row_id){ return rows.data() + row_id * dim + offset; };
+        auto nearest = [centroids, nr_centroids, sub_dim](const float *x, double &min_dist)
+        {
+            unsigned best = 0;
+            min_dist = std::numeric_limits<double>::max();
+            for( unsigned k = 0; k < nr_centroids; ++k )
+            {
+                const float *c = centroids + static_cast<size_t>(k) * sub_dim;
+                double dist = 0.;
+                for( unsigned d = 0; d < sub_dim; ++d ){ double diff = x[d] - c[d]; dist += diff * diff; }
+                if( dist < min_dist ){ min_dist = dist; best = k; }
+            }
+            return best;
+        };
+        // initialize with evenly spaced samples
+        for( unsigned k = 0; k < nr_centroids; ++k )
+        {
+            const float *x = sub_row(sample_ids[static_cast<size_t>(k) * nr_samples / nr_centroids]);
+            std::copy(x, x + sub_dim, centroids + static_cast<size_t>(k) * sub_dim);
+        }
+        for( unsigned iter = 0; iter < nr_kmeans_iter; ++iter )
+        {
+            double dist;
+            for( size_t i = 0; i < nr_samples; ++i ){ assignment[i] = nearest(sub_row(sample_ids[i]), dist); }
+            cluster_sum.assign(static_cast<size_t>(nr_centroids) * sub_dim, 0.);
+            std::fill(cluster_size.begin(), cluster_size.end(), 0);
+            for( size_t i = 0; i < nr_samples; ++i )
+            {
+                const float *x = sub_row(sample_ids[i]);
+                double *sum = cluster_sum.data() + static_cast<size_t>(assignment[i]) * sub_dim;
+                for( unsigned d = 0; d < sub_dim; ++d ){ sum[d] += x[d]; }
+                ++cluster_size[assignment[i]];
+            }
+            for( unsigned k = 0; k < nr_centroids; ++k )
+            {
+                float *c = centroids + static_cast<size_t>(k) * sub_dim;
+                if( cluster_size[k] == 0 )
+                {
+                    // re-seed an empty cluster with a sample
+                    const float *x = sub_row(sample_ids[(static_cast<size_t>(k) * 7919 + iter) % nr_samples]);
+                    std::copy(x, x + sub_dim, c);
+                    continue;
+                }
+                const double *sum = cluster_sum.data() + static_cast<size_t>(k) * sub_dim;
+                for( unsigned d = 0; d < sub_dim; ++d ){ c[d] = static_cast<float>(sum[d] / cluster_size[k]); }
+            }
+        }
+        for( size_t row_id = 0; row_id < vocab_size; ++row_id )
+        {
+            const float *x = sub_row(row_id);
+            double dist;
+            codes[row_id * nr_subspaces + s] = static_cast<uint8_t>(nearest(x, dist));
+            total_error += dist;
+            for( unsigned d = 0; d < sub_dim; ++d ){ total_norm += static_cast<double>(x[d]) * x[d]; }
+        }
+    }
+    BOOST_LOG_TRIVIAL(info) << "product quantization : " << nr_subspaces << " sub-spaces , " << nr_centroids << " centroids , "
+        << "relative squared error = " << (total_norm > 0. ? total_error / total_norm : 0.);
+}
+
+void FixedEmbeddingTable::get_row(Index id, float *out) const
+{
+    if( storage == Storage::ProductQuantized )
+    {
+        const uint8_t *row_codes = codes.data() + static_cast<size_t>(id) * nr_subspaces;
+        for( unsigned s = 0; s < nr_subspaces; ++s )
+        {
+            unsigned offset = subspace_offsets[s],
+                sub_dim = subspace_offsets[s + 1] - offset;
+            const float *c = codebooks.data() + static_cast<size_t>(PQMaxNrCentroids) * offset
+                + static_cast<size_t>(row_codes[s]) * sub_dim;
+            std::copy(c, c + sub_dim, out + offset);
+        }
+        return;
+    }
+    const uint16_t *src = values.data() + static_cast<size_t>(id) * dim;
+    if( storage == Storage::BFloat16 )
+    {
+        for( unsigned i = 0; i < dim; ++i ){ out[i] = bfloat162float(src[i]); }
+        return;
+    }
+    unsigned i = 0;
+#if defined(__F16C__)
+    for( ; i + 8 <= dim; i += 8 )
+    {
+        __m128i half8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(half8));
+    }
+#endif
+    for( ; i < dim; ++i ){ out[i] = half2float(src[i]); }
+}
+
+cnn::expr::Expression FixedEmbeddingTable::lookup(cnn::ComputationGraph &cg, Index id) const
+{
+    return cnn::expr::Expression(&cg, cg.add_function<FixedEmbeddingLookupNode>({}, this, id));
+}
+
+uint16_t FixedEmbeddingTable::float2half(float val)
+{
+    // round to nearest even , overflow to inf , underflow to (sub-normal) zero
+    uint32_t x;
+    std::memcpy(&x, &val, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000,
+        abs_x = x & 0x7fffffff;
+    if( abs_x >= 0x7f800000 ){ return static_cast<uint16_t>(sign | 0x7c00 | (abs_x > 0x7f800000 ? 0x200 : 0)); } // inf , nan
+    if( abs_x >= 0x477ff000 ){ return static_cast<uint16_t>(sign | 0x7c00); } // >= 65520 rounds to inf
+    if( abs_x < 0x38800000 )
+    {
+        // sub-normal half (or zero)
+        if( abs_x < 0x33000000 ){ return static_cast<uint16_t>(sign); }
+        uint32_t shift = 126 - (abs_x >> 23),
+            mantissa = (abs_x & 0x7fffff) | 0x800000;
+        uint32_t half_mantissa = mantissa >> shift,
+            rest = mantissa & ((1U << shift) - 1),
+            halfway = 1U << (shift - 1);
+        if( rest > halfway || (rest == halfway && (half_mantissa & 1)) ){ ++half_mantissa; }
+        return static_cast<uint16_t>(sign | half_mantissa);
+    }
+    uint32_t half_bits = ((abs_x - 0x38000000) >> 13),
+        rest = abs_x & 0x1fff;
+    if( rest > 0x1000 || (rest == 0x1000 && (half_bits & 1)) ){ ++half_bits; }
+    return static_cast<uint16_t>(sign | half_bits);
+}
+
+float FixedEmbeddingTable::half2float(uint16_t val)
+{
+    uint32_t sign = static_cast<uint32_t>(val & 0x8000) << 16,
+        exponent = (val >> 10) & 0x1f,
+        mantissa = val & 0x3ff,
+        x;
+    if( exponent == 0x1f ){ x = sign | 0x7f800000 | (mantissa << 13); }
+    else if( exponent != 0 ){ x = sign | ((exponent + 112) << 23) | (mantissa << 13); }
+    else if( mantissa == 0 ){ x = sign; }
+    else
+    {
+        // normalize the sub-normal half
+        exponent = 113;
+        while( (mantissa & 0x400) == 0 ){ mantissa <<= 1; --exponent; }
+        x = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    float ret;
+    std::memcpy(&ret, &x, sizeof(ret));
+    return ret;
+}
+
+uint16_t FixedEmbeddingTable::float2bfloat16(float val)
+{
+    uint32_t x;
+    std::memcpy(&x, &val, sizeof(x));
+    if( (x & 0x7fffffff) > 0x7f800000 ){ return static_cast<uint16_t>((x >> 16) | 0x40); } // keep nan quiet
+    x += 0x7fff + ((x >> 16) & 1); // round to nearest even
+    return static_cast<uint16_t>(x >> 16);
+}
+
+float FixedEmbeddingTable::bfloat162float(uint16_t val)
+{
+    uint32_t x = static_cast<uint32_t>(val) << 16;
+    float ret;
+    std::memcpy(&ret, &x, sizeof(ret));
+    return ret;
+}
+
+std::string FixedEmbeddingLookupNode::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream oss;
+    oss << "fixed_embedding_lookup(" << FixedEmbeddingTable::storage_name(table->get_storage()) << ", " << id << ")";
+    return oss.str();
+}
+
+cnn::Dim FixedEmbeddingLookupNode::dim_forward(const std::vector<cnn::Dim>& xs) const
+{
+    return cnn::Dim({ table->get_dim() });
+}
+
+void FixedEmbeddingLookupNode::forward_impl(const std::vector<const cnn::Tensor*>& xs, cnn::Tensor& fx) const
+{
+    table->get_row(id, fx.v);
+}
+
+void FixedEmbeddingLookupNode::backward_impl(const std::vector<const cnn::Tensor*>& xs,
+    const cnn::Tensor& fx,
+    const cnn::Tensor& dEdf,
+    unsigned i,
+    cnn::Tensor& dEdxi) const
+{
+    throw std::runtime_error("fixed embedding lookup node has no argument to back-propagate to .");
+}
+
+} // end of namespace slnn
@@ -0,0 +1,146 @@
+#ifndef SLNN_MODELMODULE_FIXED_EMBEDDING_TABLE_H_
+#define SLNN_MODELMODULE_FIXED_EMBEDDING_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/vector.hpp>
+#include "cnn/cnn.h"
+#include "cnn/nodes.h"
+#include "cnn/expr.h"
+#include "utils/typedeclaration.h"
+
+namespace slnn{
+
+/**
+ * compact storage of a pre-trained (fixed) embedding table , out of `cnn::Model` .
+ * rows are stored in 16 bits (IEEE half or bfloat16) , or product-quantized :
+ * the dimensions are split into sub-spaces , every sub-space has a codebook of (at most) 256 centroids
+ * learned by k-means , and a row is one byte code per sub-space .
+ * the compact form is kept in memory and in the model file ,
+ * and only the rows gathered for a sentence are decoded to float (`lookup`) .
+ * the table is a constant input , it is not fine-tuned when training .
+ * `Float32` means no compact table , the layer keeps its `cnn::LookupParameters` .
+ */
+class FixedEmbeddingTable
+{
+    friend class boost::serialization::access;
+public:
+    enum class Storage : int
+    {
+        Float32 = 0,
+        Float16 = 1,
+        BFloat16 = 2,
+        ProductQuantized = 3
+    };
+    static const unsigned PQMaxNrCentroids = 256;
+    // "float" , "fp16" , "bf16" , "pq" , throw for others
+    static Storage parse_storage(const std::string &name);
+    static std::string storage_name(Storage storage);
+
+    FixedEmbeddingTable() : storage(Storage::Float32), vocab_size(0), dim(0), nr_subspaces(0), nr_kmeans_iter(10){}
+    void set_storage(Storage storage){ this->storage = storage; }
+    // `nr_subspaces` = 0 for one sub-space every 4 dimensions
+    void set_pq_param(unsigned nr_subspaces, unsigned nr_kmeans_iter);
+    Storage get_storage() const { return storage; }
+    bool is_compact() const { return storage != Storage::Float32; }
+    // all rows are zero after resizing
+    void resize(unsigned vocab_size, unsigned dim);
+    void set_row(Index id, const std::vector<float> &row);
+    // called after all rows are set . product quantization learns the codebooks and encodes the rows here ,
+    // rows are buffered in float until then
+    void finish_building();
+    void get_row(Index id, float *out) const;
+    unsigned get_vocab_size() const { return vocab_size; }
+    unsigned get_dim() const { return dim; }
+    size_t get_memory_bytes() const
+    {
+        return values.size() * sizeof(uint16_t) + codebooks.size() * sizeof(float) + codes.size() * sizeof(uint8_t);
+    }
+    // constant expression of row `id`
+    cnn::expr::Expression lookup(cnn::ComputationGraph &cg, Index id) const;
+
+    static uint16_t float2half(float val);
+    static float half2float(uint16_t val);
+    static uint16_t float2bfloat16(float val);
+    static float bfloat162float(uint16_t val);
+
+    template <typename Archive>
+    void save(Archive &ar, const unsigned version) const;
+    template <typename Archive>
+    void load(Archive &ar, const unsigned version);
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+private:
+    Storage storage;
+    unsigned vocab_size,
+        dim;
+    void build_subspace_offsets();
+    void train_codebooks(std::vector<float> &rows);
+    std::vector<uint16_t> values; // vocab_size * dim , row-major , for 16-bits storage
+    // product quantization
+    unsigned nr_subspaces,
+        nr_kmeans_iter;
+    std::vector<unsigned> subspace_offsets; // nr_subspaces + 1
+    std::vector<float> codebooks; // sub-space s , centroid k at [PQMaxNrCentroids * offsets[s] + k * sub_dim(s)]
+    std::vector<uint8_t> codes; // vocab_size * nr_subspaces
+    std::vector<float> building_rows; // float rows before `finish_building` , cleared after
+};
+
+/**
+ * widens one row of a `FixedEmbeddingTable` into the output tensor . no argument , no gradient .
+ */
+struct FixedEmbeddingLookupNode : public cnn::Node
+{
+    FixedEmbeddingLookupNode(const std::initializer_list<cnn::VariableIndex> &args,
+        const FixedEmbeddingTable *table, Index id) : cnn::Node(args), table(table), id(id){}
+    std::string as_string(const std::vector<std::string>& arg_names) const override;
+    cnn::Dim dim_forward(const std::vector<cnn::Dim>& xs) const override;
+    void forward_impl(const std::vector<const cnn::Tensor*>& xs, cnn::Tensor& fx) const override;
+    void backward_impl(const std::vector<const cnn::Tensor*>& xs,
+        const cnn::Tensor& fx,
+        const cnn::Tensor& dEdf,
+        unsigned i,
+        cnn::Tensor& dEdxi) const override;
+
+    const FixedEmbeddingTable *table;
+    Index id;
+};
+
+/*************** inline implementation ***************/
+
+template <typename Archive>
+void FixedEmbeddingTable::save(Archive &ar, const unsigned version) const
+{
+    int storage_val = static_cast<int>(storage);
+    ar & storage_val & vocab_size & dim;
+    if( storage == Storage::ProductQuantized ){ ar & nr_subspaces & codebooks & codes; }
+    else if( is_compact() ){ ar & values; }
+}
+
+template <typename Archive>
+void FixedEmbeddingTable::load(Archive &ar, const unsigned version)
+{
+    int storage_val;
+    ar & storage_val & vocab_size & dim;
+    storage = static_cast<Storage>(storage_val);
+    values.clear();
+    if( storage == Storage::ProductQuantized )
+    {
+        ar & nr_subspaces & codebooks & codes;
+        build_subspace_offsets();
+        if( codes.size() != static_cast<size_t>(vocab_size) * nr_subspaces ||
+            codebooks.size() != static_cast<size_t>(PQMaxNrCentroids) * dim )
+        {
+            throw std::runtime_error("fixed embedding table is broken .");
+        }
+        return;
+    }
+    if( is_compact() ){ ar & values; }
+    if( values.size() != static_cast<size_t>(vocab_size) * dim ){ throw std::runtime_error("fixed embedding table is broken ."); }
+}
+
+} // end of namespace slnn
+
+#endif
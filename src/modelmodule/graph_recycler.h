@@ -0,0 +1,128 @@
+#ifndef SLNN_MODELMODULE_GRAPH_RECYCLER_H_
+#define SLNN_MODELMODULE_GRAPH_RECYCLER_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "cnn/cnn.h"
+
+namespace slnn{
+
+/**
+ * Recycle ONE computation graph for all sentences of a worker (train / devel / predict loop) .
+ * parameter nodes added by layers' `new_graph` are built at the first sentence and persist ,
+ * `next_graph()` only deletes the nodes added after them (lookup , input , rnn states , outputs ...) ,
+ * so the graph setup cost of a sentence does not scale with the number of parameters .
+ *
+ * handler side :
+ *     model->set_graph_recycler(&graph_recycler); // once
+ *     cnn::ComputationGraph &cg = graph_recycler.next_graph();
+ *     model->predict(cg, ...);
+ * model side :
+ *     if( GraphRecycler::need_new_graph(graph_recycler, cg) )
+ *     {
+ *         layer->new_graph(cg); ...
+ *         GraphRecycler::mark_persistent(graph_recycler, cg);
+ *     }
+ * a graph not from the given recycler (or a null recycler) always needs `new_graph` , so models keep working
+ * with a plain graph .
+ * cnn permits only one computation graph at the same time , so at most one recycler should be alive ,
+ * and no other graph should be created while the recycler holds its graph .
+ */
+class GraphRecycler
+{
+public:
+    GraphRecycler();
+    ~GraphRecycler();
+    GraphRecycler(const GraphRecycler&) = delete;
+    GraphRecycler& operator=(const GraphRecycler&) = delete;
+
+    cnn::ComputationGraph& next_graph();
+    void release();
+
+    // `recycler` may be nullptr
+    static bool need_new_graph(const GraphRecycler *recycler, const cnn::ComputationGraph &cg);
+    static void mark_persistent(GraphRecycler *recycler, const cnn::ComputationGraph &cg);
+
+private:
+    void recycle();
+
+    cnn::ComputationGraph *pcg;
+    size_t nr_persistent_nodes;
+    bool is_persistent_ready;
+};
+
+/*************** inline implementation ***************/
+
+inline
+GraphRecycler::GraphRecycler()
+    :pcg(nullptr),
+    nr_persistent_nodes(0),
+    is_persistent_ready(false)
+{}
+
+inline
+GraphRecycler::~GraphRecycler()
+{
+    release();
+}
+
+inline
+cnn::ComputationGraph& GraphRecycler::next_graph()
+{
+    // graph is created lazily , cnn should have been initialized at the first call
+    if( nullptr == pcg ){ pcg = new cnn::ComputationGraph(); }
+    else { recycle(); }
+    return *pcg;
+}
+
+inline
+void GraphRecycler::release()
+{
+    if( nullptr == pcg ){ return; }
+    delete pcg;
+    pcg = nullptr;
+    nr_persistent_nodes = 0;
+    is_persistent_ready = false;
+}
+
+inline
+void GraphRecycler::recycle()
+{
+    if( !is_persistent_ready )
+    {
+        // the last sentence didn't mark persistent nodes (model not recycle-aware) , drop all .
+        release();
+        pcg = new cnn::ComputationGraph();
+        return;
+    }
+    std::vector<cnn::Node*> &nodes = pcg->nodes;
+    for( size_t i = nr_persistent_nodes; i < nodes.size(); ++i ){ delete nodes[i]; }
+    nodes.resize(nr_persistent_nodes);
+    // lookup nodes of the last sentence are also registered as parameter nodes
+    size_t nr_persistent = nr_persistent_nodes;
+    std::vector<cnn::VariableIndex> &parameter_nodes = pcg->parameter_nodes;
+    parameter_nodes.erase(std::remove_if(parameter_nodes.begin(), parameter_nodes.end(),
+        [nr_persistent](cnn::VariableIndex i){ return static_cast<size_t>(i) >= nr_persistent; }),
+        parameter_nodes.end());
+    // forward values (and memory pool) are dropped , parameter nodes will re-read the updated parameters
+    pcg->invalidate();
+}
+
+inline
+bool GraphRecycler::need_new_graph(const GraphRecycler *recycler, const cnn::ComputationGraph &cg)
+{
+    return !( recycler && recycler->pcg == &cg && recycler->is_persistent_ready );
+}
+
+inline
+void GraphRecycler::mark_persistent(GraphRecycler *recycler, const cnn::ComputationGraph &cg)
+{
+    if( !recycler || recycler->pcg != &cg ){ return; }
+    recycler->nr_persistent_nodes = cg.nodes.size();
+    recycler->is_persistent_ready = true;
+}
+
+} // end of namespace slnn
+
+#endif
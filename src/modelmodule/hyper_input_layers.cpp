@@ -15,9 +15,10 @@ Input1::~Input1()
 
 Input1WithFeature::Input1WithFeature(cnn::Model *m, unsigned vocab_size, unsigned embedding_dim,
     unsigned feature_embedding_dim, unsigned merge_out_dim,
-    NonLinearFunc *nonlinear_func)
+    NonLinearFunc *nonlinear_func,
+    AffineWeights *affine_weights)
     :word_lookup_param(m->add_lookup_parameters(vocab_size, { embedding_dim })),
-    m2_layer(m,embedding_dim, feature_embedding_dim, merge_out_dim),
+    m2_layer(m,embedding_dim, feature_embedding_dim, merge_out_dim, affine_weights),
     nonlinear_func(nonlinear_func)
 {}
 
@@ -43,6 +44,18 @@ Input2::Input2(cnn::Model *m, unsigned dynamic_vocab_size, unsigned dynamic_embe
     NonLinearFunc *nonlinear_func) 
     :dynamic_lookup_param(m->add_lookup_parameters(dynamic_vocab_size, {dynamic_embedding_dim})) ,
     fixed_lookup_param(m->add_lookup_parameters(fixed_vocab_size , {fixed_embedding_dim})) ,
+    fixed_table(nullptr),
+    m2_layer(m , dynamic_embedding_dim , fixed_embedding_dim , mergeout_dim) ,
+    nonlinear_func(nonlinear_func)
+{}
+
+Input2::Input2(cnn::Model *m, unsigned dynamic_vocab_size, unsigned dynamic_embedding_dim,
+    const FixedEmbeddingTable *fixed_table, unsigned fixed_embedding_dim,
+    unsigned mergeout_dim ,
+    NonLinearFunc *nonlinear_func) 
+    :dynamic_lookup_param(m->add_lookup_parameters(dynamic_vocab_size, {dynamic_embedding_dim})) ,
+    fixed_lookup_param(nullptr) ,
+    fixed_table(fixed_table),
     m2_layer(m , dynamic_embedding_dim , fixed_embedding_dim , mergeout_dim) ,
     nonlinear_func(nonlinear_func)
 {}
@@ -57,6 +70,18 @@ Input2WithFeature::Input2WithFeature(cnn::Model *m, unsigned dynamic_vocab_size,
     unsigned mergeout_dim , NonLinearFunc *nonlinear_func)
     :dynamic_lookup_param(m->add_lookup_parameters(dynamic_vocab_size, {dynamic_embedding_dim})) ,
     fixed_lookup_param(m->add_lookup_parameters(fixed_vocab_size , {fixed_embedding_dim})) ,
+    fixed_table(nullptr),
+    m3_layer(m,dynamic_embedding_dim, fixed_embedding_dim, feature_embedding_dim, mergeout_dim),
+    nonlinear_func(nonlinear_func)
+{}
+
+Input2WithFeature::Input2WithFeature(cnn::Model *m, unsigned dynamic_vocab_size, unsigned dynamic_embedding_dim,
+    const FixedEmbeddingTable *fixed_table, unsigned fixed_embedding_dim,
+    unsigned feature_embedding_dim,
+    unsigned mergeout_dim , NonLinearFunc *nonlinear_func)
+    :dynamic_lookup_param(m->add_lookup_parameters(dynamic_vocab_size, {dynamic_embedding_dim})) ,
+    fixed_lookup_param(nullptr) ,
+    fixed_table(fixed_table),
     m3_layer(m,dynamic_embedding_dim, fixed_embedding_dim, feature_embedding_dim, mergeout_dim),
     nonlinear_func(nonlinear_func)
 {}
@@ -3,6 +3,7 @@
 
 #include <initializer_list>
 #include "layers.h"
+#include "fixed_embedding_table.h"
 #include "utils/typedeclaration.h"
 
 namespace slnn{
@@ -26,7 +27,8 @@ struct Input1WithFeature
     NonLinearFunc *nonlinear_func;
     Input1WithFeature(cnn::Model *m, unsigned vocab_size, unsigned embedding_dim,
         unsigned feature_embedding_dim, unsigned merge_out_dim,
-        NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
+        NonLinearFunc *nonlinear_func=&cnn::expr::rectify,
+        AffineWeights *affine_weights=nullptr);
     cnn::LookupParameters *get_lookup_param(){ return word_lookup_param; }
     void new_graph(cnn::ComputationGraph &cg);
     void build_inputs(const IndexSeq &sent , const std::vector<cnn::expr::Expression> &feature_exprs,
@@ -52,7 +54,8 @@ struct Input2D
 struct Input2
 {
     cnn::LookupParameters *dynamic_lookup_param,
-        *fixed_lookup_param;
+        *fixed_lookup_param; // nullptr if the fixed channel is a compact table
+    const FixedEmbeddingTable *fixed_table;
     Merge2Layer m2_layer;
     cnn::ComputationGraph *pcg;
     NonLinearFunc *nonlinear_func;
@@ -60,6 +63,10 @@ struct Input2
     Input2(cnn::Model *m, unsigned dynamic_vocab_size, unsigned dynamic_embedding_dim,
         unsigned fixed_vocab_size, unsigned fixed_embedding_dim,
         unsigned mergeout_dim , NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
+    // fixed channel from a compact table (owned by the model , not in `m`) , constant : NOT fine-tuned as the float one
+    Input2(cnn::Model *m, unsigned dynamic_vocab_size, unsigned dynamic_embedding_dim,
+        const FixedEmbeddingTable *fixed_table, unsigned fixed_embedding_dim,
+        unsigned mergeout_dim , NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
     ~Input2();
     void new_graph(cnn::ComputationGraph &cg);
     void build_inputs(const IndexSeq &dynamic_sent, const IndexSeq &fixed_sent, 
@@ -69,7 +76,8 @@ struct Input2
 struct Input2WithFeature
 {
     cnn::LookupParameters *dynamic_lookup_param,
-        *fixed_lookup_param;
+        *fixed_lookup_param; // nullptr if the fixed channel is a compact table
+    const FixedEmbeddingTable *fixed_table;
     Merge3Layer m3_layer;
     cnn::ComputationGraph *pcg;
     NonLinearFunc *nonlinear_func;
@@ -78,6 +86,11 @@ struct Input2WithFeature
         unsigned fixed_vocab_size, unsigned fixed_embedding_dim,
         unsigned feature_embedding_dim,
         unsigned mergeout_dim , NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
+    // fixed channel from a compact table (owned by the model , not in `m`) , constant : NOT fine-tuned as the float one
+    Input2WithFeature(cnn::Model *m, unsigned dynamic_vocab_size, unsigned dynamic_embedding_dim,
+        const FixedEmbeddingTable *fixed_table, unsigned fixed_embedding_dim,
+        unsigned feature_embedding_dim,
+        unsigned mergeout_dim , NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
     ~Input2WithFeature();
     void new_graph(cnn::ComputationGraph &cg);
     void build_inputs(const IndexSeq &dynamic_sent, const IndexSeq &fixed_sent, 
@@ -123,6 +136,8 @@ struct AnotherBareInput1
 {
     cnn::LookupParameters *word_lookup_param;
     cnn::ComputationGraph *pcg;
+    std::vector<cnn::expr::Expression> concated_exprs, // buffers , reused across sentences
+        feature_group;
     AnotherBareInput1(cnn::Model *m, unsigned vocabulary_size, unsigned word_embedding_dim);
     void new_graph(cnn::ComputationGraph &cg);
     void build_inputs(const IndexSeq &sent, const std::vector<std::vector<cnn::expr::Expression> *> &extra_feature_ptr_exprs_seq,
@@ -145,12 +160,11 @@ void Input1::build_inputs(const IndexSeq &sent, std::vector<cnn::expr::Expressio
 {
     if (nullptr == pcg) throw std::runtime_error("cg should be set .");
     size_t sent_len = sent.size();
-    std::vector<cnn::expr::Expression> tmp_inputs(sent_len);
+    inputs_exprs.resize(sent_len);
     for (size_t i = 0; i < sent_len; ++i)
     {
-        tmp_inputs[i] = lookup(*pcg, word_lookup_param, sent[i]);
+        inputs_exprs[i] = lookup(*pcg, word_lookup_param, sent[i]);
     }
-    std::swap(inputs_exprs, tmp_inputs);
 }
 
 /******* input with feature ******/
@@ -166,18 +180,16 @@ void Input1WithFeature::build_inputs(const IndexSeq &sent,
     const std::vector<cnn::expr::Expression> &features_exprs,
     std::vector<cnn::expr::Expression> &inputs_exprs)
 {
-    using std::swap;
     if (nullptr == pcg) throw std::runtime_error("cg should be set .");
     size_t sent_len = sent.size();
-    std::vector<cnn::expr::Expression> tmp_inputs(sent_len);
+    inputs_exprs.resize(sent_len);
     for (size_t i = 0; i < sent_len; ++i)
     {
         cnn::expr::Expression word_expr = lookup(*pcg, word_lookup_param, sent[i]);
         const cnn::expr::Expression &feature_expr = features_exprs[i];
         cnn::expr::Expression merge_expr = m2_layer.build_graph(word_expr, feature_expr);
-        tmp_inputs[i] = (*nonlinear_func)(merge_expr);
+        inputs_exprs[i] = (*nonlinear_func)(merge_expr);
     }
-    std::swap(inputs_exprs, tmp_inputs);
 }
 /******* input 2d  *******/
 inline
@@ -191,16 +203,15 @@ inline
 void Input2D::build_inputs(const IndexSeq &seq1, const IndexSeq &seq2, std::vector<cnn::expr::Expression> &inputs_exprs )
 {
     size_t seq_len = seq1.size();
-    std::vector<cnn::expr::Expression> tmp_inputs(seq_len);
+    inputs_exprs.resize(seq_len);
     for (size_t i = 0; i < seq_len; ++i)
     {
         cnn::expr::Expression expr1 = lookup(*pcg, dynamic_lookup_param1, seq1.at(i));
         cnn::expr::Expression expr2 = lookup(*pcg, dynamic_lookup_param2, seq2.at(i));
         cnn::expr::Expression linear_merge_expr = m2_layer.build_graph(expr1, expr2);
         cnn::expr::Expression nonlinear_expr = nonlinear_func(linear_merge_expr);
-        tmp_inputs[i] = nonlinear_expr;
+        inputs_exprs[i] = nonlinear_expr;
     }
-    std::swap(inputs_exprs, tmp_inputs);
 }
 
 /******** input 2 ***********/
@@ -215,16 +226,16 @@ inline
 void Input2::build_inputs(const IndexSeq &dynamic_seq, const IndexSeq &fixed_seq, std::vector<cnn::expr::Expression> &inputs_exprs)
 {
     size_t seq_len = dynamic_seq.size();
-    std::vector<cnn::expr::Expression> tmp_inputs(seq_len);
+    inputs_exprs.resize(seq_len);
     for (size_t i = 0; i < seq_len; ++i)
     {
         cnn::expr::Expression expr1 = lookup(*pcg, dynamic_lookup_param, dynamic_seq.at(i));
-        cnn::expr::Expression expr2 = lookup(*pcg, fixed_lookup_param, fixed_seq.at(i));
+        cnn::expr::Expression expr2 = fixed_table ? fixed_table->lookup(*pcg, fixed_seq.at(i)) :
+            lookup(*pcg, fixed_lookup_param, fixed_seq.at(i));
         cnn::expr::Expression linear_merge_expr = m2_layer.build_graph(expr1, expr2);
         cnn::expr::Expression nonlinear_expr = nonlinear_func(linear_merge_expr);
-        tmp_inputs[i] = nonlinear_expr;
+        inputs_exprs[i] = nonlinear_expr;
     }
-    std::swap(inputs_exprs, tmp_inputs);
 }
 
 /* input2 with  feature */
@@ -240,16 +251,16 @@ void Input2WithFeature::build_inputs(const IndexSeq &dynamic_sent, const IndexSe
     std::vector<cnn::expr::Expression> &inputs_exprs)
 {
     size_t seq_len = dynamic_sent.size();
-    std::vector<cnn::expr::Expression> tmp_inputs(seq_len);
+    inputs_exprs.resize(seq_len);
     for (size_t i = 0; i < seq_len; ++i)
     {
         cnn::expr::Expression expr1 = lookup(*pcg, dynamic_lookup_param, dynamic_sent.at(i));
-        cnn::expr::Expression expr2 = lookup(*pcg, fixed_lookup_param, fixed_sent.at(i));
+        cnn::expr::Expression expr2 = fixed_table ? fixed_table->lookup(*pcg, fixed_sent.at(i)) :
+            lookup(*pcg, fixed_lookup_param, fixed_sent.at(i));
         cnn::expr::Expression linear_merge_expr = m3_layer.build_graph(expr1, expr2, feature_exprs.at(i));
         cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(linear_merge_expr);
-        tmp_inputs[i] = nonlinear_expr;
+        inputs_exprs[i] = nonlinear_expr;
     }
-    std::swap(inputs_exprs, tmp_inputs);
 }
 
 /******* input 3  ********/
@@ -265,16 +276,15 @@ void Input3::build_inputs(const IndexSeq &dseq1, const IndexSeq &dseq2, const In
     std::vector<cnn::expr::Expression> &inputs_exprs)
 {
     size_t seq_len = dseq1.size();
-    std::vector<cnn::expr::Expression> tmp_inputs(seq_len);
+    inputs_exprs.resize(seq_len);
     for (size_t i = 0; i < seq_len; ++i)
     {
         cnn::expr::Expression dexpr1 = lookup(*pcg, dynamic_lookup_param1, dseq1.at(i));
         cnn::expr::Expression dexpr2 = lookup(*pcg, dynamic_lookup_param2, dseq2.at(i));
         cnn::expr::Expression fexpr = const_lookup(*pcg, fixed_lookup_param, fseq.at(i));
         cnn::expr::Expression linear_merge_expr = m3_layer.build_graph(dexpr1, dexpr2, fexpr);
-        tmp_inputs[i] = nonlinear_func(linear_merge_expr);
+        inputs_exprs[i] = nonlinear_func(linear_merge_expr);
     }
-    std::swap(inputs_exprs, tmp_inputs);
 }
 /******* bare input1  *******/
 inline
@@ -299,14 +309,12 @@ inline
 void BareInput1::build_inputs(const IndexSeq &sent, const std::vector<std::vector<cnn::expr::Expression>> &extra_feature_exprs_seq,
     std::vector<cnn::expr::Expression> &input_exprs)
 {
-    using std::swap;
     unsigned seq_len = sent.size();
-    std::vector<cnn::expr::Expression> concat_result(seq_len);
+    input_exprs.resize(seq_len);
     for( unsigned i = 0; i < seq_len ; ++i )
     {
-        concat_result[i] = build_input(sent[i], extra_feature_exprs_seq[i]);
+        input_exprs[i] = build_input(sent[i], extra_feature_exprs_seq[i]);
     }
-    swap(concat_result, input_exprs);
 }
 
 /* Another Bare input1 */
@@ -324,8 +332,8 @@ void AnotherBareInput1::build_inputs(const IndexSeq &sent, const std::vector<std
     size_t nr_feature_variety = extra_feature_ptr_expr_gp_seq.size();
     assert(nr_feature_variety > 0);
     size_t feature_seq_len = extra_feature_ptr_expr_gp_seq[0]->size();
-    std::vector<cnn::expr::Expression> concated_exprs(feature_seq_len);
-    std::vector<cnn::expr::Expression> feature_group(nr_feature_variety);
+    concated_exprs.resize(feature_seq_len);
+    feature_group.resize(nr_feature_variety);
     for( size_t j = 0; j < feature_seq_len; ++j )
     {
         for( size_t fi = 0; fi < nr_feature_variety; ++fi )
@@ -341,15 +349,13 @@ inline
 void AnotherBareInput1::build_inputs(const IndexSeq &sent, const std::vector<cnn::expr::Expression> &feature_exprs,
     std::vector<cnn::expr::Expression> &input_exprs)
 {
-    using std::swap;
     unsigned seq_len = sent.size();
-    std::vector<cnn::expr::Expression> tmp_input_exprs(seq_len);
+    input_exprs.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
         cnn::expr::Expression word_expr = lookup(*pcg, word_lookup_param, sent[i]);
-        tmp_input_exprs[i] = cnn::expr::concatenate({ word_expr, feature_exprs[i] });
+        input_exprs[i] = cnn::expr::concatenate({ word_expr, feature_exprs[i] });
     }
-    swap(input_exprs, tmp_input_exprs);
 }
 
 } // end of namespace slnn
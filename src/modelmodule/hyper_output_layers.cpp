@@ -16,10 +16,11 @@ OutputBase::~OutputBase(){} // base class should implement deconstructor , even
 SimpleOutput::SimpleOutput(cnn::Model *m, unsigned input_dim1, unsigned input_dim2 ,
     unsigned hidden_dim, unsigned output_dim , 
     cnn::real dropout_rate,
-    NonLinearFunc *nonlinear_func)
+    NonLinearFunc *nonlinear_func,
+    AffineWeights *affine_weights)
     : OutputBase(dropout_rate, nonlinear_func),
-    hidden_layer(m , input_dim1 , input_dim2 , hidden_dim) ,
-    output_layer(m , hidden_dim , output_dim) 
+    hidden_layer(m , input_dim1 , input_dim2 , hidden_dim, affine_weights) ,
+    output_layer(m , hidden_dim , output_dim, affine_weights) 
 {}
 
 SimpleOutput::~SimpleOutput() {};
@@ -33,8 +34,8 @@ PretagOutput::PretagOutput(cnn::Model *m,
     :OutputBase(dropout_rate, nonlinear_func),
     hidden_layer(m , input_dim1 , input_dim2 , tag_embedding_dim , hidden_dim) ,
     output_layer(m , hidden_dim , output_dim) ,
-    tag_lookup_param(m->add_lookup_parameters(output_dim , {tag_embedding_dim})) ,
-    TAG_SOS(m->add_parameters({tag_embedding_dim})) 
+    pretag_layer(m, output_dim, tag_embedding_dim, ShiftedIndex2ExprLayer::RightShift, 1), // same parameters order as before
+    beam_size(1)
 {}
 
 PretagOutput::~PretagOutput(){} 
@@ -64,14 +65,22 @@ CRFOutput::build_output_loss(const std::vector<cnn::expr::Expression> &expr_cont
 {
     size_t len = expr_cont1.size() ;
     // viterbi data preparation
-    std::vector<cnn::expr::Expression> all_tag_expr_cont(tag_num);
-    std::vector<cnn::expr::Expression> init_score(tag_num);
-    std::vector<cnn::expr::Expression> trans_score(tag_num * tag_num);
-    std::vector<std::vector<cnn::expr::Expression>> emit_score(len,
-        std::vector<cnn::expr::Expression>(tag_num));
-    std::vector<cnn::expr::Expression> cur_score_expr_cont(tag_num),
-        pre_score_expr_cont(tag_num);
-    std::vector<cnn::expr::Expression> gold_score_expr_cont(len) ;
+    std::vector<cnn::expr::Expression> &all_tag_expr_cont = scratch.all_tag_exprs,
+        &init_score = scratch.init_score_exprs,
+        &trans_score = scratch.trans_score_exprs,
+        &emit_score = scratch.emit_score_exprs, // flat , emit_score[time_step * tag_num + tag]
+        &cur_score_expr_cont = scratch.cur_score_exprs,
+        &pre_score_expr_cont = scratch.pre_score_exprs,
+        &partial_score_expr_cont = scratch.partial_score_exprs,
+        &gold_score_expr_cont = scratch.gold_score_exprs;
+    all_tag_expr_cont.resize(tag_num);
+    init_score.resize(tag_num);
+    trans_score.resize(tag_num * tag_num);
+    emit_score.resize(len * tag_num);
+    cur_score_expr_cont.resize(tag_num);
+    pre_score_expr_cont.resize(tag_num);
+    partial_score_expr_cont.resize(tag_num);
+    gold_score_expr_cont.resize(len);
     // init tag expr , init score
     for( size_t i = 0; i < tag_num ; ++i )
     {
@@ -92,7 +101,7 @@ CRFOutput::build_output_loss(const std::vector<cnn::expr::Expression> &expr_cont
                 expr_cont2[time_step], all_tag_expr_cont[i]);
             cnn::expr::Expression non_linear_expr = (*nonlinear_func)(hidden_out_expr) ;
             cnn::expr::Expression dropout_expr = dropout(non_linear_expr, dropout_rate) ;
-            emit_score[time_step][i] = emit_layer.build_graph(dropout_expr);
+            emit_score[time_step * tag_num + i] = emit_layer.build_graph(dropout_expr);
         }
     }
     // viterbi docoding
@@ -100,7 +109,7 @@ CRFOutput::build_output_loss(const std::vector<cnn::expr::Expression> &expr_cont
     for( size_t i = 0; i < tag_num ; ++i )
     {
         // init_score + emit_score
-        cur_score_expr_cont[i] = init_score[i] + emit_score[0][i];
+        cur_score_expr_cont[i] = init_score[i] + emit_score[i];
     }
     gold_score_expr_cont[0] = cur_score_expr_cont[gold_seq.at(0)];
     // 2. the continues time
@@ -110,7 +119,6 @@ CRFOutput::build_output_loss(const std::vector<cnn::expr::Expression> &expr_cont
         for( size_t cur_idx = 0; cur_idx < tag_num ; ++cur_idx )
         {
             // for every possible trans
-            std::vector<cnn::expr::Expression> partial_score_expr_cont(tag_num);
             for( size_t pre_idx = 0; pre_idx < tag_num; ++pre_idx )
             {
                 size_t flatten_idx = pre_idx * tag_num + cur_idx;
@@ -119,12 +127,12 @@ CRFOutput::build_output_loss(const std::vector<cnn::expr::Expression> &expr_cont
                     trans_score[flatten_idx];
             }
             cur_score_expr_cont[cur_idx] = cnn::expr::logsumexp(partial_score_expr_cont) +
-                emit_score[time_step][cur_idx];
+                emit_score[time_step * tag_num + cur_idx];
         }
         // calc gold 
         size_t gold_trans_flatten_idx = gold_seq.at(time_step - 1) * tag_num + gold_seq.at(time_step);
         gold_score_expr_cont[time_step] = trans_score[gold_trans_flatten_idx] +
-            emit_score[time_step][gold_seq.at(time_step)];
+            emit_score[time_step * tag_num + gold_seq.at(time_step)];
     }
     cnn::expr::Expression predict_score_expr = cnn::expr::logsumexp(cur_score_expr_cont);
 
@@ -140,10 +148,14 @@ void CRFOutput::build_output(const std::vector<cnn::expr::Expression> &expr_cont
 {
     size_t len = expr_cont1.size() ;
     // viterbi data preparation
-    std::vector<cnn::expr::Expression> all_tag_expr_cont(tag_num);
-    std::vector<cnn::real> init_score(tag_num);
-    std::vector < cnn::real> trans_score(tag_num * tag_num);
-    std::vector<std::vector<cnn::real>> emit_score(len, std::vector<cnn::real>(tag_num));
+    std::vector<cnn::expr::Expression> &all_tag_expr_cont = scratch.all_tag_exprs;
+    std::vector<cnn::real> &init_score = scratch.init_scores,
+        &trans_score = scratch.trans_scores,
+        &emit_score = scratch.emit_scores; // flat , emit_score[time_step * tag_num + tag]
+    all_tag_expr_cont.resize(tag_num);
+    init_score.resize(tag_num);
+    trans_score.resize(tag_num * tag_num);
+    emit_score.resize(len * tag_num);
     // get initial score
     for( size_t i = 0 ; i < tag_num ; ++i )
     {
@@ -169,19 +181,22 @@ void CRFOutput::build_output(const std::vector<cnn::expr::Expression> &expr_cont
                 expr_cont2[time_step], all_tag_expr_cont[i]);
             cnn::expr::Expression non_linear_expr = (*nonlinear_func)(hidden_out_expr) ;
             cnn::expr::Expression emit_expr = emit_layer.build_graph(non_linear_expr);
-            emit_score[time_step][i] = cnn::as_scalar( pcg->get_value(emit_expr) );
+            emit_score[time_step * tag_num + i] = cnn::as_scalar( pcg->get_value(emit_expr) );
         }
     }
     // viterbi - process
-    std::vector<std::vector<size_t>> path_matrix(len, std::vector<size_t>(tag_num));
-    std::vector<cnn::real> current_scores(tag_num); 
+    std::vector<size_t> &path_matrix = scratch.path_matrix; // flat , path_matrix[time_step * tag_num + tag]
+    std::vector<cnn::real> &current_scores = scratch.cur_scores,
+        &pre_timestep_scores = scratch.pre_scores;
+    path_matrix.resize(len * tag_num);
+    current_scores.resize(tag_num);
+    pre_timestep_scores.resize(tag_num);
     // time 0
     for (size_t i = 0; i < tag_num ; ++i)
     {
-        current_scores[i] = init_score[i] + emit_score[0][i];
+        current_scores[i] = init_score[i] + emit_score[i];
     }
     // continues time
-    std::vector<cnn::real>  pre_timestep_scores(tag_num);
     for (size_t time_step = 1; time_step < len ; ++time_step)
     {
         std::swap(pre_timestep_scores, current_scores); // move current_score -> pre_timestep_score
@@ -192,7 +207,7 @@ void CRFOutput::build_output(const std::vector<cnn::expr::Expression> &expr_cont
                 trans_score[pre_tag_with_max_score * tag_num + i];
             for (size_t pre_i = 1 ; pre_i < tag_num ; ++pre_i)
             {
-                size_t flat_idx = pre_i * tag_num + pre_i ;
+                size_t flat_idx = pre_i * tag_num + i ;
                 cnn::real score = pre_timestep_scores[pre_i] + trans_score[flat_idx];
                 if (score > max_score)
                 {
@@ -200,34 +215,34 @@ void CRFOutput::build_output(const std::vector<cnn::expr::Expression> &expr_cont
                     max_score = score;
                 }
             }
-            path_matrix[time_step][i] = pre_tag_with_max_score;
-            current_scores[i] = max_score + emit_score[time_step][i];
+            path_matrix[time_step * tag_num + i] = pre_tag_with_max_score;
+            current_scores[i] = max_score + emit_score[time_step * tag_num + i];
         }
     }
     // get result 
-    IndexSeq tmp_predict_ner_seq(len);
+    pred_seq.resize(len);
     Index end_predicted_idx = std::distance(current_scores.cbegin(),
         max_element(current_scores.cbegin(), current_scores.cend()));
-    tmp_predict_ner_seq[len - 1] = end_predicted_idx;
+    pred_seq[len - 1] = end_predicted_idx;
     Index pre_predicted_idx = end_predicted_idx;
     for (size_t reverse_idx = len - 1; reverse_idx >= 1; --reverse_idx)
     {
-        pre_predicted_idx = path_matrix[reverse_idx][pre_predicted_idx]; // backtrace
-        tmp_predict_ner_seq[reverse_idx - 1] = pre_predicted_idx;
+        pre_predicted_idx = path_matrix[reverse_idx * tag_num + pre_predicted_idx]; // backtrace
+        pred_seq[reverse_idx - 1] = pre_predicted_idx;
     }
-    std::swap(tmp_predict_ner_seq, pred_seq);
 }
 
 /* Bare Output Base */
-BareOutputBase::BareOutputBase(cnn::Model *m, unsigned input_dim, unsigned output_dim)
-    :softmax_layer(m, input_dim, output_dim)
+BareOutputBase::BareOutputBase(cnn::Model *m, unsigned input_dim, unsigned output_dim, AffineWeights *affine_weights)
+    :softmax_layer(m, input_dim, output_dim, affine_weights)
 {}
 
 BareOutputBase::~BareOutputBase(){}
 
 /* Simple Bare Output */
-SimpleBareOutput::SimpleBareOutput(cnn::Model *m, unsigned inputs_total_dim, unsigned output_dim)
-    :BareOutputBase(m, inputs_total_dim, output_dim)
+SimpleBareOutput::SimpleBareOutput(cnn::Model *m, unsigned inputs_total_dim, unsigned output_dim,
+    AffineWeights *affine_weights)
+    :BareOutputBase(m, inputs_total_dim, output_dim, affine_weights)
 {}
 
 /************* SoftmaxLayer ***********/
@@ -250,10 +265,11 @@ OutputBaseWithFeature::~OutputBaseWithFeature(){}
 SimpleOutputWithFeature::SimpleOutputWithFeature(cnn::Model *m, unsigned input_dim1, unsigned input_dim2,
     unsigned feature_dim, unsigned hidden_dim, unsigned output_dim,
     cnn::real dropout_rate,
-    NonLinearFunc *nonlinear_func)
+    NonLinearFunc *nonlinear_func,
+    AffineWeights *affine_weights)
     :OutputBaseWithFeature(dropout_rate, nonlinear_func),
-    hidden_layer(m, input_dim1, input_dim2, feature_dim, hidden_dim),
-    output_layer(m, hidden_dim, output_dim)
+    hidden_layer(m, input_dim1, input_dim2, feature_dim, hidden_dim, affine_weights),
+    output_layer(m, hidden_dim, output_dim, affine_weights)
 {}
 
 SimpleOutputWithFeature::~SimpleOutputWithFeature() {};
@@ -266,8 +282,8 @@ PretagOutputWithFeature::PretagOutputWithFeature(cnn::Model *m, unsigned tag_emb
     :OutputBaseWithFeature(dropout_rate, nonlinear_func),
     hidden_layer(m, input_dim1, input_dim2, feature_dim, tag_embedding_dim, hidden_dim),
     output_layer(m, hidden_dim, output_dim),
-    tag_lookup_param(m->add_lookup_parameters(output_dim , {tag_embedding_dim})) ,
-    TAG_SOS(m->add_parameters({tag_embedding_dim})) 
+    pretag_layer(m, output_dim, tag_embedding_dim, ShiftedIndex2ExprLayer::RightShift, 1), // same parameters order as before
+    beam_size(1)
 {}
 
 PretagOutputWithFeature::~PretagOutputWithFeature(){}
@@ -301,14 +317,22 @@ CRFOutputWithFeature::build_output_loss(const std::vector<cnn::expr::Expression>
 {
     size_t len = expr_cont1.size() ;
     // viterbi data preparation
-    std::vector<cnn::expr::Expression> all_tag_expr_cont(tag_num);
-    std::vector<cnn::expr::Expression> init_score(tag_num);
-    std::vector<cnn::expr::Expression> trans_score(tag_num * tag_num);
-    std::vector<std::vector<cnn::expr::Expression>> emit_score(len,
-        std::vector<cnn::expr::Expression>(tag_num));
-    std::vector<cnn::expr::Expression> cur_score_expr_cont(tag_num),
-        pre_score_expr_cont(tag_num);
-    std::vector<cnn::expr::Expression> gold_score_expr_cont(len) ;
+    std::vector<cnn::expr::Expression> &all_tag_expr_cont = scratch.all_tag_exprs,
+        &init_score = scratch.init_score_exprs,
+        &trans_score = scratch.trans_score_exprs,
+        &emit_score = scratch.emit_score_exprs, // flat , emit_score[time_step * tag_num + tag]
+        &cur_score_expr_cont = scratch.cur_score_exprs,
+        &pre_score_expr_cont = scratch.pre_score_exprs,
+        &partial_score_expr_cont = scratch.partial_score_exprs,
+        &gold_score_expr_cont = scratch.gold_score_exprs;
+    all_tag_expr_cont.resize(tag_num);
+    init_score.resize(tag_num);
+    trans_score.resize(tag_num * tag_num);
+    emit_score.resize(len * tag_num);
+    cur_score_expr_cont.resize(tag_num);
+    pre_score_expr_cont.resize(tag_num);
+    partial_score_expr_cont.resize(tag_num);
+    gold_score_expr_cont.resize(len);
     // init tag expr , init score
     for( size_t i = 0; i < tag_num ; ++i )
     {
@@ -329,7 +353,7 @@ CRFOutputWithFeature::build_output_loss(const std::vector<cnn::expr::Expression>
                 expr_cont2.at(time_step), feature_expr_cont.at(time_step), all_tag_expr_cont.at(i));
             cnn::expr::Expression non_linear_expr = (*nonlinear_func)(hidden_out_expr) ;
             cnn::expr::Expression dropout_expr = dropout(non_linear_expr, dropout_rate) ;
-            emit_score[time_step][i] = emit_layer.build_graph(dropout_expr);
+            emit_score[time_step * tag_num + i] = emit_layer.build_graph(dropout_expr);
         }
     }
     // viterbi docoding
@@ -337,7 +361,7 @@ CRFOutputWithFeature::build_output_loss(const std::vector<cnn::expr::Expression>
     for( size_t i = 0; i < tag_num ; ++i )
     {
         // init_score + emit_score
-        cur_score_expr_cont[i] = init_score[i] + emit_score[0][i];
+        cur_score_expr_cont[i] = init_score[i] + emit_score[i];
     }
     gold_score_expr_cont[0] = cur_score_expr_cont[gold_seq.at(0)];
     // 2. the continues time
@@ -347,7 +371,6 @@ CRFOutputWithFeature::build_output_loss(const std::vector<cnn::expr::Expression>
         for( size_t cur_idx = 0; cur_idx < tag_num ; ++cur_idx )
         {
             // for every possible trans
-            std::vector<cnn::expr::Expression> partial_score_expr_cont(tag_num);
             for( size_t pre_idx = 0; pre_idx < tag_num; ++pre_idx )
             {
                 size_t flatten_idx = pre_idx * tag_num + cur_idx;
@@ -356,12 +379,12 @@ CRFOutputWithFeature::build_output_loss(const std::vector<cnn::expr::Expression>
                     trans_score[flatten_idx];
             }
             cur_score_expr_cont[cur_idx] = cnn::expr::logsumexp(partial_score_expr_cont) +
-                emit_score[time_step][cur_idx];
+                emit_score[time_step * tag_num + cur_idx];
         }
         // calc gold 
         size_t gold_trans_flatten_idx = gold_seq.at(time_step - 1) * tag_num + gold_seq.at(time_step);
         gold_score_expr_cont[time_step] = trans_score[gold_trans_flatten_idx] +
-            emit_score[time_step][gold_seq.at(time_step)];
+            emit_score[time_step * tag_num + gold_seq.at(time_step)];
     }
     cnn::expr::Expression predict_score_expr = cnn::expr::logsumexp(cur_score_expr_cont);
 
@@ -379,10 +402,14 @@ void CRFOutputWithFeature::build_output(const std::vector<cnn::expr::Expression>
 {
     size_t len = expr_cont1.size() ;
     // viterbi data preparation
-    std::vector<cnn::expr::Expression> all_tag_expr_cont(tag_num);
-    std::vector<cnn::real> init_score(tag_num);
-    std::vector < cnn::real> trans_score(tag_num * tag_num);
-    std::vector<std::vector<cnn::real>> emit_score(len, std::vector<cnn::real>(tag_num));
+    std::vector<cnn::expr::Expression> &all_tag_expr_cont = scratch.all_tag_exprs;
+    std::vector<cnn::real> &init_score = scratch.init_scores,
+        &trans_score = scratch.trans_scores,
+        &emit_score = scratch.emit_scores; // flat , emit_score[time_step * tag_num + tag]
+    all_tag_expr_cont.resize(tag_num);
+    init_score.resize(tag_num);
+    trans_score.resize(tag_num * tag_num);
+    emit_score.resize(len * tag_num);
     // get initial score
     for( size_t i = 0 ; i < tag_num ; ++i )
     {
@@ -408,19 +435,22 @@ void CRFOutputWithFeature::build_output(const std::vector<cnn::expr::Expression>
                 expr_cont2.at(time_step), feature_expr_cont.at(time_step), all_tag_expr_cont.at(i));
             cnn::expr::Expression non_linear_expr = (*nonlinear_func)(hidden_out_expr) ;
             cnn::expr::Expression emit_expr = emit_layer.build_graph(non_linear_expr);
-            emit_score[time_step][i] = cnn::as_scalar( pcg->get_value(emit_expr) );
+            emit_score[time_step * tag_num + i] = cnn::as_scalar( pcg->get_value(emit_expr) );
         }
     }
     // viterbi - process
-    std::vector<std::vector<size_t>> path_matrix(len, std::vector<size_t>(tag_num));
-    std::vector<cnn::real> current_scores(tag_num); 
+    std::vector<size_t> &path_matrix = scratch.path_matrix; // flat , path_matrix[time_step * tag_num + tag]
+    std::vector<cnn::real> &current_scores = scratch.cur_scores,
+        &pre_timestep_scores = scratch.pre_scores;
+    path_matrix.resize(len * tag_num);
+    current_scores.resize(tag_num);
+    pre_timestep_scores.resize(tag_num);
     // time 0
     for (size_t i = 0; i < tag_num ; ++i)
     {
-        current_scores[i] = init_score[i] + emit_score[0][i];
+        current_scores[i] = init_score[i] + emit_score[i];
     }
     // continues time
-    std::vector<cnn::real>  pre_timestep_scores(tag_num);
     for (size_t time_step = 1; time_step < len ; ++time_step)
     {
         std::swap(pre_timestep_scores, current_scores); // move current_score -> pre_timestep_score
@@ -431,7 +461,7 @@ void CRFOutputWithFeature::build_output(const std::vector<cnn::expr::Expression>
                 trans_score[pre_tag_with_max_score * tag_num + i];
             for (size_t pre_i = 1 ; pre_i < tag_num ; ++pre_i)
             {
-                size_t flat_idx = pre_i * tag_num + pre_i ;
+                size_t flat_idx = pre_i * tag_num + i ;
                 cnn::real score = pre_timestep_scores[pre_i] + trans_score[flat_idx];
                 if (score > max_score)
                 {
@@ -439,21 +469,20 @@ void CRFOutputWithFeature::build_output(const std::vector<cnn::expr::Expression>
                     max_score = score;
                 }
             }
-            path_matrix[time_step][i] = pre_tag_with_max_score;
-            current_scores[i] = max_score + emit_score[time_step][i];
+            path_matrix[time_step * tag_num + i] = pre_tag_with_max_score;
+            current_scores[i] = max_score + emit_score[time_step * tag_num + i];
         }
     }
     // get result 
-    IndexSeq tmp_predict_ner_seq(len);
+    pred_seq.resize(len);
     Index end_predicted_idx = std::distance(current_scores.cbegin(),
         max_element(current_scores.cbegin(), current_scores.cend()));
-    tmp_predict_ner_seq[len - 1] = end_predicted_idx;
+    pred_seq[len - 1] = end_predicted_idx;
     Index pre_predicted_idx = end_predicted_idx;
     for (size_t reverse_idx = len - 1; reverse_idx >= 1; --reverse_idx)
     {
-        pre_predicted_idx = path_matrix[reverse_idx][pre_predicted_idx]; // backtrace
-        tmp_predict_ner_seq[reverse_idx - 1] = pre_predicted_idx;
+        pre_predicted_idx = path_matrix[reverse_idx * tag_num + pre_predicted_idx]; // backtrace
+        pred_seq[reverse_idx - 1] = pre_predicted_idx;
     }
-    std::swap(tmp_predict_ner_seq, pred_seq);
 }
 } // end of namespace slnn
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <initializer_list>
 #include "layers.h"
+#include "pretag_beam_search.h"
 #include "utils/typedeclaration.h"
 
 namespace slnn{
@@ -28,9 +29,11 @@ struct SimpleOutput : public OutputBase
     Merge2Layer hidden_layer;
     DenseLayer output_layer;
     cnn::ComputationGraph *pcg;
+    std::vector<cnn::expr::Expression> loss_cont; // buffer , reused across sentences
     SimpleOutput(cnn::Model *m, unsigned input_dim1, unsigned input_dim2 ,
         unsigned hidden_dim, unsigned output_dim , 
-        cnn::real dropout_rate=0.f, NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
+        cnn::real dropout_rate=0.f, NonLinearFunc *nonlinear_func=&cnn::expr::rectify,
+        AffineWeights *affine_weights=nullptr);
     virtual ~SimpleOutput();
     virtual void new_graph(cnn::ComputationGraph &cg);
     virtual cnn::expr::Expression
@@ -42,13 +45,24 @@ struct SimpleOutput : public OutputBase
         IndexSeq &pred_out_seq);
 };
 
+// beam search decodes outside the computation graph , and only knows rectify and tanh
+inline
+void check_beam_size(unsigned beam_size, NonLinearFunc *nonlinear_func)
+{
+    if( beam_size > 1 && !PretagBeamSearchDecoder::is_supported_nonlinear(nonlinear_func) )
+    {
+        throw std::runtime_error("beam size " + std::to_string(beam_size) + " is not supported for the nonlinear function"
+            " of the model , only rectify and tanh can be decoded with beam search . use beam size 1 .");
+    }
+}
+
 struct PretagOutput : public OutputBase
 {
     Merge3Layer hidden_layer;
     DenseLayer output_layer;
-    cnn::LookupParameters *tag_lookup_param ;
-    cnn::Parameters *TAG_SOS ;
+    ShiftedIndex2ExprLayer pretag_layer; // [SOS] tag_0 tag_1 ... tag_{n-2}
     cnn::ComputationGraph *pcg;
+    unsigned beam_size;
 
     PretagOutput(cnn::Model *m, unsigned tag_embedding_dim, unsigned input_dim1, unsigned input_dim2,
         unsigned hidden_dim, unsigned output_dim , 
@@ -62,6 +76,31 @@ struct PretagOutput : public OutputBase
     virtual void build_output(const std::vector<cnn::expr::Expression> &expr_1,
         const std::vector<cnn::expr::Expression> &expr_2,
         IndexSeq &pred_out_seq) ;
+    // greedy decoding step by step on the computation graph , for the nonlinear function beam search can't handle
+    void build_output_in_graph(const std::vector<cnn::expr::Expression> &expr_1,
+        const std::vector<cnn::expr::Expression> &expr_2,
+        IndexSeq &pred_out_seq) ;
+    // throw if beam_size > 1 with a nonlinear function beam search can't handle
+    void set_beam_size(unsigned beam_size){ check_beam_size(beam_size, nonlinear_func); this->beam_size = beam_size; }
+};
+
+// containers of the CRF loss and viterbi decoding , kept by the CRF outputs so their capacity is reused across sentences
+struct CRFScratchBuffers
+{
+    std::vector<cnn::expr::Expression> all_tag_exprs,
+        init_score_exprs,
+        trans_score_exprs,
+        emit_score_exprs,
+        cur_score_exprs,
+        pre_score_exprs,
+        partial_score_exprs,
+        gold_score_exprs;
+    std::vector<cnn::real> init_scores,
+        trans_scores,
+        emit_scores,
+        cur_scores,
+        pre_scores;
+    std::vector<size_t> path_matrix;
 };
 
 struct CRFOutput : public OutputBase
@@ -73,6 +112,7 @@ struct CRFOutput : public OutputBase
     cnn::LookupParameters *init_score_lookup_param ;
     cnn::ComputationGraph *pcg ;
     size_t tag_num ;
+    CRFScratchBuffers scratch ;
     CRFOutput(cnn::Model *m,
         unsigned tag_embedding_dim, unsigned input_dim1, unsigned input_dim2,
         unsigned hidden_dim,
@@ -97,7 +137,8 @@ struct BareOutputBase
 {
     cnn::ComputationGraph *pcg;
     DenseLayer softmax_layer;
-    BareOutputBase(cnn::Model *m, unsigned input_dim, unsigned output_dim);
+    std::vector<cnn::expr::Expression> loss_cont; // buffers , reused across sentences
+    BareOutputBase(cnn::Model *m, unsigned input_dim, unsigned output_dim, AffineWeights *affine_weights=nullptr);
     virtual ~BareOutputBase();
     virtual void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression
@@ -111,13 +152,15 @@ struct BareOutputBase
     virtual void build_output(const std::vector<cnn::expr::Expression> &input_expr_seq,
         IndexSeq &predicted_seq) = 0 ;
 private:
+    std::vector<cnn::expr::Expression> merged_expr_cont,
+        feature_group;
     void concate_input_expr_ptr_group(const std::vector<std::vector<cnn::expr::Expression> *> &input_expr_ptr_group_seq, 
             std::vector<cnn::expr::Expression> &concated_input_expr_cont);
 };
 
 struct SimpleBareOutput : public BareOutputBase
 {
-    SimpleBareOutput(cnn::Model *m, unsigned inputs_total_dim, unsigned output_dim);
+    SimpleBareOutput(cnn::Model *m, unsigned inputs_total_dim, unsigned output_dim, AffineWeights *affine_weights=nullptr);
     cnn::expr::Expression
         build_output_loss(const std::vector<cnn::expr::Expression> &input_expr_seq,
             const IndexSeq &gold_seq) override;
@@ -131,6 +174,7 @@ struct SoftmaxLayer
 {
     cnn::ComputationGraph *pcg;
     DenseLayer output_layer;
+    std::vector<cnn::expr::Expression> loss_expr_cont; // buffer , reused across sentences
     SoftmaxLayer(cnn::Model *m, unsigned input_dim, unsigned output_dim);
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression
@@ -168,9 +212,11 @@ struct SimpleOutputWithFeature : public OutputBaseWithFeature
     Merge3Layer hidden_layer;
     DenseLayer output_layer;
     cnn::ComputationGraph *pcg;
+    std::vector<cnn::expr::Expression> loss_cont; // buffer , reused across sentences
     SimpleOutputWithFeature(cnn::Model *m, unsigned input_dim1, unsigned input_dim2, unsigned feature_dim,
         unsigned hidden_dim, unsigned output_dim,
-        cnn::real dropout_rate=0.f, NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
+        cnn::real dropout_rate=0.f, NonLinearFunc *nonlinear_func=&cnn::expr::rectify,
+        AffineWeights *affine_weights=nullptr);
     virtual ~SimpleOutputWithFeature();
     virtual void new_graph(cnn::ComputationGraph &cg);
     virtual cnn::expr::Expression
@@ -188,9 +234,9 @@ struct PretagOutputWithFeature : public OutputBaseWithFeature
 {
     Merge4Layer hidden_layer;
     DenseLayer output_layer;
-    cnn::LookupParameters *tag_lookup_param ;
-    cnn::Parameters *TAG_SOS ;
+    ShiftedIndex2ExprLayer pretag_layer; // [SOS] tag_0 tag_1 ... tag_{n-2}
     cnn::ComputationGraph *pcg;
+    unsigned beam_size;
 
     PretagOutputWithFeature(cnn::Model *m, unsigned tag_embedding_dim, unsigned input_dim1, unsigned input_dim2, 
         unsigned feature_dim,
@@ -207,6 +253,12 @@ struct PretagOutputWithFeature : public OutputBaseWithFeature
         const std::vector<cnn::expr::Expression> &expr_2,
         const std::vector<cnn::expr::Expression> &feature_expr_cont,
         IndexSeq &pred_out_seq) ;
+    void build_output_in_graph(const std::vector<cnn::expr::Expression> &expr_1,
+        const std::vector<cnn::expr::Expression> &expr_2,
+        const std::vector<cnn::expr::Expression> &feature_expr_cont,
+        IndexSeq &pred_out_seq) ;
+    // throw if beam_size > 1 with a nonlinear function beam search can't handle
+    void set_beam_size(unsigned beam_size){ check_beam_size(beam_size, nonlinear_func); this->beam_size = beam_size; }
 };
 
 struct CRFOutputWithFeature : public  OutputBaseWithFeature
@@ -218,6 +270,7 @@ struct CRFOutputWithFeature : public  OutputBaseWithFeature
     cnn::LookupParameters *init_score_lookup_param ;
     cnn::ComputationGraph *pcg ;
     size_t tag_num ;
+    CRFScratchBuffers scratch ;
     CRFOutputWithFeature(cnn::Model *m,
         unsigned tag_embedding_dim, unsigned input_dim1, unsigned input_dim2,
         unsigned feature_dim,
@@ -256,7 +309,7 @@ Expression SimpleOutput::build_output_loss(const std::vector<cnn::expr::Expressi
     const std::vector<cnn::expr::Expression> &expr_cont2 , const IndexSeq &gold_seq)
 {
     size_t len = expr_cont1.size();
-    std::vector<cnn::expr::Expression> loss_cont(len);
+    loss_cont.resize(len);
     for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i]);
@@ -274,18 +327,14 @@ void SimpleOutput::build_output(const std::vector<cnn::expr::Expression> &expr_c
     IndexSeq &pred_out_seq)
 {
     size_t len = expr_cont1.size();
-    std::vector<Index> tmp_pred_out(len);
+    pred_out_seq.resize(len);
     for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i]);
         cnn::expr::Expression nonlinear_expr = nonlinear_func(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-        Index idx_of_max_prob = std::distance(out_probs.cbegin(),
-            std::max_element(out_probs.cbegin(), out_probs.cend()));
-        tmp_pred_out[i] = idx_of_max_prob;
+        pred_out_seq[i] = expr_value_argmax(*pcg, out_expr);
     }
-    std::swap(pred_out_seq, tmp_pred_out);
 }
 
 
@@ -295,6 +344,7 @@ void PretagOutput::new_graph(cnn::ComputationGraph &cg)
 {
     hidden_layer.new_graph(cg) ;
     output_layer.new_graph(cg) ;
+    pretag_layer.new_graph(cg) ;
     pcg = &cg ;
 }
 
@@ -304,40 +354,69 @@ PretagOutput::build_output_loss(const std::vector<cnn::expr::Expression> &expr_c
     const std::vector<cnn::expr::Expression> &expr_cont2,
     const IndexSeq &gold_seq)
 {
-    size_t len = expr_cont1.size() ;
-    std::vector<cnn::expr::Expression> loss_cont(len);
-    cnn::expr::Expression pretag_exp = parameter(*pcg, TAG_SOS) ;
-    for( size_t i = 0; i < len; ++i )
+    // teacher forcing : given the right-shifted gold tags , every position is independent ,
+    // so the whole sequence is computed as one mini-batch instead of a chain of per-position graph .
+    std::vector<cnn::expr::Expression> pretag_exprs;
+    pretag_layer.index_seq2expr_seq(gold_seq, pretag_exprs);
+    cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(StaticBatchLayer::seq2batch_expr(expr_cont1),
+        StaticBatchLayer::seq2batch_expr(expr_cont2), StaticBatchLayer::seq2batch_expr(pretag_exprs));
+    cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
+    cnn::expr::Expression dropout_expr = cnn::expr::dropout(nonlinear_expr, dropout_rate);
+    cnn::expr::Expression out_expr = output_layer.build_graph(dropout_expr);
+    std::vector<unsigned> gold_batch(gold_seq.cbegin(), gold_seq.cend());
+    return cnn::expr::sum_batches(cnn::expr::pickneglogsoftmax(out_expr, gold_batch));
+}
+
+inline
+void PretagOutput::build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
+    const std::vector<cnn::expr::Expression> &expr_cont2,
+    IndexSeq &pred_seq)
+{
+    using Decoder = PretagBeamSearchDecoder;
+    if( !Decoder::is_supported_nonlinear(nonlinear_func) )
     {
-        cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i] , pretag_exp);
-        cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
-        cnn::expr::Expression dropout_expr = cnn::expr::dropout(nonlinear_expr, dropout_rate);
-        cnn::expr::Expression out_expr = output_layer.build_graph(dropout_expr);
-        loss_cont[i] = cnn::expr::pickneglogsoftmax(out_expr, gold_seq.at(i));
-        pretag_exp = lookup(*pcg, tag_lookup_param, gold_seq.at(i)) ;
+        assert(beam_size <= 1);
+        build_output_in_graph(expr_cont1, expr_cont2, pred_seq);
+        return;
     }
-    return cnn::expr::sum(loss_cont);
+    unsigned hidden_dim = pcg->nodes[hidden_layer.b_exp.i]->dim.rows(),
+        tag_num = pcg->nodes[output_layer.b_exp.i]->dim.rows();
+    // part of hidden layer without previous tag , for all positions
+    cnn::expr::Expression precomputed_hidden_expr = cnn::expr::affine_transform({
+        hidden_layer.b_exp,
+        hidden_layer.w1_exp, StaticBatchLayer::seq2batch_expr(expr_cont1),
+        hidden_layer.w2_exp, StaticBatchLayer::seq2batch_expr(expr_cont2)
+    });
+    // previous tag part , for all tags and SOS
+    std::vector<cnn::expr::Expression> all_tag_exprs(tag_num + 1);
+    for( unsigned t = 0; t < tag_num; ++t ){ all_tag_exprs[t] = pretag_layer.index2expr(t); }
+    all_tag_exprs[tag_num] = pretag_layer.get_padding_expr();
+    cnn::expr::Expression tag_hidden_expr = hidden_layer.w3_exp * cnn::expr::concatenate_cols(all_tag_exprs);
+    Decoder::decode(Decoder::expr_value2matrix(*pcg, precomputed_hidden_expr, hidden_dim),
+        Decoder::expr_value2matrix(*pcg, tag_hidden_expr, hidden_dim),
+        nonlinear_func,
+        Decoder::expr_value2matrix(*pcg, output_layer.w_exp, tag_num),
+        Decoder::expr_value2matrix(*pcg, output_layer.b_exp, tag_num),
+        beam_size, pred_seq);
 }
 
 inline
-void PretagOutput::build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
+void PretagOutput::build_output_in_graph(const std::vector<cnn::expr::Expression> &expr_cont1,
     const std::vector<cnn::expr::Expression> &expr_cont2,
     IndexSeq &pred_seq)
 {
     size_t len = expr_cont1.size() ;
-    IndexSeq tmp_pred(len) ;
-    cnn::expr::Expression pretag_exp = parameter(*pcg, TAG_SOS) ;
+    pred_seq.resize(len) ;
+    cnn::expr::Expression pretag_exp = pretag_layer.get_padding_expr() ;
     for( size_t i = 0; i < len; ++i )
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i], pretag_exp);
         cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> dist = as_vector(pcg->get_value(out_expr)) ;
-        Index id_of_max_prob = std::distance(dist.cbegin(), std::max_element(dist.cbegin(), dist.cend())) ;
-        tmp_pred[i] = id_of_max_prob ;
-        pretag_exp = lookup(*pcg, tag_lookup_param,id_of_max_prob) ;
+        Index id_of_max_prob = expr_value_argmax(*pcg, out_expr) ;
+        pred_seq[i] = id_of_max_prob ;
+        pretag_exp = pretag_layer.index2expr(id_of_max_prob) ;
     }
-    std::swap(pred_seq, tmp_pred) ;
 }
 
 /****** crf output *******/
@@ -367,17 +446,16 @@ void BareOutputBase::concate_input_expr_ptr_group(const std::vector<std::vector<
     size_t nr_feature_variety = input_expr_ptr_group_seq.size();
     //assert(nr_feature_variety > 0);
     size_t feature_seq_len = input_expr_ptr_group_seq[0]->size();
-    std::vector<cnn::expr::Expression> tmp_concated_expr(feature_seq_len);
-    std::vector<cnn::expr::Expression> feature_group(nr_feature_variety);
+    concated_input_expr_cont.resize(feature_seq_len);
+    feature_group.resize(nr_feature_variety);
     for( size_t j = 0; j < feature_seq_len; ++j )
     {
         for( size_t fi = 0; fi < nr_feature_variety; ++fi )
         {
             feature_group.at(fi) = input_expr_ptr_group_seq[fi]->at(j);
         }
-        tmp_concated_expr.at(j) = cnn::expr::concatenate(feature_group);
+        concated_input_expr_cont.at(j) = cnn::expr::concatenate(feature_group);
     }
-    swap(concated_input_expr_cont, tmp_concated_expr);
 }
 
 inline
@@ -385,7 +463,6 @@ cnn::expr::Expression
 BareOutputBase::build_output_loss(const std::vector<std::vector<cnn::expr::Expression> *> &input_expr_ptr_group_seq,
     const IndexSeq &gold_seq)
 {
-    std::vector<cnn::expr::Expression> merged_expr_cont;
     concate_input_expr_ptr_group(input_expr_ptr_group_seq, merged_expr_cont);
     return build_output_loss(merged_expr_cont, gold_seq);
 }
@@ -393,7 +470,6 @@ inline
 void BareOutputBase::build_output(const std::vector<std::vector<cnn::expr::Expression> *> &input_expr_ptr_group_seq,
     IndexSeq &predicted_seq)
 {
-    std::vector<cnn::expr::Expression> merged_expr_cont;
     concate_input_expr_ptr_group(input_expr_ptr_group_seq, merged_expr_cont);
     return build_output(merged_expr_cont, predicted_seq);
 }
@@ -405,7 +481,7 @@ SimpleBareOutput::build_output_loss(const std::vector<cnn::expr::Expression> &in
     const IndexSeq &gold_seq) 
 {
     size_t seq_len = input_expr_seq.size();
-    std::vector<cnn::expr::Expression> loss_cont(seq_len);
+    loss_cont.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
         cnn::expr::Expression dist_expr = softmax_layer.build_graph(input_expr_seq[i]);
@@ -418,17 +494,13 @@ inline
 void SimpleBareOutput::build_output(const std::vector<cnn::expr::Expression> &input_expr_seq,
     IndexSeq &predicted_seq)
 {
-    using std::swap;
     size_t seq_len = input_expr_seq.size();
-    IndexSeq tmp_pred_seq(seq_len);
+    predicted_seq.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
         cnn::expr::Expression dest_expr = softmax_layer.build_graph(input_expr_seq[i]);
-        std::vector<cnn::real> dist = cnn::as_vector(pcg->get_value(dest_expr));
-        Index id_of_max_prob = std::distance(dist.begin(), std::max_element(dist.begin(), dist.end()) );
-        tmp_pred_seq[i] = id_of_max_prob;
+        predicted_seq[i] = expr_value_argmax(*pcg, dest_expr);
     }
-    swap(predicted_seq, tmp_pred_seq);
 }
 
 /******* Softmax layer **********/
@@ -446,7 +518,7 @@ SoftmaxLayer::build_output_loss(const std::vector<cnn::expr::Expression> &input_
     const IndexSeq &gold_seq)
 {
     unsigned sz = input_expr_cont.size();
-    std::vector<cnn::expr::Expression> loss_expr_cont(sz);
+    loss_expr_cont.resize(sz);
     for( unsigned i = 0 ; i < sz ; ++i )
     {
         cnn::expr::Expression output_expr = output_layer.build_graph(input_expr_cont.at(i));
@@ -460,24 +532,19 @@ void SoftmaxLayer::build_output(const std::vector<cnn::expr::Expression> &input_
     IndexSeq &predicted_seq)
 {
     size_t len = input_expr_cont.size();
-    std::vector<Index> tmp_pred_out(len);
+    predicted_seq.resize(len);
     for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression out_expr = output_layer.build_graph(input_expr_cont.at(i));
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-        Index idx_of_max_prob = std::distance(out_probs.cbegin(),
-            std::max_element(out_probs.cbegin(), out_probs.cend()));
-        tmp_pred_out.at(i) = idx_of_max_prob;
+        predicted_seq.at(i) = expr_value_argmax(*pcg, out_expr);
     }
-    std::swap(predicted_seq, tmp_pred_out);
 }
 
 inline
 Index SoftmaxLayer::build_output(cnn::expr::Expression input_expr)
 {
-    std::vector<cnn::real> out_probs;
-    get_output_distribution(input_expr, out_probs);
-    return std::distance(out_probs.cbegin(), std::max_element(out_probs.cbegin(), out_probs.cend()));
+    cnn::expr::Expression out_expr = output_layer.build_graph(input_expr);
+    return expr_value_argmax(*pcg, out_expr);
 }
 
 inline
@@ -505,7 +572,7 @@ Expression SimpleOutputWithFeature::build_output_loss(const std::vector<cnn::exp
     const IndexSeq &gold_seq)
 {
     size_t len = expr_cont1.size();
-    std::vector<cnn::expr::Expression> loss_cont(len);
+    loss_cont.resize(len);
     for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1.at(i), expr_cont2.at(i), feature_expr_cont.at(i));
@@ -524,18 +591,14 @@ void SimpleOutputWithFeature::build_output(const std::vector<cnn::expr::Expressi
     IndexSeq &pred_out_seq)
 {
     size_t len = expr_cont1.size();
-    std::vector<Index> tmp_pred_out(len);
+    pred_out_seq.resize(len);
     for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1.at(i), expr_cont2.at(i), feature_expr_cont.at(i));
         cnn::expr::Expression nonlinear_expr = nonlinear_func(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-        Index idx_of_max_prob = std::distance(out_probs.cbegin(),
-            std::max_element(out_probs.cbegin(), out_probs.cend()));
-        tmp_pred_out[i] = idx_of_max_prob;
+        pred_out_seq[i] = expr_value_argmax(*pcg, out_expr);
     }
-    std::swap(pred_out_seq, tmp_pred_out);
 }
 
 /* pretag output with feature  */
@@ -545,6 +608,7 @@ void PretagOutputWithFeature::new_graph(cnn::ComputationGraph &cg)
 {
     hidden_layer.new_graph(cg) ;
     output_layer.new_graph(cg) ;
+    pretag_layer.new_graph(cg) ;
     pcg = &cg ;
 }
 
@@ -556,42 +620,71 @@ PretagOutputWithFeature::build_output_loss(const std::vector<cnn::expr::Expressi
     const std::vector<cnn::expr::Expression> &feature_expr_cont,
     const IndexSeq &gold_seq)
 {
-    size_t len = expr_cont1.size() ;
-    std::vector<cnn::expr::Expression> loss_cont(len);
-    cnn::expr::Expression pretag_exp = parameter(*pcg, TAG_SOS) ;
-    for( size_t i = 0; i < len; ++i )
+    // teacher forcing , see `PretagOutput::build_output_loss`
+    std::vector<cnn::expr::Expression> pretag_exprs;
+    pretag_layer.index_seq2expr_seq(gold_seq, pretag_exprs);
+    cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(StaticBatchLayer::seq2batch_expr(expr_cont1),
+        StaticBatchLayer::seq2batch_expr(expr_cont2), StaticBatchLayer::seq2batch_expr(feature_expr_cont),
+        StaticBatchLayer::seq2batch_expr(pretag_exprs));
+    cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
+    cnn::expr::Expression dropout_expr = cnn::expr::dropout(nonlinear_expr, dropout_rate);
+    cnn::expr::Expression out_expr = output_layer.build_graph(dropout_expr);
+    std::vector<unsigned> gold_batch(gold_seq.cbegin(), gold_seq.cend());
+    return cnn::expr::sum_batches(cnn::expr::pickneglogsoftmax(out_expr, gold_batch));
+}
+
+inline
+void PretagOutputWithFeature::build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
+    const std::vector<cnn::expr::Expression> &expr_cont2,
+    const std::vector<cnn::expr::Expression> &feature_expr_cont,
+    IndexSeq &pred_seq)
+{
+    using Decoder = PretagBeamSearchDecoder;
+    if( !Decoder::is_supported_nonlinear(nonlinear_func) )
     {
-        cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1.at(i), expr_cont2.at(i), feature_expr_cont.at(i),
-            pretag_exp);
-        cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
-        cnn::expr::Expression dropout_expr = cnn::expr::dropout(nonlinear_expr, dropout_rate);
-        cnn::expr::Expression out_expr = output_layer.build_graph(dropout_expr);
-        loss_cont[i] = cnn::expr::pickneglogsoftmax(out_expr, gold_seq.at(i));
-        pretag_exp = lookup(*pcg, tag_lookup_param, gold_seq.at(i)) ;
+        assert(beam_size <= 1);
+        build_output_in_graph(expr_cont1, expr_cont2, feature_expr_cont, pred_seq);
+        return;
     }
-    return cnn::expr::sum(loss_cont);
+    unsigned hidden_dim = pcg->nodes[hidden_layer.b_exp.i]->dim.rows(),
+        tag_num = pcg->nodes[output_layer.b_exp.i]->dim.rows();
+    // see `PretagOutput::build_output`
+    cnn::expr::Expression precomputed_hidden_expr = cnn::expr::affine_transform({
+        hidden_layer.b_exp,
+        hidden_layer.w1_exp, StaticBatchLayer::seq2batch_expr(expr_cont1),
+        hidden_layer.w2_exp, StaticBatchLayer::seq2batch_expr(expr_cont2),
+        hidden_layer.w3_exp, StaticBatchLayer::seq2batch_expr(feature_expr_cont)
+    });
+    std::vector<cnn::expr::Expression> all_tag_exprs(tag_num + 1);
+    for( unsigned t = 0; t < tag_num; ++t ){ all_tag_exprs[t] = pretag_layer.index2expr(t); }
+    all_tag_exprs[tag_num] = pretag_layer.get_padding_expr();
+    cnn::expr::Expression tag_hidden_expr = hidden_layer.w4_exp * cnn::expr::concatenate_cols(all_tag_exprs);
+    Decoder::decode(Decoder::expr_value2matrix(*pcg, precomputed_hidden_expr, hidden_dim),
+        Decoder::expr_value2matrix(*pcg, tag_hidden_expr, hidden_dim),
+        nonlinear_func,
+        Decoder::expr_value2matrix(*pcg, output_layer.w_exp, tag_num),
+        Decoder::expr_value2matrix(*pcg, output_layer.b_exp, tag_num),
+        beam_size, pred_seq);
 }
 
 inline
-void PretagOutputWithFeature::build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
+void PretagOutputWithFeature::build_output_in_graph(const std::vector<cnn::expr::Expression> &expr_cont1,
     const std::vector<cnn::expr::Expression> &expr_cont2,
     const std::vector<cnn::expr::Expression> &feature_expr_cont,
     IndexSeq &pred_seq)
 {
     size_t len = expr_cont1.size() ;
-    IndexSeq tmp_pred(len) ;
-    cnn::expr::Expression pretag_exp = parameter(*pcg, TAG_SOS) ;
+    pred_seq.resize(len) ;
+    cnn::expr::Expression pretag_exp = pretag_layer.get_padding_expr() ;
     for( size_t i = 0; i < len; ++i )
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1.at(i), expr_cont2.at(i), feature_expr_cont.at(i), pretag_exp);
         cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> dist = as_vector(pcg->get_value(out_expr)) ;
-        Index id_of_max_prob = std::distance(dist.cbegin(), std::max_element(dist.cbegin(), dist.cend())) ;
-        tmp_pred[i] = id_of_max_prob ;
-        pretag_exp = lookup(*pcg, tag_lookup_param,id_of_max_prob) ;
+        Index id_of_max_prob = expr_value_argmax(*pcg, out_expr) ;
+        pred_seq[i] = id_of_max_prob ;
+        pretag_exp = pretag_layer.index2expr(id_of_max_prob) ;
     }
-    std::swap(pred_seq, tmp_pred) ;
 }
 
 /* CRF output with feature */
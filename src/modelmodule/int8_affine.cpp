@@ -0,0 +1,182 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "int8_affine.h"
+
+namespace slnn{
+
+const unsigned Int8Matrix::ColumnAlignment;
+
+void Int8Matrix::quantize(const cnn::Parameters &source)
+{
+    rows = source.dim.rows();
+    cols = source.dim.cols();
+    padded_cols = pad_cols(cols);
+    std::vector<int8_t> tmp_values(static_cast<size_t>(rows) * padded_cols, 0);
+    std::vector<float> tmp_row_scales(rows);
+    const float *w = source.values.v; // column major
+    for( unsigned r = 0; r < rows; ++r )
+    {
+        float max_abs = 0.f;
+        for( unsigned c = 0; c < cols; ++c ){ max_abs = std::max(max_abs, std::abs(w[static_cast<size_t>(c) * rows + r])); }
+        float scale = max_abs > 0.f ? max_abs / 127.f : 1.f;
+        tmp_row_scales[r] = scale;
+        int8_t *row = tmp_values.data() + static_cast<size_t>(r) * padded_cols;
+        for( unsigned c = 0; c < cols; ++c )
+        {
+            float q = std::round(w[static_cast<size_t>(c) * rows + r] / scale);
+            row[c] = static_cast<int8_t>(std::max(-127.f, std::min(127.f, q)));
+        }
+    }
+    values.swap(tmp_values);
+    row_scales.swap(tmp_row_scales);
+}
+
+float Int8Matrix::quantize_vector(const float *x, unsigned len, unsigned padded_len, int8_t *x_q)
+{
+    float max_abs = 0.f;
+    for( unsigned i = 0; i < len; ++i ){ max_abs = std::max(max_abs, std::abs(x[i])); }
+    float scale = max_abs > 0.f ? max_abs / 127.f : 1.f,
+        inv_scale = 1.f / scale;
+    for( unsigned i = 0; i < len; ++i )
+    {
+        float q = std::round(x[i] * inv_scale);
+        x_q[i] = static_cast<int8_t>(std::max(-127.f, std::min(127.f, q)));
+    }
+    std::fill(x_q + len, x_q + padded_len, static_cast<int8_t>(0));
+    return scale;
+}
+
+int32_t Int8Matrix::dot(const int8_t *a, const int8_t *b, unsigned padded_len)
+{
+#if defined(__AVX2__)
+    // sign-extend 16 int8 to int16 , multiply-add adjacent pairs to int32 . |a| , |b| <= 127 so no overflow
+    __m256i acc = _mm256_setzero_si256();
+    for( unsigned i = 0; i < padded_len; i += 16 )
+    {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    // plain loop , vectorized by the compiler
+    int32_t acc = 0;
+    for( unsigned i = 0; i < padded_len; ++i ){ acc += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]); }
+    return acc;
+#endif
+}
+
+void Int8Matrix::gemv_accumulate(const int8_t *x_q, float x_scale, float *y) const
+{
+    const int8_t *row = values.data();
+    for( unsigned r = 0; r < rows; ++r, row += padded_cols )
+    {
+        y[r] += row_scales[r] * x_scale * static_cast<float>(dot(row, x_q, padded_cols));
+    }
+}
+
+std::string Int8AffineNode::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream oss;
+    oss << "int8_affine(" << arg_names[0];
+    for( size_t i = 1; i < arg_names.size(); ++i ){ oss << " + W" << i << " * " << arg_names[i]; }
+    oss << ")";
+    return oss.str();
+}
+
+cnn::Dim Int8AffineNode::dim_forward(const std::vector<cnn::Dim>& xs) const
+{
+    unsigned nr_batch = 1;
+    for( const cnn::Dim &d : xs ){ nr_batch = std::max(nr_batch, d.bd); }
+    return cnn::Dim({ xs[0].rows() }, nr_batch);
+}
+
+void Int8AffineNode::forward_impl(const std::vector<const cnn::Tensor*>& xs, cnn::Tensor& fx) const
+{
+    assert(weights.size() + 1 == xs.size());
+    unsigned output_dim = fx.d.rows(),
+        nr_batch = fx.d.bd;
+    for( unsigned bi = 0; bi < nr_batch; ++bi )
+    {
+        float *y = fx.v + static_cast<size_t>(bi) * output_dim;
+        const cnn::Tensor &bias = *xs[0];
+        const float *b = bias.v + (bias.d.bd > 1 ? static_cast<size_t>(bi) * output_dim : 0);
+        std::copy(b, b + output_dim, y);
+        for( size_t i = 0; i < weights.size(); ++i )
+        {
+            const Int8Matrix &w = *weights[i];
+            const cnn::Tensor &x = *xs[i + 1];
+            assert(w.get_rows() == output_dim && w.get_cols() == x.d.rows());
+            const float *xv = x.v + (x.d.bd > 1 ? static_cast<size_t>(bi) * x.d.batch_size() : 0);
+            x_q_buffer.resize(w.get_padded_cols());
+            float x_scale = Int8Matrix::quantize_vector(xv, w.get_cols(), w.get_padded_cols(), x_q_buffer.data());
+            w.gemv_accumulate(x_q_buffer.data(), x_scale, y);
+        }
+    }
+}
+
+void Int8AffineNode::backward_impl(const std::vector<const cnn::Tensor*>& xs,
+    const cnn::Tensor& fx,
+    const cnn::Tensor& dEdf,
+    unsigned i,
+    cnn::Tensor& dEdxi) const
+{
+    throw std::runtime_error("int8 affine node is for inference only .");
+}
+
+void AffineWeights::set_int8(bool is_int8)
+{
+    if( !float_weights.empty() || !int8_weights.empty() )
+    {
+        throw std::runtime_error("int8 mode should be set before the layers are built .");
+    }
+    is_int8_mode = is_int8;
+}
+
+cnn::Parameters* AffineWeights::add_weight(AffineWeights *weights, cnn::Model *m, const cnn::Dim &dim, Int8Matrix *&w_int8)
+{
+    w_int8 = nullptr;
+    if( nullptr == weights ){ return m->add_parameters(dim); }
+    if( weights->is_int8_mode )
+    {
+        weights->int8_weights.emplace_back(dim.rows(), dim.cols());
+        w_int8 = &weights->int8_weights.back();
+        return nullptr;
+    }
+    cnn::Parameters *w = m->add_parameters(dim);
+    weights->float_weights.push_back(w);
+    return w;
+}
+
+size_t AffineWeights::get_int8_memory_bytes() const
+{
+    size_t bytes = 0;
+    for( const Int8Matrix &w : int8_weights ){ bytes += w.get_memory_bytes(); }
+    return bytes;
+}
+
+cnn::expr::Expression Int8Inference::affine_transform(const cnn::expr::Expression &b_exp,
+    std::initializer_list<const Int8Matrix*> weights, std::initializer_list<cnn::expr::Expression> xs)
+{
+    assert(weights.size() == xs.size());
+    cnn::ComputationGraph &cg = *b_exp.pg;
+    std::vector<cnn::VariableIndex> args;
+    args.reserve(xs.size() + 1);
+    args.push_back(b_exp.i);
+    for( const cnn::expr::Expression &x : xs ){ args.push_back(x.i); }
+    cnn::VariableIndex node_idx = cg.add_function<Int8AffineNode>(args);
+    Int8AffineNode *node = static_cast<Int8AffineNode*>(cg.nodes[node_idx]);
+    node->weights.assign(weights.begin(), weights.end());
+    return cnn::expr::Expression(&cg, node_idx);
+}
+
+} // end of namespace slnn
@@ -0,0 +1,207 @@
+#ifndef SLNN_MODELMODULE_INT8_AFFINE_H_
+#define SLNN_MODELMODULE_INT8_AFFINE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+#include <initializer_list>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/tracking.hpp>
+#include <boost/serialization/vector.hpp>
+#include "cnn/cnn.h"
+#include "cnn/nodes.h"
+#include "cnn/expr.h"
+
+namespace slnn{
+
+/**
+ * int8 weight matrix for CPU inference .
+ * every row has its own scale (symmetric , max |w| -> 127) , rows are stored row-major and zero-padded
+ * to `ColumnAlignment` , so a row is one contiguous int8 dot product .
+ * quantized from a float cnn::Parameters when an int8 model is written , and loaded from the int8 model .
+ */
+class Int8Matrix
+{
+    friend class boost::serialization::access;
+public:
+    static const unsigned ColumnAlignment = 32;
+
+    Int8Matrix() : rows(0), cols(0), padded_cols(0){}
+    Int8Matrix(unsigned rows, unsigned cols) : rows(rows), cols(cols), padded_cols(pad_cols(cols)){}
+    Int8Matrix(const Int8Matrix&) = delete;
+    Int8Matrix& operator=(const Int8Matrix&) = delete;
+    void quantize(const cnn::Parameters &source);
+    unsigned get_rows() const { return rows; }
+    unsigned get_cols() const { return cols; }
+    unsigned get_padded_cols() const { return padded_cols; }
+    size_t get_memory_bytes() const { return values.capacity() * sizeof(int8_t) + row_scales.capacity() * sizeof(float); }
+    // y[r] += row_scale[r] * x_scale * dot(W[r] , x_q) , `x_q` has `padded_cols` elements (padding is 0)
+    void gemv_accumulate(const int8_t *x_q, float x_scale, float *y) const;
+
+    // symmetric per-vector quantization of the input , `x_q` should have `padded_len` elements
+    static float quantize_vector(const float *x, unsigned len, unsigned padded_len, int8_t *x_q);
+    static int32_t dot(const int8_t *a, const int8_t *b, unsigned padded_len);
+private:
+    static unsigned pad_cols(unsigned cols){ return (cols + ColumnAlignment - 1) / ColumnAlignment * ColumnAlignment; }
+    template <typename Archive>
+    void serialize(Archive &ar, const unsigned version);
+    unsigned rows,
+        cols,
+        padded_cols;
+    std::vector<int8_t> values; // rows * padded_cols
+    std::vector<float> row_scales;
+};
+
+/**
+ * the weight matrices of the affine layers (`DenseLayer` , `MergeNLayer` , `MLPHiddenLayer`) of ONE model .
+ * a float model keeps them as cnn::Parameters in the cnn::Model , as before .
+ * an int8 model doesn't add them to the cnn::Model at all , they are `Int8Matrix` kept here , so the resident
+ * weights are about 4x smaller . embeddings , the RNN builders' parameters and the biases stay float .
+ * the mode is a property of the model file , so it should be set before the layers are built , and models loaded
+ * into one process don't affect each other .
+ */
+class AffineWeights
+{
+public:
+    AffineWeights() : is_int8_mode(false){}
+    AffineWeights(const AffineWeights&) = delete;
+    AffineWeights& operator=(const AffineWeights&) = delete;
+
+    void set_int8(bool is_int8);
+    bool is_int8() const { return is_int8_mode; }
+    // the weight of a layer : float parameters added to `m` (and `w_int8` = nullptr) , or nullptr and the int8 matrix
+    // in `w_int8` for an int8 model . `weights` may be nullptr for a plain float layer
+    static cnn::Parameters* add_weight(AffineWeights *weights, cnn::Model *m, const cnn::Dim &dim, Int8Matrix *&w_int8);
+    size_t get_int8_memory_bytes() const;
+
+    // parameters of `m` with the weights here , as int8 if `as_int8` (float weights are quantized on the fly)
+    template <typename Archive>
+    void save_parameters(Archive &ar, cnn::Model &m, bool as_int8) const;
+    template <typename Archive>
+    void load_parameters(Archive &ar, cnn::Model &m);
+private:
+    bool is_int8_mode;
+    std::vector<cnn::Parameters*> float_weights; // in `m` , float mode
+    std::deque<Int8Matrix> int8_weights; // int8 mode , addresses are kept by the layers
+};
+
+/**
+ * y = b + sum_i W_i x_i with int8 W_i and int8 (dynamically quantized) x_i , int32 accumulation .
+ * args : b , x_1 ... x_n . batched inputs are supported (every batch element is one gemv) .
+ * inference only , backward throws .
+ */
+struct Int8AffineNode : public cnn::Node
+{
+    template <typename T>
+    explicit Int8AffineNode(const T &args) : cnn::Node(args){}
+    std::string as_string(const std::vector<std::string>& arg_names) const override;
+    cnn::Dim dim_forward(const std::vector<cnn::Dim>& xs) const override;
+    void forward_impl(const std::vector<const cnn::Tensor*>& xs, cnn::Tensor& fx) const override;
+    void backward_impl(const std::vector<const cnn::Tensor*>& xs,
+        const cnn::Tensor& fx,
+        const cnn::Tensor& dEdf,
+        unsigned i,
+        cnn::Tensor& dEdxi) const override;
+
+    std::vector<const Int8Matrix*> weights; // weights[i] for args[i + 1]
+    mutable std::vector<int8_t> x_q_buffer;
+};
+
+/**
+ * build the int8 affine node on the graph of `b_exp` .
+ */
+struct Int8Inference
+{
+    static cnn::expr::Expression affine_transform(const cnn::expr::Expression &b_exp,
+        std::initializer_list<const Int8Matrix*> weights, std::initializer_list<cnn::expr::Expression> xs);
+};
+
+/*************** inline implementation ***************/
+
+template <typename Archive>
+void Int8Matrix::serialize(Archive &ar, const unsigned version)
+{
+    ar & rows & cols & padded_cols & values & row_scales;
+}
+
+template <typename Archive>
+void AffineWeights::save_parameters(Archive &ar, cnn::Model &m, bool as_int8) const
+{
+    if( !as_int8 )
+    {
+        if( is_int8_mode ){ throw std::runtime_error("int8 model can't be saved as a float model ."); }
+        ar & m;
+        return;
+    }
+    // parameters except the float weights , lookup parameters , then the int8 weights
+    const std::vector<cnn::Parameters*> &params = m.parameters_list();
+    const std::vector<cnn::LookupParameters*> &lookup_params = m.lookup_parameters_list();
+    unsigned nr_params = static_cast<unsigned>(params.size() - float_weights.size()),
+        nr_lookup_params = static_cast<unsigned>(lookup_params.size());
+    ar & nr_params & nr_lookup_params;
+    for( cnn::Parameters *param : params )
+    {
+        if( std::find(float_weights.begin(), float_weights.end(), param) == float_weights.end() ){ ar & *param; }
+    }
+    for( cnn::LookupParameters *lookup_param : lookup_params ){ ar & *lookup_param; }
+    unsigned nr_int8_weights = static_cast<unsigned>(is_int8_mode ? int8_weights.size() : float_weights.size());
+    ar & nr_int8_weights;
+    if( is_int8_mode )
+    {
+        for( const Int8Matrix &w : int8_weights ){ ar & w; }
+        return;
+    }
+    for( const cnn::Parameters *param : float_weights )
+    {
+        Int8Matrix w;
+        w.quantize(*param);
+        ar & w;
+    }
+}
+
+template <typename Archive>
+void AffineWeights::load_parameters(Archive &ar, cnn::Model &m)
+{
+    if( !is_int8_mode )
+    {
+        ar & m;
+        return;
+    }
+    const std::vector<cnn::Parameters*> &params = m.parameters_list();
+    const std::vector<cnn::LookupParameters*> &lookup_params = m.lookup_parameters_list();
+    unsigned nr_params = 0,
+        nr_lookup_params = 0;
+    ar & nr_params & nr_lookup_params;
+    if( nr_params != params.size() || nr_lookup_params != lookup_params.size() )
+    {
+        throw std::runtime_error("parameters of the int8 model don't match the model structure .");
+    }
+    for( cnn::Parameters *param : params ){ ar & *param; }
+    for( cnn::LookupParameters *lookup_param : lookup_params ){ ar & *lookup_param; }
+    unsigned nr_int8_weights = 0;
+    ar & nr_int8_weights;
+    if( nr_int8_weights != int8_weights.size() )
+    {
+        throw std::runtime_error("int8 weights of the model don't match the model structure .");
+    }
+    for( Int8Matrix &w : int8_weights )
+    {
+        unsigned rows = w.get_rows(),
+            cols = w.get_cols();
+        ar & w;
+        if( w.get_rows() != rows || w.get_cols() != cols )
+        {
+            throw std::runtime_error("int8 weight dimension doesn't match the model structure .");
+        }
+    }
+}
+
+} // end of namespace slnn
+
+// the quantized copy written by `AffineWeights::save_parameters` is a temporary
+BOOST_CLASS_TRACKING(slnn::Int8Matrix, boost::serialization::track_never)
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "layers.h" 
 
 using namespace cnn;
@@ -6,45 +7,74 @@ namespace slnn {
 
 // DenseLayer
 
-DenseLayer::DenseLayer(Model *m , unsigned input_dim , unsigned output_dim)
-    :w(m->add_parameters({output_dim , input_dim})) ,
-    b(m->add_parameters({output_dim}))
-{}
+DenseLayer::DenseLayer(Model *m , unsigned input_dim , unsigned output_dim, AffineWeights *affine_weights)
+    :w(nullptr),
+    b(nullptr),
+    w_int8(nullptr)
+{
+    w = AffineWeights::add_weight(affine_weights, m, {output_dim , input_dim}, w_int8);
+    b = m->add_parameters({output_dim});
+}
 
 DenseLayer::~DenseLayer(){}
 
 // Merge 2 Layer
 
-Merge2Layer::Merge2Layer(Model *m, unsigned input1_dim, unsigned input2_dim,unsigned output_dim)
-    :w1(m->add_parameters({ output_dim , input1_dim })),
-    w2(m->add_parameters({ output_dim , input2_dim })),
-    b(m->add_parameters({ output_dim}))
-{}
+Merge2Layer::Merge2Layer(Model *m, unsigned input1_dim, unsigned input2_dim,unsigned output_dim, AffineWeights *affine_weights)
+    :w1(nullptr),
+    w2(nullptr),
+    b(nullptr),
+    w1_int8(nullptr),
+    w2_int8(nullptr)
+{
+    w1 = AffineWeights::add_weight(affine_weights, m, { output_dim , input1_dim }, w1_int8);
+    w2 = AffineWeights::add_weight(affine_weights, m, { output_dim , input2_dim }, w2_int8);
+    b = m->add_parameters({ output_dim});
+}
 
 Merge2Layer::~Merge2Layer() {}
 
 
 // Merge 3 Layer
 
-Merge3Layer::Merge3Layer(Model *m ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim , unsigned output_dim )
-    :w1(m->add_parameters({output_dim , input1_dim})) ,
-    w2(m->add_parameters({output_dim , input2_dim})) ,
-    w3(m->add_parameters({output_dim , input3_dim})) ,
-    b(m->add_parameters({output_dim}))
-{}
+Merge3Layer::Merge3Layer(Model *m ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim , unsigned output_dim ,
+    AffineWeights *affine_weights)
+    :w1(nullptr),
+    w2(nullptr),
+    w3(nullptr),
+    b(nullptr),
+    w1_int8(nullptr),
+    w2_int8(nullptr),
+    w3_int8(nullptr)
+{
+    w1 = AffineWeights::add_weight(affine_weights, m, {output_dim , input1_dim}, w1_int8);
+    w2 = AffineWeights::add_weight(affine_weights, m, {output_dim , input2_dim}, w2_int8);
+    w3 = AffineWeights::add_weight(affine_weights, m, {output_dim , input3_dim}, w3_int8);
+    b = m->add_parameters({output_dim});
+}
 
 Merge3Layer::~Merge3Layer(){}
 
 
 // Merge 4 Layer
 Merge4Layer::Merge4Layer(Model *m ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim ,
-    unsigned input4_dim, unsigned output_dim )
-    :w1(m->add_parameters({output_dim , input1_dim})) ,
-    w2(m->add_parameters({output_dim , input2_dim})) ,
-    w3(m->add_parameters({output_dim , input3_dim})) ,
-    w4(m->add_parameters({output_dim, input4_dim})),
-    b(m->add_parameters({output_dim}))
-{}
+    unsigned input4_dim, unsigned output_dim , AffineWeights *affine_weights)
+    :w1(nullptr),
+    w2(nullptr),
+    w3(nullptr),
+    w4(nullptr),
+    b(nullptr),
+    w1_int8(nullptr),
+    w2_int8(nullptr),
+    w3_int8(nullptr),
+    w4_int8(nullptr)
+{
+    w1 = AffineWeights::add_weight(affine_weights, m, {output_dim , input1_dim}, w1_int8);
+    w2 = AffineWeights::add_weight(affine_weights, m, {output_dim , input2_dim}, w2_int8);
+    w3 = AffineWeights::add_weight(affine_weights, m, {output_dim , input3_dim}, w3_int8);
+    w4 = AffineWeights::add_weight(affine_weights, m, {output_dim , input4_dim}, w4_int8);
+    b = m->add_parameters({output_dim});
+}
 
 Merge4Layer::~Merge4Layer(){}
 
@@ -52,25 +82,74 @@ Merge4Layer::~Merge4Layer(){}
 
 MLPHiddenLayer::MLPHiddenLayer(Model *m, unsigned input_dim, const vector<unsigned> &layers_dim, 
     cnn::real dropout_rate,
-    NonLinearFunc *nonlinear_func)
+    NonLinearFunc *nonlinear_func,
+    AffineWeights *affine_weights)
     :nr_hidden_layer(layers_dim.size()),
     w_list(nr_hidden_layer),
     b_list(nr_hidden_layer),
     w_expr_list(nr_hidden_layer),
     b_expr_list(nr_hidden_layer),
+    w_int8_list(nr_hidden_layer),
     dropout_rate(dropout_rate),
     nonlinear_func(nonlinear_func)
 {
     assert(nr_hidden_layer > 0);
-    w_list[0] = m->add_parameters({ layers_dim.at(0), input_dim });
+    w_list[0] = AffineWeights::add_weight(affine_weights, m, { layers_dim.at(0), input_dim }, w_int8_list[0]);
     b_list[0] = m->add_parameters({ layers_dim.at(0) });
     for( unsigned i = 1 ; i < nr_hidden_layer ; ++i )
     {
-        w_list.at(i) = m->add_parameters({ layers_dim.at(i), layers_dim.at(i - 1) });
+        w_list.at(i) = AffineWeights::add_weight(affine_weights, m, { layers_dim.at(i), layers_dim.at(i - 1) }, w_int8_list.at(i));
         b_list.at(i) = m->add_parameters({ layers_dim.at(i) });
     }
 }
 
+// Index2ExprLayer
 
+Index2ExprLayer::Index2ExprLayer(cnn::Model *m, unsigned vocab_size, unsigned embedding_dim)
+    :lookup_param(m->add_lookup_parameters(vocab_size, {embedding_dim}))
+{}
+
+ShiftedIndex2ExprLayer::ShiftedIndex2ExprLayer(cnn::Model *m, unsigned vocab_size, unsigned embedding_dim, ShiftDirection direction,
+    unsigned shift_distance)
+    : Index2ExprLayer(m, vocab_size, embedding_dim),
+    shift_direction(direction),
+    shift_distance(shift_distance),
+    padding_parameters(shift_distance)
+{
+    for( unsigned i = 0 ; i < shift_distance; ++i )
+    {
+        padding_parameters[i] = m->add_parameters({ embedding_dim });
+    }
+}
+
+void ShiftedIndex2ExprLayer::index_seq2expr_seq(const IndexSeq &indexSeq, std::vector<cnn::expr::Expression> &exprs)
+{
+    unsigned sz = indexSeq.size();
+    exprs.resize(sz);
+    if( shift_direction == LeftShift )
+    {
+        for( unsigned i = shift_distance ; i < sz; ++i )
+        {
+            exprs[i-shift_distance] = lookup(*pcg, lookup_param, indexSeq[i]);
+        }
+        unsigned padding_pos = shift_distance > sz ? 0 : sz - shift_distance ;
+        for( unsigned i = padding_pos; i < sz; ++i )
+        {
+            exprs[i] = parameter(*pcg, padding_parameters[i - padding_pos]);
+        }
+    }
+    else
+    {
+        unsigned padding_end_pos = std::min(shift_distance, sz);
+        for( unsigned i = 0; i < padding_end_pos; ++i )
+        {
+            exprs[i] = parameter(*pcg, padding_parameters[i]);
+        }
+        for( unsigned i = padding_end_pos; i < sz; ++i )
+        {
+            exprs[i] = lookup(*pcg, lookup_param, indexSeq[i - padding_end_pos]);
+        }
+    }
+}
 
 } // end namespace slnn
\ No newline at end of file
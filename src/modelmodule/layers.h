@@ -2,6 +2,8 @@
 #define LAYERS_H_INCLUDE
 
 #include <vector>
+#include <cassert>
+#include <algorithm>
 
 #include "cnn/nodes.h"
 #include "cnn/cnn.h"
@@ -12,6 +14,7 @@
 #include "cnn/dict.h"
 #include "cnn/expr.h"
 #include "utils/typedeclaration.h"
+#include "int8_affine.h"
 
 namespace slnn {
 
@@ -48,7 +51,8 @@ struct DenseLayer
         *b;
     cnn::expr::Expression w_exp,
         b_exp;
-    DenseLayer(cnn::Model *m , unsigned input_dim , unsigned output_dim );
+    Int8Matrix *w_int8; // weight of an int8 model , `w` is nullptr then
+    DenseLayer(cnn::Model *m , unsigned input_dim , unsigned output_dim , AffineWeights *affine_weights=nullptr);
     ~DenseLayer();
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression build_graph(const cnn::expr::Expression &e);
@@ -62,7 +66,10 @@ struct Merge2Layer
     cnn::expr::Expression w1_exp,
         w2_exp,
         b_exp;
-    Merge2Layer(cnn::Model *model , unsigned input1_dim, unsigned input2_dim, unsigned output_dim );
+    Int8Matrix *w1_int8,
+        *w2_int8;
+    Merge2Layer(cnn::Model *model , unsigned input1_dim, unsigned input2_dim, unsigned output_dim ,
+        AffineWeights *affine_weights=nullptr);
     ~Merge2Layer();
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression build_graph(const cnn::expr::Expression &e1, const cnn::expr::Expression &e2);
@@ -78,7 +85,11 @@ struct Merge3Layer
         w2_exp,
         w3_exp,
         b_exp;
-    Merge3Layer(cnn::Model *model ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim , unsigned output_dim);
+    Int8Matrix *w1_int8,
+        *w2_int8,
+        *w3_int8;
+    Merge3Layer(cnn::Model *model ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim , unsigned output_dim,
+        AffineWeights *affine_weights=nullptr);
     ~Merge3Layer();
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression build_graph(const cnn::expr::Expression &e1, const cnn::expr::Expression &e2, const cnn::expr::Expression &e3);
@@ -96,7 +107,12 @@ struct Merge4Layer
         w3_exp,
         w4_exp,
         b_exp;
-    Merge4Layer(cnn::Model *model ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim , unsigned input4_dim, unsigned output_dim);
+    Int8Matrix *w1_int8,
+        *w2_int8,
+        *w3_int8,
+        *w4_int8;
+    Merge4Layer(cnn::Model *model ,unsigned input1_dim , unsigned input2_dim , unsigned input3_dim , unsigned input4_dim, unsigned output_dim,
+        AffineWeights *affine_weights=nullptr);
     ~Merge4Layer();
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression build_graph(const cnn::expr::Expression &e1, const cnn::expr::Expression &e2, const cnn::expr::Expression &e3,
@@ -110,11 +126,13 @@ struct MLPHiddenLayer
     std::vector<cnn::Parameters *> b_list;
     std::vector<cnn::expr::Expression> w_expr_list;
     std::vector<cnn::expr::Expression> b_expr_list;
+    std::vector<Int8Matrix *> w_int8_list; // weights of an int8 model , `w_list` is nullptr then
     cnn::real dropout_rate;
     NonLinearFunc *nonlinear_func;
     MLPHiddenLayer(cnn::Model *m, unsigned input_dim, const std::vector<unsigned> &hidden_layer_dim_list, 
         cnn::real dropout_rate=0.f,
-        NonLinearFunc *nonlinear_func=cnn::expr::tanh);
+        NonLinearFunc *nonlinear_func=cnn::expr::tanh,
+        AffineWeights *affine_weights=nullptr);
     void new_graph(cnn::ComputationGraph &cg);
     cnn::expr::Expression
         build_graph(const cnn::expr::Expression &input_expr);
@@ -122,17 +140,76 @@ struct MLPHiddenLayer
 };
 
 
+struct Index2ExprLayer
+{
+    Index2ExprLayer(cnn::Model *m, unsigned vocab_size, unsigned embedding_dim);
+    void new_graph(cnn::ComputationGraph &cg);
+    void index_seq2expr_seq(const IndexSeq &indexSeq, std::vector<cnn::expr::Expression> &exprs);
+    cnn::expr::Expression index2expr(Index index);
+    cnn::LookupParameters* get_lookup_param(){ return lookup_param; }
+protected:
+    cnn::LookupParameters *lookup_param;
+    cnn::ComputationGraph *pcg;
+};
+
+struct ShiftedIndex2ExprLayer : public Index2ExprLayer
+{
+    // Shift Index2Expr Layer 
+    // for pre-tag , we'need an expr of [SOS] Tag1 Tag2 ... Tag[N-1] ,
+    // so we build an more flexible shift layer , such that we can build any shift position and direction 
+    using ShiftDirection = int;
+    static constexpr ShiftDirection LeftShift = -1;
+    static constexpr ShiftDirection RightShift = 1;
+    ShiftedIndex2ExprLayer(cnn::Model *m, unsigned vocab_size, unsigned embedding_dim, ShiftDirection direction=RightShift,
+        unsigned shift_distance=1);
+    void index_seq2expr_seq(const IndexSeq &indexSeq, std::vector<cnn::expr::Expression> &exprs);
+    cnn::expr::Expression get_padding_expr(unsigned padding_position = 0);
+private:
+    ShiftDirection shift_direction;
+    unsigned shift_distance;
+    std::vector<cnn::Parameters *> padding_parameters;
+};
+
+/**
+ * expression buffers for building the graph of ONE sentence .
+ * layers write outputs into caller-provided vectors by `resize` + assignment (output should NOT alias input) ,
+ * so keeping these buffers in a per-worker object (e.g. the model) keeps their capacity across sentences ,
+ * and a steady-state sentence does no vector allocation in the layers .
+ */
+struct SentenceExprBuffers
+{
+    std::vector<cnn::expr::Expression> word_exprs,
+        feature_exprs,
+        input_exprs,
+        l2r_exprs,
+        r2l_exprs,
+        concat_parts; // scratch of `StaticConcatenateLayer::concatenate_exprs`
+    std::vector<std::vector<cnn::expr::Expression> *> expr_groups; // sequences passed to a layer together
+};
+
+// index of the max value of an evaluated expr , without copying the value out of the tensor
+Index expr_value_argmax(cnn::ComputationGraph &cg, const cnn::expr::Expression &expr);
+
+struct StaticBatchLayer
+{
+    // pack a sequence of same dimension exprs into ONE mini-batched expr (batch size = sequence length) ,
+    // so that a per-position layer can be applied to the whole sequence in one matrix operation .
+    static cnn::expr::Expression seq2batch_expr(const std::vector<cnn::expr::Expression> &exprs);
+};
+
+
 // ------------------- inline function definition --------------------
 // DenseLayer
 inline 
 void DenseLayer::new_graph(cnn::ComputationGraph &cg)
 {
-    w_exp = parameter(cg, w);
+    if( w != nullptr ){ w_exp = parameter(cg, w); }
     b_exp = parameter(cg, b);
 }
 inline
 Expression DenseLayer::build_graph(const cnn::expr::Expression &e)
 {
+    if( w_int8 != nullptr ){ return Int8Inference::affine_transform(b_exp, { w_int8 }, { e }); }
     return affine_transform({ 
        b_exp ,
        w_exp , e 
@@ -144,12 +221,14 @@ inline
 void Merge2Layer::new_graph(cnn::ComputationGraph &cg)
 {
     b_exp = parameter(cg, b);
+    if( w1 == nullptr ){ return; } // int8 model
     w1_exp = parameter(cg, w1);
     w2_exp = parameter(cg, w2);
 }
 inline
 cnn::expr::Expression Merge2Layer::build_graph(const cnn::expr::Expression &e1, const cnn::expr::Expression &e2)
 {
+    if( w1_int8 != nullptr ){ return Int8Inference::affine_transform(b_exp, { w1_int8, w2_int8 }, { e1, e2 }); }
     return affine_transform({
         b_exp ,
         w1_exp , e1,
@@ -162,6 +241,7 @@ inline
 void Merge3Layer::new_graph(cnn::ComputationGraph &cg)
 {
     b_exp = parameter(cg, b);
+    if( w1 == nullptr ){ return; } // int8 model
     w1_exp = parameter(cg, w1);
     w2_exp = parameter(cg, w2);
     w3_exp = parameter(cg, w3);
@@ -170,6 +250,10 @@ void Merge3Layer::new_graph(cnn::ComputationGraph &cg)
 inline
 cnn::expr::Expression Merge3Layer::build_graph(const cnn::expr::Expression &e1, const cnn::expr::Expression &e2, const cnn::expr::Expression &e3)
 {
+    if( w1_int8 != nullptr )
+    {
+        return Int8Inference::affine_transform(b_exp, { w1_int8, w2_int8, w3_int8 }, { e1, e2, e3 });
+    }
     return affine_transform({
         b_exp,
         w1_exp, e1 ,
@@ -183,6 +267,7 @@ inline
 void Merge4Layer::new_graph(cnn::ComputationGraph &cg)
 {
     b_exp = parameter(cg, b);
+    if( w1 == nullptr ){ return; } // int8 model
     w1_exp = parameter(cg, w1);
     w2_exp = parameter(cg, w2);
     w3_exp = parameter(cg, w3);
@@ -193,6 +278,10 @@ inline
 cnn::expr::Expression Merge4Layer::build_graph(const cnn::expr::Expression &e1, const cnn::expr::Expression &e2,
     const cnn::expr::Expression &e3, const cnn::expr::Expression &e4)
 {
+    if( w1_int8 != nullptr )
+    {
+        return Int8Inference::affine_transform(b_exp, { w1_int8, w2_int8, w3_int8, w4_int8 }, { e1, e2, e3, e4 });
+    }
     return affine_transform({
         b_exp,
         w1_exp, e1 ,
@@ -209,7 +298,7 @@ void MLPHiddenLayer::new_graph(cnn::ComputationGraph &cg)
 {
     for( unsigned i = 0 ; i < nr_hidden_layer; ++i )
     {
-        w_expr_list[i] = parameter(cg, w_list[i]);
+        if( w_list[i] != nullptr ){ w_expr_list[i] = parameter(cg, w_list[i]); }
         b_expr_list[i] = parameter(cg, b_list[i]);
     }
 }
@@ -219,6 +308,15 @@ cnn::expr::Expression
 MLPHiddenLayer::build_graph(const cnn::expr::Expression &input_expr)
 {
     cnn::expr::Expression tmp_expr = input_expr;
+    if( w_int8_list[0] != nullptr )
+    {
+        // inference only , no dropout
+        for( unsigned i = 0; i < nr_hidden_layer; ++i )
+        {
+            tmp_expr = (*nonlinear_func)(Int8Inference::affine_transform(b_expr_list[i], { w_int8_list[i] }, { tmp_expr }));
+        }
+        return tmp_expr;
+    }
     for( unsigned i = 0 ; i < nr_hidden_layer; ++i )
     {
         cnn::expr::Expression net_expr = affine_transform({
@@ -235,12 +333,63 @@ void MLPHiddenLayer::build_graph(const std::vector<cnn::expr::Expression> &input
     std::vector<cnn::expr::Expression> &output_exprs)
 {
     unsigned sz = input_exprs.size();
-    std::vector<cnn::expr::Expression> tmp_output_exprs(sz);
+    output_exprs.resize(sz);
     for( unsigned i = 0; i < sz; ++i )
     {
-        tmp_output_exprs.at(i) = build_graph(input_exprs.at(i));
+        output_exprs[i] = build_graph(input_exprs[i]);
     }
-    swap(output_exprs, tmp_output_exprs);
+}
+
+// Index2ExprLayer
+
+inline 
+void Index2ExprLayer::new_graph(cnn::ComputationGraph &cg)
+{
+    pcg = &cg;
+}
+
+inline
+void Index2ExprLayer::index_seq2expr_seq(const IndexSeq &indexSeq, std::vector<cnn::expr::Expression> &exprs)
+{
+    size_t sz = indexSeq.size();
+    exprs.resize(sz);
+    for( size_t i = 0; i < sz; ++i )
+    {
+        exprs[i] = cnn::expr::lookup(*pcg, lookup_param, indexSeq[i]);
+    }
+}
+
+inline
+cnn::expr::Expression Index2ExprLayer::index2expr(Index index)
+{
+    return cnn::expr::lookup(*pcg, lookup_param, index);
+}
+
+inline
+cnn::expr::Expression ShiftedIndex2ExprLayer::get_padding_expr(unsigned padding_position)
+{
+    assert(padding_position < shift_distance);
+    return cnn::expr::parameter(*pcg, padding_parameters[padding_position]);
+}
+
+inline
+Index expr_value_argmax(cnn::ComputationGraph &cg, const cnn::expr::Expression &expr)
+{
+    const cnn::Tensor &value = cg.get_value(expr);
+    const cnn::real *begin = value.v,
+        *end = value.v + value.d.size();
+    return static_cast<Index>(std::max_element(begin, end) - begin);
+}
+
+// StaticBatchLayer
+
+inline
+cnn::expr::Expression StaticBatchLayer::seq2batch_expr(const std::vector<cnn::expr::Expression> &exprs)
+{
+    // column-major matrix [ e_0 e_1 ... e_{n-1} ] has the same memory layout as n batch elements
+    const cnn::expr::Expression &first_expr = exprs.at(0);
+    unsigned expr_dim = first_expr.pg->nodes[first_expr.i]->dim.rows();
+    return cnn::expr::reshape(cnn::expr::concatenate_cols(exprs), cnn::Dim({ expr_dim }, exprs.size()));
 }
 
 /*****************************
@@ -336,18 +485,16 @@ void BIRNNLayer<RNNDerived>::build_graph(const std::vector<cnn::expr::Expression
                                          std::vector<cnn::expr::Expression> &r2l_outputs)
 {
     size_t seq_len = X_seq.size();
-    std::vector<cnn::expr::Expression> tmp_l2r_outputs(seq_len),
-        tmp_r2l_outputs(seq_len);
+    l2r_outputs.resize(seq_len);
+    r2l_outputs.resize(seq_len);
     l2r_builder->add_input(SOS_EXP);
     r2l_builder->add_input(EOS_EXP);
     for (int pos = 0; pos < static_cast<int>(seq_len); ++pos)
     {
-        tmp_l2r_outputs[pos] = l2r_builder->add_input(X_seq[pos]);
+        l2r_outputs[pos] = l2r_builder->add_input(X_seq[pos]);
         int reverse_pos = seq_len - pos - 1;
-        tmp_r2l_outputs[reverse_pos] = r2l_builder->add_input(X_seq[reverse_pos]);
+        r2l_outputs[reverse_pos] = r2l_builder->add_input(X_seq[reverse_pos]);
     }
-    swap(l2r_outputs, tmp_l2r_outputs);
-    swap(r2l_outputs, tmp_r2l_outputs);
 }
 
 
@@ -0,0 +1,91 @@
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include "multi_lookup_concat.h"
+
+namespace slnn{
+
+const unsigned MultiLookupConcatNode::MaxNrTables;
+
+MultiLookupConcatNode::MultiLookupConcatNode(const std::initializer_list<cnn::VariableIndex> &args,
+    const std::vector<cnn::LookupParameters*> *lookup_params, const Index *indices)
+    :lookup_params(lookup_params),
+    output_dim(0)
+{
+    if( lookup_params->size() > MaxNrTables ){ throw std::runtime_error("too many lookup tables for one multi-lookup node ."); }
+    for( unsigned k = 0; k < lookup_params->size(); ++k )
+    {
+        this->indices[k] = indices[k];
+        output_dim += (*lookup_params)[k]->dim.size();
+    }
+}
+
+std::string MultiLookupConcatNode::as_string(const std::vector<std::string>& arg_names) const
+{
+    std::ostringstream oss;
+    oss << "multi_lookup_concat(";
+    for( unsigned k = 0; k < lookup_params->size(); ++k )
+    {
+        oss << (k == 0 ? "" : ", ") << "|x|=" << (*lookup_params)[k]->values.size() << " --> " << indices[k];
+    }
+    oss << ") dim=" << output_dim;
+    return oss.str();
+}
+
+cnn::Dim MultiLookupConcatNode::dim_forward(const std::vector<cnn::Dim>& xs) const
+{
+    return cnn::Dim({ output_dim });
+}
+
+void MultiLookupConcatNode::forward_impl(const std::vector<const cnn::Tensor*>& xs, cnn::Tensor& fx) const
+{
+    float *out = fx.v;
+    for( unsigned k = 0; k < lookup_params->size(); ++k )
+    {
+        const cnn::LookupParameters *param = (*lookup_params)[k];
+        unsigned dim = param->dim.size();
+        if( indices[k] < 0 ){ std::memset(out, 0, dim * sizeof(float)); }
+        else
+        {
+            assert(static_cast<unsigned>(indices[k]) < param->values.size());
+            std::memcpy(out, param->values[indices[k]].v, dim * sizeof(float));
+        }
+        out += dim;
+    }
+}
+
+void MultiLookupConcatNode::backward_impl(const std::vector<const cnn::Tensor*>& xs,
+    const cnn::Tensor& fx,
+    const cnn::Tensor& dEdf,
+    unsigned i,
+    cnn::Tensor& dEdxi) const
+{
+    throw std::runtime_error("multi-lookup node has no argument to back-propagate to .");
+}
+
+void MultiLookupConcatNode::accumulate_grad(const cnn::Tensor& g)
+{
+    float *grad = g.v;
+    for( unsigned k = 0; k < lookup_params->size(); ++k )
+    {
+        cnn::LookupParameters *param = (*lookup_params)[k];
+        if( indices[k] >= 0 )
+        {
+            cnn::Tensor slot_grad(param->dim, grad);
+            param->accumulate_grad(indices[k], slot_grad);
+        }
+        grad += param->dim.size();
+    }
+}
+
+cnn::expr::Expression MultiLookupConcat::build(cnn::ComputationGraph &cg,
+    const std::vector<cnn::LookupParameters*> &lookup_params, const Index *indices)
+{
+    cnn::VariableIndex node_idx = cg.add_function<MultiLookupConcatNode>({}, &lookup_params, indices);
+    // parameter nodes are where backward stops and gradients are accumulated
+    cg.parameter_nodes.push_back(node_idx);
+    return cnn::expr::Expression(&cg, node_idx);
+}
+
+} // end of namespace slnn
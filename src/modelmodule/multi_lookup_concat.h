@@ -0,0 +1,55 @@
+#ifndef SLNN_MODELMODULE_MULTI_LOOKUP_CONCAT_H_
+#define SLNN_MODELMODULE_MULTI_LOOKUP_CONCAT_H_
+
+#include <array>
+#include <string>
+#include <vector>
+#include "cnn/cnn.h"
+#include "cnn/nodes.h"
+#include "cnn/param-nodes.h"
+#include "cnn/expr.h"
+#include "utils/typedeclaration.h"
+
+namespace slnn{
+
+/**
+ * gather-and-concatenate node .
+ * looks up one row from every lookup table of a fixed list , and writes them contiguously into one output column ,
+ * the same value as `concatenate({ lookup(t0, i0), lookup(t1, i1) ... })` but ONE node instead of (nr_tables + 1) .
+ * backward scatters slices of the output gradient back to the rows in one `accumulate_grad` .
+ * a negative index gives zeroes for its slot (and no gradient) , as `zeroes` for an empty feature .
+ * the table list is owned by the caller (a layer) and should outlive the graph .
+ * CPU only (memcpy into the output tensor) .
+ */
+struct MultiLookupConcatNode : public cnn::ParameterNodeBase
+{
+    static const unsigned MaxNrTables = 8;
+
+    MultiLookupConcatNode(const std::initializer_list<cnn::VariableIndex> &args,
+        const std::vector<cnn::LookupParameters*> *lookup_params, const Index *indices);
+    std::string as_string(const std::vector<std::string>& arg_names) const override;
+    cnn::Dim dim_forward(const std::vector<cnn::Dim>& xs) const override;
+    void forward_impl(const std::vector<const cnn::Tensor*>& xs, cnn::Tensor& fx) const override;
+    void backward_impl(const std::vector<const cnn::Tensor*>& xs,
+        const cnn::Tensor& fx,
+        const cnn::Tensor& dEdf,
+        unsigned i,
+        cnn::Tensor& dEdxi) const override;
+    bool has_parameters() const override { return true; }
+    void accumulate_grad(const cnn::Tensor& g) override;
+
+    const std::vector<cnn::LookupParameters*> *lookup_params;
+    std::array<Index, MaxNrTables> indices;
+    unsigned output_dim;
+};
+
+struct MultiLookupConcat
+{
+    // `indices` has `lookup_params.size()` elements
+    static cnn::expr::Expression build(cnn::ComputationGraph &cg,
+        const std::vector<cnn::LookupParameters*> &lookup_params, const Index *indices);
+};
+
+} // end of namespace slnn
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef MODELMODULE_PRETAG_BEAM_SEARCH_H_
+#define MODELMODULE_PRETAG_BEAM_SEARCH_H_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <Eigen/Dense>
+
+#include "cnn/cnn.h"
+#include "cnn/expr.h"
+#include "utils/typedeclaration.h"
+
+namespace slnn{
+
+/**
+ * Beam search decoder for pretag output .
+ * pretag hidden layer is : h_i = f( b + W_1 x1_i + W_2 x2_i + ... + W_tag tag_{i-1} ) ,
+ * the part without previous tag is precomputed for all positions (in ONE forward) ,
+ * and W_tag * tag is precomputed for every tag (the tag set is small) .
+ * So a decoding step for all K hypotheses is only a column gather + ONE (output_dim x hidden_dim) * (hidden_dim x K)
+ * matrix product , and no more forward calls on computation graph .
+ * With beam_size = 1 it is the greedy decoding , equal to `PretagOutput::build_output_in_graph` up to float rounding
+ * (Eigen and the graph may sum in different orders , so a near-tie of the top-2 tags may be decided differently) .
+ */
+struct PretagBeamSearchDecoder
+{
+    using Matrix = Eigen::Matrix<cnn::real, Eigen::Dynamic, Eigen::Dynamic>;
+    using Vector = Eigen::Matrix<cnn::real, Eigen::Dynamic, 1>;
+
+    /**
+     * precomputed_hidden : hidden_dim x len , hidden value before the previous tag part (bias included)
+     * tag_hidden : hidden_dim x (tag_num + 1) , W_tag * tag_embedding , the last column is for SOS
+     * output_w , output_b : output dense layer
+     */
+    static void decode(const Matrix &precomputed_hidden, const Matrix &tag_hidden,
+        NonLinearFunc *nonlinear_func,
+        const Matrix &output_w, const Vector &output_b,
+        unsigned beam_size,
+        IndexSeq &pred_seq);
+
+    static Matrix expr_value2matrix(cnn::ComputationGraph &cg, const cnn::expr::Expression &expr, unsigned rows);
+    static void apply_nonlinear(NonLinearFunc *nonlinear_func, Matrix &m);
+    static bool is_supported_nonlinear(NonLinearFunc *nonlinear_func);
+};
+
+/****************** inline implementation *****************/
+
+inline
+bool PretagBeamSearchDecoder::is_supported_nonlinear(NonLinearFunc *nonlinear_func)
+{
+    return nonlinear_func == static_cast<NonLinearFunc *>(&cnn::expr::rectify) ||
+        nonlinear_func == static_cast<NonLinearFunc *>(&cnn::expr::tanh);
+}
+
+inline
+void PretagBeamSearchDecoder::apply_nonlinear(NonLinearFunc *nonlinear_func, Matrix &m)
+{
+    if( nonlinear_func == static_cast<NonLinearFunc *>(&cnn::expr::rectify) )
+    {
+        m = m.cwiseMax(static_cast<cnn::real>(0));
+    }
+    else if( nonlinear_func == static_cast<NonLinearFunc *>(&cnn::expr::tanh) )
+    {
+        m = m.unaryExpr([](cnn::real x){ return std::tanh(x); });
+    }
+    else { throw std::runtime_error("unsupported nonlinear function for pretag beam search decoding ."); }
+}
+
+inline
+PretagBeamSearchDecoder::Matrix
+PretagBeamSearchDecoder::expr_value2matrix(cnn::ComputationGraph &cg, const cnn::expr::Expression &expr, unsigned rows)
+{
+    // cnn Tensor is column-major , so the flat values can be mapped directly
+    std::vector<cnn::real> values = cnn::as_vector(cg.get_value(expr));
+    unsigned cols = values.size() / rows;
+    return Eigen::Map<Matrix>(values.data(), rows, cols);
+}
+
+inline
+void PretagBeamSearchDecoder::decode(const Matrix &precomputed_hidden, const Matrix &tag_hidden,
+    NonLinearFunc *nonlinear_func,
+    const Matrix &output_w, const Vector &output_b,
+    unsigned beam_size,
+    IndexSeq &pred_seq)
+{
+    using std::swap;
+    unsigned len = precomputed_hidden.cols();
+    unsigned tag_num = output_w.rows();
+    unsigned sos_col = tag_hidden.cols() - 1;
+    if( 0 == len ){ pred_seq.clear(); return; }
+    if( 0 == beam_size ){ beam_size = 1; }
+    // hypothesis of the current step
+    std::vector<cnn::real> hyp_scores(1, 0.f);
+    std::vector<Index> hyp_last_tags(1, -1); // -1 for SOS
+    // back-trace : for every step , the (previous hypothesis index , tag) of every hypothesis
+    std::vector<std::vector<unsigned>> back_hyp_idx_seq(len);
+    std::vector<std::vector<Index>> back_tag_seq(len);
+    // candidates container
+    struct Candidate
+    {
+        cnn::real score;
+        cnn::real output_score; // un-normalized , to break the tie caused by float rounding of normalization
+        unsigned hyp_idx;
+        Index tag;
+    };
+    std::vector<Candidate> candidates;
+    Matrix hidden;
+    Matrix output;
+    for( unsigned i = 0; i < len; ++i )
+    {
+        unsigned nr_hyp = hyp_scores.size();
+        // gather hidden for all hypotheses
+        hidden.resize(precomputed_hidden.rows(), nr_hyp);
+        for( unsigned k = 0; k < nr_hyp; ++k )
+        {
+            unsigned tag_col = hyp_last_tags[k] < 0 ? sos_col : static_cast<unsigned>(hyp_last_tags[k]);
+            hidden.col(k) = precomputed_hidden.col(i) + tag_hidden.col(tag_col);
+        }
+        apply_nonlinear(nonlinear_func, hidden);
+        output.noalias() = output_w * hidden;
+        output.colwise() += output_b;
+        // log-softmax for every hypothesis , and expand
+        candidates.clear();
+        candidates.reserve(nr_hyp * tag_num);
+        for( unsigned k = 0; k < nr_hyp; ++k )
+        {
+            cnn::real max_val = output.col(k).maxCoeff();
+            cnn::real log_z = max_val + std::log((output.col(k).array() - max_val).exp().sum());
+            for( unsigned t = 0; t < tag_num; ++t )
+            {
+                candidates.push_back(Candidate{ hyp_scores[k] + output(t, k) - log_z, output(t, k), k, static_cast<Index>(t) });
+            }
+        }
+        // select top-k . tie is broken by (hyp_idx , output score , tag) order , so beam_size = 1 keeps the first max , as `max_element`
+        unsigned nr_selected = std::min<unsigned>(beam_size, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + nr_selected, candidates.end(),
+            [](const Candidate &lhs, const Candidate &rhs)
+            {
+                if( lhs.score != rhs.score ){ return lhs.score > rhs.score; }
+                if( lhs.hyp_idx != rhs.hyp_idx ){ return lhs.hyp_idx < rhs.hyp_idx; }
+                if( lhs.output_score != rhs.output_score ){ return lhs.output_score > rhs.output_score; }
+                return lhs.tag < rhs.tag;
+            });
+        hyp_scores.resize(nr_selected);
+        hyp_last_tags.resize(nr_selected);
+        back_hyp_idx_seq[i].resize(nr_selected);
+        back_tag_seq[i].resize(nr_selected);
+        for( unsigned k = 0; k < nr_selected; ++k )
+        {
+            hyp_scores[k] = candidates[k].score;
+            hyp_last_tags[k] = candidates[k].tag;
+            back_hyp_idx_seq[i][k] = candidates[k].hyp_idx;
+            back_tag_seq[i][k] = candidates[k].tag;
+        }
+    }
+    // hypotheses are sorted , the first one is the best
+    IndexSeq tmp_pred_seq(len);
+    unsigned hyp_idx = 0;
+    for( unsigned i = len; i > 0; --i )
+    {
+        tmp_pred_seq[i - 1] = back_tag_seq[i - 1][hyp_idx];
+        hyp_idx = back_hyp_idx_seq[i - 1][hyp_idx];
+    }
+    swap(pred_seq, tmp_pred_seq);
+}
+
+} // end of namespace slnn
+
+#endif
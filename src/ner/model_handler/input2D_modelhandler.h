@@ -57,6 +57,10 @@ public :
                 const std::vector<IndexSeq> *p_ner_seqs ,
                 const std::string *p_conlleval_script_path);
     void predict(std::istream &is, std::ostream &os);
+    // recognize word sequences in memory (no text parsing) , for in-process pipelines .
+    // `postag_seqs` are ids of `sim->get_postag_dict()` , an empty sentence gets empty ner tags
+    void predict_ner_seqs(const std::vector<Seq> &word_seqs, const std::vector<IndexSeq> &postag_seqs,
+                          std::vector<IndexSeq> &ner_seqs, BasicStat &stat);
 
     // Save & Load
     void save_model(std::ostream &os);
@@ -486,6 +490,37 @@ void Input2DModelHandler<SIModel>::predict(std::istream &is, std::ostream &os)
     BOOST_LOG_TRIVIAL(info) << stat.get_stat_str("predict done.")  ;
 }
 
+template <typename SIModel>
+void Input2DModelHandler<SIModel>::predict_ner_seqs(const std::vector<Seq> &word_seqs,
+                                                    const std::vector<IndexSeq> &postag_seqs,
+                                                    std::vector<IndexSeq> &ner_seqs,
+                                                    BasicStat &stat)
+{
+    cnn::Dict &word_dict = sim->get_word_dict() ;
+    assert(word_dict.is_frozen()) ;
+    std::vector<IndexSeq> tmp_ner_seqs(word_seqs.size());
+    IndexSeq sent;
+    for( size_t i = 0; i < word_seqs.size(); ++i )
+    {
+        const Seq &words = word_seqs.at(i);
+        if( words.empty() ) continue;
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        {
+            ScopedStageTimer extract_timer(stat.stage_timings, StageTimings::Stage::Extract);
+            sent.resize(words.size());
+            for( size_t word_idx = 0; word_idx < words.size(); ++word_idx )
+            {
+                sent[word_idx] = word_dict.Convert(replace_number(words[word_idx]));
+            }
+        }
+        ScopedStageTimer decode_timer(stat.stage_timings, StageTimings::Stage::Decode);
+        cnn::ComputationGraph cg;
+        sim->predict(cg, sent, postag_seqs.at(i), tmp_ner_seqs[i]);
+        stat.total_tags += tmp_ner_seqs[i].size() ;
+    }
+    swap(ner_seqs, tmp_ner_seqs);
+}
+
 template <typename SIModel>
 void Input2DModelHandler<SIModel>::save_model(std::ostream &os)
 {
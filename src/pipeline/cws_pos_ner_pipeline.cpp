@@ -0,0 +1,178 @@
+#include <boost/log/core.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+#include "segmentor/cws_input1_cl_with_feature/cws_input1_cl_f2i_model.h"
+#include "segmentor/model_handler/input1_with_feature_modelhandler_0628.hpp"
+#include "postagger/pos_input2_classification_with_feature/pos_input2_classification_feature2input_layer_model.h"
+#include "postagger/model_handler/input2_with_feature_modelhandler.hpp"
+#include "ner/ner_single_classification/ner_single_classification_model.h"
+#include "ner/model_handler/input2D_modelhandler.h"
+#include "pipeline/cws_pos_ner_pipeline.hpp"
+#include "utils/general.hpp"
+
+using namespace std;
+using namespace cnn;
+using namespace slnn;
+namespace po = boost::program_options;
+static const string ProgramHeader = "CWS -> POS -> NER Pipeline based on CNN Library";
+static const int CNNRandomSeed = 1234;
+
+template <typename Handler>
+void load_model_or_exit(Handler &model_handler, const string &model_path)
+{
+    ifstream is(model_path);
+    if (!is)
+    {
+        fatal_error("Error : failed to open model path at '" + model_path + "' . ");
+    }
+    model_handler.load_model(is);
+    is.close();
+}
+
+template <typename RNNDerived>
+int predict_process(int argc, char *argv[], const string &program_name)
+{
+    string description = ProgramHeader + "\n"
+        "Predict process .\n"
+        "using `" + program_name + " predict [rnn-type] <options>` to segment , postag and recognize named entities"
+        " of raw text in one process . rnn-type is of the CWS and POS models . predict options are as following";
+    po::options_description op_des = po::options_description(description);
+    string raw_data_path, output_path, cws_model_path, pos_model_path, ner_model_path;
+    op_des.add_options()
+        ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) as JSON to the path .")
+        ("raw_data", po::value<string>(&raw_data_path), "The path to raw data (not segmented) .")
+        ("output", po::value<string>(&output_path), "The path to storing result . using `stdout` if not specified .")
+        ("cws_model", po::value<string>(&cws_model_path), "The CWS model path (cws_input1_cl_f2i)")
+        ("pos_model", po::value<string>(&pos_model_path), "The POS model path (pos_input2_classification_feature2input_layer)")
+        ("ner_model", po::value<string>(&ner_model_path), "The NER model path (ner_single_classification)")
+        ("batch_size", po::value<unsigned>()->default_value(256), "The number of lines passed between stages at a time .")
+        ("sentence_cache_mb", po::value<float>()->default_value(0.f), "Cache the tags of repeated sentences in at most N MB"
+            " for CWS and POS each , the least recently used are dropped . 0 disables it .")
+        ("help,h", "Show help information.");
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).allow_unregistered().run(), var_map);
+    po::notify(var_map);
+    if (var_map.count("help"))
+    {
+        cerr << op_des << endl;
+        return 0;
+    }
+
+    //set params
+
+    varmap_key_fatal_check(var_map, "raw_data", "raw_data path should be specified .");
+
+    if (output_path == "")
+    {
+        BOOST_LOG_TRIVIAL(info) << "no output is specified . using stdout .";
+    }
+
+    varmap_key_fatal_check(var_map, "cws_model", "Error : CWS model path should be specified ! ");
+    varmap_key_fatal_check(var_map, "pos_model", "Error : POS model path should be specified ! ");
+    varmap_key_fatal_check(var_map, "ner_model", "Error : NER model path should be specified ! ");
+
+    // Init
+    int cnn_argc;
+    shared_ptr<char *> cnn_argv;
+    unsigned cnn_mem = 0 ;
+    if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
+    CWSInput1WithFeatureModelHandler<RNNDerived, CWSInput1CLF2IModel<RNNDerived>> cws_model_handler;
+    Input2WithFeatureModelHandler<RNNDerived, POSInput2ClassificationF2IModel<RNNDerived>> pos_model_handler;
+    Input2DModelHandler<NERSingleClassificationModel> ner_model_handler;
+
+    // load models
+    load_model_or_exit(cws_model_handler, cws_model_path);
+    load_model_or_exit(pos_model_handler, pos_model_path);
+    load_model_or_exit(ner_model_handler, ner_model_path);
+    float sentence_cache_mb = var_map["sentence_cache_mb"].as<float>();
+    cws_model_handler.set_sentence_cache(sentence_cache_mb, SentenceCache::model_id_from_name(cws_model_path));
+    pos_model_handler.set_sentence_cache(sentence_cache_mb, SentenceCache::model_id_from_name(pos_model_path));
+    CWSPOSNERPipeline<decltype(cws_model_handler), decltype(pos_model_handler), decltype(ner_model_handler)>
+        pipeline(cws_model_handler, pos_model_handler, ner_model_handler);
+
+    // open raw_data
+    ifstream raw_is(raw_data_path);
+    if (!raw_is)
+    {
+        fatal_error("Error : failed to open raw data at '" + raw_data_path + "'");
+    }
+
+    // open output
+    unsigned batch_size = var_map["batch_size"].as<unsigned>();
+    if ("" == output_path)
+    {
+        pipeline.run(raw_is, cout, batch_size); // using `cout` as output stream
+        raw_is.close();
+    }
+    else
+    {
+        ofstream os(output_path);
+        if (!os)
+        {
+            raw_is.close();
+            fatal_error("Error : failed open output file at : `" +  output_path + "`.");
+        }
+        pipeline.run(raw_is, os, batch_size);
+        os.close();
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    ostringstream oss;
+    string program_name = argv[0];
+    oss << ProgramHeader << "\n"
+        << "usage : " << program_name << " [task] [rnn-type] <options>" << "\n"
+        << "task : [ predict ]\n"
+        << "rnn-type : [ rnn, lstm, gru] , \n"
+        << "           rnn  : simple rnn implementation for RNN\n"
+        << "           lstm : lstm implementation for RNN\n"
+        << "           gru  : gru implementation for RNN\n"
+        << "<options> : options for specific task and model .\n"
+        << "            using '" << program_name << " [task] [rnn-type] -h' for details" ;
+    string usage = oss.str();
+
+    if (argc <= 3)
+    {
+        cerr << usage << "\n" ;
+#if (defined(_WIN32)) && (defined(_DEBUG))
+        system("pause");
+#endif
+        return -1;
+    }
+    string task = string(argv[1]);
+    string rnn_type = string(argv[2]);
+    int ret_status ;
+    const string PredictTask = "predict";
+    const string SimpleRNNType = "rnn", LSTMType = "lstm", GRUType = "gru";
+    function<void()> action_when_unknown_rnn_type = [&ret_status,&rnn_type]
+    {
+        cerr << "unknow rnn-type : '" << rnn_type << "'\n";
+        ret_status = -1;
+    } ;
+    if( PredictTask == task )
+    {
+        if( SimpleRNNType == rnn_type ){ ret_status = predict_process<SimpleRNNBuilder>(argc - 2, argv + 2, program_name); }
+        else if( LSTMType == rnn_type ){ ret_status = predict_process<LSTMBuilder>(argc - 2, argv + 2, program_name); }
+        else if( GRUType == rnn_type ){ ret_status = predict_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
+        else { action_when_unknown_rnn_type() ; }
+    }
+    else
+    {
+        cerr << "unknown task : " << task << "\n"
+            << usage;
+        ret_status = -1;
+    }
+#if (defined(_WIN32)) && (_DEBUG)
+    system("pause");
+#endif
+    return ret_status;
+}
@@ -0,0 +1,252 @@
+#ifndef SLNN_PIPELINE_CWS_POS_NER_PIPELINE_HPP_
+#define SLNN_PIPELINE_CWS_POS_NER_PIPELINE_HPP_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <functional>
+#include <algorithm>
+#include <utility>
+#include <iostream>
+#include <boost/log/trivial.hpp>
+#include "utils/typedeclaration.h"
+#include "utils/utf8processing.hpp"
+#include "utils/stat.hpp"
+#include "utils/bounded_queue.hpp"
+#include "segmentor/cws_module/cws_feature.h"
+
+namespace slnn{
+
+/**
+ * in-process CWS -> POS -> NER pipeline .
+ * word boundaries , POS ids and NER ids are passed in memory between stages , instead of writing and
+ * re-parsing the `word` / `word_postag` text between three processes . POS ids of the POS model are mapped
+ * to POS ids of the NER model by a table built once , so no tag string is converted per word .
+ *
+ * threads , connected by bounded queues of batches :
+ *     reader : read lines , split into utf8 chars and extract CWS features
+ *     tagger : CWS , POS and NER networks
+ *     writer : format and write `word/postag#ner` lines (the `predict` output of NER)
+ * cnn permits one computation graph at a time , so all networks run on the tagger thread . every network runs
+ * over the whole batch and releases its recycled graph before the next one builds its graph .
+ */
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+class CWSPOSNERPipeline
+{
+public:
+    CWSPOSNERPipeline(CWSHandler &cws_handler, POSHandler &pos_handler, NERHandler &ner_handler);
+    CWSPOSNERPipeline(const CWSPOSNERPipeline&) = delete;
+    CWSPOSNERPipeline& operator=(const CWSPOSNERPipeline&) = delete;
+
+    // `batch_size` lines for every batch , at most `queue_capacity` batches wait between two threads
+    void run(std::istream &is, std::ostream &os, unsigned batch_size, unsigned queue_capacity=4);
+
+private:
+    struct Batch
+    {
+        std::vector<Seq> char_seqs;
+        std::vector<IndexSeq> char_index_seqs;
+        std::vector<CWSFeatureDataSeq> cws_feature_seqs;
+        std::vector<Seq> word_seqs;
+        std::vector<IndexSeq> postag_seqs, // ids of the POS model
+            ner_postag_seqs, // ids of the NER model
+            ner_seqs;
+    };
+
+    void build_postag_mapping();
+    void read_batches(std::istream &is, unsigned batch_size, BoundedQueue<Batch> &read_queue);
+    void tag_batches(BoundedQueue<Batch> &read_queue, BoundedQueue<Batch> &tagged_queue);
+    void write_batches(std::ostream &os, BoundedQueue<Batch> &tagged_queue);
+
+    CWSHandler &cws_handler;
+    POSHandler &pos_handler;
+    NERHandler &ner_handler;
+    IndexSeq pos2ner_postag; // POS id of the POS model -> POS id of the NER model
+    Seq postag_strs; // POS id of the POS model -> tag string
+    // every stat is touched by one thread only
+    BasicStat io_stat,
+        cws_stat,
+        pos_stat,
+        ner_stat;
+};
+
+/*************** inline implementation ***************/
+
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+CWSPOSNERPipeline<CWSHandler, POSHandler, NERHandler>::CWSPOSNERPipeline(CWSHandler &cws_handler,
+    POSHandler &pos_handler, NERHandler &ner_handler)
+    :cws_handler(cws_handler),
+    pos_handler(pos_handler),
+    ner_handler(ner_handler),
+    io_stat(true),
+    cws_stat(true),
+    pos_stat(true),
+    ner_stat(true)
+{
+    build_postag_mapping();
+}
+
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+void CWSPOSNERPipeline<CWSHandler, POSHandler, NERHandler>::build_postag_mapping()
+{
+    cnn::Dict &pos_postag_dict = pos_handler.i2m->get_postag_dict(),
+        &ner_postag_dict = ner_handler.sim->get_postag_dict();
+    unsigned nr_postags = pos_postag_dict.size();
+    pos2ner_postag.assign(nr_postags, 0);
+    postag_strs.resize(nr_postags);
+    unsigned nr_unknown = 0;
+    for( unsigned postag_id = 0; postag_id < nr_postags; ++postag_id )
+    {
+        const std::string &postag = pos_postag_dict.Convert(static_cast<int>(postag_id));
+        postag_strs[postag_id] = postag;
+        if( ner_postag_dict.Contains(postag) ){ pos2ner_postag[postag_id] = ner_postag_dict.Convert(postag); }
+        else
+        {
+            BOOST_LOG_TRIVIAL(warning) << "POS tag `" << postag << "` is unknown to the NER model , mapped to `"
+                << ner_postag_dict.Convert(0) << "` .";
+            ++nr_unknown;
+        }
+    }
+    BOOST_LOG_TRIVIAL(info) << nr_postags << " POS tags are mapped to the NER model (" << nr_unknown << " unknown) .";
+}
+
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+void CWSPOSNERPipeline<CWSHandler, POSHandler, NERHandler>::read_batches(std::istream &is, unsigned batch_size,
+    BoundedQueue<Batch> &read_queue)
+{
+    std::string line;
+    bool has_more = true;
+    while( has_more )
+    {
+        Batch batch;
+        batch.char_seqs.reserve(batch_size);
+        {
+            ScopedStageTimer read_timer(io_stat.stage_timings, StageTimings::Stage::Read);
+            while( batch.char_seqs.size() < batch_size && (has_more = static_cast<bool>(std::getline(is, line))) )
+            {
+                batch.char_seqs.emplace_back();
+                UTF8Processing::utf8_str2char_seq(line, batch.char_seqs.back());
+            }
+        }
+        if( batch.char_seqs.empty() ){ break; }
+        batch.char_index_seqs.resize(batch.char_seqs.size());
+        batch.cws_feature_seqs.resize(batch.char_seqs.size());
+        for( size_t i = 0; i < batch.char_seqs.size(); ++i )
+        {
+            if( batch.char_seqs[i].empty() ){ continue; }
+            ScopedStageTimer extract_timer(io_stat.stage_timings, StageTimings::Stage::Extract);
+            // thread-safe with frozen dicts , the tagger thread runs networks meanwhile
+            cws_handler.i1m->char_seq2index_seq(batch.char_seqs[i], batch.char_index_seqs[i], batch.cws_feature_seqs[i]);
+        }
+        if( !read_queue.push(std::move(batch)) ){ break; } // closed by a failed thread
+    }
+}
+
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+void CWSPOSNERPipeline<CWSHandler, POSHandler, NERHandler>::tag_batches(BoundedQueue<Batch> &read_queue,
+    BoundedQueue<Batch> &tagged_queue)
+{
+    Batch batch;
+    while( read_queue.pop(batch) )
+    {
+        cws_handler.predict_word_seqs(batch.char_seqs, batch.char_index_seqs, batch.cws_feature_seqs, batch.word_seqs, cws_stat);
+        cws_handler.release_graph();
+        pos_handler.predict_postag_seqs(batch.word_seqs, batch.postag_seqs, pos_stat);
+        pos_handler.release_graph();
+        batch.ner_postag_seqs.resize(batch.postag_seqs.size());
+        for( size_t i = 0; i < batch.postag_seqs.size(); ++i )
+        {
+            const IndexSeq &postag_seq = batch.postag_seqs[i];
+            IndexSeq &ner_postag_seq = batch.ner_postag_seqs[i];
+            ner_postag_seq.resize(postag_seq.size());
+            for( size_t word_idx = 0; word_idx < postag_seq.size(); ++word_idx )
+            {
+                ner_postag_seq[word_idx] = pos2ner_postag.at(postag_seq[word_idx]);
+            }
+        }
+        ner_handler.predict_ner_seqs(batch.word_seqs, batch.ner_postag_seqs, batch.ner_seqs, ner_stat);
+        if( !tagged_queue.push(std::move(batch)) ){ break; }
+    }
+}
+
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+void CWSPOSNERPipeline<CWSHandler, POSHandler, NERHandler>::write_batches(std::ostream &os,
+    BoundedQueue<Batch> &tagged_queue)
+{
+    cnn::Dict &ner_dict = ner_handler.sim->get_ner_dict();
+    const std::string &delimiter = NERHandler::OUT_SPLIT_DELIMITER;
+    Batch batch;
+    while( tagged_queue.pop(batch) )
+    {
+        ScopedStageTimer write_timer(io_stat.stage_timings, StageTimings::Stage::Write);
+        for( size_t i = 0; i < batch.word_seqs.size(); ++i )
+        {
+            const Seq &words = batch.word_seqs[i];
+            const IndexSeq &postag_seq = batch.postag_seqs[i],
+                &ner_seq = batch.ner_seqs[i];
+            for( size_t word_idx = 0; word_idx < words.size(); ++word_idx )
+            {
+                if( word_idx > 0 ){ os << delimiter; }
+                os << words[word_idx] << "/" << postag_strs[postag_seq[word_idx]]
+                    << "#" << ner_dict.Convert(ner_seq[word_idx]);
+            }
+            os << "\n";
+            io_stat.total_tags += words.size();
+        }
+    }
+    os.flush();
+}
+
+template <typename CWSHandler, typename POSHandler, typename NERHandler>
+void CWSPOSNERPipeline<CWSHandler, POSHandler, NERHandler>::run(std::istream &is, std::ostream &os,
+    unsigned batch_size, unsigned queue_capacity)
+{
+    batch_size = std::max(batch_size, 1U);
+    BoundedQueue<Batch> read_queue(queue_capacity),
+        tagged_queue(queue_capacity);
+    std::exception_ptr first_exception;
+    std::mutex exception_mutex;
+    // a failed thread closes both queues , so the others stop
+    auto guarded = [&](std::function<void()> body, BoundedQueue<Batch> *done_queue)
+    {
+        try{ body(); }
+        catch( ... )
+        {
+            {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                if( !first_exception ){ first_exception = std::current_exception(); }
+            }
+            read_queue.close();
+            tagged_queue.close();
+        }
+        if( done_queue ){ done_queue->close(); }
+    };
+    BOOST_LOG_TRIVIAL(info) << "run CWS -> POS -> NER pipeline , " << batch_size << " lines for every batch .";
+    io_stat.start_time_stat();
+    std::thread reader(guarded, [&]{ read_batches(is, batch_size, read_queue); }, &read_queue),
+        tagger(guarded, [&]{ tag_batches(read_queue, tagged_queue); }, &tagged_queue);
+    guarded([&]{ write_batches(os, tagged_queue); }, nullptr);
+    reader.join();
+    tagger.join();
+    io_stat.end_time_stat();
+    if( first_exception ){ std::rethrow_exception(first_exception); }
+
+    BOOST_LOG_TRIVIAL(info) << io_stat.get_stat_str("pipeline done.") << "\n"
+        << "words : " << io_stat.total_tags << " , CWS tags : " << cws_stat.total_tags
+        << " , POS tags : " << pos_stat.total_tags << " , NER tags : " << ner_stat.total_tags;
+    // every stage timings is reported on its own (one JSON line each) , so the sentence histograms stay apart
+    io_stat.stage_timings.report("stage latency of reading and writing :");
+    cws_stat.stage_timings.report("stage latency of CWS :");
+    pos_stat.stage_timings.report("stage latency of POS :");
+    ner_stat.stage_timings.report("stage latency of NER :");
+    cws_handler.report_graph_memory("graph memory of CWS :");
+    pos_handler.report_graph_memory("graph memory of POS :");
+    cws_handler.report_sentence_cache("sentence cache of CWS :");
+    pos_handler.report_sentence_cache("sentence cache of POS :");
+}
+
+} // end of namespace slnn
+
+#endif
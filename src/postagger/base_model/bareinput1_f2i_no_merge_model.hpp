@@ -11,6 +11,7 @@
 #include "cnn/cnn.h"
 #include "cnn/dict.h"
 #include "single_input_with_feature_model.hpp"
+#include "modelmodule/graph_recycler.h"
 namespace slnn{
 
 template<typename RNNDerived>
@@ -120,24 +121,29 @@ cnn::expr::Expression BareInput1F2IModel<RNNDerived>::build_loss(cnn::Computatio
                                                                            const POSFeature::POSFeatureIndexGroupSeq &features_gp_seq,
                                                                            const IndexSeq &gold_seq)
 {
-    pos_feature_layer->new_graph(cg);
-    input_layer->new_graph(cg) ;
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        pos_feature_layer->new_graph(cg);
+        input_layer->new_graph(cg) ;
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->set_dropout() ;
     birnn_layer->start_new_sequence() ;
 
-    std::vector<cnn::expr::Expression> features_exprs;
+    std::vector<cnn::expr::Expression> &features_exprs = this->expr_buffers.feature_exprs;
     pos_feature_layer->build_feature_exprs(features_gp_seq, features_exprs);
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     input_layer->build_inputs(input_seq, features_exprs, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
-    return output_layer->build_output_loss(std::vector<std::vector<cnn::expr::Expression> *>({ &l2r_exprs, &r2l_exprs }), 
+    this->expr_buffers.expr_groups.assign({ &l2r_exprs, &r2l_exprs });
+    return output_layer->build_output_loss(this->expr_buffers.expr_groups, 
         gold_seq) ;
 }
 
@@ -147,23 +153,28 @@ void BareInput1F2IModel<RNNDerived>::predict(cnn::ComputationGraph &cg,
                                                       const POSFeature::POSFeatureIndexGroupSeq &features_gp_seq,
                                                       IndexSeq &pred_seq)
 {
-    pos_feature_layer->new_graph(cg);
-    input_layer->new_graph(cg) ;
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        pos_feature_layer->new_graph(cg);
+        input_layer->new_graph(cg) ;
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->disable_dropout() ;
     birnn_layer->start_new_sequence();
 
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     pos_feature_layer->build_feature_exprs(features_gp_seq, feature_exprs);
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     input_layer->build_inputs(input_seq, feature_exprs, inputs_exprs) ;
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
-    output_layer->build_output(std::vector<std::vector<cnn::expr::Expression> *>({ &l2r_exprs, &r2l_exprs }),
+    this->expr_buffers.expr_groups.assign({ &l2r_exprs, &r2l_exprs });
+    output_layer->build_output(this->expr_buffers.expr_groups,
         pred_seq) ;
 }
 
@@ -13,6 +13,7 @@
 
 #include "utils/typedeclaration.h"
 #include "bareinput1_f2o_no_merge_model.hpp"
+#include "modelmodule/graph_recycler.h"
 namespace slnn{
 
 template<typename RNNDerived>
@@ -85,23 +86,27 @@ cnn::expr::Expression BareInput1F2ONonlinearModel<RNNDerived>::build_loss(cnn::C
     const POSFeature::POSFeatureIndexGroupSeq &features_gp_seq,
     const IndexSeq &gold_seq)
 {
-    this->pos_feature_layer->new_graph(cg);
-    pos_feature_hidden_layer->new_graph(cg);
-    this->input_layer->new_graph(cg) ;
-    this->birnn_layer->new_graph(cg) ;
-    this->output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        this->pos_feature_layer->new_graph(cg);
+        pos_feature_hidden_layer->new_graph(cg);
+        this->input_layer->new_graph(cg) ;
+        this->birnn_layer->new_graph(cg) ;
+        this->output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     this->birnn_layer->set_dropout() ;
     this->birnn_layer->start_new_sequence() ;
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     this->input_layer->build_inputs(input_seq, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     this->birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
 
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     this->pos_feature_layer->build_feature_exprs(features_gp_seq, feature_exprs);
     for( size_t i = 0; i < input_seq.size(); ++i )
     {
@@ -109,7 +114,8 @@ cnn::expr::Expression BareInput1F2ONonlinearModel<RNNDerived>::build_loss(cnn::C
             pos_feature_hidden_layer->build_graph(feature_exprs.at(i))
         );
     }
-    return this->output_layer->build_output_loss(std::vector<std::vector<cnn::expr::Expression> *>({ &l2r_exprs, &r2l_exprs, &feature_exprs }),
+    this->expr_buffers.expr_groups.assign({ &l2r_exprs, &r2l_exprs, &feature_exprs });
+    return this->output_layer->build_output_loss(this->expr_buffers.expr_groups,
         gold_seq) ;
 }
 
@@ -119,23 +125,27 @@ void BareInput1F2ONonlinearModel<RNNDerived>::predict(cnn::ComputationGraph &cg,
     const POSFeature::POSFeatureIndexGroupSeq &features_gp_seq,
     IndexSeq &pred_seq)
 {
-    this->pos_feature_layer->new_graph(cg);
-    pos_feature_hidden_layer->new_graph(cg);
-    this->input_layer->new_graph(cg) ;
-    this->birnn_layer->new_graph(cg) ;
-    this->output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        this->pos_feature_layer->new_graph(cg);
+        pos_feature_hidden_layer->new_graph(cg);
+        this->input_layer->new_graph(cg) ;
+        this->birnn_layer->new_graph(cg) ;
+        this->output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     this->birnn_layer->disable_dropout() ;
     this->birnn_layer->start_new_sequence();
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     this->input_layer->build_inputs(input_seq, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     this->birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
 
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     this->pos_feature_layer->build_feature_exprs(features_gp_seq, feature_exprs);
     
     for( size_t i = 0; i < input_seq.size(); ++i )
@@ -145,7 +155,8 @@ void BareInput1F2ONonlinearModel<RNNDerived>::predict(cnn::ComputationGraph &cg,
         );
     }
     
-    this->output_layer->build_output(std::vector<std::vector<cnn::expr::Expression> *>({ &l2r_exprs, &r2l_exprs, &feature_exprs }),
+    this->expr_buffers.expr_groups.assign({ &l2r_exprs, &r2l_exprs, &feature_exprs });
+    this->output_layer->build_output(this->expr_buffers.expr_groups,
         pred_seq) ;
 }
 
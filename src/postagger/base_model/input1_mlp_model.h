@@ -140,14 +140,13 @@ void Input1MLPModel::replace_word_with_unk(const IndexSeq &sent,
     ContextFeatureDataSeq &replaced_context_feature_gp_seq,
     POSFeature::POSFeatureIndexGroupSeq &replaced_feature_gp_seq)
 {
-    using std::swap;
+    // write in place , so a reused output buffer doesn't allocate
     size_t seq_len = sent.size();
-    IndexSeq tmp_rep_sent(seq_len);
+    replaced_sent.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
-        tmp_rep_sent[i] = word_dict_wrapper.ConvertProbability(sent[i]);
+        replaced_sent[i] = word_dict_wrapper.ConvertProbability(sent[i]);
     }
-    swap(replaced_sent, tmp_rep_sent);
     pos_feature.do_repalce_feature_with_unk_in_copy(feature_gp_seq, replaced_feature_gp_seq);
     context_feature.random_replace_with_unk(context_feature_gp_seq, replaced_context_feature_gp_seq);
 }
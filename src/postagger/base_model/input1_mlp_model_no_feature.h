@@ -127,14 +127,13 @@ void Input1MLPModelNoFeature::replace_word_with_unk(const IndexSeq &sent,
     IndexSeq &replaced_sent, 
     ContextFeatureDataSeq &replaced_context_feature_gp_seq)
 {
-    using std::swap;
+    // write in place , so a reused output buffer doesn't allocate
     size_t seq_len = sent.size();
-    IndexSeq tmp_rep_sent(seq_len);
+    replaced_sent.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
-        tmp_rep_sent[i] = word_dict_wrapper.ConvertProbability(sent[i]);
+        replaced_sent[i] = word_dict_wrapper.ConvertProbability(sent[i]);
     }
-    swap(replaced_sent, tmp_rep_sent);
     context_feature.random_replace_with_unk(context_feature_gp_seq, replaced_context_feature_gp_seq);
 }
 
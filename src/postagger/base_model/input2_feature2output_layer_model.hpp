@@ -7,11 +7,13 @@
 #include <boost/serialization/assume_abstract.hpp>
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "cnn/cnn.h"
 #include "cnn/dict.h"
 
 #include "input2_with_feature_model.hpp"
+#include "modelmodule/graph_recycler.h"
 namespace slnn{
 
 template<typename RNNDerived>
@@ -51,6 +53,8 @@ public:
     void serialize(Archive & ar, const unsigned version);
 
 protected:
+    // the fixed channel is a lookup parameter in `m` , or the compact table if its storage is not float
+    Input2* new_input_layer(unsigned mergeout_dim);
 
     POSFeatureLayer * pos_feature_layer;
     Input2 *input_layer;
@@ -108,6 +112,14 @@ void Input2F2OModel<RNNDerived>::set_model_param(const boost::program_options::v
     hidden_dim = var_map["tag_layer_hidden_dim"].as<unsigned>() ;
 
     dropout_rate = var_map["dropout_rate"].as<cnn::real>() ;
+    if( var_map.count("fixed_embedding_storage") != 0 )
+    {
+        this->set_fixed_embedding_storage(FixedEmbeddingTable::parse_storage(var_map["fixed_embedding_storage"].as<std::string>()));
+    }
+    if( var_map.count("pq_nr_subspaces") != 0 && var_map.count("pq_kmeans_iter") != 0 )
+    {
+        this->set_fixed_embedding_pq_param(var_map["pq_nr_subspaces"].as<unsigned>(), var_map["pq_kmeans_iter"].as<unsigned>());
+    }
 
     unsigned prefix_suffix_len1_embedding_dim = var_map["prefix_suffix_len1_embedding_dim"].as<unsigned>();
     unsigned prefix_suffix_len2_embedding_dim = var_map["prefix_suffix_len2_embedding_dim"].as<unsigned>();
@@ -130,7 +142,30 @@ void Input2F2OModel<RNNDerived>::build_fixed_dict(std::ifstream &is)
 template <typename RNNDerived>
 void Input2F2OModel<RNNDerived>::load_fixed_embedding(std::ifstream &is)
 {
-    Word2vecEmbeddingHelper::load_fixed_embedding(is, this->fixed_word_dict, fixed_word_embedding_dim, input_layer->fixed_lookup_param);
+    if( !this->fixed_embedding_table.is_compact() )
+    {
+        Word2vecEmbeddingHelper::load_fixed_embedding(is, this->fixed_word_dict, fixed_word_embedding_dim, input_layer->fixed_lookup_param);
+        return;
+    }
+    FixedEmbeddingTable &table = this->fixed_embedding_table;
+    table.resize(fixed_word_dict_size, fixed_word_embedding_dim);
+    Word2vecEmbeddingHelper::load_fixed_embedding(is, this->fixed_word_dict, fixed_word_embedding_dim,
+        [&table](int word_id, const std::vector<cnn::real> &embedding_vec){ table.set_row(word_id, embedding_vec); });
+    table.finish_building();
+    BOOST_LOG_TRIVIAL(info) << "fixed embedding is stored as " << FixedEmbeddingTable::storage_name(table.get_storage())
+        << " , " << table.get_memory_bytes() << " bytes .";
+}
+
+template <typename RNNDerived>
+Input2* Input2F2OModel<RNNDerived>::new_input_layer(unsigned mergeout_dim)
+{
+    if( this->fixed_embedding_table.is_compact() )
+    {
+        return new Input2(this->m, dynamic_word_dict_size, dynamic_word_embedding_dim,
+            &this->fixed_embedding_table, fixed_word_embedding_dim, mergeout_dim);
+    }
+    return new Input2(this->m, dynamic_word_dict_size, dynamic_word_embedding_dim,
+        fixed_word_dict_size, fixed_word_embedding_dim, mergeout_dim);
 }
 
 
@@ -141,22 +176,26 @@ cnn::expr::Expression Input2F2OModel<RNNDerived>::build_loss(cnn::ComputationGra
     const POSFeature::POSFeatureIndexGroupSeq &features_gp_seq,
     const IndexSeq &gold_seq)
 {
-    pos_feature_layer->new_graph(cg);
-    input_layer->new_graph(cg) ;
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        pos_feature_layer->new_graph(cg);
+        input_layer->new_graph(cg) ;
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->set_dropout() ;
     birnn_layer->start_new_sequence() ;
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     input_layer->build_inputs(dynamic_sent, fixed_sent, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
 
-    std::vector<cnn::expr::Expression> features_exprs;
+    std::vector<cnn::expr::Expression> &features_exprs = this->expr_buffers.feature_exprs;
     pos_feature_layer->build_feature_exprs(features_gp_seq, features_exprs);
 
     return output_layer->build_output_loss(l2r_exprs, r2l_exprs, features_exprs, gold_seq) ;
@@ -169,22 +208,26 @@ void Input2F2OModel<RNNDerived>::predict(cnn::ComputationGraph &cg,
     const POSFeature::POSFeatureIndexGroupSeq &features_gp_seq,
     IndexSeq &pred_seq)
 {
-    pos_feature_layer->new_graph(cg);
-    input_layer->new_graph(cg) ;
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        pos_feature_layer->new_graph(cg);
+        input_layer->new_graph(cg) ;
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->disable_dropout() ;
     birnn_layer->start_new_sequence();
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     input_layer->build_inputs(dynamic_sent, fixed_sent, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
 
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     pos_feature_layer->build_feature_exprs(features_gp_seq, feature_exprs);
 
     output_layer->build_output(l2r_exprs, r2l_exprs, feature_exprs, pred_seq) ;
@@ -199,6 +242,7 @@ void Input2F2OModel<RNNDerived>::save(Archive &ar, const unsigned version) const
         & hidden_dim & output_dim
         & dropout_rate ;
     ar & this->dynamic_word_dict & this->fixed_word_dict & this->postag_dict & this->pos_feature ;
+    ar & this->fixed_embedding_table;
     ar & *this->m ;
 }
 
@@ -211,6 +255,7 @@ void Input2F2OModel<RNNDerived>::load(Archive &ar, const unsigned version)
         & hidden_dim & output_dim
         & dropout_rate ;
     ar & this->dynamic_word_dict & this->fixed_word_dict & this->postag_dict & this->pos_feature;
+    if( version >= 1 ){ ar & this->fixed_embedding_table; }
     assert(this->dynamic_word_dict.size() == dynamic_word_dict_size && this->fixed_word_dict.size() == fixed_word_dict_size &&
         this->postag_dict.size() == output_dim) ;
     build_model_structure() ;
@@ -225,4 +270,17 @@ void Input2F2OModel<RNNDerived>::serialize(Archive & ar, const unsigned version)
 }
 
 } // end of namespace slnn
+
+// version 1 : compact fixed embedding table
+namespace boost{
+namespace serialization{
+template <typename RNNDerived>
+struct version<slnn::Input2F2OModel<RNNDerived>>
+{
+    typedef mpl::int_<1> type;
+    typedef mpl::integral_c_tag tag;
+    BOOST_STATIC_CONSTANT(int, value = version::type::value);
+};
+} // end of namespace serialization
+} // end of namespace boost
 #endif
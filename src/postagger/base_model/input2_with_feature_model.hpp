@@ -2,6 +2,7 @@
 #define POS_BASE_MODEL_INPUT2_WITH_FEATURE_MODEL_HPP_
 #include <fstream>
 #include <boost/program_options.hpp>
+#include <boost/log/trivial.hpp>
 
 #include "cnn/cnn.h"
 #include "cnn/dict.h"
@@ -10,9 +11,13 @@
 #include "postagger/postagger_module/pos_feature_extractor.h"
 #include "postagger/postagger_module/pos_feature_layer.h"
 #include "utils/dict_wrapper.hpp"
+#include "utils/frozen_dict.hpp"
 #include "utils/utf8processing.hpp"
 #include "utils/word2vec_embedding_helper.h"
+#include "utils/memory_stat.hpp"
 #include "modelmodule/hyper_layers.h"
+#include "modelmodule/graph_recycler.h"
+#include "modelmodule/fixed_embedding_table.h"
 namespace slnn{
 
 template<typename RNNDerived>
@@ -31,11 +36,26 @@ public:
     Input2WithFeatureModel& operator()(const Input2WithFeatureModel&) = delete;
 
     void set_replace_threshold(int freq_threshold, float prob_threshold);
+    void set_feature_hash_bucket_size(unsigned hash_bucket_size){ pos_feature.set_hash_bucket_size(hash_bucket_size); }
+    // store the fixed embedding as a compact table out of `m` , should be set before building the structure .
+    // unlike float , a compact table is NOT fine-tuned when training , so the trained model differs
+    void set_fixed_embedding_storage(FixedEmbeddingTable::Storage storage);
+    void set_fixed_embedding_pq_param(unsigned nr_subspaces, unsigned nr_kmeans_iter)
+    {
+        fixed_embedding_table.set_pq_param(nr_subspaces, nr_kmeans_iter);
+    }
     bool is_fixed_dict_frozen(){ return fixed_word_dict.is_frozen(); }
     bool is_dict_frozen();
     void freeze_dict();
+    // re-index dynamic words by frequency when freezing , `old2new` remaps the data indexed before .
+    // fixed dict needs no re-indexing : its ids follow the embedding file , which is frequency ordered by word2vec
+    void freeze_dict_in_frequency_order(IndexSeq &old2new);
+    // read-only copies of the frozen dicts for inference , built after the model is loaded
+    void build_frozen_dicts();
     virtual void build_fixed_dict(std::ifstream &is) = 0; // bacause paremeter about size is in derived class
     void print_dynamic_word_hit_info();
+    // estimated memory of all dicts (and their frozen copies)
+    size_t get_dict_memory_bytes() const;
     virtual void set_model_param(const boost::program_options::variables_map &var_map) = 0;
     
     virtual void build_model_structure() = 0 ;
@@ -69,15 +89,23 @@ public:
     cnn::Dict& get_postag_dict(){ return postag_dict ; } 
     DictWrapper& get_word_dict_wrapper(){ return dynamic_word_dict_wrapper ; } 
     cnn::Model *get_cnn_model(){ return m ; } 
+    // graphs passed to `build_loss` / `predict` from this recycler keep their parameter nodes , nullptr for plain graphs
+    void set_graph_recycler(GraphRecycler *graph_recycler){ this->graph_recycler = graph_recycler; }
 
 
 protected:
     cnn::Model *m;
+    SentenceExprBuffers expr_buffers; // reused by `build_loss` and `predict` across sentences
+    GraphRecycler *graph_recycler; // not owned
+    ParameterMemoryLedger param_ledger; // parameter bytes of every layer , marked in `build_model_structure`
 
     cnn::Dict dynamic_word_dict;
     cnn::Dict fixed_word_dict;
     cnn::Dict postag_dict;
     DictWrapper dynamic_word_dict_wrapper;
+    FrozenDict frozen_dynamic_word_dict;
+    FrozenDict frozen_fixed_word_dict;
+    FixedEmbeddingTable fixed_embedding_table; // used when its storage is compact
 
 public:
     POSFeature pos_feature; // also as parameters
@@ -98,6 +126,7 @@ const size_t Input2WithFeatureModel<RNNDerived>::LenStrOfRepalceNumber = StrOfRe
 template<typename RNNDerived>
 Input2WithFeatureModel<RNNDerived>::Input2WithFeatureModel() 
     :m(nullptr),
+    graph_recycler(nullptr),
     dynamic_word_dict_wrapper(dynamic_word_dict)
 {}
 
@@ -106,6 +135,17 @@ Input2WithFeatureModel<RNNDerived>::~Input2WithFeatureModel()
 {
     delete m;
 }
+template <typename RNNDerived>
+void Input2WithFeatureModel<RNNDerived>::set_fixed_embedding_storage(FixedEmbeddingTable::Storage storage)
+{
+    fixed_embedding_table.set_storage(storage);
+    if( fixed_embedding_table.is_compact() )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "fixed embedding is stored as " << FixedEmbeddingTable::storage_name(storage)
+            << " , it is kept constant (not fine-tuned) when training , results differ from float storage .";
+    }
+}
+
 template <typename RNNDerived>
 void Input2WithFeatureModel<RNNDerived>::set_replace_threshold(int freq_threshold, float prob_threshold)
 {
@@ -129,12 +169,37 @@ void Input2WithFeatureModel<RNNDerived>::freeze_dict()
     pos_feature.freeze_dict();
 }
 
+template <typename RNNDerived>
+void Input2WithFeatureModel<RNNDerived>::freeze_dict_in_frequency_order(IndexSeq &old2new)
+{
+    dynamic_word_dict_wrapper.freeze_in_frequency_order(UNK_STR, old2new);
+    postag_dict.Freeze();
+    pos_feature.freeze_dict();
+}
+
+template <typename RNNDerived>
+void Input2WithFeatureModel<RNNDerived>::build_frozen_dicts()
+{
+    frozen_dynamic_word_dict.build(dynamic_word_dict, dynamic_word_dict.Convert(UNK_STR));
+    frozen_fixed_word_dict.build(fixed_word_dict, fixed_word_dict.Convert(UNK_STR));
+    pos_feature.build_frozen_dicts();
+}
+
 template <typename RNNDerived>
 void Input2WithFeatureModel<RNNDerived>::print_dynamic_word_hit_info()
 {
     Word2vecEmbeddingHelper::calc_hit_rate(fixed_word_dict, dynamic_word_dict, UNK_STR);
 }
 
+template <typename RNNDerived>
+size_t Input2WithFeatureModel<RNNDerived>::get_dict_memory_bytes() const
+{
+    return MemoryStat::dict_bytes(dynamic_word_dict) + MemoryStat::dict_bytes(fixed_word_dict)
+        + MemoryStat::dict_bytes(postag_dict)
+        + frozen_dynamic_word_dict.get_memory_bytes() + frozen_fixed_word_dict.get_memory_bytes()
+        + pos_feature.get_dict_memory_bytes();
+}
+
 
 template <typename RNNDerived>
 void Input2WithFeatureModel<RNNDerived>::input_seq2index_seq(const Seq &sent,
@@ -157,9 +222,13 @@ void Input2WithFeatureModel<RNNDerived>::input_seq2index_seq(const Seq &sent,
         tmp_fixed_sent_index_seq.at(i) = fixed_word_dict.Convert(replaced_word);
         tmp_postag_index_seq[i] = postag_dict.Convert(postag_seq[i]);
     }
-    POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
-    POSFeatureExtractor::extract(sent, feature_gp_str_seq);
-    pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
+    if( pos_feature.is_hashing_feature() ){ pos_feature.extract_hashed_feature_index_group_seq(sent, feature_gp_seq); }
+    else
+    {
+        POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
+        POSFeatureExtractor::extract(sent, feature_gp_str_seq);
+        pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
+    }
 
     swap(dynamic_index_sent, tmp_dynamic_sent_index_seq);
     swap(fixed_index_sent, tmp_fixed_sent_index_seq);
@@ -179,12 +248,24 @@ void Input2WithFeatureModel<RNNDerived>::input_seq2index_seq(const Seq &sent,
     for( size_t i = 0 ; i < seq_len; ++i )
     {
         std::string replaced_word = UTF8Processing::replace_number(sent[i], StrOfReplaceNumber, LenStrOfRepalceNumber);
-        tmp_dynamic_index_sent[i] = dynamic_word_dict_wrapper.Convert(replaced_word);
-        tmp_fixed_index_sent.at(i) = fixed_word_dict.Convert(replaced_word);
+        if( !frozen_dynamic_word_dict.empty() )
+        {
+            tmp_dynamic_index_sent[i] = frozen_dynamic_word_dict.convert(replaced_word);
+            tmp_fixed_index_sent[i] = frozen_fixed_word_dict.convert(replaced_word);
+        }
+        else
+        {
+            tmp_dynamic_index_sent[i] = dynamic_word_dict_wrapper.Convert(replaced_word);
+            tmp_fixed_index_sent.at(i) = fixed_word_dict.Convert(replaced_word);
+        }
+    }
+    if( pos_feature.is_hashing_feature() ){ pos_feature.extract_hashed_feature_index_group_seq(sent, feature_gp_seq); }
+    else
+    {
+        POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
+        POSFeatureExtractor::extract(sent, feature_gp_str_seq);
+        pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
     }
-    POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
-    POSFeatureExtractor::extract(sent, feature_gp_str_seq);
-    pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
 
     swap(dynamic_index_sent, tmp_dynamic_index_sent);
     swap(fixed_index_sent, tmp_fixed_index_sent);
@@ -197,14 +278,13 @@ void Input2WithFeatureModel<RNNDerived>::replace_word_with_unk(const IndexSeq &d
                                                                     IndexSeq &replaced_dynamic_sent, 
                                                                     POSFeature::POSFeatureIndexGroupSeq &replaced_feature_gp_seq)
 {
-    using std::swap;
+    // write in place , so a reused output buffer doesn't allocate
     size_t seq_len = dynamic_sent.size();
-    IndexSeq tmp_rep_sent(seq_len);
+    replaced_dynamic_sent.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
-        tmp_rep_sent[i] = dynamic_word_dict_wrapper.ConvertProbability(dynamic_sent[i]);
+        replaced_dynamic_sent[i] = dynamic_word_dict_wrapper.ConvertProbability(dynamic_sent[i]);
     }
-    swap(replaced_dynamic_sent, tmp_rep_sent);
     pos_feature.do_repalce_feature_with_unk_in_copy(feature_gp_seq, replaced_feature_gp_seq);
 }
 
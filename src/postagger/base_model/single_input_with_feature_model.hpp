@@ -12,6 +12,7 @@
 #include "utils/dict_wrapper.hpp"
 #include "utils/utf8processing.hpp"
 #include "modelmodule/hyper_layers.h"
+#include "modelmodule/graph_recycler.h"
 namespace slnn{
 
 template<typename RNNDerived>
@@ -30,6 +31,7 @@ public:
     SingleInputWithFeatureModel& operator()(const SingleInputWithFeatureModel&) = delete;
 
     void set_replace_threshold(int freq_threshold, float prob_threshold);
+    void set_feature_hash_bucket_size(unsigned hash_bucket_size){ pos_feature.set_hash_bucket_size(hash_bucket_size); }
     bool is_dict_frozen();
     void freeze_dict();
     virtual void set_model_param(const boost::program_options::variables_map &var_map) = 0;
@@ -59,10 +61,14 @@ public:
     cnn::Dict& get_postag_dict(){ return postag_dict ; } 
     DictWrapper& get_word_dict_wrapper(){ return word_dict_wrapper ; } 
     cnn::Model *get_cnn_model(){ return m ; } 
+    // graphs passed to `build_loss` / `predict` from this recycler keep their parameter nodes , nullptr for plain graphs
+    void set_graph_recycler(GraphRecycler *graph_recycler){ this->graph_recycler = graph_recycler; }
 
 
 protected:
     cnn::Model *m;
+    SentenceExprBuffers expr_buffers; // reused by `build_loss` and `predict` across sentences
+    GraphRecycler *graph_recycler; // not owned
 
     cnn::Dict word_dict;
     cnn::Dict postag_dict;
@@ -87,6 +93,7 @@ const size_t SingleInputWithFeatureModel<RNNDerived>::LenStrOfRepalceNumber = St
 template<typename RNNDerived>
 SingleInputWithFeatureModel<RNNDerived>::SingleInputWithFeatureModel() 
     :m(nullptr),
+    graph_recycler(nullptr),
     word_dict_wrapper(word_dict)
 {}
 
@@ -136,9 +143,13 @@ void SingleInputWithFeatureModel<RNNDerived>::input_seq2index_seq(const Seq &sen
         );
         tmp_postag_index_seq[i] = postag_dict.Convert(postag_seq[i]);
     }
-    POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
-    POSFeatureExtractor::extract(sent, feature_gp_str_seq);
-    pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
+    if( pos_feature.is_hashing_feature() ){ pos_feature.extract_hashed_feature_index_group_seq(sent, feature_gp_seq); }
+    else
+    {
+        POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
+        POSFeatureExtractor::extract(sent, feature_gp_str_seq);
+        pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
+    }
 
     swap(index_sent, tmp_sent_index_seq);
     swap(index_postag_seq, tmp_postag_index_seq);
@@ -158,9 +169,13 @@ void SingleInputWithFeatureModel<RNNDerived>::input_seq2index_seq(const Seq &sen
             UTF8Processing::replace_number(sent[i], StrOfReplaceNumber, LenStrOfRepalceNumber)
         );
     }
-    POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
-    POSFeatureExtractor::extract(sent, feature_gp_str_seq);
-    pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
+    if( pos_feature.is_hashing_feature() ){ pos_feature.extract_hashed_feature_index_group_seq(sent, feature_gp_seq); }
+    else
+    {
+        POSFeature::POSFeatureGroupSeq feature_gp_str_seq;
+        POSFeatureExtractor::extract(sent, feature_gp_str_seq);
+        pos_feature.feature_group_seq2feature_index_group_seq(feature_gp_str_seq, feature_gp_seq);
+    }
 
     swap(index_sent, tmp_sent_index_seq);
 }
@@ -172,14 +187,13 @@ void SingleInputWithFeatureModel<RNNDerived>::replace_word_with_unk(const IndexS
                                                                     IndexSeq &replaced_sent, 
                                                                     POSFeature::POSFeatureIndexGroupSeq &replaced_feature_gp_seq)
 {
-    using std::swap;
+    // write in place , so a reused output buffer doesn't allocate
     size_t seq_len = sent.size();
-    IndexSeq tmp_rep_sent(seq_len);
+    replaced_sent.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
-        tmp_rep_sent[i] = word_dict_wrapper.ConvertProbability(sent[i]);
+        replaced_sent[i] = word_dict_wrapper.ConvertProbability(sent[i]);
     }
-    swap(replaced_sent, tmp_rep_sent);
     pos_feature.do_repalce_feature_with_unk_in_copy(feature_gp_seq, replaced_feature_gp_seq);
 }
 
@@ -247,6 +247,9 @@ void Input1MLPModelNoFeatureHandler<MLPModel>::train(const std::vector<IndexSeq>
         BasicStat training_stat_per_epoch;
         training_stat_per_epoch.start_time_stat();
 
+        // scratch buffers for UNK replacement , reused by every sample
+        IndexSeq sent_after_replace;
+        ContextFeatureDataSeq context_feature_gp_seq_after_replace;
         // train for every Epoch 
         for( unsigned i = 0; i < nr_samples; ++i )
         {
@@ -258,8 +261,6 @@ void Input1MLPModelNoFeatureHandler<MLPModel>::train(const std::vector<IndexSeq>
             { // new scope , for only one Computatoin Graph can be exists in one scope at the same time .
               // devel will creat another Computation Graph , so we need to create new scoce to release it before devel .
                 cnn::ComputationGraph cg ;
-                IndexSeq sent_after_replace ;
-                ContextFeatureDataSeq context_feature_gp_seq_after_replace;
                 mlp_model->replace_word_with_unk(sent, context_feature_gp_seq, 
                     sent_after_replace, context_feature_gp_seq_after_replace);
                 mlp_model->build_loss(cg, sent_after_replace, context_feature_gp_seq_after_replace, tag_seq);
@@ -1,11 +1,16 @@
 #ifndef POS_MODEL_HANDLER_INPUT2_WITH_FEATURE_MODELHANDLERS_HPP_
 #define POS_MODEL_HANDLER_INPUT2_WITH_FEATURE_MODELHANDLERS_HPP_
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include "postagger/base_model/input2_with_feature_model.hpp"
 #include "postagger/postagger_module/pos_reader.h"
 #include "utils/stash_model.hpp"
 #include "utils/stat.hpp"
+#include "utils/memory_stat.hpp"
+#include "modelmodule/graph_recycler.h"
+#include "utils/flat_seqs.hpp"
+#include "utils/sentence_cache.hpp"
 namespace slnn{
 
 template <typename RNNDerived, typename I2Model>
@@ -23,50 +28,71 @@ public:
 
     // before reading
     void build_fixed_dict(std::ifstream &is);
+    // 0 : prefix / suffix dicts , > 0 : hash prefix / suffix features into buckets
+    void set_feature_hash_bucket_size(unsigned hash_bucket_size){ i2m->set_feature_hash_bucket_size(hash_bucket_size); }
 
     // Reading data 
     void read_annotated_data(std::istream &is,
-        std::vector<IndexSeq> &dynamic_sents,
-        std::vector<IndexSeq> &fixed_sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
-        std::vector<IndexSeq> &postags_seqs);
+        FlatIndexSeqs &dynamic_sents,
+        FlatIndexSeqs &fixed_sents,
+        POSFeature::POSFeatureIndexGroupFlatSeqs &features_seqs,
+        FlatIndexSeqs &postags_seqs);
 
     void read_training_data(std::istream &is,
-        std::vector<IndexSeq> &training_dynamic_sents,
-        std::vector<IndexSeq> &training_fixed_sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
-        std::vector<IndexSeq> &postags_seqs);
+        FlatIndexSeqs &training_dynamic_sents,
+        FlatIndexSeqs &training_fixed_sents,
+        POSFeature::POSFeatureIndexGroupFlatSeqs &features_seqs,
+        FlatIndexSeqs &postags_seqs);
 
     void read_devel_data(std::istream &is,
-        std::vector<IndexSeq> &devel_dynamic_sents,
-        std::vector<IndexSeq> &devel_fixed_sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
-        std::vector<IndexSeq> &postag_seqs);
+        FlatIndexSeqs &devel_dynamic_sents,
+        FlatIndexSeqs &devel_fixed_sents,
+        POSFeature::POSFeatureIndexGroupFlatSeqs &features_seqs,
+        FlatIndexSeqs &postag_seqs);
 
     void read_test_data(std::istream &is,
         std::vector<Seq> &raw_sents,
         std::vector<IndexSeq> &dynamic_sents,
         std::vector<IndexSeq> &fixed_sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs);
+        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
+        StageTimings *timings=nullptr); // extraction latency of every sentence is recorded if not null
 
-    void train(const std::vector<IndexSeq> *p_dynamic_sents,
-        const std::vector<IndexSeq> *p_fixed_sents,
-        const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-        const std::vector<IndexSeq> *p_tag_seqs,
+    void train(const FlatIndexSeqs *p_dynamic_sents,
+        const FlatIndexSeqs *p_fixed_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+        const FlatIndexSeqs *p_tag_seqs,
         unsigned max_epoch,
-        const std::vector<IndexSeq> *p_dev_dynamic_sents,
-        const std::vector<IndexSeq> *p_dev_fixed_sents,
-        const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_dev_features_gp_seqs,
-        const std::vector<IndexSeq> *p_dev_tag_seqs,
+        const FlatIndexSeqs *p_dev_dynamic_sents,
+        const FlatIndexSeqs *p_dev_fixed_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_dev_features_gp_seqs,
+        const FlatIndexSeqs *p_dev_tag_seqs,
         unsigned do_devel_freq,
         unsigned trivial_report_freq);
 
-    float devel(const std::vector<IndexSeq> *p_dynamic_sents,
-        const std::vector<IndexSeq> *p_fixed_sents,
-        const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-        const std::vector<IndexSeq> *p_tag_seqs);
+    float devel(const FlatIndexSeqs *p_dynamic_sents,
+        const FlatIndexSeqs *p_fixed_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+        const FlatIndexSeqs *p_tag_seqs);
 
     void predict(std::istream &is, std::ostream &os);
+    // tag raw lines for the server , one output line (without '\n') for every input line ,
+    // in the same format as `predict` . nothing is logged , latencies and tags are counted to `stat`
+    void predict_lines(const std::vector<std::string> &lines, std::vector<std::string> &outputs, BasicStat &stat);
+    // tag word sequences in memory (no text parsing) , for in-process pipelines .
+    // tags are ids of `i2m->get_postag_dict()` , an empty sentence gets empty tags
+    void predict_postag_seqs(const std::vector<Seq> &word_seqs, std::vector<IndexSeq> &postag_seqs, BasicStat &stat);
+    // drop the recycled graph , so that another handler can build its graph (cnn permits one graph at a time)
+    void release_graph(){ graph_recycler.release(); }
+    // log the graph memory profile and merge it into the memory profile file of this model (if set)
+    void report_graph_memory(const std::string &info_header);
+    // the memory profile file of this model , nothing is written if empty (the default)
+    void set_mem_profile_path(const std::string &path){ mem_profile_path = path; }
+    // cache tags of repeated sentences for all predictions , `capacity_mb` = 0 disables it .
+    // `model_id` tells models apart , e.g. `SentenceCache::model_id_from_name(model_path)`
+    void set_sentence_cache(double capacity_mb, uint64_t model_id);
+    const SentenceCache& get_sentence_cache() const { return sentence_cache; }
+    // log hit rate and memory of the sentence cache (if enabled)
+    void report_sentence_cache(const std::string &info_header);
 
     void save_model(std::ostream &os);
     void load_model(std::istream &is);
@@ -77,7 +103,18 @@ public:
     void load_fixed_embedding(std::ifstream &is);
 
 private:
+    void log_corpus_memory(const std::string &corpus_name,
+        const FlatIndexSeqs *p_dynamic_sents, const FlatIndexSeqs *p_fixed_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs, const FlatIndexSeqs *p_tag_seqs);
+    // tags of one sentence from the network , then cached
+    void decode_sentence(const Seq &word_seq, const IndexSeq &dynamic_sent, const IndexSeq &fixed_sent,
+        const POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq, IndexSeq &pred_tag_seq, StageTimings &timings);
+
     CNNModelStash model_stash;
+    GraphRecycler graph_recycler; // train , devel and predict share ONE recycled graph
+    GraphMemoryProfile graph_memory_profile; // peak graph memory by sentence length , of all graphs built
+    SentenceCache sentence_cache; // predicted tags keyed by the word sequence , disabled by default
+    std::string mem_profile_path; // measured graph memory is merged into it , if not empty
 };
 
 template <typename RNNDerived, typename I2Model>
@@ -86,7 +123,9 @@ const std::string Input2WithFeatureModelHandler<RNNDerived, I2Model>::OutputDeli
 template <typename RNNDerived, typename I2Model>
 Input2WithFeatureModelHandler<RNNDerived, I2Model>::Input2WithFeatureModelHandler()
     :i2m(new I2Model())
-{}
+{
+    i2m->set_graph_recycler(&graph_recycler);
+}
 
 template <typename RNNDerived, typename I2Model>
 Input2WithFeatureModelHandler<RNNDerived, I2Model>::~Input2WithFeatureModelHandler()
@@ -102,41 +141,45 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::build_fixed_dict(std::i
 
 template <typename RNNDerived, typename I2Model>
 void Input2WithFeatureModelHandler<RNNDerived, I2Model>::read_annotated_data(std::istream &is,
-    std::vector<IndexSeq> &dynamic_sents,
-    std::vector<IndexSeq> &fixed_sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_gp_seqs,
-    std::vector<IndexSeq> &postag_seqs)
+    FlatIndexSeqs &dynamic_sents,
+    FlatIndexSeqs &fixed_sents,
+    POSFeature::POSFeatureIndexGroupFlatSeqs &features_gp_seqs,
+    FlatIndexSeqs &postag_seqs)
 {
     using std::swap;
     assert(i2m->is_fixed_dict_frozen() == true);
     POSReader reader(is);
-    std::vector<IndexSeq> tmp_dynamic_sents,
+    FlatIndexSeqs tmp_dynamic_sents,
         tmp_fixed_sents,
         tmp_postag_seqs;
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> tmp_features_gp_seqs;
+    POSFeature::POSFeatureIndexGroupFlatSeqs tmp_features_gp_seqs;
     size_t detected_line_cnt = reader.count_line();
-    tmp_dynamic_sents.reserve(detected_line_cnt);
-    tmp_fixed_sents.reserve(detected_line_cnt);
-    tmp_postag_seqs.reserve(detected_line_cnt);
-    tmp_features_gp_seqs.reserve(detected_line_cnt);
+    tmp_dynamic_sents.reserve(detected_line_cnt, 0);
+    tmp_fixed_sents.reserve(detected_line_cnt, 0);
+    tmp_postag_seqs.reserve(detected_line_cnt, 0);
+    tmp_features_gp_seqs.reserve(detected_line_cnt, 0);
     size_t line_cnt = 0 ;
     Seq str_sent,
         str_postag_seq;
+    IndexSeq dynamic_sent,
+        fixed_sent,
+        postag_seq;
+    POSFeature::POSFeatureIndexGroupSeq features_gp_seq;
     while( reader.readline(str_sent, str_postag_seq) )
     {
         if( str_sent.size() == 0 ) continue;
-        IndexSeq dynamic_sent,
-            fixed_sent,
-            postag_seq;
-        POSFeature::POSFeatureIndexGroupSeq features_gp_seq;
         i2m->input_seq2index_seq(str_sent, str_postag_seq, dynamic_sent, fixed_sent, postag_seq, features_gp_seq);
-        tmp_dynamic_sents.push_back(std::move(dynamic_sent));
-        tmp_fixed_sents.push_back(std::move(fixed_sent));
-        tmp_postag_seqs.push_back(std::move(postag_seq));
-        tmp_features_gp_seqs.push_back(std::move(features_gp_seq));
+        tmp_dynamic_sents.push_back(dynamic_sent);
+        tmp_fixed_sents.push_back(fixed_sent);
+        tmp_postag_seqs.push_back(postag_seq);
+        tmp_features_gp_seqs.push_back(features_gp_seq);
         ++line_cnt;
         if( 0 == line_cnt % 10000 ) BOOST_LOG_TRIVIAL(info) << line_cnt << " lines has been preprocessed."  ;
     }
+    tmp_dynamic_sents.shrink_to_fit();
+    tmp_fixed_sents.shrink_to_fit();
+    tmp_postag_seqs.shrink_to_fit();
+    tmp_features_gp_seqs.shrink_to_fit();
     swap(dynamic_sents, tmp_dynamic_sents);
     swap(fixed_sents, tmp_fixed_sents);
     swap(features_gp_seqs, tmp_features_gp_seqs);
@@ -146,24 +189,27 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::read_annotated_data(std
 
 template <typename RNNDerived, typename I2Model>
 void Input2WithFeatureModelHandler<RNNDerived, I2Model>::read_training_data(std::istream &is,
-    std::vector<IndexSeq> &training_dynamic_sents,
-    std::vector<IndexSeq> &training_fixed_sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_gp_seqs,
-    std::vector<IndexSeq> &postag_seqs)
+    FlatIndexSeqs &training_dynamic_sents,
+    FlatIndexSeqs &training_fixed_sents,
+    POSFeature::POSFeatureIndexGroupFlatSeqs &features_gp_seqs,
+    FlatIndexSeqs &postag_seqs)
 {
     assert(!i2m->is_dict_frozen());
     BOOST_LOG_TRIVIAL(info) << "read training data .";
     read_annotated_data(is, training_dynamic_sents, training_fixed_sents, features_gp_seqs, postag_seqs);
-    i2m->freeze_dict();
+    // frequent words take the leading rows of the dynamic lookup table , remap what has been indexed
+    IndexSeq old2new;
+    i2m->freeze_dict_in_frequency_order(old2new);
+    training_dynamic_sents.transform_items([&old2new](Index word_id){ return old2new[word_id]; });
     BOOST_LOG_TRIVIAL(info) << "read training data done.";
 }
 
 template <typename RNNDerived, typename I2Model>
 void Input2WithFeatureModelHandler<RNNDerived, I2Model>::read_devel_data(std::istream &is,
-    std::vector<IndexSeq> &devel_dynamic_sents,
-    std::vector<IndexSeq> &devel_fixed_sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_gp_seqs,
-    std::vector<IndexSeq> &postag_seqs)
+    FlatIndexSeqs &devel_dynamic_sents,
+    FlatIndexSeqs &devel_fixed_sents,
+    POSFeature::POSFeatureIndexGroupFlatSeqs &features_gp_seqs,
+    FlatIndexSeqs &postag_seqs)
 {
     assert(i2m->is_dict_frozen());
     BOOST_LOG_TRIVIAL(info) << "read devel data .";
@@ -176,7 +222,8 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::read_test_data(std::ist
     std::vector<Seq> &raw_sents,
     std::vector<IndexSeq> &dynamic_sents,
     std::vector<IndexSeq> &fixed_sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &feature_gp_seqs)
+    std::vector<POSFeature::POSFeatureIndexGroupSeq> &feature_gp_seqs,
+    StageTimings *timings)
 {
     using std::swap;
     assert(i2m->is_dict_frozen());
@@ -198,7 +245,9 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::read_test_data(std::ist
         IndexSeq dynamic_sent,
             fixed_sent;
         POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
+        uint64_t extract_start = StageTimings::now_ns();
         i2m->input_seq2index_seq(raw_sent, dynamic_sent, fixed_sent, feature_gp_seq);
+        if( timings ){ timings->record(StageTimings::Stage::Extract, StageTimings::now_ns() - extract_start); }
         tmp_raw_sents.push_back(std::move(raw_sent));
         tmp_dynamic_sents.push_back(std::move(dynamic_sent));
         tmp_fixed_sents.push_back(std::move(fixed_sent));
@@ -237,20 +286,23 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::load_fixed_embedding(st
 
 
 template <typename RNNDerived, typename I2Model>
-void Input2WithFeatureModelHandler<RNNDerived, I2Model>::train(const std::vector<IndexSeq> *p_dynamic_sents,
-    const std::vector<IndexSeq> *p_fixed_sents,
-    const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-    const std::vector<IndexSeq> *p_tag_seqs,
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::train(const FlatIndexSeqs *p_dynamic_sents,
+    const FlatIndexSeqs *p_fixed_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+    const FlatIndexSeqs *p_tag_seqs,
     unsigned max_epoch,
-    const std::vector<IndexSeq> *p_dev_dynamic_sents,
-    const std::vector<IndexSeq> *p_dev_fixed_sents,
-    const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_dev_feature_gp_seqs,
-    const std::vector<IndexSeq> *p_dev_tag_seqs,
+    const FlatIndexSeqs *p_dev_dynamic_sents,
+    const FlatIndexSeqs *p_dev_fixed_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_dev_feature_gp_seqs,
+    const FlatIndexSeqs *p_dev_tag_seqs,
     unsigned do_devel_freq,
     unsigned trivial_report_freq)
 {
     unsigned nr_samples = p_dynamic_sents->size();
     BOOST_LOG_TRIVIAL(info) << "train at " << nr_samples << " instances .\n";
+    BOOST_LOG_TRIVIAL(info) << "memory of dicts : " << MemoryStat::format_bytes(i2m->get_dict_memory_bytes());
+    log_corpus_memory("training", p_dynamic_sents, p_fixed_sents, p_feature_gp_seqs, p_tag_seqs);
+    log_corpus_memory("devel", p_dev_dynamic_sents, p_dev_fixed_sents, p_dev_feature_gp_seqs, p_dev_tag_seqs);
 
     std::vector<unsigned> access_order(nr_samples);
     for( unsigned i = 0; i < nr_samples; ++i ) access_order[i] = i;
@@ -269,28 +321,50 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::train(const std::vector
         BasicStat training_stat_per_epoch;
         training_stat_per_epoch.start_time_stat();
 
+        // scratch buffers for the sample (copied out of the flat dataset) and its UNK replacement ,
+        // reused by every sample
+        IndexSeq dynamic_sent, fixed_sent, tag_seq;
+        POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
+        IndexSeq sent_after_replace;
+        POSFeature::POSFeatureIndexGroupSeq feature_gp_seq_after_replace;
         // train for every Epoch 
         for( unsigned i = 0; i < nr_samples; ++i )
         {
             unsigned access_idx = access_order[i];
+            StageTimings &timings = training_stat_per_epoch.stage_timings;
+            ScopedStageTimer sentence_timer(timings, StageTimings::Stage::Sentence);
             // using negative_loglikelihood loss to build model
-            const IndexSeq &dynamic_sent = p_dynamic_sents->at(access_idx),
-                &fixed_sent = p_fixed_sents->at(access_idx),
-                &tag_seq = p_tag_seqs->at(access_idx);
-            const POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq = p_feature_gp_seqs->at(access_idx);
-            { // new scope , for only one Computatoin Graph can be exists in one scope at the same time .
-              // devel will creat another Computation Graph , so we need to create new scoce to release it before devel .
-                cnn::ComputationGraph cg ;
-                IndexSeq sent_after_replace ;
-                POSFeature::POSFeatureIndexGroupSeq feature_gp_seq_after_replace;
+            p_dynamic_sents->at(access_idx).copy_to(dynamic_sent);
+            p_fixed_sents->at(access_idx).copy_to(fixed_sent);
+            p_tag_seqs->at(access_idx).copy_to(tag_seq);
+            p_feature_gp_seqs->at(access_idx).copy_to(feature_gp_seq);
+            { // only one Computation Graph can exist at the same time , so devel also uses the recycled graph .
+                cnn::ComputationGraph &cg = graph_recycler.next_graph();
+                uint64_t stage_start = StageTimings::now_ns(),
+                    stage_end;
                 i2m->replace_word_with_unk(dynamic_sent, feature_gp_seq, sent_after_replace, feature_gp_seq_after_replace);
+                stage_end = StageTimings::now_ns();
+                timings.record(StageTimings::Stage::Extract, stage_end - stage_start);
+                stage_start = stage_end;
                 i2m->build_loss(cg, sent_after_replace, fixed_sent, feature_gp_seq_after_replace, tag_seq);
+                stage_end = StageTimings::now_ns();
+                timings.record(StageTimings::Stage::GraphBuild, stage_end - stage_start);
+                stage_start = stage_end;
                 cnn::real loss = as_scalar(cg.forward());
+                stage_end = StageTimings::now_ns();
+                timings.record(StageTimings::Stage::Forward, stage_end - stage_start);
+                stage_start = stage_end;
                 cg.backward();
+                stage_end = StageTimings::now_ns();
+                timings.record(StageTimings::Stage::Backward, stage_end - stage_start);
+                stage_start = stage_end;
                 sgd.update(1.f);
+                timings.record(StageTimings::Stage::Update, StageTimings::now_ns() - stage_start);
+                graph_memory_profile.record(sent_after_replace.size(), cg, true);
                 training_stat_per_epoch.loss += loss;
                 training_stat_per_epoch.total_tags += dynamic_sent.size() ;
             }
+            sentence_timer.stop();
             if( 0 == (i + 1) % trivial_report_freq ) // Report 
             {
                 std::string trivial_header = std::to_string(i + 1) + " instances have been trained.";
@@ -323,6 +397,8 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::train(const std::vector
             << nr_samples << " instances has been trained . ";
         std::string info_header = tmp_sos.str();
         BOOST_LOG_TRIVIAL(info) << training_stat_per_epoch.get_stat_str(info_header);
+        training_stat_per_epoch.stage_timings.report("stage latency of training epoch " + std::to_string(nr_epoch + 1) + " :");
+        report_graph_memory("graph memory till training epoch " + std::to_string(nr_epoch + 1) + " :");
         total_time_cost_in_seconds += training_stat_per_epoch.get_time_cost_in_seconds();
         // do validation at every ends of epoch
         if( p_dev_dynamic_sents != nullptr && is_train_ok )
@@ -343,30 +419,37 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::train(const std::vector
 
 
 template <typename RNNDerived, typename I2Model>
-float Input2WithFeatureModelHandler<RNNDerived, I2Model>::devel(const std::vector<IndexSeq> *p_dynamic_sents,
-    const std::vector<IndexSeq> *p_fixed_sents,
-    const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-    const std::vector<IndexSeq> *p_tag_seqs)
+float Input2WithFeatureModelHandler<RNNDerived, I2Model>::devel(const FlatIndexSeqs *p_dynamic_sents,
+    const FlatIndexSeqs *p_fixed_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+    const FlatIndexSeqs *p_tag_seqs)
 {
     unsigned nr_samples = p_dynamic_sents->size();
     BOOST_LOG_TRIVIAL(info) << "validation at " << nr_samples << " instances .";
 
     Stat stat(true);
     stat.start_time_stat();
+    IndexSeq dynamic_sent, fixed_sent, predict_tag_seq;
+    POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
     for( unsigned access_idx = 0; access_idx < nr_samples; ++access_idx )
     {
-        cnn::ComputationGraph cg;
-        IndexSeq predict_tag_seq;
-        const IndexSeq &dynamic_sent = p_dynamic_sents->at(access_idx),
-            &fixed_sent = p_fixed_sents->at(access_idx),
-            &gold_tag = p_tag_seqs->at(access_idx);
-        const POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq = p_feature_gp_seqs->at(access_idx);
-        i2m->predict(cg, dynamic_sent, fixed_sent, feature_gp_seq, predict_tag_seq);
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        cnn::ComputationGraph &cg = graph_recycler.next_graph();
+        p_dynamic_sents->at(access_idx).copy_to(dynamic_sent);
+        p_fixed_sents->at(access_idx).copy_to(fixed_sent);
+        p_feature_gp_seqs->at(access_idx).copy_to(feature_gp_seq);
+        SeqView<Index> gold_tag = p_tag_seqs->at(access_idx);
+        {
+            // graph building and forward are interleaved with decoding in the output layer
+            ScopedStageTimer decode_timer(stat.stage_timings, StageTimings::Stage::Decode);
+            i2m->predict(cg, dynamic_sent, fixed_sent, feature_gp_seq, predict_tag_seq);
+        }
+        graph_memory_profile.record(dynamic_sent.size(), cg, false);
 
         stat.total_tags += predict_tag_seq.size();
         for( size_t tag_idx = 0 ; tag_idx < gold_tag.size() ; ++tag_idx )
         {
-            if( gold_tag.at(tag_idx) == predict_tag_seq.at(tag_idx) ) ++stat.correct_tags ;
+            if( gold_tag[tag_idx] == predict_tag_seq.at(tag_idx) ) ++stat.correct_tags ;
         }
     }
     stat.end_time_stat();
@@ -374,6 +457,8 @@ float Input2WithFeatureModelHandler<RNNDerived, I2Model>::devel(const std::vecto
     std::ostringstream tmp_sos;
     tmp_sos << "validation finished ." ;
     BOOST_LOG_TRIVIAL(info) << stat.get_stat_str(tmp_sos.str()) ;
+    stat.stage_timings.report("stage latency of validation :");
+    report_graph_memory("graph memory till validation :");
     return stat.get_acc() ;
 }
 
@@ -386,9 +471,12 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::predict(std::istream &i
     std::vector<IndexSeq> dynamic_sents ,
         fixed_sents;
     std::vector<POSFeature::POSFeatureIndexGroupSeq> feature_gp_seqs;
-    read_test_data(is, raw_instances, dynamic_sents, fixed_sents, feature_gp_seqs);
-    BOOST_LOG_TRIVIAL(info) << "do prediction on " << raw_instances.size() << " instances .";
     BasicStat stat(true);
+    {
+        ScopedStageTimer read_timer(stat.stage_timings, StageTimings::Stage::Read);
+        read_test_data(is, raw_instances, dynamic_sents, fixed_sents, feature_gp_seqs, &stat.stage_timings);
+    }
+    BOOST_LOG_TRIVIAL(info) << "do prediction on " << raw_instances.size() << " instances .";
     stat.start_time_stat();
     for( unsigned int i = 0; i < raw_instances.size(); ++i )
     {
@@ -398,12 +486,16 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::predict(std::istream &i
             os << "\n";
             continue;
         }
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
         IndexSeq &dynamic_sent = dynamic_sents.at(i) ,
             fixed_sent = fixed_sents.at(i);
         POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq = feature_gp_seqs.at(i);
         IndexSeq pred_tag_seq;
-        cnn::ComputationGraph cg;
-        i2m->predict(cg, dynamic_sent, fixed_sent, feature_gp_seq, pred_tag_seq);
+        if( !sentence_cache.lookup(raw_sent, pred_tag_seq) )
+        {
+            decode_sentence(raw_sent, dynamic_sent, fixed_sent, feature_gp_seq, pred_tag_seq, stat.stage_timings);
+        }
+        ScopedStageTimer write_timer(stat.stage_timings, StageTimings::Stage::Write);
         Seq postag_seq;
         i2m->postag_index_seq2postag_str_seq(pred_tag_seq, postag_seq);
         os << raw_sent[0] << "_" << postag_seq[0] ;
@@ -417,6 +509,138 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::predict(std::istream &i
     }
     stat.end_time_stat() ;
     BOOST_LOG_TRIVIAL(info) << stat.get_stat_str("predict done.")  ;
+    stat.stage_timings.report("stage latency of prediction :");
+    report_graph_memory("graph memory of prediction :");
+    report_sentence_cache("sentence cache of prediction :");
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::predict_lines(const std::vector<std::string> &lines,
+    std::vector<std::string> &outputs, BasicStat &stat)
+{
+    assert(i2m->is_dict_frozen());
+    std::vector<std::string> tmp_outputs(lines.size());
+    Seq raw_sent,
+        postag_seq;
+    IndexSeq dynamic_sent,
+        fixed_sent,
+        pred_tag_seq;
+    POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
+    for( size_t line_idx = 0; line_idx < lines.size(); ++line_idx )
+    {
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        {
+            // parsed by the reader , the same as `read_test_data`
+            std::istringstream line_is(lines[line_idx]);
+            POSReader reader(line_is);
+            if( !reader.readline(raw_sent) || (raw_sent.size() == 1 && raw_sent[0].empty()) ){ raw_sent.clear(); }
+        }
+        if( raw_sent.empty() ){ continue; }
+        // a cached sentence skips feature extraction too
+        if( !sentence_cache.lookup(raw_sent, pred_tag_seq) )
+        {
+            {
+                ScopedStageTimer extract_timer(stat.stage_timings, StageTimings::Stage::Extract);
+                i2m->input_seq2index_seq(raw_sent, dynamic_sent, fixed_sent, feature_gp_seq);
+            }
+            decode_sentence(raw_sent, dynamic_sent, fixed_sent, feature_gp_seq, pred_tag_seq, stat.stage_timings);
+        }
+        ScopedStageTimer write_timer(stat.stage_timings, StageTimings::Stage::Write);
+        i2m->postag_index_seq2postag_str_seq(pred_tag_seq, postag_seq);
+        std::string &output = tmp_outputs[line_idx];
+        output = raw_sent[0] + "_" + postag_seq[0];
+        for( size_t i = 1; i < raw_sent.size(); ++i )
+        {
+            output += OutputDelimiter;
+            output += raw_sent[i] + "_" + postag_seq[i];
+        }
+        stat.total_tags += pred_tag_seq.size();
+    }
+    outputs.swap(tmp_outputs);
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::predict_postag_seqs(const std::vector<Seq> &word_seqs,
+    std::vector<IndexSeq> &postag_seqs, BasicStat &stat)
+{
+    assert(i2m->is_dict_frozen());
+    std::vector<IndexSeq> tmp_postag_seqs(word_seqs.size());
+    IndexSeq dynamic_sent,
+        fixed_sent;
+    POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
+    for( size_t i = 0; i < word_seqs.size(); ++i )
+    {
+        if( word_seqs[i].empty() ){ continue; }
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        if( !sentence_cache.lookup(word_seqs[i], tmp_postag_seqs[i]) )
+        {
+            {
+                ScopedStageTimer extract_timer(stat.stage_timings, StageTimings::Stage::Extract);
+                i2m->input_seq2index_seq(word_seqs[i], dynamic_sent, fixed_sent, feature_gp_seq);
+            }
+            decode_sentence(word_seqs[i], dynamic_sent, fixed_sent, feature_gp_seq, tmp_postag_seqs[i], stat.stage_timings);
+        }
+        stat.total_tags += tmp_postag_seqs[i].size();
+    }
+    postag_seqs.swap(tmp_postag_seqs);
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::decode_sentence(const Seq &word_seq,
+    const IndexSeq &dynamic_sent, const IndexSeq &fixed_sent, const POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq,
+    IndexSeq &pred_tag_seq, StageTimings &timings)
+{
+    cnn::ComputationGraph &cg = graph_recycler.next_graph();
+    {
+        // graph building and forward are interleaved with decoding in the output layer
+        ScopedStageTimer decode_timer(timings, StageTimings::Stage::Decode);
+        i2m->predict(cg, dynamic_sent, fixed_sent, feature_gp_seq, pred_tag_seq);
+    }
+    graph_memory_profile.record(dynamic_sent.size(), cg, false);
+    sentence_cache.insert(word_seq, pred_tag_seq);
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::set_sentence_cache(double capacity_mb, uint64_t model_id)
+{
+    sentence_cache.set_capacity_mb(capacity_mb);
+    sentence_cache.set_model_id(model_id);
+    if( sentence_cache.is_enabled() )
+    {
+        BOOST_LOG_TRIVIAL(info) << "sentence cache is enabled , capacity = " << capacity_mb << " MB .";
+    }
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::report_sentence_cache(const std::string &info_header)
+{
+    if( !sentence_cache.is_enabled() ){ return; }
+    BOOST_LOG_TRIVIAL(info) << sentence_cache.get_report_str(info_header);
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::report_graph_memory(const std::string &info_header)
+{
+    if( graph_memory_profile.empty() ){ return; }
+    size_t parameter_bytes = MemoryStat::model_parameter_bytes(*i2m->get_cnn_model());
+    BOOST_LOG_TRIVIAL(info) << graph_memory_profile.get_report_str(info_header)
+        << "\nparameters (values + gradients) : " << MemoryStat::format_bytes(parameter_bytes);
+    CnnMemPlanner::update_profile(mem_profile_path, graph_memory_profile, parameter_bytes);
+}
+
+template <typename RNNDerived, typename I2Model>
+void Input2WithFeatureModelHandler<RNNDerived, I2Model>::log_corpus_memory(const std::string &corpus_name,
+    const FlatIndexSeqs *p_dynamic_sents, const FlatIndexSeqs *p_fixed_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs, const FlatIndexSeqs *p_tag_seqs)
+{
+    size_t word_bytes = p_dynamic_sents->get_memory_bytes() + p_fixed_sents->get_memory_bytes(),
+        feature_bytes = p_feature_gp_seqs->get_memory_bytes(),
+        tag_bytes = p_tag_seqs->get_memory_bytes();
+    BOOST_LOG_TRIVIAL(info) << "memory of " << corpus_name << " corpus : "
+        << MemoryStat::format_bytes(word_bytes + feature_bytes + tag_bytes)
+        << " (words " << MemoryStat::format_bytes(word_bytes)
+        << " , features " << MemoryStat::format_bytes(feature_bytes)
+        << " , tags " << MemoryStat::format_bytes(tag_bytes) << ")";
 }
 
 template <typename RNNDerived, typename I2Model>
@@ -435,6 +659,7 @@ void Input2WithFeatureModelHandler<RNNDerived, I2Model>::load_model(std::istream
     BOOST_LOG_TRIVIAL(info) << "loading model ...";
     boost::archive::text_iarchive ti(is) ;
     ti >> *(static_cast<I2Model*>(i2m));
+    i2m->build_frozen_dicts();
     i2m->print_model_info() ;
 }
 
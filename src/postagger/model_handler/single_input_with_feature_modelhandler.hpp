@@ -6,6 +6,8 @@
 #include "postagger/postagger_module/pos_reader.h"
 #include "utils/stash_model.hpp"
 #include "utils/stat.hpp"
+#include "modelmodule/graph_recycler.h"
+#include "utils/flat_seqs.hpp"
 namespace slnn{
 
 template <typename RNNDerived, typename SIModel>
@@ -23,40 +25,43 @@ public:
     SingleInputWithFeatureModelHandler& operator()(const SingleInputWithFeatureModelHandler&) = delete;
 
 
+    // before reading . 0 : prefix / suffix dicts , > 0 : hash prefix / suffix features into buckets
+    void set_feature_hash_bucket_size(unsigned hash_bucket_size){ sim->set_feature_hash_bucket_size(hash_bucket_size); }
+
     // Reading data 
     void read_annotated_data(std::istream &is,
-        std::vector<IndexSeq> &sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
-        std::vector<IndexSeq> &postags_seqs);
+        FlatIndexSeqs &sents,
+        POSFeature::POSFeatureIndexGroupFlatSeqs &features_seqs,
+        FlatIndexSeqs &postags_seqs);
 
     void read_training_data(std::istream &is,
-        std::vector<IndexSeq> &training_sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
-        std::vector<IndexSeq> &postags_seqs);
+        FlatIndexSeqs &training_sents,
+        POSFeature::POSFeatureIndexGroupFlatSeqs &features_seqs,
+        FlatIndexSeqs &postags_seqs);
 
     void read_devel_data(std::istream &is,
-        std::vector<IndexSeq> &devel_sents,
-        std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs,
-        std::vector<IndexSeq> &postag_seqs);
+        FlatIndexSeqs &devel_sents,
+        POSFeature::POSFeatureIndexGroupFlatSeqs &features_seqs,
+        FlatIndexSeqs &postag_seqs);
 
     void read_test_data(std::istream &is,
         std::vector<Seq> &raw_sents,
         std::vector<IndexSeq> &sents,
         std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_seqs);
 
-    void train(const std::vector<IndexSeq> *p_sents,
-        const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-        const std::vector<IndexSeq> *p_tag_seqs,
+    void train(const FlatIndexSeqs *p_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+        const FlatIndexSeqs *p_tag_seqs,
         unsigned max_epoch,
-        const std::vector<IndexSeq> *p_dev_sents,
-        const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_dev_features_gp_seqs,
-        const std::vector<IndexSeq> *p_dev_tag_seqs,
+        const FlatIndexSeqs *p_dev_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_dev_features_gp_seqs,
+        const FlatIndexSeqs *p_dev_tag_seqs,
         unsigned do_devel_freq,
         unsigned trivial_report_freq);
 
-    float devel(const std::vector<IndexSeq> *p_sents,
-        const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-        const std::vector<IndexSeq> *p_tag_seqs);
+    float devel(const FlatIndexSeqs *p_sents,
+        const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+        const FlatIndexSeqs *p_tag_seqs);
 
     void predict(std::istream &is, std::ostream &os);
 
@@ -69,6 +74,7 @@ public:
 
 private:
     CNNModelStash model_stash;
+    GraphRecycler graph_recycler; // train , devel and predict share ONE recycled graph
 };
 
 template<typename RNNDerived, typename SIModel>
@@ -80,7 +86,9 @@ const std::string SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::Outpu
 template <typename RNNDerived, typename SIModel>
 SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::SingleInputWithFeatureModelHandler()
     :sim(new SIModel())
-{}
+{
+    sim->set_graph_recycler(&graph_recycler);
+}
 
 template <typename RNNDerived, typename SIModel>
 SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::~SingleInputWithFeatureModelHandler()
@@ -90,35 +98,38 @@ SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::~SingleInputWithFeature
 
 template <typename RNNDerived, typename SIModel>
 void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::read_annotated_data(std::istream &is,
-    std::vector<IndexSeq> &sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_gp_seqs,
-    std::vector<IndexSeq> &postag_seqs)
+    FlatIndexSeqs &sents,
+    POSFeature::POSFeatureIndexGroupFlatSeqs &features_gp_seqs,
+    FlatIndexSeqs &postag_seqs)
 {
     using std::swap;
     POSReader reader(is);
-    std::vector<IndexSeq> tmp_sents,
+    FlatIndexSeqs tmp_sents,
         tmp_postag_seqs;
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> tmp_features_gp_seqs;
+    POSFeature::POSFeatureIndexGroupFlatSeqs tmp_features_gp_seqs;
     size_t detected_line_cnt = reader.count_line();
-    tmp_sents.reserve(detected_line_cnt);
-    tmp_postag_seqs.reserve(detected_line_cnt);
-    tmp_features_gp_seqs.reserve(detected_line_cnt);
+    tmp_sents.reserve(detected_line_cnt, 0);
+    tmp_postag_seqs.reserve(detected_line_cnt, 0);
+    tmp_features_gp_seqs.reserve(detected_line_cnt, 0);
     size_t line_cnt = 0 ;
     Seq str_sent,
         str_postag_seq;
+    IndexSeq sent,
+        postag_seq;
+    POSFeature::POSFeatureIndexGroupSeq features_gp_seq;
     while( reader.readline(str_sent, str_postag_seq) )
     {
         if( str_sent.size() == 0 ) continue;
-        IndexSeq sent,
-            postag_seq;
-        POSFeature::POSFeatureIndexGroupSeq features_gp_seq;
         sim->input_seq2index_seq(str_sent, str_postag_seq, sent, postag_seq, features_gp_seq);
-        tmp_sents.push_back(std::move(sent));
-        tmp_postag_seqs.push_back(std::move(postag_seq));
-        tmp_features_gp_seqs.push_back(std::move(features_gp_seq));
+        tmp_sents.push_back(sent);
+        tmp_postag_seqs.push_back(postag_seq);
+        tmp_features_gp_seqs.push_back(features_gp_seq);
         ++line_cnt;
         if( 0 == line_cnt % 10000 ) BOOST_LOG_TRIVIAL(info) << line_cnt << " lines has been preprocessed."  ;
     }
+    tmp_sents.shrink_to_fit();
+    tmp_postag_seqs.shrink_to_fit();
+    tmp_features_gp_seqs.shrink_to_fit();
     swap(sents, tmp_sents);
     swap(features_gp_seqs, tmp_features_gp_seqs);
     swap(postag_seqs, tmp_postag_seqs);
@@ -127,9 +138,9 @@ void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::read_annotated_dat
 
 template <typename RNNDerived, typename SIModel>
 void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::read_training_data(std::istream &is,
-    std::vector<IndexSeq> &training_sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_gp_seqs,
-    std::vector<IndexSeq> &postag_seqs)
+    FlatIndexSeqs &training_sents,
+    POSFeature::POSFeatureIndexGroupFlatSeqs &features_gp_seqs,
+    FlatIndexSeqs &postag_seqs)
 {
     assert(!sim->is_dict_frozen());
     BOOST_LOG_TRIVIAL(info) << "read training data .";
@@ -140,9 +151,9 @@ void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::read_training_data
 
 template <typename RNNDerived, typename SIModel>
 void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::read_devel_data(std::istream &is,
-    std::vector<IndexSeq> &devel_sents,
-    std::vector<POSFeature::POSFeatureIndexGroupSeq> &features_gp_seqs,
-    std::vector<IndexSeq> &postag_seqs)
+    FlatIndexSeqs &devel_sents,
+    POSFeature::POSFeatureIndexGroupFlatSeqs &features_gp_seqs,
+    FlatIndexSeqs &postag_seqs)
 {
     assert(sim->is_dict_frozen());
     BOOST_LOG_TRIVIAL(info) << "read devel data .";
@@ -203,13 +214,13 @@ void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::build_model()
 
 
 template <typename RNNDerived, typename SIModel>
-void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::train(const std::vector<IndexSeq> *p_sents,
-    const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-    const std::vector<IndexSeq> *p_tag_seqs,
+void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::train(const FlatIndexSeqs *p_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+    const FlatIndexSeqs *p_tag_seqs,
     unsigned max_epoch,
-    const std::vector<IndexSeq> *p_dev_sents,
-    const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_dev_feature_gp_seqs,
-    const std::vector<IndexSeq> *p_dev_tag_seqs,
+    const FlatIndexSeqs *p_dev_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_dev_feature_gp_seqs,
+    const FlatIndexSeqs *p_dev_tag_seqs,
     unsigned do_devel_freq,
     unsigned trivial_report_freq)
 {
@@ -233,19 +244,22 @@ void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::train(const std::v
         BasicStat training_stat_per_epoch;
         training_stat_per_epoch.start_time_stat();
 
+        // scratch buffers for the sample (copied out of the flat dataset) and its UNK replacement ,
+        // reused by every sample
+        IndexSeq sent, tag_seq;
+        POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
+        IndexSeq sent_after_replace;
+        POSFeature::POSFeatureIndexGroupSeq feature_gp_seq_after_replace;
         // train for every Epoch 
         for( unsigned i = 0; i < nr_samples; ++i )
         {
             unsigned access_idx = access_order[i];
             // using negative_loglikelihood loss to build model
-            const IndexSeq &sent = p_sents->at(access_idx),
-                &tag_seq = p_tag_seqs->at(access_idx);
-            const POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq = p_feature_gp_seqs->at(access_idx);
-            { // new scope , for only one Computatoin Graph can be exists in one scope at the same time .
-              // devel will creat another Computation Graph , so we need to create new scoce to release it before devel .
-                cnn::ComputationGraph cg ;
-                IndexSeq sent_after_replace ;
-                POSFeature::POSFeatureIndexGroupSeq feature_gp_seq_after_replace;
+            p_sents->at(access_idx).copy_to(sent);
+            p_tag_seqs->at(access_idx).copy_to(tag_seq);
+            p_feature_gp_seqs->at(access_idx).copy_to(feature_gp_seq);
+            { // only one Computation Graph can exist at the same time , so devel also uses the recycled graph .
+                cnn::ComputationGraph &cg = graph_recycler.next_graph();
                 sim->replace_word_with_unk(sent, feature_gp_seq, sent_after_replace, feature_gp_seq_after_replace);
                 sim->build_loss(cg, sent_after_replace, feature_gp_seq_after_replace, tag_seq);
                 cnn::real loss = as_scalar(cg.forward());
@@ -307,28 +321,29 @@ void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::train(const std::v
 
 
 template <typename RNNDerived, typename SIModel>
-float SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::devel(const std::vector<IndexSeq> *p_sents,
-    const std::vector<POSFeature::POSFeatureIndexGroupSeq> *p_feature_gp_seqs,
-    const std::vector<IndexSeq> *p_tag_seqs)
+float SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::devel(const FlatIndexSeqs *p_sents,
+    const POSFeature::POSFeatureIndexGroupFlatSeqs *p_feature_gp_seqs,
+    const FlatIndexSeqs *p_tag_seqs)
 {
     unsigned nr_samples = p_sents->size();
     BOOST_LOG_TRIVIAL(info) << "validation at " << nr_samples << " instances .";
 
     Stat stat(true);
     stat.start_time_stat();
+    IndexSeq sent, predict_tag_seq;
+    POSFeature::POSFeatureIndexGroupSeq feature_gp_seq;
     for( unsigned access_idx = 0; access_idx < nr_samples; ++access_idx )
     {
-        cnn::ComputationGraph cg;
-        IndexSeq predict_tag_seq;
-        const IndexSeq &sent = p_sents->at(access_idx),
-            &gold_tag = p_tag_seqs->at(access_idx);
-        const POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq = p_feature_gp_seqs->at(access_idx);
+        cnn::ComputationGraph &cg = graph_recycler.next_graph();
+        p_sents->at(access_idx).copy_to(sent);
+        p_feature_gp_seqs->at(access_idx).copy_to(feature_gp_seq);
+        SeqView<Index> gold_tag = p_tag_seqs->at(access_idx);
         sim->predict(cg, sent, feature_gp_seq, predict_tag_seq);
 
         stat.total_tags += predict_tag_seq.size();
         for( size_t tag_idx = 0 ; tag_idx < gold_tag.size() ; ++tag_idx )
         {
-            if( gold_tag.at(tag_idx) == predict_tag_seq.at(tag_idx) ) ++stat.correct_tags ;
+            if( gold_tag[tag_idx] == predict_tag_seq.at(tag_idx) ) ++stat.correct_tags ;
         }
     }
     stat.end_time_stat();
@@ -362,7 +377,7 @@ void SingleInputWithFeatureModelHandler<RNNDerived, SIModel>::predict(std::istre
         IndexSeq &sent = sents.at(i) ;
         POSFeature::POSFeatureIndexGroupSeq &feature_gp_seq = feature_gp_seqs.at(i);
         IndexSeq pred_tag_seq;
-        cnn::ComputationGraph cg;
+        cnn::ComputationGraph &cg = graph_recycler.next_graph();
         sim->predict(cg, sent, feature_gp_seq, pred_tag_seq);
         Seq postag_seq;
         sim->postag_index_seq2postag_str_seq(pred_tag_seq, postag_seq);
@@ -45,6 +45,7 @@ int train_process(int argc, char *argv[], const string &program_name)
         ("prefix_suffix_len1_embedding_dim", po::value<unsigned>()->default_value(20), "The dimension for prefix suffix len1 feature .")
         ("prefix_suffix_len2_embedding_dim", po::value<unsigned>()->default_value(40), "The dimension for prefix suffix len2 feature .")
         ("prefix_suffix_len3_embedding_dim", po::value<unsigned>()->default_value(40), "The dimension for prefix suffix len3 feature .")
+        ("feature_hash_bucket_size", po::value<unsigned>()->default_value(0), "Hash prefix and suffix features into this number of buckets instead of building dicts , 0 for dicts .")
         ("char_length_embedding_dim", po::value<unsigned>()->default_value(5), "The dimension for character length feature .")
         ("nr_rnn_stacked_layer", po::value<unsigned>()->default_value(1), "The number of stacked layers in bi-rnn.")
         ("rnn_h_dim", po::value<unsigned>()->default_value(100), "The dimension for rnn H.")
@@ -119,9 +120,10 @@ int train_process(int argc, char *argv[], const string &program_name)
     if (!train_is) {
         fatal_error("Error : failed to open training: `" + training_data_path + "` .");
     }
-    vector<IndexSeq> sents ,
+    FlatIndexSeqs sents ,
         tag_seqs;
-    vector<POSFeature::POSFeatureIndexGroupSeq> feature_gp_seqs;
+    POSFeature::POSFeatureIndexGroupFlatSeqs feature_gp_seqs;
+    model_handler.set_feature_hash_bucket_size(var_map["feature_hash_bucket_size"].as<unsigned>());
     model_handler.read_training_data(train_is, sents ,feature_gp_seqs, tag_seqs);
     train_is.close();
     // set model structure param 
@@ -131,8 +133,8 @@ int train_process(int argc, char *argv[], const string &program_name)
     model_handler.build_model(); // passing the var_map to specify the model structure
     
     // reading developing data
-    vector<IndexSeq> dev_sents, dev_tag_seqs ;
-    vector<POSFeature::POSFeatureIndexGroupSeq> dev_feature_gp_seqs ;
+    FlatIndexSeqs dev_sents, dev_tag_seqs ;
+    POSFeature::POSFeatureIndexGroupFlatSeqs dev_feature_gp_seqs ;
     std::ifstream devel_is(devel_data_path);
     if (!devel_is) {
         fatal_error("Error : failed to open devel file: `" + devel_data_path + "`");
@@ -201,9 +203,9 @@ int devel_process(int argc, char *argv[], const string &program_name)
     // read devel data
     ifstream devel_is(devel_data_path) ;
     if( !devel_is ) fatal_error("Error : failed to open devel data at `" + devel_data_path + "`") ;
-    vector<IndexSeq> sents,
+    FlatIndexSeqs sents,
         tag_seqs ;
-    vector<POSFeature::POSFeatureIndexGroupSeq> feature_gp_seqs;
+    POSFeature::POSFeatureIndexGroupFlatSeqs feature_gp_seqs;
     model_handler.read_devel_data(devel_is, sents, feature_gp_seqs, tag_seqs);
     devel_is.close();
 
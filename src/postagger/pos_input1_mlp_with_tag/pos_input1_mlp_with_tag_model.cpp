@@ -39,7 +39,7 @@ void POSInput1MLPWithTagModel::build_model_structure()
     word_expr_layer = new Index2ExprLayer(m, word_dict_size, word_embedding_dim);
     tag_expr_layer = new ShiftedIndex2ExprLayer(m, output_dim, tag_embedding_dim, ShiftedIndex2ExprLayer::RightShift, 1);
     pos_feature_layer = new POSFeatureLayer(m, pos_feature);
-    pos_context_feature_layer = new ContextFeatureLayer(m, word_expr_layer->get_lookup_param());
+    pos_context_feature_layer = new ContextFeatureLayer(m, word_expr_layer->get_lookup_param(), context_feature);
     mlp_hidden_layer = new MLPHiddenLayer(m, input_dim, mlp_hidden_dim_list, dropout_rate, nonlinear_func);
     output_layer = new SoftmaxLayer(m, mlp_hidden_dim_list.back(), output_dim);
 }
@@ -108,13 +108,15 @@ POSInput1MLPWithTagModel::predict(cnn::ComputationGraph &cg,
     output_layer->new_graph(cg);
     unsigned sent_len = input_seq.size();
 
+    std::vector<cnn::expr::Expression> context_feature_exprs;
+    pos_context_feature_layer->build_feature_exprs(context_feature_gp_seq, context_feature_exprs);
     std::vector<Index> tmp_pred_seq(sent_len);
     cnn::expr::Expression pre_tag_expr = tag_expr_layer->get_padding_expr(0);
     for( size_t i = 0; i < sent_len ; ++i )
     {
         cnn::expr::Expression word_expr = word_expr_layer->index2expr(input_seq[i]),
             pos_feature_expr = pos_feature_layer->build_feature_expr(features_gp_seq[i]),
-            context_feature_expr = pos_context_feature_layer->build_feature_expr(context_feature_gp_seq[i]);
+            context_feature_expr = context_feature_exprs[i];
         cnn::expr::Expression input_expr = StaticConcatenateLayer::concatenate_exprs(std::vector<cnn::expr::Expression>({
             word_expr, pre_tag_expr, pos_feature_expr, context_feature_expr
         }));
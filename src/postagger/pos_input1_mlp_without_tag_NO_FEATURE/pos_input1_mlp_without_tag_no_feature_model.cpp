@@ -24,7 +24,7 @@ void Input1MLPWithoutTagNoFeatureModel::build_model_structure()
     input_layer = new BareInput1(m, word_dict_size, word_embedding_dim, 1);
     mlp_hidden_layer = new MLPHiddenLayer(m, input_dim, mlp_hidden_dim_list, dropout_rate);
     output_layer = new SoftmaxLayer(m, mlp_hidden_dim_list.at(mlp_hidden_dim_list.size() - 1), output_dim);
-    pos_context_feature_layer = new ContextFeatureLayer(m, input_layer->word_lookup_param);
+    pos_context_feature_layer = new ContextFeatureLayer(m, input_layer->word_lookup_param, context_feature);
 }
 
 void Input1MLPWithoutTagNoFeatureModel::print_model_info()
@@ -52,12 +52,12 @@ Input1MLPWithoutTagNoFeatureModel::build_loss(cnn::ComputationGraph &cg,
     unsigned sent_len = input_seq.size();
 
     std::vector<cnn::expr::Expression> input_exprs(sent_len);
+    std::vector<cnn::expr::Expression> context_feature_exprs;
+    pos_context_feature_layer->build_feature_exprs(context_feature_gp_seq, context_feature_exprs);
     std::vector<cnn::expr::Expression> tmp_feature_cont(1) ;
     for( unsigned i = 0 ; i < sent_len; ++i )
     {
-        tmp_feature_cont.at(0) = pos_context_feature_layer->build_feature_expr(
-            context_feature_gp_seq.at(i)
-            ) ;
+        tmp_feature_cont.at(0) = context_feature_exprs.at(i);
         input_exprs.at(i) = input_layer->build_input(input_seq.at(i), tmp_feature_cont);
     }
     std::vector<cnn::expr::Expression> output_exprs;
@@ -78,12 +78,12 @@ Input1MLPWithoutTagNoFeatureModel::predict(cnn::ComputationGraph &cg,
     unsigned sent_len = input_seq.size();
 
     std::vector<cnn::expr::Expression> input_exprs(sent_len);
-    std::vector<cnn::expr::Expression> tmp_feature_cont(2) ;
+    std::vector<cnn::expr::Expression> context_feature_exprs;
+    pos_context_feature_layer->build_feature_exprs(context_feature_gp_seq, context_feature_exprs);
+    std::vector<cnn::expr::Expression> tmp_feature_cont(1) ;
     for( unsigned i = 0 ; i < sent_len; ++i )
     {
-        tmp_feature_cont.at(0) = pos_context_feature_layer->build_feature_expr(
-            context_feature_gp_seq.at(i)
-            ) ;
+        tmp_feature_cont.at(0) = context_feature_exprs.at(i);
         input_exprs.at(i) = input_layer->build_input(input_seq.at(i), tmp_feature_cont);
     }
     std::vector<cnn::expr::Expression> output_exprs;
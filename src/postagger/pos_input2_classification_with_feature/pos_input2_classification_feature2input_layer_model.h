@@ -42,15 +42,17 @@ template <typename RNNDerived>
 void POSInput2ClassificationF2IModel<RNNDerived>::build_model_structure()
 {
     this->m = new cnn::Model() ;
+    this->param_ledger.start(this->m);
     this->pos_feature_layer = new POSFeatureLayer(this->m, this->pos_feature);
-    this->input_layer = new Input2WithFeature(this->m, this->dynamic_word_dict_size, this->fixed_word_embedding_dim,
-        this->fixed_word_dict_size, this->fixed_word_embedding_dim,
-        this->pos_feature.concatenated_feature_embedding_dim,
-        this->rnn_x_dim);
+    this->param_ledger.mark("feature layer");
+    this->input_layer = this->new_input_layer(this->fixed_word_embedding_dim, this->rnn_x_dim);
+    this->param_ledger.mark("input layer");
     this->birnn_layer = new BIRNNLayer<RNNDerived>(this->m, this->nr_rnn_stacked_layer, 
                                                    this->rnn_x_dim, this->rnn_h_dim, this->dropout_rate) ;
+    this->param_ledger.mark("birnn layer");
     this->output_layer = new SimpleOutput(this->m, this->rnn_h_dim, this->rnn_h_dim, this->hidden_dim, this->output_dim,
         this->dropout_rate) ;
+    this->param_ledger.mark("output layer");
 }
 
 template <typename RNNDerived>
@@ -64,7 +66,8 @@ void POSInput2ClassificationF2IModel<RNNDerived>::print_model_info()
         << "tag hidden layer dim : " << this->hidden_dim << "\n"
         << "output dim : " << this->output_dim << "\n"
         << "feature info : \n"
-        << this->pos_feature.get_feature_info() ;
+        << this->pos_feature.get_feature_info()
+        << "\n" << this->param_ledger.get_report_str();
 }
 } // end of namespace slnn 
 #endif 
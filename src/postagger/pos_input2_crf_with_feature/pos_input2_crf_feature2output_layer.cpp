@@ -11,6 +11,7 @@
 #include "pos_input2_crf_feature2output_layer_model.h"
 #include "postagger/model_handler/input2_with_feature_modelhandler.hpp"
 #include "utils/general.hpp"
+#include "utils/tagging_server_process.hpp"
 
 using namespace std;
 using namespace cnn;
@@ -28,6 +29,12 @@ int train_process(int argc, char *argv[], const string &program_name)
     po::options_description op_des = po::options_description(description);
     op_des.add_options()
         ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the input plus this headroom ratio (e.g. 0.3) ,"
+            " using the memory profile measured by previous runs .")
+        ("mem_profile", po::value<string>(), "The memory profile , updated with the measured graph and parameter memory and read by `cnn_mem_auto` ."
+            " `<model>.memprofile` if not specified ."
+            " it is only written if this or `cnn_mem_auto` is specified .")
         ("training_data", po::value<string>(), "[required] The path to training data")
         ("devel_data", po::value<string>(), "The path to developing data . For validation duration training . Empty for discarding .")
         ("word2vec_embedding" , po::value<string>(), "The path to word2vec embedding")
@@ -47,6 +54,13 @@ int train_process(int argc, char *argv[], const string &program_name)
         ("prefix_suffix_len1_embedding_dim", po::value<unsigned>()->default_value(20), "The dimension for prefix suffix len1 feature .")
         ("prefix_suffix_len2_embedding_dim", po::value<unsigned>()->default_value(40), "The dimension for prefix suffix len2 feature .")
         ("prefix_suffix_len3_embedding_dim", po::value<unsigned>()->default_value(40), "The dimension for prefix suffix len3 feature .")
+        ("feature_hash_bucket_size", po::value<unsigned>()->default_value(0), "Hash prefix and suffix features into this number of buckets instead of building dicts , 0 for dicts .")
+        ("fixed_embedding_storage", po::value<string>()->default_value("float"), "Storage of the word2vec embedding : [float, fp16, bf16, pq] ."
+            " fp16 / bf16 halve its memory and model file size , pq (product quantization) stores one byte for every sub-space ."
+            " float fine-tunes it when training as before , all the others FREEZE it (not fine-tuned) ,"
+            " so the trained model differs from float .")
+        ("pq_nr_subspaces", po::value<unsigned>()->default_value(0), "The number of sub-spaces for pq storage , 0 for one every 4 dimensions .")
+        ("pq_kmeans_iter", po::value<unsigned>()->default_value(10), "The k-means iterations to learn pq codebooks .")
         ("char_length_embedding_dim", po::value<unsigned>()->default_value(5), "The dimension for character length feature .")
         ("nr_rnn_stacked_layer", po::value<unsigned>()->default_value(1), "The number of stacked layers in bi-rnn.")
         ("rnn_x_dim", po::value<unsigned>()->default_value(50), "The dimension for rnn X.")
@@ -113,10 +127,18 @@ int train_process(int argc, char *argv[], const string &program_name)
     shared_ptr<char *> cnn_argv;
     unsigned cnn_mem = 0 ;
     if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    string mem_profile_path = var_map.count("mem_profile") != 0 ? var_map["mem_profile"].as<string>() : model_path + ".memprofile";
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        cnn_mem = CnnMemPlanner::plan_cnn_mem_mb(mem_profile_path, { training_data_path, devel_data_path }, CnnMemPlanner::LengthUnit::Token, true,
+            var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
     build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
     char **cnn_argv_ptr = cnn_argv.get();
     cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed); 
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
     Input2WithFeatureModelHandler<RNNDerived, POSInput2CRFF2OModel<RNNDerived>> model_handler;
+    if( var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0 ){ model_handler.set_mem_profile_path(mem_profile_path); }
 
     ifstream embedding_is(word2vec_embedding_path);
     if (!embedding_is)
@@ -137,10 +159,11 @@ int train_process(int argc, char *argv[], const string &program_name)
     if (!train_is) {
         fatal_error("Error : failed to open training: `" + training_data_path + "` .");
     }
-    vector<IndexSeq> dynamic_sents ,
+    FlatIndexSeqs dynamic_sents ,
         fixed_sents,
         tag_seqs;
-    vector<POSFeature::POSFeatureIndexGroupSeq> feature_gp_seqs;
+    POSFeature::POSFeatureIndexGroupFlatSeqs feature_gp_seqs;
+    model_handler.set_feature_hash_bucket_size(var_map["feature_hash_bucket_size"].as<unsigned>());
     model_handler.read_training_data(train_is, dynamic_sents, fixed_sents, feature_gp_seqs, tag_seqs);
     train_is.close();
     // set model structure param 
@@ -152,8 +175,8 @@ int train_process(int argc, char *argv[], const string &program_name)
     model_handler.load_fixed_embedding(embedding_is);
     embedding_is.close();
     // reading developing data
-    vector<IndexSeq> dev_dynamic_sents, dev_fixed_sents, dev_tag_seqs ;
-    vector<POSFeature::POSFeatureIndexGroupSeq> dev_feature_gp_seqs ;
+    FlatIndexSeqs dev_dynamic_sents, dev_fixed_sents, dev_tag_seqs ;
+    POSFeature::POSFeatureIndexGroupFlatSeqs dev_feature_gp_seqs ;
     std::ifstream devel_is(devel_data_path);
     if (!devel_is) {
         fatal_error("Error : failed to open devel file: `" + devel_data_path + "`");
@@ -185,6 +208,12 @@ int devel_process(int argc, char *argv[], const string &program_name)
     string devel_data_path, model_path ;
     op_des.add_options()
         ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the input plus this headroom ratio (e.g. 0.3) ,"
+            " using the memory profile measured by previous runs .")
+        ("mem_profile", po::value<string>(), "The memory profile , updated with the measured graph and parameter memory and read by `cnn_mem_auto` ."
+            " `<model>.memprofile` if not specified ."
+            " it is only written if this or `cnn_mem_auto` is specified .")
         ("devel_data", po::value<string>(&devel_data_path), "The path to validation data .")
         ("model", po::value<string>(&model_path), "Use to specify the model name(path)")
         ("help,h", "Show help information.");
@@ -206,10 +235,18 @@ int devel_process(int argc, char *argv[], const string &program_name)
     shared_ptr<char *> cnn_argv;
     unsigned cnn_mem = 0 ;
     if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    string mem_profile_path = var_map.count("mem_profile") != 0 ? var_map["mem_profile"].as<string>() : model_path + ".memprofile";
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        cnn_mem = CnnMemPlanner::plan_cnn_mem_mb(mem_profile_path, { devel_data_path }, CnnMemPlanner::LengthUnit::Token, false,
+            var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
     build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
     char **cnn_argv_ptr = cnn_argv.get();
     cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed); 
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
     Input2WithFeatureModelHandler<RNNDerived, POSInput2CRFF2OModel<RNNDerived>> model_handler;
+    if( var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0 ){ model_handler.set_mem_profile_path(mem_profile_path); }
     // Load model 
     ifstream model_is(model_path);
     if (!model_is)
@@ -222,10 +259,10 @@ int devel_process(int argc, char *argv[], const string &program_name)
     // read devel data
     ifstream devel_is(devel_data_path) ;
     if( !devel_is ) fatal_error("Error : failed to open devel data at `" + devel_data_path + "`") ;
-    vector<IndexSeq> dynamic_sents,
+    FlatIndexSeqs dynamic_sents,
         fixed_sents,
         tag_seqs ;
-    vector<POSFeature::POSFeatureIndexGroupSeq> feature_gp_seqs;
+    POSFeature::POSFeatureIndexGroupFlatSeqs feature_gp_seqs;
     model_handler.read_devel_data(devel_is, dynamic_sents, fixed_sents, feature_gp_seqs, tag_seqs);
     devel_is.close();
 
@@ -245,9 +282,17 @@ int predict_process(int argc, char *argv[], const string &program_name)
     string raw_data_path, output_path, model_path;
     op_des.add_options()
         ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the input plus this headroom ratio (e.g. 0.3) ,"
+            " using the memory profile measured by previous runs .")
+        ("mem_profile", po::value<string>(), "The memory profile , updated with the measured graph and parameter memory and read by `cnn_mem_auto` ."
+            " `<model>.memprofile` if not specified ."
+            " it is only written if this or `cnn_mem_auto` is specified .")
         ("raw_data", po::value<string>(&raw_data_path), "The path to raw data(It should be segmented) .")
         ("output", po::value<string>(&output_path), "The path to storing result . using `stdout` if not specified .")
         ("model", po::value<string>(&model_path), "Use to specify the model name(path)")
+        ("sentence_cache_mb", po::value<float>()->default_value(0.f), "Cache the tags of repeated sentences in at most N MB ,"
+            " the least recently used are dropped . 0 disables it .")
         ("help,h", "Show help information.");
     po::variables_map var_map;
     po::store(po::command_line_parser(argc, argv).options(op_des).allow_unregistered().run(), var_map);
@@ -274,10 +319,18 @@ int predict_process(int argc, char *argv[], const string &program_name)
     shared_ptr<char *> cnn_argv;
     unsigned cnn_mem = 0 ;
     if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    string mem_profile_path = var_map.count("mem_profile") != 0 ? var_map["mem_profile"].as<string>() : model_path + ".memprofile";
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        cnn_mem = CnnMemPlanner::plan_cnn_mem_mb(mem_profile_path, { raw_data_path }, CnnMemPlanner::LengthUnit::Token, false,
+            var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
     build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
     char **cnn_argv_ptr = cnn_argv.get();
     cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed); 
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
     Input2WithFeatureModelHandler<RNNDerived, POSInput2CRFF2OModel<RNNDerived>> model_handler ;
+    if( var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0 ){ model_handler.set_mem_profile_path(mem_profile_path); }
 
     // load model 
     ifstream is(model_path);
@@ -287,6 +340,7 @@ int predict_process(int argc, char *argv[], const string &program_name)
     }
     model_handler.load_model(is);
     is.close();
+    model_handler.set_sentence_cache(var_map["sentence_cache_mb"].as<float>(), SentenceCache::model_id_from_name(model_path));
 
     // open raw_data
     ifstream raw_is(raw_data_path);
@@ -316,13 +370,20 @@ int predict_process(int argc, char *argv[], const string &program_name)
 }
 
 
+template <typename RNNDerived>
+int serve_process(int argc, char *argv[], const string &program_name)
+{
+    using ModelHandler = Input2WithFeatureModelHandler<RNNDerived, POSInput2CRFF2OModel<RNNDerived>>;
+    return run_tagging_server<ModelHandler>(argc, argv, ProgramHeader, program_name);
+}
+
 int main(int argc, char *argv[])
 {
     ostringstream oss;
     string program_name = argv[0];
     oss << ProgramHeader << "\n"
         << "usage : " << program_name << " [task] [rnn-type] <options>" << "\n"
-        << "task : [ train, devel, predict ] , anyone of the list is optional\n"
+        << "task : [ train, devel, predict, serve ] , anyone of the list is optional\n"
         << "rnn-type : [ rnn, lstm, gru] , \n"
         << "           rnn  : simple rnn implementation for RNN\n"
         << "           lstm : lstm implementation for RNN\n"
@@ -342,7 +403,7 @@ int main(int argc, char *argv[])
     string task = string(argv[1]);
     string rnn_type = string(argv[2]);
     int ret_status ;
-    const string TrainTask = "train", DevelTask = "devel", PredictTask = "predict";
+    const string TrainTask = "train", DevelTask = "devel", PredictTask = "predict", ServeTask = "serve";
     const string SimpleRNNType = "rnn", LSTMType = "lstm", GRUType = "gru";
     function<void()> action_when_unknown_rnn_type = [&ret_status,&rnn_type]
     {
@@ -370,6 +431,13 @@ int main(int argc, char *argv[])
         else if( GRUType == rnn_type ){ ret_status = predict_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
         else { action_when_unknown_rnn_type() ; }
     }
+    else if( ServeTask == task )
+    {
+        if( SimpleRNNType == rnn_type ){ ret_status = serve_process<SimpleRNNBuilder>(argc - 2, argv + 2, program_name); }
+        else if( LSTMType == rnn_type ){ ret_status = serve_process<LSTMBuilder>(argc - 2, argv + 2, program_name); }
+        else if( GRUType == rnn_type ){ ret_status = serve_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
+        else { action_when_unknown_rnn_type(); }
+    }
     else
     {
         cerr << "unknown task : " << task << "\n"
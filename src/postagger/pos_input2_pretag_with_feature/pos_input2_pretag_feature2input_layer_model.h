@@ -21,6 +21,7 @@ public:
     void set_model_param(const boost::program_options::variables_map &var_map) ;
     void build_model_structure() ;
     void print_model_info() ;
+    void set_beam_size(unsigned beam_size) ;
 
     template<typename Archive>
     void serialize(Archive &ar, const unsigned version);
@@ -48,15 +49,17 @@ template <typename RNNDerived>
 void POSInput2PretagF2IModel<RNNDerived>::build_model_structure()
 {
     this->m = new cnn::Model() ;
+    this->param_ledger.start(this->m);
     this->pos_feature_layer = new POSFeatureLayer(this->m, this->pos_feature);
-    this->input_layer = new Input2WithFeature(this->m, this->dynamic_word_dict_size, this->fixed_word_embedding_dim,
-        this->fixed_word_dict_size, this->fixed_word_embedding_dim,
-        this->pos_feature.concatenated_feature_embedding_dim,
-        this->rnn_x_dim);
+    this->param_ledger.mark("feature layer");
+    this->input_layer = this->new_input_layer(this->fixed_word_embedding_dim, this->rnn_x_dim);
+    this->param_ledger.mark("input layer");
     this->birnn_layer = new BIRNNLayer<RNNDerived>(this->m, this->nr_rnn_stacked_layer, 
                                                    this->rnn_x_dim, this->rnn_h_dim, this->dropout_rate) ;
+    this->param_ledger.mark("birnn layer");
     this->output_layer = new PretagOutput(this->m, tag_embedding_dim,this->rnn_h_dim, this->rnn_h_dim, this->hidden_dim, this->output_dim,
         this->dropout_rate) ;
+    this->param_ledger.mark("output layer");
 }
 
 template <typename RNNDerived>
@@ -71,7 +74,14 @@ void POSInput2PretagF2IModel<RNNDerived>::print_model_info()
         << "tag hidden layer dim : " << this->hidden_dim << "\n"
         << "output dim : " << this->output_dim << "\n"
         << "feature info : \n"
-        << this->pos_feature.get_feature_info() ;
+        << this->pos_feature.get_feature_info()
+        << "\n" << this->param_ledger.get_report_str();
+}
+
+template <typename RNNDerived>
+void POSInput2PretagF2IModel<RNNDerived>::set_beam_size(unsigned beam_size)
+{
+    static_cast<PretagOutput*>(this->output_layer)->set_beam_size(beam_size);
 }
 
 template <typename RNNDerived>
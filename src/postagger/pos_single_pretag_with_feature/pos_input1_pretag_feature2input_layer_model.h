@@ -21,6 +21,7 @@ public:
     void set_model_param(const boost::program_options::variables_map &var_map) ;
     void build_model_structure() ;
     void print_model_info() ;
+    void set_beam_size(unsigned beam_size) ;
 
     template<typename Archive>
     void serialize(Archive &ar, const unsigned version);
@@ -73,6 +74,12 @@ void POSInput1PretagF2IModel<RNNDerived>::print_model_info()
         << this->pos_feature.get_feature_info() ;
 }
 
+template <typename RNNDerived>
+void POSInput1PretagF2IModel<RNNDerived>::set_beam_size(unsigned beam_size)
+{
+    static_cast<PretagOutput*>(this->output_layer)->set_beam_size(beam_size);
+}
+
 template <typename RNNDerived>
 template <typename Archive>
 void POSInput1PretagF2IModel<RNNDerived>::serialize(Archive &ar, unsigned version)
@@ -1,4 +1,5 @@
 #include "pos_feature.h"
+#include "utils/memory_stat.hpp"
 
 namespace slnn{
 
@@ -11,7 +12,8 @@ const Index POSFeature::FeatureEmptyIndexPlaceholder = -1;
 const std::string POSFeature::FeatureUnkStr = "feature_unk_str";
 
 POSFeature::POSFeature()
-    : prefix_suffix_len1_dict_wrapper(prefix_suffix_len1_dict),
+    : hash_bucket_size(0),
+    prefix_suffix_len1_dict_wrapper(prefix_suffix_len1_dict),
     prefix_suffix_len2_dict_wrapper(prefix_suffix_len2_dict),
     prefix_suffix_len3_dict_wrapper(prefix_suffix_len3_dict)
 {}
@@ -21,12 +23,24 @@ std::string POSFeature::get_feature_info()
 {
     std::ostringstream oss;
 
-    oss << "prefix and suffix dict size : [ " << prefix_suffix_len1_dict.size() << ", " << prefix_suffix_len2_dict.size() << ", "
-        << prefix_suffix_len3_dict.size() << " ]\n"
-        << "prefix and suffix embedding dim : [ " << prefix_suffix_len1_embedding_dim << ", " << prefix_suffix_len2_embedding_dim << ", "
+    if( is_hashing_feature() ){ oss << "prefix and suffix hashed into " << hash_bucket_size << " buckets\n"; }
+    else
+    {
+        oss << "prefix and suffix dict size : [ " << prefix_suffix_len1_dict.size() << ", " << prefix_suffix_len2_dict.size() << ", "
+            << prefix_suffix_len3_dict.size() << " ]\n";
+    }
+    oss << "prefix and suffix embedding dim : [ " << prefix_suffix_len1_embedding_dim << ", " << prefix_suffix_len2_embedding_dim << ", "
         << prefix_suffix_len3_embedding_dim << " ]\n"
         << "character length feature dict size : " << get_char_length_dict_size() << " , dimension : " << char_length_embedding_dim << "\n"
         << "total pos feature dimension : " << get_pos_feature_dim() ;
     return oss.str();
 }
+
+size_t POSFeature::get_dict_memory_bytes() const
+{
+    return MemoryStat::dict_bytes(prefix_suffix_len1_dict) + MemoryStat::dict_bytes(prefix_suffix_len2_dict)
+        + MemoryStat::dict_bytes(prefix_suffix_len3_dict)
+        + frozen_prefix_suffix_len1_dict.get_memory_bytes() + frozen_prefix_suffix_len2_dict.get_memory_bytes()
+        + frozen_prefix_suffix_len3_dict.get_memory_bytes();
+}
 }
@@ -2,10 +2,18 @@
 #define POS_POS_MODULE_POS_FEATURE_HPP_
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include <boost/serialization/serialization.hpp>
+#include <boost/serialization/version.hpp>
 #include "cnn/cnn.h"
 #include "utils/dict_wrapper.hpp"
+#include "utils/frozen_dict.hpp"
 #include "utils/typedeclaration.h"
+#include "utils/flat_seqs.hpp"
+#include "utils/corpus_cache.hpp"
+#include "utils/utf8processing.hpp"
 
 namespace slnn{
 
@@ -25,6 +33,9 @@ struct POSFeature
     unsigned prefix_suffix_len3_embedding_dim;
     unsigned char_length_embedding_dim;
     unsigned concatenated_feature_embedding_dim;
+    // > 0 : hashing trick , every prefix / suffix feature is hashed into `hash_bucket_size` buckets ,
+    // the three dicts are not used (nor serialized) . 0 : prefix / suffix dicts .
+    unsigned hash_bucket_size;
 
     cnn::Dict prefix_suffix_len1_dict;
     cnn::Dict prefix_suffix_len2_dict;
@@ -34,8 +45,14 @@ struct POSFeature
     DictWrapper prefix_suffix_len2_dict_wrapper;
     DictWrapper prefix_suffix_len3_dict_wrapper;
 
+    // read-only copies for inference , lookups use them once built
+    FrozenDict frozen_prefix_suffix_len1_dict;
+    FrozenDict frozen_prefix_suffix_len2_dict;
+    FrozenDict frozen_prefix_suffix_len3_dict;
+
     using POSFeatureIndexGroup = FeaturesIndex<NrFeature>;
     using POSFeatureIndexGroupSeq = FeaturesIndexSeq<NrFeature>;
+    using POSFeatureIndexGroupFlatSeqs = FlatSeqs<POSFeatureIndexGroup>; // dataset storage
     using POSFeatureGroup = FeatureGroup<NrFeature>;
     using POSFeatureGroupSeq = FeatureGroupSeq<NrFeature>;
     POSFeature();
@@ -45,10 +62,19 @@ struct POSFeature
                             unsigned prefix_suffix_len3_embedding_dim,
                             unsigned char_length_embedding_dim);
     unsigned get_pos_feature_dim(){ return concatenated_feature_embedding_dim ; }
+    // should be set before reading training data
+    void set_hash_bucket_size(unsigned hash_bucket_size){ this->hash_bucket_size = hash_bucket_size; }
+    bool is_hashing_feature() const { return hash_bucket_size > 0; }
     // Dict interface
+    size_t get_prefix_suffix_len1_dict_size(){ return is_hashing_feature() ? hash_bucket_size : prefix_suffix_len1_dict.size(); }
+    size_t get_prefix_suffix_len2_dict_size(){ return is_hashing_feature() ? hash_bucket_size : prefix_suffix_len2_dict.size(); }
+    size_t get_prefix_suffix_len3_dict_size(){ return is_hashing_feature() ? hash_bucket_size : prefix_suffix_len3_dict.size(); }
     size_t get_char_length_dict_size(){ return FeatureCharLengthLimit; }
     bool is_dict_frozen();
     void freeze_dict();
+    void build_frozen_dicts();
+    // estimated memory of the prefix / suffix dicts and their frozen copies
+    size_t get_dict_memory_bytes() const;
 
     // replace word with unk interface
     void set_replace_feature_with_unk_threshold(int freq_thres, float prob_thres);
@@ -60,13 +86,17 @@ struct POSFeature
                                            POSFeatureIndexGroup &feature_index_gp);
     void feature_group_seq2feature_index_group_seq(const POSFeatureGroupSeq &feature_gp_seq,
                                                    POSFeatureIndexGroupSeq &feature_index_gp_seq);
+    // hashing mode : hash prefix / suffix byte spans of every word directly , no feature string is built
+    void extract_hashed_feature_index_group_seq(const Seq &words, POSFeatureIndexGroupSeq &feature_index_gp_seq) const;
 
     std::string get_feature_info();
     template <typename Archive>
     void serialize(Archive &ar, const unsigned version);
 private:
-    Index prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(DictWrapper &dw, const std::string &feature_str);
+    Index prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(DictWrapper &dw, const FrozenDict &frozen_dict,
+        const std::string &feature_str);
     Index char_length_feature_str2feature_idx_and_adding2dict_in_training(const std::string &feature_str);
+    Index hash_feature(char type, size_t len, const char *data, size_t nr_bytes) const;
 };
 
 inline
@@ -100,6 +130,15 @@ void POSFeature::freeze_dict()
     prefix_suffix_len3_dict_wrapper.Freeze(); prefix_suffix_len3_dict_wrapper.SetUnk(FeatureUnkStr);
 }
 
+inline
+void POSFeature::build_frozen_dicts()
+{
+    if( is_hashing_feature() ){ return; }
+    frozen_prefix_suffix_len1_dict.build(prefix_suffix_len1_dict, prefix_suffix_len1_dict.Convert(FeatureUnkStr));
+    frozen_prefix_suffix_len2_dict.build(prefix_suffix_len2_dict, prefix_suffix_len2_dict.Convert(FeatureUnkStr));
+    frozen_prefix_suffix_len3_dict.build(prefix_suffix_len3_dict, prefix_suffix_len3_dict.Convert(FeatureUnkStr));
+}
+
 inline
 void POSFeature::set_replace_feature_with_unk_threshold(int freq_thres, float prob_thres)
 {
@@ -112,18 +151,25 @@ inline
 void POSFeature::do_repalce_feature_with_unk_in_copy(const POSFeatureIndexGroupSeq &gp_seq,
                                       POSFeatureIndexGroupSeq &rep_gp_seq)
 {
-    using std::swap;
     static auto word_replace_with_unk = [](DictWrapper &dw, Index idx)->Index
     {
         if( idx != FeatureEmptyIndexPlaceholder ) { return dw.ConvertProbability(idx); }
         else { return idx ; }
     } ;
+    // feature groups are fixed-size arrays in one contiguous buffer , so replace into the (reused) output
+    // buffer in place . every field is read before written , the same object is OK for in and out .
     size_t seq_len = gp_seq.size();
-    POSFeatureIndexGroupSeq tmp_rep_gp_seq(seq_len);
+    rep_gp_seq.resize(seq_len);
+    if( is_hashing_feature() )
+    {
+        // no frequency for hashed features , nothing replaced
+        if( &rep_gp_seq != &gp_seq ){ std::copy(gp_seq.begin(), gp_seq.end(), rep_gp_seq.begin()); }
+        return;
+    }
     for( size_t i = 0; i < seq_len; ++i )
     {
         const POSFeatureIndexGroup &ori_gp = gp_seq[i];
-        POSFeatureIndexGroup &rep_gp = tmp_rep_gp_seq[i];
+        POSFeatureIndexGroup &rep_gp = rep_gp_seq[i];
         rep_gp[0] = word_replace_with_unk(prefix_suffix_len1_dict_wrapper, ori_gp[0]);
         rep_gp[1] = word_replace_with_unk(prefix_suffix_len2_dict_wrapper, ori_gp[1]);
         rep_gp[2] = word_replace_with_unk(prefix_suffix_len3_dict_wrapper, ori_gp[2]);
@@ -132,13 +178,14 @@ void POSFeature::do_repalce_feature_with_unk_in_copy(const POSFeatureIndexGroupS
         rep_gp[5] = word_replace_with_unk(prefix_suffix_len3_dict_wrapper, ori_gp[5]);
         rep_gp[6] = ori_gp[6];
     }
-    swap(rep_gp_seq, tmp_rep_gp_seq);
 }
 
 inline
-Index POSFeature::prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(DictWrapper &dw, const std::string &feature_str)
+Index POSFeature::prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(DictWrapper &dw, const FrozenDict &frozen_dict,
+    const std::string &feature_str)
 {
     if( feature_str == FeatureEmptyStrPlaceholder ){ return FeatureEmptyIndexPlaceholder; }
+    else if( !frozen_dict.empty() ){ return frozen_dict.convert(feature_str); }
     else { return dw.Convert(feature_str); }
 }
 
@@ -161,12 +208,18 @@ void POSFeature::feature_group2feature_index_group(const POSFeatureGroup &featur
     // -- [suffix_len1] , [suffix_len2] , [suffix_len3]
     // -- [char_length_feature]
 
-    feature_index_gp[0] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len1_dict_wrapper, feature_gp[0]);
-    feature_index_gp[1] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len2_dict_wrapper, feature_gp[1]);
-    feature_index_gp[2] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len3_dict_wrapper, feature_gp[2]);
-    feature_index_gp[3] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len1_dict_wrapper, feature_gp[3]);
-    feature_index_gp[4] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len2_dict_wrapper, feature_gp[4]);
-    feature_index_gp[5] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len3_dict_wrapper, feature_gp[5]);
+    feature_index_gp[0] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len1_dict_wrapper,
+        frozen_prefix_suffix_len1_dict, feature_gp[0]);
+    feature_index_gp[1] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len2_dict_wrapper,
+        frozen_prefix_suffix_len2_dict, feature_gp[1]);
+    feature_index_gp[2] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len3_dict_wrapper,
+        frozen_prefix_suffix_len3_dict, feature_gp[2]);
+    feature_index_gp[3] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len1_dict_wrapper,
+        frozen_prefix_suffix_len1_dict, feature_gp[3]);
+    feature_index_gp[4] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len2_dict_wrapper,
+        frozen_prefix_suffix_len2_dict, feature_gp[4]);
+    feature_index_gp[5] = prefix_suffix_feature_str2feature_idx_and_adding2dict_in_training(prefix_suffix_len3_dict_wrapper,
+        frozen_prefix_suffix_len3_dict, feature_gp[5]);
     feature_index_gp[6] = char_length_feature_str2feature_idx_and_adding2dict_in_training(feature_gp[6]);
 }
 
@@ -184,19 +237,81 @@ void POSFeature::feature_group_seq2feature_index_group_seq(const POSFeatureGroup
     swap(tmp_feature_index_gp_seq, feature_index_gp_seq);
 }
 
+inline
+Index POSFeature::hash_feature(char type, size_t len, const char *data, size_t nr_bytes) const
+{
+    // FNV-1a over (type , char length , bytes) , prefix and suffix of the same length share the table
+    const char head[2] = { type, static_cast<char>(static_cast<unsigned char>(len)) };
+    uint64_t h = CorpusCacheUtils::hash_bytes(data, nr_bytes, CorpusCacheUtils::hash_bytes(head, 2));
+    return static_cast<Index>(h % hash_bucket_size);
+}
+
+inline
+void POSFeature::extract_hashed_feature_index_group_seq(const Seq &words, POSFeatureIndexGroupSeq &feature_index_gp_seq) const
+{
+    assert(is_hashing_feature());
+    size_t seq_len = words.size();
+    feature_index_gp_seq.resize(seq_len);
+    // byte end of the first `PrefixSuffixMaxLen` chars , and byte begin of the last `PrefixSuffixMaxLen` chars
+    size_t prefix_ends[PrefixSuffixMaxLen],
+        suffix_begins[PrefixSuffixMaxLen];
+    for( size_t i = 0; i < seq_len; ++i )
+    {
+        const std::string &word = words[i];
+        POSFeatureIndexGroup &feature_index_gp = feature_index_gp_seq[i];
+        size_t nr_chars = 0,
+            pos = 0;
+        while( pos < word.size() )
+        {
+            size_t char_len = UTF8Processing::get_utf8_char_length_checked(word.cbegin() + pos, word.cend());
+            if( char_len == 0 ){ char_len = 1; } // skip illegal byte , as `utf8_str2char_seq`
+            else
+            {
+                if( nr_chars < PrefixSuffixMaxLen ){ prefix_ends[nr_chars] = pos + char_len; }
+                suffix_begins[nr_chars % PrefixSuffixMaxLen] = pos;
+                ++nr_chars;
+            }
+            pos += char_len;
+        }
+        if( nr_chars == 0 ) throw std::runtime_error("feature char length less equal to 0");
+        size_t min_len = std::min(PrefixSuffixMaxLen, nr_chars);
+        for( size_t len = 1; len <= min_len; ++len )
+        {
+            size_t suffix_begin = suffix_begins[(nr_chars - len) % PrefixSuffixMaxLen];
+            feature_index_gp[len - 1] = hash_feature('P', len, word.data(), prefix_ends[len - 1]);
+            feature_index_gp[len - 1 + PrefixSuffixMaxLen] = hash_feature('S', len, word.data() + suffix_begin,
+                word.size() - suffix_begin);
+        }
+        for( size_t len = min_len + 1; len <= PrefixSuffixMaxLen; ++len )
+        {
+            feature_index_gp[len - 1] = FeatureEmptyIndexPlaceholder;
+            feature_index_gp[len - 1 + PrefixSuffixMaxLen] = FeatureEmptyIndexPlaceholder;
+        }
+        feature_index_gp[NrFeature - 1] = static_cast<Index>(std::min(nr_chars, FeatureCharLengthLimit)) - 1;
+    }
+}
 
 template <typename Archive>
-void POSFeature::serialize(Archive &ar, const unsigned versoin)
+void POSFeature::serialize(Archive &ar, const unsigned version)
 {
     ar & prefix_suffix_len1_embedding_dim
         & prefix_suffix_len2_embedding_dim
         & prefix_suffix_len3_embedding_dim
         & char_length_embedding_dim
-        & concatenated_feature_embedding_dim
-        & prefix_suffix_len1_dict
-        & prefix_suffix_len2_dict
-        & prefix_suffix_len3_dict ;
+        & concatenated_feature_embedding_dim ;
+    // version 0 has no hashing mode
+    if( version > 0 ){ ar & hash_bucket_size; }
+    else { hash_bucket_size = 0; }
+    if( !is_hashing_feature() )
+    {
+        ar & prefix_suffix_len1_dict
+            & prefix_suffix_len2_dict
+            & prefix_suffix_len3_dict ;
+    }
 }
 
 }
+
+BOOST_CLASS_VERSION(slnn::POSFeature, 1)
+
 #endif
@@ -12,6 +12,7 @@
 #include "cnn/dict.h"
 #include "input1_with_feature_model_0628.hpp"
 #include "segmentor/cws_module/cws_feature_layer.h"
+#include "modelmodule/graph_recycler.h"
 namespace slnn{
 
 template<typename RNNDerived>
@@ -126,27 +127,32 @@ cnn::expr::Expression CWSBareInput1F2IModel<RNNDerived>::build_loss(cnn::Computa
                                                                            const CWSFeatureDataSeq &cws_feature_seq,
                                                                            const IndexSeq &gold_seq) 
 {
-    word_expr_layer->new_graph(cg);
-    cws_feature_layer->new_graph(cg);
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        word_expr_layer->new_graph(cg);
+        cws_feature_layer->new_graph(cg);
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->set_dropout() ;
     birnn_layer->start_new_sequence() ;
 
-    std::vector<cnn::expr::Expression> word_exprs;
+    std::vector<cnn::expr::Expression> &word_exprs = this->expr_buffers.word_exprs;
     word_expr_layer->index_seq2expr_seq(input_seq, word_exprs);
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     cws_feature_layer->build_cws_feature(cws_feature_seq, feature_exprs);
 
-    std::vector<cnn::expr::Expression> input_exprs ;
-    StaticConcatenateLayer::concatenate_exprs(std::vector<std::vector<cnn::expr::Expression> *>(
-    { &word_exprs, &feature_exprs }), input_exprs);
+    std::vector<cnn::expr::Expression> &input_exprs = this->expr_buffers.input_exprs;
+    this->expr_buffers.expr_groups.assign({ &word_exprs, &feature_exprs });
+    StaticConcatenateLayer::concatenate_exprs(this->expr_buffers.expr_groups, input_exprs, this->expr_buffers.concat_parts);
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(input_exprs, l2r_exprs, r2l_exprs) ;
-    return output_layer->build_output_loss(std::vector<std::vector<cnn::expr::Expression> *>({ &l2r_exprs, &r2l_exprs}),
+    this->expr_buffers.expr_groups.assign({ &l2r_exprs, &r2l_exprs });
+    return output_layer->build_output_loss(this->expr_buffers.expr_groups,
         gold_seq) ;
 }
 
@@ -156,27 +162,32 @@ void CWSBareInput1F2IModel<RNNDerived>::predict(cnn::ComputationGraph &cg,
                                                       const CWSFeatureDataSeq &cws_feature_seq,
                                                       IndexSeq &pred_seq)
 {
-    word_expr_layer->new_graph(cg);
-    cws_feature_layer->new_graph(cg);
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        word_expr_layer->new_graph(cg);
+        cws_feature_layer->new_graph(cg);
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->disable_dropout() ;
     birnn_layer->start_new_sequence();
 
-    std::vector<cnn::expr::Expression> word_exprs;
+    std::vector<cnn::expr::Expression> &word_exprs = this->expr_buffers.word_exprs;
     word_expr_layer->index_seq2expr_seq(input_seq, word_exprs);
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     cws_feature_layer->build_cws_feature(cws_feature_seq, feature_exprs);
 
-    std::vector<cnn::expr::Expression> input_exprs ;
-    StaticConcatenateLayer::concatenate_exprs(std::vector<std::vector<cnn::expr::Expression> *>(
-    { &word_exprs, &feature_exprs }), input_exprs);
+    std::vector<cnn::expr::Expression> &input_exprs = this->expr_buffers.input_exprs;
+    this->expr_buffers.expr_groups.assign({ &word_exprs, &feature_exprs });
+    StaticConcatenateLayer::concatenate_exprs(this->expr_buffers.expr_groups, input_exprs, this->expr_buffers.concat_parts);
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(input_exprs, l2r_exprs, r2l_exprs) ;
-    output_layer->build_output(std::vector<std::vector<cnn::expr::Expression> *>({ &l2r_exprs, &r2l_exprs}),
+    this->expr_buffers.expr_groups.assign({ &l2r_exprs, &r2l_exprs });
+    output_layer->build_output(this->expr_buffers.expr_groups,
         pred_seq) ;
 }
 
@@ -188,7 +199,7 @@ void CWSBareInput1F2IModel<RNNDerived>::save(Archive &ar, const unsigned version
         & softmax_layer_input_dim & output_dim
         & dropout_rate ;
     ar & this->word_dict & this->cws_feature ;
-    ar & *this->m ;
+    this->save_parameters(ar) ;
 }
 
 template <typename RNNDerived>template< typename Archive>
@@ -200,8 +211,7 @@ void CWSBareInput1F2IModel<RNNDerived>::load(Archive &ar, const unsigned version
         & dropout_rate ;
     ar & this->word_dict & this->cws_feature;
     assert(this->get_word_dict_size() == word_dict_size && this->get_tag_dict_size() == output_dim) ;
-    build_model_structure() ;
-    ar & *this->m ;
+    this->load_parameters(ar, version) ;
 }
 
 template <typename RNNDerived>
@@ -12,6 +12,7 @@
 #include "cnn/dict.h"
 #include "input1_with_feature_model_0628.hpp"
 #include "segmentor/cws_module/cws_feature_layer.h"
+#include "modelmodule/graph_recycler.h"
 
 namespace slnn{
 
@@ -124,22 +125,26 @@ cnn::expr::Expression CWSInput1F2OModel<RNNDerived>::build_loss(cnn::Computation
     const CWSFeatureDataSeq &feature_seq,
     const IndexSeq &gold_seq)
 {
-    cws_feature_layer->new_graph(cg);
-    input_layer->new_graph(cg) ;
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        cws_feature_layer->new_graph(cg);
+        input_layer->new_graph(cg) ;
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->set_dropout() ;
     birnn_layer->start_new_sequence() ;
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     input_layer->build_inputs(input_seq, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
 
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     cws_feature_layer->build_cws_feature(feature_seq, feature_exprs);
 
     return output_layer->build_output_loss(l2r_exprs, r2l_exprs, feature_exprs, gold_seq) ;
@@ -151,22 +156,26 @@ void CWSInput1F2OModel<RNNDerived>::predict(cnn::ComputationGraph &cg,
     const CWSFeatureDataSeq &feature_seq,
     IndexSeq &pred_seq)
 {
-    cws_feature_layer->new_graph(cg);
-    input_layer->new_graph(cg) ;
-    birnn_layer->new_graph(cg) ;
-    output_layer->new_graph(cg) ;
+    if( GraphRecycler::need_new_graph(this->graph_recycler, cg) )
+    {
+        cws_feature_layer->new_graph(cg);
+        input_layer->new_graph(cg) ;
+        birnn_layer->new_graph(cg) ;
+        output_layer->new_graph(cg) ;
+        GraphRecycler::mark_persistent(this->graph_recycler, cg);
+    }
 
     birnn_layer->set_dropout() ;
     birnn_layer->start_new_sequence() ;
 
-    std::vector<cnn::expr::Expression> inputs_exprs ;
+    std::vector<cnn::expr::Expression> &inputs_exprs = this->expr_buffers.input_exprs;
     input_layer->build_inputs(input_seq, inputs_exprs) ;
 
-    std::vector<cnn::expr::Expression> l2r_exprs,
-        r2l_exprs ;
+    std::vector<cnn::expr::Expression> &l2r_exprs = this->expr_buffers.l2r_exprs,
+        &r2l_exprs = this->expr_buffers.r2l_exprs;
     birnn_layer->build_graph(inputs_exprs, l2r_exprs, r2l_exprs) ;
 
-    std::vector<cnn::expr::Expression> feature_exprs;
+    std::vector<cnn::expr::Expression> &feature_exprs = this->expr_buffers.feature_exprs;
     cws_feature_layer->build_cws_feature(feature_seq, feature_exprs);
 
     output_layer->build_output(l2r_exprs, r2l_exprs, feature_exprs, pred_seq) ;
@@ -180,7 +189,7 @@ void CWSInput1F2OModel<RNNDerived>::save(Archive &ar, const unsigned version) co
         & hidden_dim & output_dim
         & dropout_rate ;
     ar & this->word_dict & this->cws_feature ;
-    ar & *this->m ;
+    this->save_parameters(ar) ;
 }
 
 template <typename RNNDerived>template< typename Archive>
@@ -192,8 +201,7 @@ void CWSInput1F2OModel<RNNDerived>::load(Archive &ar, const unsigned version)
         & dropout_rate ;
     ar & this->word_dict & this->cws_feature;
     assert(this->get_word_dict_size() == word_dict_size && this->get_tag_dict_size() == output_dim) ;
-    build_model_structure() ;
-    ar & *this->m ;
+    this->load_parameters(ar, version) ;
 }
 
 template <typename RNNDerived>
@@ -4,17 +4,23 @@
 #include <iostream>
 
 #include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
 #include <boost/program_options.hpp>
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/assume_abstract.hpp>
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/vector.hpp>
 
 #include "cnn/cnn.h"
 #include "cnn/dict.h"
 #include "utils/typedeclaration.h"
 #include "utils/dict_wrapper.hpp"
+#include "utils/frozen_dict.hpp"
+#include "utils/memory_stat.hpp"
 #include "modelmodule/hyper_layers.h"
+#include "modelmodule/graph_recycler.h"
+#include "modelmodule/int8_affine.h"
 #include "segmentor/cws_module/cws_tagging_system.h"
 #include "segmentor/cws_module/cws_feature.h"
 namespace slnn{
@@ -36,6 +42,10 @@ public:
     void set_replace_threshold(int freq_threshold, float prob_threshold);
     bool is_dict_frozen();
     void freeze_dict();
+    // re-index chars by frequency when freezing , `old2new` remaps the data indexed before
+    void freeze_dict_in_frequency_order(IndexSeq &old2new);
+    // read-only copy of the frozen word dict for inference , built after the model is loaded
+    void build_frozen_dict(){ frozen_word_dict.build(word_dict, word_dict.Convert(UNK_STR)); }
     virtual void set_model_param_from_outer(const boost::program_options::variables_map &var_map) = 0;
     virtual void set_model_param_from_inner() = 0;
 
@@ -60,13 +70,39 @@ public:
         IndexSeq &pred_seq) = 0 ;
 
     size_t get_word_dict_size(){ return word_dict.size(); }
+    // estimated memory of the word dict and its frozen copy
+    size_t get_dict_memory_bytes() const
+    {
+        return MemoryStat::dict_bytes(word_dict) + frozen_word_dict.get_memory_bytes();
+    }
     size_t get_tag_dict_size(){ return CWSTaggingSystem::get_tag_num(); }
     DictWrapper& get_word_dict_wrapper(){ return word_dict_wrapper ; } 
     cnn::Model *get_cnn_model(){ return m ; } ;
+    // the weights of the affine layers are int8 , decided by the loaded model file
+    bool is_int8() const { return affine_weights.is_int8(); }
+    size_t get_int8_memory_bytes() const { return affine_weights.get_int8_memory_bytes(); }
+    // write the model as int8 when saving a float model
+    void set_save_as_int8(bool save_as_int8){ this->save_as_int8 = save_as_int8; }
 
     // CWSFeature interface promote to this class
     void count_word_frequency(const Seq &word_seq){ cws_feature.count_word_frequency(word_seq); };
     void build_lexicon(){ cws_feature.build_lexicon(); };
+    // for parallel reading : merge word counts from workers , and extract feature with merged char ids (thread-safe)
+    void add_word_count(const std::string &word, unsigned cnt){ cws_feature.add_word_count(word, cnt); }
+    void extract_feature(const Seq &char_seq, const IndexSeq &index_char_seq, CWSFeatureDataSeq &feature_data_seq)
+    {
+        cws_feature.extract(char_seq, index_char_seq, feature_data_seq);
+    }
+
+    // corpus cache : word dict (with frequency records) and lexicon built from training data
+    void set_feature_extract_param(unsigned context_left_size, unsigned context_right_size)
+    {
+        cws_feature.set_extract_parameters(context_left_size, context_right_size);
+    }
+    std::string get_extract_signature() const { return cws_feature.get_extract_signature(); }
+    uint64_t get_corpus_state_fingerprint() const;
+    void save_corpus_state(std::ostream &os);
+    void load_corpus_state(std::istream &is);
 
     // DEBUG
     void debug_one_sent(const IndexSeq &index_char_seq, const CWSFeatureDataSeq &feature_seq)
@@ -76,12 +112,27 @@ public:
             [this](Index word_idx){ return this->word_dict.Convert(word_idx); });
         cws_feature.debug_one_sent(char_seq, feature_seq);
     }
+    // graphs passed to `build_loss` / `predict` from this recycler keep their parameter nodes , nullptr for plain graphs
+    void set_graph_recycler(GraphRecycler *graph_recycler){ this->graph_recycler = graph_recycler; }
 
 protected:
+    // int8 flag and parameters , after the hyper parameters and dicts
+    template <typename Archive>
+    void save_parameters(Archive &ar) const;
+    // read the int8 flag (model version >= 1) , `build_model_structure` in that mode , then read the parameters
+    template <typename Archive>
+    void load_parameters(Archive &ar, const unsigned version);
+
     cnn::Model *m;
+    AffineWeights affine_weights; // passed to the affine layers in `build_model_structure`
+    bool save_as_int8;
+    SentenceExprBuffers expr_buffers; // reused by `build_loss` and `predict` across sentences
+    GraphRecycler *graph_recycler; // not owned
+    ParameterMemoryLedger param_ledger; // parameter bytes of every layer , marked in `build_model_structure`
 
     cnn::Dict word_dict;
     DictWrapper word_dict_wrapper;
+    FrozenDict frozen_word_dict;
 
     CWSFeature cws_feature;
 };
@@ -95,6 +146,8 @@ const unsigned CWSInput1WithFeatureModel<RNNDerived>::SentMaxLen = 256;
 template <typename RNNDerived>
 CWSInput1WithFeatureModel<RNNDerived>::CWSInput1WithFeatureModel()
     :m(nullptr),
+    save_as_int8(false),
+    graph_recycler(nullptr),
     word_dict_wrapper(word_dict),
     cws_feature(word_dict_wrapper)
 {}
@@ -124,6 +177,65 @@ void CWSInput1WithFeatureModel<RNNDerived>::freeze_dict()
     word_dict_wrapper.SetUnk(UNK_STR);
 }
 
+template <typename RNNDerived>
+void CWSInput1WithFeatureModel<RNNDerived>::freeze_dict_in_frequency_order(IndexSeq &old2new)
+{
+    word_dict_wrapper.freeze_in_frequency_order(UNK_STR, old2new);
+}
+
+template <typename RNNDerived>
+uint64_t CWSInput1WithFeatureModel<RNNDerived>::get_corpus_state_fingerprint() const
+{
+    // words in id order + lexicon . frequency records are only used in training , not hashed
+    uint64_t h = CorpusCacheUtils::FNVOffset;
+    unsigned dict_size = word_dict.size();
+    for( unsigned i = 0; i < dict_size; ++i )
+    {
+        h = CorpusCacheUtils::hash_string(word_dict.Convert(static_cast<int>(i)), h);
+        h = CorpusCacheUtils::hash_bytes("\n", 1, h);
+    }
+    return cws_feature.get_corpus_state_fingerprint(h);
+}
+
+template <typename RNNDerived>
+void CWSInput1WithFeatureModel<RNNDerived>::save_corpus_state(std::ostream &os)
+{
+    boost::archive::text_oarchive to(os);
+    to << word_dict << word_dict_wrapper.freq_records;
+    cws_feature.serialize_corpus_state(to);
+}
+
+template <typename RNNDerived>
+void CWSInput1WithFeatureModel<RNNDerived>::load_corpus_state(std::istream &is)
+{
+    boost::archive::text_iarchive ti(is);
+    ti >> word_dict >> word_dict_wrapper.freq_records;
+    cws_feature.serialize_corpus_state(ti);
+    if( !word_dict.is_frozen() ){ throw std::runtime_error("word dict in corpus cache is not frozen ."); }
+    // dict is frozen with UNK in cache , only restore the wrapper's UNK id
+    word_dict_wrapper.UNK = word_dict.Convert(UNK_STR);
+}
+
+template <typename RNNDerived>
+template <typename Archive>
+void CWSInput1WithFeatureModel<RNNDerived>::save_parameters(Archive &ar) const
+{
+    bool is_int8_model = affine_weights.is_int8() || save_as_int8;
+    ar & is_int8_model;
+    affine_weights.save_parameters(ar, *m, is_int8_model);
+}
+
+template <typename RNNDerived>
+template <typename Archive>
+void CWSInput1WithFeatureModel<RNNDerived>::load_parameters(Archive &ar, const unsigned version)
+{
+    bool is_int8_model = false;
+    if( version >= 1 ){ ar & is_int8_model; }
+    affine_weights.set_int8(is_int8_model);
+    build_model_structure();
+    affine_weights.load_parameters(ar, *m);
+}
+
 template <typename RNNDerived>
 void CWSInput1WithFeatureModel<RNNDerived>::word_seq2index_seq(const Seq &word_seq, IndexSeq &word_index_seq, IndexSeq &tag_index_seq,
     CWSFeatureDataSeq &feature_data_seq)
@@ -163,7 +275,7 @@ void CWSInput1WithFeatureModel<RNNDerived>::char_seq2index_seq(const Seq &char_s
     IndexSeq tmp_word_index_seq(sz);
     for(size_t i = 0; i < sz; ++i )
     {
-        tmp_word_index_seq[i] = word_dict.Convert(char_seq[i]);
+        tmp_word_index_seq[i] = frozen_word_dict.empty() ? word_dict.Convert(char_seq[i]) : frozen_word_dict.convert(char_seq[i]);
     }
     cws_feature.extract(char_seq, tmp_word_index_seq, feature_data_seq);
     swap(word_index_seq, tmp_word_index_seq);
@@ -175,14 +287,13 @@ void CWSInput1WithFeatureModel<RNNDerived>::replace_word_with_unk(const IndexSeq
     IndexSeq &rep_word_seq,
     CWSFeatureDataSeq &rep_feature_data_seq)
 {
-    using std::swap;
+    // write in place , so a reused output buffer doesn't allocate
     size_t sz = ori_word_seq.size();
-    IndexSeq tmp_rep_word_seq(sz);
+    rep_word_seq.resize(sz);
     for( size_t i = 0; i < sz; ++i )
     {
-        tmp_rep_word_seq[i] = word_dict_wrapper.ConvertProbability(ori_word_seq[i]);
+        rep_word_seq[i] = word_dict_wrapper.ConvertProbability(ori_word_seq[i]);
     }
-    swap(rep_word_seq, tmp_rep_word_seq);
     cws_feature.random_replace_with_unk(origin_feature_data_seq, rep_feature_data_seq);
 }
 
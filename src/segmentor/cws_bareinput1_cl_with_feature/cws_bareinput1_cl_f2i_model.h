@@ -7,6 +7,7 @@
 #include <boost/serialization/base_object.hpp>
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "cnn/cnn.h"
 
@@ -38,11 +39,16 @@ template <typename RNNDerived>
 void CWSBareInput1CLF2IModel<RNNDerived>::build_model_structure()
 {
     this->m = new cnn::Model() ;
+    this->param_ledger.start(this->m);
     this->word_expr_layer = new Index2ExprLayer(this->m, this->word_dict_size, this->word_embedding_dim);
+    this->param_ledger.mark("word expr layer");
     this->cws_feature_layer = new CWSFeatureLayer(this->m, this->cws_feature, this->word_expr_layer->get_lookup_param());
+    this->param_ledger.mark("feature layer");
     this->birnn_layer = new BIRNNLayer<RNNDerived>(this->m, this->nr_rnn_stacked_layer, this->rnn_x_dim, this->rnn_h_dim, 
         this->dropout_rate) ;
-    this->output_layer = new CWSSimpleBareOutput(this->m, this->softmax_layer_input_dim, this->output_dim) ;
+    this->param_ledger.mark("birnn layer");
+    this->output_layer = new CWSSimpleBareOutput(this->m, this->softmax_layer_input_dim, this->output_dim, &this->affine_weights) ;
+    this->param_ledger.mark("output layer");
 }
 
 template <typename RNNDerived>
@@ -55,7 +61,21 @@ void CWSBareInput1CLF2IModel<RNNDerived>::print_model_info()
         << "softmax layer input dim : " << this->softmax_layer_input_dim << "\n"
         << "output dim : " << this->output_dim << "\n"
         << "feature info : \n"
-        << this->cws_feature.get_feature_info() ;
+        << this->cws_feature.get_feature_info()
+        << "\n" << this->param_ledger.get_report_str();
 }
 } // end of namespace slnn 
+
+// version 1 : int8 model flag before the parameters
+namespace boost{
+namespace serialization{
+template <typename RNNDerived>
+struct version<slnn::CWSBareInput1CLF2IModel<RNNDerived>>
+{
+    typedef mpl::int_<1> type;
+    typedef mpl::integral_c_tag tag;
+    BOOST_STATIC_CONSTANT(int, value = version::type::value);
+};
+} // end of namespace serialization
+} // end of namespace boost
 #endif 
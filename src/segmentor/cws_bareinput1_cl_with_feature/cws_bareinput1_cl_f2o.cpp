@@ -4,7 +4,9 @@
 
 #include "cws_bareinput1_cl_f2o_model.h"
 #include "segmentor/model_handler/input1_with_feature_modelhandler_0628.hpp"
+#include "segmentor/model_handler/input1_with_feature_process.hpp"
 #include "utils/general.hpp"
+#include "utils/tagging_server_process.hpp"
 
 using namespace std;
 using namespace cnn;
@@ -22,8 +24,20 @@ int train_process(int argc, char *argv[], const string &program_name)
     po::options_description op_des = po::options_description(description);
     op_des.add_options()
         ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the input plus this headroom ratio (e.g. 0.3) ,"
+            " using the memory profile measured by previous runs .")
+        ("mem_profile", po::value<string>(), "The memory profile , updated with the measured graph and parameter memory and read by `cnn_mem_auto` ."
+            " `<model>.memprofile` if not specified ."
+            " it is only written if this or `cnn_mem_auto` is specified .")
         ("training_data", po::value<string>(), "[required] The path to training data")
+        ("reading_threads", po::value<unsigned>()->default_value(1), "The number of threads to parse training data . if > 1 , the file is"
+            " split and parsed in parallel , and char dict is ordered by frequency .")
         ("devel_data", po::value<string>(), "The path to developing data . For validation duration training . Empty for discarding .")
+        ("corpus_cache", po::value<string>(), "The path to corpus cache built by `index` . If it matches the training and devel data ,"
+            " data is loaded from it instead of parsing the text .")
+        ("shuffle_buffer_size", po::value<unsigned>()->default_value(10000), "The shuffle buffer size (instances) when training"
+            " from the shards of corpus cache .")
         ("max_epoch", po::value<unsigned>(), "The epoch to iterate for training")
         ("model", po::value<string>(), "Use to specify the model name(path)")
         ("dropout_rate", po::value<float>(), "droupout rate for training (Only for bi-lstm)")
@@ -101,10 +115,18 @@ int train_process(int argc, char *argv[], const string &program_name)
     shared_ptr<char *> cnn_argv;
     unsigned cnn_mem = 0 ;
     if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    string mem_profile_path = var_map.count("mem_profile") != 0 ? var_map["mem_profile"].as<string>() : model_path + ".memprofile";
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        cnn_mem = CnnMemPlanner::plan_cnn_mem_mb(mem_profile_path, { training_data_path, devel_data_path }, CnnMemPlanner::LengthUnit::Char, true,
+            var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
     build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
     char **cnn_argv_ptr = cnn_argv.get();
     cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed); 
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
     CWSInput1WithFeatureModelHandler<RNNDerived, CWSBareInput1CLF2OModel<RNNDerived>> model_handler;
+    if( var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0 ){ model_handler.set_mem_profile_path(mem_profile_path); }
 
     // pre-open model file, avoid fail after a long time training
     ofstream model_os(model_path);
@@ -112,37 +134,74 @@ int train_process(int argc, char *argv[], const string &program_name)
     
     model_handler.set_model_param_before_reading_training_data(var_map);
     // reading traing data , get word dict size and output tag number
-    ifstream train_is(training_data_path);
-    if (!train_is) {
-        fatal_error("Error : failed to open training: `" + training_data_path + "` .");
-    }
-    vector<IndexSeq> sents ,
+    FlatIndexSeqs sents ,
         tag_seqs;
-    vector<CWSFeatureDataSeq> feature_seqs;
-    model_handler.read_training_data(train_is, sents ,feature_seqs, tag_seqs);
-    train_is.close();
+    CWSFeatureDataFlatSeqs feature_seqs;
+    FlatIndexSeqs dev_sents, dev_tag_seqs ;
+    CWSFeatureDataFlatSeqs dev_feature_seqs ;
+    bool is_cache_loaded = false;
+    string corpus_cache_path;
+    unsigned nr_train_shards = 0;
+    if( var_map.count("corpus_cache") != 0 )
+    {
+        corpus_cache_path = var_map["corpus_cache"].as<string>();
+        ifstream cache_is(corpus_cache_path, ios::binary);
+        if( !cache_is ){ BOOST_LOG_TRIVIAL(warning) << "failed to open corpus cache `" << corpus_cache_path << "` , parse the text data ."; }
+        else
+        {
+            is_cache_loaded = model_handler.load_corpus_cache(cache_is, training_data_path, devel_data_path,
+                sents, feature_seqs, tag_seqs, dev_sents, dev_feature_seqs, dev_tag_seqs, nr_train_shards);
+        }
+    }
+    unsigned reading_threads = var_map["reading_threads"].as<unsigned>();
+    if( !is_cache_loaded && reading_threads > 1 )
+    {
+        if( !FileUtils::exists(training_data_path) ) fatal_error("Error : failed to find training data at `" + training_data_path + "`");
+        model_handler.read_training_data_parallel(training_data_path, reading_threads, sents, feature_seqs, tag_seqs);
+    }
+    else if( !is_cache_loaded )
+    {
+        ifstream train_is(training_data_path);
+        if (!train_is) {
+            fatal_error("Error : failed to open training: `" + training_data_path + "` .");
+        }
+        model_handler.read_training_data(train_is, sents ,feature_seqs, tag_seqs);
+        train_is.close();
+    }
     // set model structure param 
     model_handler.set_model_param_after_reading_training_data();
 
     // build model structure
     model_handler.build_model(); // passing the var_map to specify the model structure
 
-                                 // reading developing data
-    vector<IndexSeq> dev_sents, dev_tag_seqs ;
-    vector<CWSFeatureDataSeq> dev_feature_seqs ;
-    std::ifstream devel_is(devel_data_path);
-    if (!devel_is) {
-        fatal_error("Error : failed to open devel file: `" + devel_data_path + "`");
+    // reading developing data
+    if( !is_cache_loaded )
+    {
+        std::ifstream devel_is(devel_data_path);
+        if (!devel_is) {
+            fatal_error("Error : failed to open devel file: `" + devel_data_path + "`");
+        }
+        model_handler.read_devel_data(devel_is, dev_sents , dev_feature_seqs, dev_tag_seqs);
+        devel_is.close();
     }
-    model_handler.read_devel_data(devel_is, dev_sents , dev_feature_seqs, dev_tag_seqs);
-    devel_is.close();
 
     // Train 
-    model_handler.train(sents, feature_seqs, tag_seqs , 
-        max_epoch, 
-        dev_sents, dev_feature_seqs, dev_tag_seqs , 
-        devel_freq , 
-        trivial_report_freq);
+    if( nr_train_shards > 0 )
+    {
+        model_handler.train_from_shards(corpus_cache_path, nr_train_shards, var_map["shuffle_buffer_size"].as<unsigned>(),
+            max_epoch,
+            dev_sents, dev_feature_seqs, dev_tag_seqs ,
+            devel_freq ,
+            trivial_report_freq);
+    }
+    else
+    {
+        model_handler.train(sents, feature_seqs, tag_seqs , 
+            max_epoch, 
+            dev_sents, dev_feature_seqs, dev_tag_seqs , 
+            devel_freq , 
+            trivial_report_freq);
+    }
 
     // save model
     model_handler.save_model(model_os);
@@ -161,7 +220,14 @@ int devel_process(int argc, char *argv[], const string &program_name)
     string devel_data_path, model_path ;
     op_des.add_options()
         ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the input plus this headroom ratio (e.g. 0.3) ,"
+            " using the memory profile measured by previous runs .")
+        ("mem_profile", po::value<string>(), "The memory profile , updated with the measured graph and parameter memory and read by `cnn_mem_auto` ."
+            " `<model>.memprofile` if not specified ."
+            " it is only written if this or `cnn_mem_auto` is specified .")
         ("devel_data", po::value<string>(&devel_data_path), "The path to validation data .")
+        ("corpus_cache", po::value<string>(), "The path to corpus cache built by `index` with the model's training data .")
         ("model", po::value<string>(&model_path), "Use to specify the model name(path)")
         ("help,h", "Show help information.");
     po::variables_map var_map;
@@ -182,10 +248,18 @@ int devel_process(int argc, char *argv[], const string &program_name)
     shared_ptr<char *> cnn_argv;
     unsigned cnn_mem = 0 ;
     if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    string mem_profile_path = var_map.count("mem_profile") != 0 ? var_map["mem_profile"].as<string>() : model_path + ".memprofile";
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        cnn_mem = CnnMemPlanner::plan_cnn_mem_mb(mem_profile_path, { devel_data_path }, CnnMemPlanner::LengthUnit::Char, false,
+            var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
     build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
     char **cnn_argv_ptr = cnn_argv.get();
     cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed); 
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
     CWSInput1WithFeatureModelHandler<RNNDerived, CWSBareInput1CLF2OModel<RNNDerived>> model_handler;
+    if( var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0 ){ model_handler.set_mem_profile_path(mem_profile_path); }
     // Load model 
     ifstream model_is(model_path);
     if (!model_is)
@@ -196,13 +270,24 @@ int devel_process(int argc, char *argv[], const string &program_name)
     model_is.close();
 
     // read devel data
-    ifstream devel_is(devel_data_path) ;
-    if( !devel_is ) fatal_error("Error : failed to open devel data at `" + devel_data_path + "`") ;
-    vector<IndexSeq> sents,
+    FlatIndexSeqs sents,
         tag_seqs ;
-    vector<CWSFeatureDataSeq> feature_seqs;
-    model_handler.read_devel_data(devel_is, sents, feature_seqs, tag_seqs);
-    devel_is.close();
+    CWSFeatureDataFlatSeqs feature_seqs;
+    bool is_cache_loaded = false;
+    if( var_map.count("corpus_cache") != 0 )
+    {
+        string corpus_cache_path = var_map["corpus_cache"].as<string>();
+        ifstream cache_is(corpus_cache_path, ios::binary);
+        if( !cache_is ){ BOOST_LOG_TRIVIAL(warning) << "failed to open corpus cache `" << corpus_cache_path << "` , parse the text data ."; }
+        else{ is_cache_loaded = model_handler.load_devel_corpus_cache(cache_is, devel_data_path, sents, feature_seqs, tag_seqs); }
+    }
+    if( !is_cache_loaded )
+    {
+        ifstream devel_is(devel_data_path) ;
+        if( !devel_is ) fatal_error("Error : failed to open devel data at `" + devel_data_path + "`") ;
+        model_handler.read_devel_data(devel_is, sents, feature_seqs, tag_seqs);
+        devel_is.close();
+    }
 
     // devel
     model_handler.devel(sents , feature_seqs, tag_seqs); 
@@ -210,6 +295,20 @@ int devel_process(int argc, char *argv[], const string &program_name)
     return 0;
 }
 
+template <typename RNNDerived>
+int quantize_process(int argc, char *argv[], const string &program_name)
+{
+    using ModelHandler = CWSInput1WithFeatureModelHandler<RNNDerived, CWSBareInput1CLF2OModel<RNNDerived>>;
+    return run_quantize<ModelHandler>(argc, argv, ProgramHeader, program_name);
+}
+
+template <typename RNNDerived>
+int index_process(int argc, char *argv[], const string &program_name)
+{
+    using ModelHandler = CWSInput1WithFeatureModelHandler<RNNDerived, CWSBareInput1CLF2OModel<RNNDerived>>;
+    return run_index<ModelHandler>(argc, argv, ProgramHeader, program_name);
+}
+
 template <typename RNNDerived>
 int predict_process(int argc, char *argv[], const string &program_name)
 {
@@ -220,9 +319,17 @@ int predict_process(int argc, char *argv[], const string &program_name)
     string raw_data_path, output_path, model_path;
     op_des.add_options()
         ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the input plus this headroom ratio (e.g. 0.3) ,"
+            " using the memory profile measured by previous runs .")
+        ("mem_profile", po::value<string>(), "The memory profile , updated with the measured graph and parameter memory and read by `cnn_mem_auto` ."
+            " `<model>.memprofile` if not specified ."
+            " it is only written if this or `cnn_mem_auto` is specified .")
         ("raw_data", po::value<string>(&raw_data_path), "The path to raw data(It should be segmented) .")
         ("output", po::value<string>(&output_path), "The path to storing result . using `stdout` if not specified .")
         ("model", po::value<string>(&model_path), "Use to specify the model name(path)")
+        ("sentence_cache_mb", po::value<float>()->default_value(0.f), "Cache the tags of repeated sentences in at most N MB ,"
+            " the least recently used are dropped . 0 disables it .")
         ("help,h", "Show help information.");
     po::variables_map var_map;
     po::store(po::command_line_parser(argc, argv).options(op_des).allow_unregistered().run(), var_map);
@@ -249,10 +356,18 @@ int predict_process(int argc, char *argv[], const string &program_name)
     shared_ptr<char *> cnn_argv;
     unsigned cnn_mem = 0 ;
     if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    string mem_profile_path = var_map.count("mem_profile") != 0 ? var_map["mem_profile"].as<string>() : model_path + ".memprofile";
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        cnn_mem = CnnMemPlanner::plan_cnn_mem_mb(mem_profile_path, { raw_data_path }, CnnMemPlanner::LengthUnit::Char, false,
+            var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
     build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
     char **cnn_argv_ptr = cnn_argv.get();
     cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed); 
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<string>()); }
     CWSInput1WithFeatureModelHandler<RNNDerived, CWSBareInput1CLF2OModel<RNNDerived>> model_handler ;
+    if( var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0 ){ model_handler.set_mem_profile_path(mem_profile_path); }
 
     // load model 
     ifstream is(model_path);
@@ -262,6 +377,7 @@ int predict_process(int argc, char *argv[], const string &program_name)
     }
     model_handler.load_model(is);
     is.close();
+    model_handler.set_sentence_cache(var_map["sentence_cache_mb"].as<float>(), SentenceCache::model_id_from_name(model_path));
 
     // open raw_data
     ifstream raw_is(raw_data_path);
@@ -291,13 +407,20 @@ int predict_process(int argc, char *argv[], const string &program_name)
 }
 
 
+template <typename RNNDerived>
+int serve_process(int argc, char *argv[], const string &program_name)
+{
+    using ModelHandler = CWSInput1WithFeatureModelHandler<RNNDerived, CWSBareInput1CLF2OModel<RNNDerived>>;
+    return run_tagging_server<ModelHandler>(argc, argv, ProgramHeader, program_name);
+}
+
 int main(int argc, char *argv[])
 {
     ostringstream oss;
     string program_name = argv[0];
     oss << ProgramHeader << "\n"
         << "usage : " << program_name << " [task] [rnn-type] <options>" << "\n"
-        << "task : [ train, devel, predict ] , anyone of the list is optional\n"
+        << "task : [ index, train, devel, predict, quantize, serve ] , anyone of the list is optional\n"
         << "rnn-type : [ rnn, lstm, gru] , \n"
         << "           rnn  : simple rnn implementation for RNN\n"
         << "           lstm : lstm implementation for RNN\n"
@@ -317,14 +440,22 @@ int main(int argc, char *argv[])
     string task = string(argv[1]);
     string rnn_type = string(argv[2]);
     int ret_status ;
-    const string TrainTask = "train", DevelTask = "devel", PredictTask = "predict";
+    const string IndexTask = "index", TrainTask = "train", DevelTask = "devel", PredictTask = "predict",
+        QuantizeTask = "quantize", ServeTask = "serve";
     const string SimpleRNNType = "rnn", LSTMType = "lstm", GRUType = "gru";
     function<void()> action_when_unknown_rnn_type = [&ret_status,&rnn_type]
     {
         cerr << "unknow rnn-type : '" << rnn_type << "'\n";
         ret_status = -1;
     } ;
-    if( TrainTask == task )
+    if( IndexTask == task )
+    {
+        if( SimpleRNNType == rnn_type ){ ret_status = index_process<SimpleRNNBuilder>(argc - 2, argv + 2, program_name); }
+        else if( LSTMType == rnn_type ){ ret_status = index_process<LSTMBuilder>(argc - 2, argv + 2, program_name); }
+        else if( GRUType == rnn_type ){ ret_status = index_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
+        else{ action_when_unknown_rnn_type(); }
+    }
+    else if( TrainTask == task )
     {
         if( SimpleRNNType == rnn_type ){ ret_status = train_process<SimpleRNNBuilder>(argc - 2, argv + 2, program_name); }
         else if( LSTMType == rnn_type ){ ret_status = train_process<LSTMBuilder>(argc - 2, argv + 2, program_name); }
@@ -345,6 +476,20 @@ int main(int argc, char *argv[])
         else if( GRUType == rnn_type ){ ret_status = predict_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
         else { action_when_unknown_rnn_type() ; }
     }
+    else if( QuantizeTask == task )
+    {
+        if( SimpleRNNType == rnn_type ){ ret_status = quantize_process<SimpleRNNBuilder>(argc - 2, argv + 2, program_name); }
+        else if( LSTMType == rnn_type ){ ret_status = quantize_process<LSTMBuilder>(argc - 2, argv + 2, program_name); }
+        else if( GRUType == rnn_type ){ ret_status = quantize_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
+        else { action_when_unknown_rnn_type(); }
+    }
+    else if( ServeTask == task )
+    {
+        if( SimpleRNNType == rnn_type ){ ret_status = serve_process<SimpleRNNBuilder>(argc - 2, argv + 2, program_name); }
+        else if( LSTMType == rnn_type ){ ret_status = serve_process<LSTMBuilder>(argc - 2, argv + 2, program_name); }
+        else if( GRUType == rnn_type ){ ret_status = serve_process<GRUBuilder>(argc - 2, argv + 2, program_name); }
+        else { action_when_unknown_rnn_type(); }
+    }
     else
     {
         cerr << "unknown task : " << task << "\n"
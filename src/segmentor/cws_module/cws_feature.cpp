@@ -32,4 +32,12 @@ std::string CWSFeature::get_feature_info() const
     return oss.str();
 }
 
+std::string CWSFeature::get_extract_signature() const
+{
+    std::ostringstream oss;
+    oss << "context_left_size=" << context_feature.get_context_left_size()
+        << " context_right_size=" << context_feature.get_context_right_size();
+    return oss.str();
+}
+
 } // end of namespace slnn
\ No newline at end of file
@@ -4,9 +4,16 @@
 #include "lexicon_feature.h"
 #include "modelmodule/context_feature.h"
 #include "type_feature.h"
+#include "utils/flat_seqs.hpp"
+#include "utils/corpus_cache.hpp"
 
 namespace slnn{
 
+/**
+ * CWS feature data of a sentence , stored as structure of arrays :
+ * lexicon (3 bytes per char) , context ids (fixed stride , see `ContextFeatureDataSeq`) and chartype ids ,
+ * each part is one contiguous buffer .
+ */
 struct CWSFeatureDataSeq
 {
     LexiconFeatureDataSeq lexicon_feature_data_seq;
@@ -21,6 +28,40 @@ struct CWSFeatureDataSeq
     CharTypeFeatureDataSeq& get_chartype_feature_data_seq(){ return chartype_feature_data_seq; }
 };
 
+/**
+ * CSR-style storage of CWS feature data for a whole dataset , every part is one flat buffer .
+ * `get` copies a sentence to a (reused) `CWSFeatureDataSeq` .
+ */
+class CWSFeatureDataFlatSeqs
+{
+public:
+    CWSFeatureDataFlatSeqs() : context_stride(0), reserved_nr_seqs(0), reserved_nr_chars(0){}
+    // the context buffer is reserved once its stride is known (by the first `push_back` / `append`)
+    void reserve(size_t nr_seqs, size_t nr_chars);
+    void push_back(const CWSFeatureDataSeq &cws_feature_seq);
+    void append(const CWSFeatureDataFlatSeqs &other);
+    // context features hold word ids , remap them after the word dict is re-indexed (SOS / EOS are kept)
+    void remap_context_ids(const IndexSeq &old2new);
+    size_t size() const { return lexicon_seqs.size(); }
+    void get(size_t i, CWSFeatureDataSeq &cws_feature_seq) const;
+    void shrink_to_fit();
+    size_t get_memory_bytes() const
+    {
+        return lexicon_seqs.get_memory_bytes() + context_seqs.get_memory_bytes() + chartype_seqs.get_memory_bytes();
+    }
+    // corpus cache
+    void save_cache(CorpusCacheWriter &writer) const;
+    void load_cache(CorpusCacheReader &reader);
+    static void skip_cache(CorpusCacheReader &reader);
+private:
+    FlatSeqs<LexiconFeatureData> lexicon_seqs;
+    FlatIndexSeqs context_seqs; // flat context ids , `context_stride` ids for every char
+    FlatIndexSeqs chartype_seqs;
+    unsigned context_stride;
+    size_t reserved_nr_seqs,
+        reserved_nr_chars;
+};
+
 class CWSFeatureLayer;
 
 class CWSFeature
@@ -37,8 +78,10 @@ public:
                                               + chartype_feature.get_feature_dim(); };
     
     void count_word_frequency(const Seq &word_seq){ lexicon_feature.count_word_frequency(word_seq); };
+    void add_word_count(const std::string &word, unsigned cnt){ lexicon_feature.add_word_count(word, cnt); }
     void build_lexicon(){ lexicon_feature.build_lexicon(); };
     void random_replace_with_unk(const CWSFeatureDataSeq &origin_cws_feature_seq, CWSFeatureDataSeq &replaced_cws_feature_seq);
+    // only reads the feature state , can be called from several threads once the lexicon is built
     void extract(const Seq &char_seq, const IndexSeq &index_char_seq, CWSFeatureDataSeq &cws_feature_seq);
     
     std::string get_feature_info() const ;
@@ -46,6 +89,17 @@ public:
     template <typename Archive>
     void serialize(Archive &ar, unsigned version);
 
+    // corpus cache : the state built from training data , and what extracted features depend on
+    template <typename Archive>
+    void serialize_corpus_state(Archive &ar){ lexicon_feature.serialize_lexicon(ar); }
+    uint64_t get_corpus_state_fingerprint(uint64_t seed) const { return lexicon_feature.get_lexicon_fingerprint(seed); }
+    std::string get_extract_signature() const;
+    // only the parameters extraction depends on , for building corpus cache without a model
+    void set_extract_parameters(unsigned context_left_size, unsigned context_right_size)
+    {
+        context_feature.set_parameters(context_left_size, context_right_size, 0);
+    }
+
     // DEBUG
     void debug_one_sent(const Seq &char_seq, const CWSFeatureDataSeq &cws_feature_seq)
     {
@@ -63,14 +117,117 @@ private :
 inline
 void CWSFeature::random_replace_with_unk(const CWSFeatureDataSeq &origin_cws_feature_seq, CWSFeatureDataSeq &replaced_cws_feature_seq)
 {
-    using std::swap;
-    CWSFeatureDataSeq tmp_data_seq;
+    // every part is a flat buffer , assigning to the reused scratch doesn't allocate once its capacity is enough ;
+    // only context ids need replacement , and it is done in place .
+    replaced_cws_feature_seq.get_lexicon_feature_data_seq() = origin_cws_feature_seq.get_lexicon_feature_data_seq();
+    replaced_cws_feature_seq.get_chartype_feature_data_seq() = origin_cws_feature_seq.get_chartype_feature_data_seq();
     context_feature.random_replace_with_unk(origin_cws_feature_seq.get_context_feature_data_seq(), 
-        tmp_data_seq.get_context_feature_data_seq());
-    assert(tmp_data_seq.get_context_feature_data_seq().size() > 0);
-    tmp_data_seq.get_lexicon_feature_data_seq() = origin_cws_feature_seq.get_lexicon_feature_data_seq();
-    tmp_data_seq.get_chartype_feature_data_seq() = origin_cws_feature_seq.get_chartype_feature_data_seq();
-    swap(replaced_cws_feature_seq, tmp_data_seq);
+        replaced_cws_feature_seq.get_context_feature_data_seq());
+}
+
+inline
+void CWSFeatureDataFlatSeqs::reserve(size_t nr_seqs, size_t nr_chars)
+{
+    lexicon_seqs.reserve(nr_seqs, nr_chars);
+    chartype_seqs.reserve(nr_seqs, nr_chars);
+    reserved_nr_seqs = nr_seqs;
+    reserved_nr_chars = nr_chars;
+    if( size() > 0 ){ context_seqs.reserve(nr_seqs, nr_chars * context_stride); }
+}
+
+inline
+void CWSFeatureDataFlatSeqs::push_back(const CWSFeatureDataSeq &cws_feature_seq)
+{
+    const ContextFeatureDataSeq &context_seq = cws_feature_seq.get_context_feature_data_seq();
+    if( size() == 0 )
+    {
+        context_stride = context_seq.get_stride();
+        context_seqs.reserve(reserved_nr_seqs, reserved_nr_chars * context_stride);
+    }
+    else if( context_seq.get_stride() != context_stride )
+    {
+        throw std::runtime_error("context feature size is not consistent in the dataset .");
+    }
+    lexicon_seqs.push_back(cws_feature_seq.get_lexicon_feature_data_seq());
+    context_seqs.push_back(context_seq.get_flat_ids());
+    chartype_seqs.push_back(cws_feature_seq.get_chartype_feature_data_seq());
+}
+
+inline
+void CWSFeatureDataFlatSeqs::append(const CWSFeatureDataFlatSeqs &other)
+{
+    if( other.size() == 0 ){ return; }
+    if( size() == 0 )
+    {
+        context_stride = other.context_stride;
+        context_seqs.reserve(reserved_nr_seqs, reserved_nr_chars * context_stride);
+    }
+    else if( other.context_stride != context_stride )
+    {
+        throw std::runtime_error("context feature size is not consistent in the dataset .");
+    }
+    lexicon_seqs.append(other.lexicon_seqs);
+    context_seqs.append(other.context_seqs);
+    chartype_seqs.append(other.chartype_seqs);
+}
+
+inline
+void CWSFeatureDataFlatSeqs::remap_context_ids(const IndexSeq &old2new)
+{
+    context_seqs.transform_items([&old2new](Index word_id)
+    {
+        return ( word_id == ContextFeature::WordSOSId || word_id == ContextFeature::WordEOSId ) ? word_id : old2new[word_id];
+    });
+}
+
+inline
+void CWSFeatureDataFlatSeqs::get(size_t i, CWSFeatureDataSeq &cws_feature_seq) const
+{
+    SeqView<LexiconFeatureData> lexicon_view = lexicon_seqs.at(i);
+    lexicon_view.copy_to(cws_feature_seq.get_lexicon_feature_data_seq());
+    cws_feature_seq.get_context_feature_data_seq().assign(context_seqs[i].begin(), lexicon_view.size(), context_stride);
+    chartype_seqs[i].copy_to(cws_feature_seq.get_chartype_feature_data_seq());
+}
+
+inline
+void CWSFeatureDataFlatSeqs::shrink_to_fit()
+{
+    lexicon_seqs.shrink_to_fit();
+    context_seqs.shrink_to_fit();
+    chartype_seqs.shrink_to_fit();
+}
+
+inline
+void CWSFeatureDataFlatSeqs::save_cache(CorpusCacheWriter &writer) const
+{
+    writer.write_pod(context_stride);
+    writer.write_flat_seqs(lexicon_seqs);
+    writer.write_flat_seqs(context_seqs);
+    writer.write_flat_seqs(chartype_seqs);
+}
+
+inline
+void CWSFeatureDataFlatSeqs::load_cache(CorpusCacheReader &reader)
+{
+    reader.read_pod(context_stride);
+    reader.read_flat_seqs(lexicon_seqs);
+    reader.read_flat_seqs(context_seqs);
+    reader.read_flat_seqs(chartype_seqs);
+    if( context_seqs.size() != lexicon_seqs.size() || chartype_seqs.size() != lexicon_seqs.size() ||
+        context_seqs.total_items() != lexicon_seqs.total_items() * context_stride )
+    {
+        throw std::runtime_error("cws feature data in corpus cache is broken .");
+    }
+}
+
+inline
+void CWSFeatureDataFlatSeqs::skip_cache(CorpusCacheReader &reader)
+{
+    unsigned context_stride;
+    reader.read_pod(context_stride);
+    reader.skip_flat_seqs<LexiconFeatureData>();
+    reader.skip_flat_seqs<Index>();
+    reader.skip_flat_seqs<Index>();
 }
 
 template <typename Archive>
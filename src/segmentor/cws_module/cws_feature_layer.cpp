@@ -13,7 +13,7 @@ CWSFeatureLayer::CWSFeatureLayer(cnn::Model *cnn_m, unsigned start_here_dict_siz
 {}
 CWSFeatureLayer::CWSFeatureLayer(cnn::Model *cnn_m, const CWSFeature &cws_feature, cnn::LookupParameters *word_lookup_param)
     :lexicon_feature_layer(cnn_m, cws_feature.lexicon_feature),
-    context_feature_layer(cnn_m, word_lookup_param),
+    context_feature_layer(cnn_m, word_lookup_param, cws_feature.context_feature),
     chartype_feature_layer(cnn_m, cws_feature.chartype_feature.FeatureDictSize(), 
                                   cws_feature.chartype_feature.get_feature_dim())
 {}
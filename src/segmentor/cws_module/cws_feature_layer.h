@@ -24,6 +24,7 @@ private:
     LexiconFeatureLayer lexicon_feature_layer;
     ContextFeatureLayer context_feature_layer;
     Index2ExprLayer chartype_feature_layer;
+    std::vector<cnn::expr::Expression> context_feature_exprs; // buffer , context windows share the lookups
 };
 
 inline
@@ -37,21 +38,20 @@ void CWSFeatureLayer::new_graph(cnn::ComputationGraph &cg)
 inline
 void CWSFeatureLayer::build_cws_feature(const CWSFeatureDataSeq &cws_feature_data_seq, std::vector<cnn::expr::Expression> &cws_feature_exprs)
 {
-    using std::swap;
     size_t seq_len = cws_feature_data_seq.size();
-    std::vector<cnn::expr::Expression> tmp_cws_exprs(seq_len);
+    cws_feature_exprs.resize(seq_len);
     const LexiconFeatureDataSeq &lexicon_data_seq = cws_feature_data_seq.get_lexicon_feature_data_seq();
     const ContextFeatureDataSeq &context_data_seq = cws_feature_data_seq.get_context_feature_data_seq();
     const CharTypeFeatureDataSeq &chartype_data_seq = cws_feature_data_seq.get_chartype_feature_data_seq();
+    context_feature_layer.build_feature_exprs(context_data_seq, context_feature_exprs);
     for( size_t i = 0; i < seq_len; ++i )
     {
-        tmp_cws_exprs[i] = cnn::expr::concatenate({
+        cws_feature_exprs[i] = cnn::expr::concatenate({
             lexicon_feature_layer.build_lexicon_feature(lexicon_data_seq[i]),
-            context_feature_layer.build_feature_expr(context_data_seq[i]),
+            context_feature_exprs[i],
             chartype_feature_layer.index2expr(chartype_data_seq[i])
         });
     }
-    swap(cws_feature_exprs, tmp_cws_exprs);
 }
 
 
@@ -1,5 +1,9 @@
 #include <limits>
+#include <cmath>
+#include <algorithm>
 #include "cws_output_layer.h"
+#include "cws_viterbi_decoder.h"
+#include "modelmodule/pretag_beam_search.h"
 
 namespace slnn{
 
@@ -23,41 +27,25 @@ void CWSSimpleOutput::build_output(const std::vector<cnn::expr::Expression> &exp
         pred_out_seq = { tag_sys.S_ID } ;
         return ;
     }
-    std::vector<Index> tmp_pred_out(len);
-    Index pre_tag_id = -1 ;
-    for (size_t i = 0; i < len - 1; ++i)
+    constexpr size_t TagNum = CWSViterbiDecoder::TagNum;
+    const Index static2dynamic[TagNum] = { tag_sys.B_ID, tag_sys.M_ID, tag_sys.E_ID, tag_sys.S_ID };
+    // un-normalized output is enough : log-softmax only adds the same constant to every tag at one position
+    std::vector<cnn::real> flat_emit_scores(len * TagNum);
+    for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i]);
         cnn::expr::Expression nonlinear_expr = nonlinear_func(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-        
-        Index max_prob_tag_in_constrain = select_pred_tag_in_constrain(out_probs , i , pre_tag_id );
-        tmp_pred_out[i] = max_prob_tag_in_constrain ;
-        pre_tag_id = max_prob_tag_in_constrain ;
-    }
-    if( pre_tag_id == tag_sys.M_ID || pre_tag_id == tag_sys.B_ID ){ tmp_pred_out[len - 1] = tag_sys.E_ID ; }
-    else { tmp_pred_out[len - 1] = tag_sys.S_ID ; }
-    std::swap(pred_out_seq, tmp_pred_out);
-}
-
-Index CWSSimpleOutput::select_pred_tag_in_constrain(std::vector<cnn::real> &dist, size_t pos , Index pre_tag_id)
-{
-    // dist value must bigger than zero
-    cnn::real max_prob = std::numeric_limits<cnn::real>::lowest() ;
-    Index selected_tag = -1 ;
-    for( size_t cur_tag_id = 0 ; cur_tag_id < dist.size() ; ++cur_tag_id )
-    {
-        if( !tag_sys.can_emit(pos, cur_tag_id) ) continue ;
-        if( pos > 0 && !tag_sys.can_trans(pre_tag_id, cur_tag_id) ) continue ;
-        if( dist[cur_tag_id] > max_prob )
+        std::vector<cnn::real> out_scores = cnn::as_vector(pcg->get_value(out_expr));
+        for( size_t static_id = 0; static_id < TagNum; ++static_id )
         {
-            max_prob = dist[cur_tag_id] ;
-            selected_tag = cur_tag_id ;
+            flat_emit_scores[i * TagNum + static_id] = out_scores[static2dynamic[static_id]];
         }
     }
-    assert(selected_tag != -1) ;
-    return selected_tag ;
+    IndexSeq tmp_pred_out;
+    CWSViterbiDecoder::decode(flat_emit_scores, tmp_pred_out);
+    for( Index &tag_id : tmp_pred_out ){ tag_id = static2dynamic[tag_id]; }
+    std::swap(pred_out_seq, tmp_pred_out);
 }
 
 /**************** CWS Pretag Output ***************/
@@ -84,43 +72,124 @@ void CWSPretagOutput::build_output(const std::vector<cnn::expr::Expression> &exp
         pred_seq = { tag_sys.S_ID } ;
         return ;
     }
-    IndexSeq tmp_pred(len) ;
-    cnn::expr::Expression pretag_exp = parameter(*pcg, TAG_SOS) ;
-    Index pre_tag_id = -1 ;
-    for( size_t i = 0; i < len-1; ++i )
+    // the output distribution depends on the previous tag , so score every (pre-tag, cur-tag) pair
+    // at every position and do exact viterbi decoding , instead of greedy decoding .
+    constexpr size_t TagNum = CWSViterbiDecoder::TagNum;
+    const Index static2dynamic[TagNum] = { tag_sys.B_ID, tag_sys.M_ID, tag_sys.E_ID, tag_sys.S_ID };
+    cnn::real init_scores[TagNum];
+    std::vector<cnn::real> flat_pair_scores((len - 1) * TagNum * TagNum, 0.f);
+    if( PretagBeamSearchDecoder::is_supported_nonlinear(nonlinear_func) )
     {
-        cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i], pretag_exp);
-        cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
-        cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> dist = as_vector(pcg->get_value(out_expr)) ;
-        Index id_of_constrained_max_prob = select_pred_tag_in_constrain(dist, i, pre_tag_id) ;
-        tmp_pred[i] = id_of_constrained_max_prob ;
-        pretag_exp = lookup(*pcg, tag_lookup_param,id_of_constrained_max_prob) ;
-        pre_tag_id = id_of_constrained_max_prob ;
+        build_pair_scores(expr_cont1, expr_cont2, static2dynamic, init_scores, flat_pair_scores);
     }
-    // the last tag has already been determined . (pre_tag can't be -1 ! assert in `select_pred_tag_in_constrain` has ensured it !)
-    if( pre_tag_id == tag_sys.B_ID || pre_tag_id == tag_sys.M_ID ){ tmp_pred[len - 1] = tag_sys.E_ID ; }
-    else { tmp_pred[len - 1] = tag_sys.S_ID ; }
+    else { build_pair_scores_in_graph(expr_cont1, expr_cont2, static2dynamic, init_scores, flat_pair_scores); }
+    IndexSeq tmp_pred;
+    CWSViterbiDecoder::decode_pair_scores(init_scores, flat_pair_scores, len, tmp_pred);
+    for( Index &tag_id : tmp_pred ){ tag_id = static2dynamic[tag_id]; }
     std::swap(pred_seq, tmp_pred) ;
 }
 
-Index CWSPretagOutput::select_pred_tag_in_constrain(std::vector<cnn::real> &dist, size_t pos , Index pre_tag_id)
+void CWSPretagOutput::build_pair_scores(const std::vector<cnn::expr::Expression> &expr_cont1,
+                                        const std::vector<cnn::expr::Expression> &expr_cont2,
+                                        const Index *static2dynamic,
+                                        cnn::real *init_scores,
+                                        std::vector<cnn::real> &flat_pair_scores)
 {
-    // dist value must bigger than zero
-    cnn::real max_prob = std::numeric_limits<cnn::real>::lowest() ;
-    Index selected_tag = -1 ;
-    for( size_t cur_tag_id = 0 ; cur_tag_id < dist.size() ; ++cur_tag_id )
+    using Decoder = PretagBeamSearchDecoder;
+    constexpr size_t TagNum = CWSViterbiDecoder::TagNum;
+    size_t len = expr_cont1.size();
+    unsigned hidden_dim = pcg->nodes[hidden_layer.b_exp.i]->dim.rows(),
+        output_dim = pcg->nodes[output_layer.b_exp.i]->dim.rows();
+    // same split as the beam search decoder : the part without previous tag in ONE batched forward ,
+    // and W_tag * [B, M, E, S, SOS] once . the pair scores are then filled out of the graph .
+    cnn::expr::Expression precomputed_hidden_expr = cnn::expr::affine_transform({
+        hidden_layer.b_exp,
+        hidden_layer.w1_exp, StaticBatchLayer::seq2batch_expr(expr_cont1),
+        hidden_layer.w2_exp, StaticBatchLayer::seq2batch_expr(expr_cont2)
+    });
+    std::vector<cnn::expr::Expression> pretag_exprs(TagNum + 1);
+    for( size_t static_id = 0; static_id < TagNum; ++static_id )
+    {
+        pretag_exprs[static_id] = pretag_layer.index2expr(static2dynamic[static_id]);
+    }
+    pretag_exprs[TagNum] = pretag_layer.get_padding_expr();
+    cnn::expr::Expression tag_hidden_expr = hidden_layer.w3_exp * cnn::expr::concatenate_cols(pretag_exprs);
+    Decoder::Matrix precomputed_hidden = Decoder::expr_value2matrix(*pcg, precomputed_hidden_expr, hidden_dim),
+        tag_hidden = Decoder::expr_value2matrix(*pcg, tag_hidden_expr, hidden_dim),
+        output_w = Decoder::expr_value2matrix(*pcg, output_layer.w_exp, output_dim);
+    Decoder::Vector output_b = Decoder::expr_value2matrix(*pcg, output_layer.b_exp, output_dim);
+    Decoder::Matrix hidden, log_dist;
+    // log distribution at position i , one column for every previous tag column in [first_col, first_col + nr_cols)
+    auto compute_log_dist = [&](size_t i, unsigned first_col, unsigned nr_cols)
+    {
+        hidden = tag_hidden.middleCols(first_col, nr_cols);
+        hidden.colwise() += precomputed_hidden.col(i);
+        Decoder::apply_nonlinear(nonlinear_func, hidden);
+        log_dist.noalias() = output_w * hidden;
+        log_dist.colwise() += output_b;
+        for( unsigned k = 0; k < nr_cols; ++k )
+        {
+            cnn::real max_val = log_dist.col(k).maxCoeff();
+            cnn::real log_z = max_val + std::log((log_dist.col(k).array() - max_val).exp().sum());
+            log_dist.col(k).array() -= log_z;
+        }
+    };
+    // position 0 , previous tag is SOS
+    compute_log_dist(0, TagNum, 1);
+    for( size_t static_id = 0; static_id < TagNum; ++static_id ){ init_scores[static_id] = log_dist(static2dynamic[static_id], 0); }
+    // continues position
+    for( size_t i = 1; i < len; ++i )
     {
-        if( !tag_sys.can_emit(pos, cur_tag_id) ) continue ;
-        if( pos > 0 && !tag_sys.can_trans(pre_tag_id, cur_tag_id) ) continue ;
-        if( dist[cur_tag_id] > max_prob )
+        compute_log_dist(i, 0, TagNum);
+        for( size_t pre_static_id = 0; pre_static_id < TagNum; ++pre_static_id )
         {
-            max_prob = dist[cur_tag_id] ;
-            selected_tag = cur_tag_id ;
+            if( !CWSTaggingSystem::static_can_emit(i - 1, pre_static_id) ) continue ;
+            cnn::real *pair_scores = &flat_pair_scores[(i - 1) * TagNum * TagNum + pre_static_id * TagNum];
+            for( size_t static_id = 0; static_id < TagNum; ++static_id )
+            {
+                pair_scores[static_id] = log_dist(static2dynamic[static_id], pre_static_id);
+            }
+        }
+    }
+}
+
+void CWSPretagOutput::build_pair_scores_in_graph(const std::vector<cnn::expr::Expression> &expr_cont1,
+                                                 const std::vector<cnn::expr::Expression> &expr_cont2,
+                                                 const Index *static2dynamic,
+                                                 cnn::real *init_scores,
+                                                 std::vector<cnn::real> &flat_pair_scores)
+{
+    constexpr size_t TagNum = CWSViterbiDecoder::TagNum;
+    size_t len = expr_cont1.size();
+    std::vector<cnn::expr::Expression> pretag_expr_cont(TagNum);
+    for( size_t static_id = 0; static_id < TagNum; ++static_id )
+    {
+        pretag_expr_cont[static_id] = pretag_layer.index2expr(static2dynamic[static_id]);
+    }
+    auto build_log_dist_expr = [this, &expr_cont1, &expr_cont2](size_t i, const cnn::expr::Expression &pretag_exp) -> cnn::expr::Expression
+    {
+        cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i], pretag_exp);
+        cnn::expr::Expression nonlinear_expr = (*nonlinear_func)(merge_out_expr);
+        cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
+        return cnn::expr::log_softmax(out_expr);
+    };
+    // position 0 , previous tag is SOS
+    std::vector<cnn::real> log_dist = as_vector(pcg->get_value(build_log_dist_expr(0, pretag_layer.get_padding_expr())));
+    for( size_t static_id = 0; static_id < TagNum; ++static_id ){ init_scores[static_id] = log_dist[static2dynamic[static_id]]; }
+    // continues position
+    for( size_t i = 1; i < len; ++i )
+    {
+        for( size_t pre_static_id = 0; pre_static_id < TagNum; ++pre_static_id )
+        {
+            if( !CWSTaggingSystem::static_can_emit(i - 1, pre_static_id) ) continue ;
+            log_dist = as_vector(pcg->get_value(build_log_dist_expr(i, pretag_expr_cont[pre_static_id])));
+            cnn::real *pair_scores = &flat_pair_scores[(i - 1) * TagNum * TagNum + pre_static_id * TagNum];
+            for( size_t static_id = 0; static_id < TagNum; ++static_id )
+            {
+                pair_scores[static_id] = log_dist[static2dynamic[static_id]];
+            }
         }
     }
-    assert(selected_tag != -1) ;
-    return selected_tag ;
 }
 
 /************** CWS CRF OUTPUT *****************/
@@ -240,105 +309,63 @@ void CWSCRFOutput::build_output(const std::vector<cnn::expr::Expression> &expr_c
         pred_seq = { tag_sys.S_ID } ;
         return ;
     }
-    // viterbi data preparation
-    std::vector<cnn::expr::Expression> all_tag_expr_cont(tag_num);
-    std::vector<cnn::real> init_score(tag_num , std::numeric_limits<cnn::real>::min());
-    std::vector < cnn::real> trans_score(tag_num * tag_num);
-    std::vector<std::vector<cnn::real>> emit_score(len, std::vector<cnn::real>(tag_num));
+    // scores are laid out by static tag id , for CWSViterbiDecoder
+    constexpr size_t TagNum = CWSViterbiDecoder::TagNum;
+    assert(tag_num == TagNum);
+    const Index static2dynamic[TagNum] = { tag_sys.B_ID, tag_sys.M_ID, tag_sys.E_ID, tag_sys.S_ID };
+    std::vector<cnn::expr::Expression> all_tag_expr_cont(TagNum);
+    cnn::real init_score[TagNum] = { 0.f };
+    cnn::real trans_score[TagNum * TagNum] = { 0.f };
+    std::vector<cnn::real> flat_emit_score(len * TagNum, 0.f);
     // get initial score
-    for( size_t i = 0 ; i < tag_num ; ++i )
+    for( size_t i = 0 ; i < TagNum ; ++i )
     {
-        if( !tag_sys.can_emit(0, i) ) continue ;
-        cnn::expr::Expression init_score_expr = cnn::expr::lookup(*pcg, init_score_lookup_param, i);
+        if( !CWSTaggingSystem::static_can_emit(0, i) ) continue ;
+        cnn::expr::Expression init_score_expr = cnn::expr::lookup(*pcg, init_score_lookup_param, static2dynamic[i]);
         init_score[i] = cnn::as_scalar(pcg->get_value(init_score_expr)) ;
     }
     // get translation score
-    for( size_t pre_idx = 0 ; pre_idx < tag_num ; ++pre_idx )
+    for( size_t pre_idx = 0 ; pre_idx < TagNum ; ++pre_idx )
     {
-        for( size_t cur_idx = 0 ; cur_idx < tag_num ; ++cur_idx )
+        for( size_t cur_idx = 0 ; cur_idx < TagNum ; ++cur_idx )
         {
-            if( !tag_sys.can_trans(pre_idx, cur_idx) ) continue ;
-            size_t flat_idx = pre_idx * tag_num + cur_idx ;
-            cnn::expr::Expression trans_score_expr = lookup(*pcg, trans_score_lookup_param, flat_idx);
-            trans_score[flat_idx] = cnn::as_scalar(pcg->get_value(trans_score_expr)) ;
+            if( !CWSTaggingSystem::static_can_trans(pre_idx, cur_idx) ) continue ;
+            size_t dynamic_flat_idx = static2dynamic[pre_idx] * tag_num + static2dynamic[cur_idx] ;
+            cnn::expr::Expression trans_score_expr = lookup(*pcg, trans_score_lookup_param, dynamic_flat_idx);
+            trans_score[pre_idx * TagNum + cur_idx] = cnn::as_scalar(pcg->get_value(trans_score_expr)) ;
         }
     }
     // get emit score
-    for( size_t i = 0; i < tag_num ; ++i )
+    for( size_t i = 0; i < TagNum ; ++i )
     {
-        all_tag_expr_cont[i] = cnn::expr::lookup(*pcg, tag_lookup_param, i);
+        all_tag_expr_cont[i] = cnn::expr::lookup(*pcg, tag_lookup_param, static2dynamic[i]);
     }
     for( size_t time_step = 0; time_step < len; ++time_step )
     {
-        for( size_t i = 0; i < tag_num; ++i )
+        for( size_t i = 0; i < TagNum; ++i )
         {
-            if( !tag_sys.can_emit(time_step, i) ) continue ;
+            if( !CWSTaggingSystem::static_can_emit(time_step, i) ) continue ;
             cnn::expr::Expression hidden_out_expr = hidden_layer.build_graph(expr_cont1[time_step],
                                                                              expr_cont2[time_step], all_tag_expr_cont[i]);
             cnn::expr::Expression non_linear_expr = (*nonlinear_func)(hidden_out_expr) ;
             cnn::expr::Expression emit_expr = emit_layer.build_graph(non_linear_expr);
-            emit_score[time_step][i] = cnn::as_scalar( pcg->get_value(emit_expr) );
+            flat_emit_score[time_step * TagNum + i] = cnn::as_scalar( pcg->get_value(emit_expr) );
         }
     }
     // viterbi - process
-    std::vector<std::vector<size_t>> path_matrix(len, std::vector<size_t>(tag_num));
-    std::vector<cnn::real> current_scores(tag_num); 
-    // time 0
-    for (size_t i = 0; i < tag_num ; ++i)
-    {
-        if( !tag_sys.can_emit(0, i) ) continue ;
-        current_scores[i] = init_score[i] + emit_score[0][i];
-    }
-    // continues time
-    std::vector<cnn::real>  pre_timestep_scores(tag_num);
-    for (size_t time_step = 1; time_step < len ; ++time_step)
-    {
-        std::swap(pre_timestep_scores, current_scores); // move current_score -> pre_timestep_score
-        for (size_t i = 0; i < tag_num ; ++i )
-        {
-            
-            Index pre_tag_with_max_score = -1;
-            cnn::real max_score = std::numeric_limits<cnn::real>::lowest() ;
-            for (size_t pre_i = 0 ; pre_i < tag_num ; ++pre_i)
-            {
-                if( !tag_sys.can_emit(time_step - 1, pre_i) || !tag_sys.can_trans(pre_i, i) ) continue ;
-                size_t flat_idx = pre_i * tag_num + pre_i ;
-                cnn::real score = pre_timestep_scores[pre_i] + trans_score[flat_idx];
-                if (score > max_score)
-                {
-                    pre_tag_with_max_score = pre_i;
-                    max_score = score;
-                }
-            }
-            assert(pre_tag_with_max_score != -1) ;
-            path_matrix[time_step][i] = pre_tag_with_max_score;
-            current_scores[i] = max_score + emit_score[time_step][i];
-        }
-    }
-    // get result 
-    IndexSeq tmp_predict_ner_seq(len);
-    // from TAG `E` or `S` to select the id with the max score 
-    Index end_predicted_idx ;
-    cnn::real end_of_E_score = current_scores.at(tag_sys.E_ID) ;
-    cnn::real end_of_S_score = current_scores.at(tag_sys.S_ID) ;
-    if( end_of_E_score <= end_of_S_score ){ end_predicted_idx = tag_sys.S_ID ; }
-    else { end_predicted_idx = tag_sys.E_ID ; }
-    tmp_predict_ner_seq[len - 1] = end_predicted_idx;
-    Index pre_predicted_idx = end_predicted_idx;
-    for (size_t reverse_idx = len - 1; reverse_idx >= 1; --reverse_idx)
-    {
-        pre_predicted_idx = path_matrix[reverse_idx][pre_predicted_idx]; // backtrace
-        tmp_predict_ner_seq[reverse_idx - 1] = pre_predicted_idx;
-    }
-    std::swap(tmp_predict_ner_seq, pred_seq);
+    IndexSeq tmp_predict_seq;
+    CWSViterbiDecoder::decode(flat_emit_score, trans_score, init_score, tmp_predict_seq);
+    for( Index &tag_id : tmp_predict_seq ){ tag_id = static2dynamic[tag_id]; }
+    std::swap(tmp_predict_seq, pred_seq);
 }
 
 /* CWSSimpleOutputWithFeature */
 
 CWSSimpleOutputWithFeature::CWSSimpleOutputWithFeature(cnn::Model *m, unsigned input_dim1, unsigned input_dim2, unsigned feature_dim,
     unsigned hidden_dim, unsigned output_dim,
-    cnn::real dropout_rate, NonLinearFunc *nonlinear_func)
-    : SimpleOutputWithFeature(m, input_dim1, input_dim2, feature_dim, hidden_dim, output_dim, dropout_rate, nonlinear_func)
+    cnn::real dropout_rate, NonLinearFunc *nonlinear_func, AffineWeights *affine_weights)
+    : SimpleOutputWithFeature(m, input_dim1, input_dim2, feature_dim, hidden_dim, output_dim, dropout_rate, nonlinear_func,
+        affine_weights)
 {}
 
 void CWSSimpleOutputWithFeature::build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
@@ -352,25 +379,17 @@ void CWSSimpleOutputWithFeature::build_output(const std::vector<cnn::expr::Expre
         pred_out_seq = { CWSTaggingSystem::STATIC_S_ID };
         return ;
     }
-    std::vector<Index> tmp_pred_out(len);
-    Index pre_tag_id = CWSTaggingSystem::STATIC_NONE_ID ;
-    for (size_t i = 0; i < len - 1; ++i)
+    std::vector<cnn::real> flat_emit_scores(len * CWSViterbiDecoder::TagNum);
+    for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i], feature_expr_cont[i]);
         cnn::expr::Expression nonlinear_expr = nonlinear_func(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-
-        Index max_prob_tag_in_constrain = CWSTaggingSystem::static_select_tag_constrained(out_probs , i , pre_tag_id );
-        tmp_pred_out[i] = max_prob_tag_in_constrain ;
-        pre_tag_id = max_prob_tag_in_constrain ;
-    }
-    if( pre_tag_id == CWSTaggingSystem::STATIC_M_ID || 
-        pre_tag_id == CWSTaggingSystem::STATIC_B_ID )
-    { 
-        tmp_pred_out[len - 1] = CWSTaggingSystem::STATIC_E_ID ; 
+        std::vector<cnn::real> out_scores = cnn::as_vector(pcg->get_value(out_expr));
+        std::copy(out_scores.cbegin(), out_scores.cend(), flat_emit_scores.begin() + i * CWSViterbiDecoder::TagNum);
     }
-    else { tmp_pred_out[len - 1] = CWSTaggingSystem::STATIC_S_ID; }
+    IndexSeq tmp_pred_out;
+    CWSViterbiDecoder::decode(flat_emit_scores, tmp_pred_out);
     std::swap(pred_out_seq, tmp_pred_out);
 }
 
@@ -379,8 +398,9 @@ CWSSimpleOutputNew::CWSSimpleOutputNew(cnn::Model *m,
     unsigned input_dim1, unsigned input_dim2,
     unsigned hidden_dim, unsigned output_dim,
     cnn::real dropout_rate,
-    NonLinearFunc *nonlinear_func)
-    : SimpleOutput(m , input_dim1 , input_dim2 , hidden_dim , output_dim, dropout_rate, nonlinear_func)
+    NonLinearFunc *nonlinear_func,
+    AffineWeights *affine_weights)
+    : SimpleOutput(m , input_dim1 , input_dim2 , hidden_dim , output_dim, dropout_rate, nonlinear_func, affine_weights)
 {}
 
 void CWSSimpleOutputNew::build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
@@ -393,32 +413,24 @@ void CWSSimpleOutputNew::build_output(const std::vector<cnn::expr::Expression> &
         pred_out_seq = { CWSTaggingSystem::STATIC_S_ID };
         return ;
     }
-    std::vector<Index> tmp_pred_out(len);
-    Index pre_tag_id = CWSTaggingSystem::STATIC_NONE_ID ;
-    for (size_t i = 0; i < len - 1; ++i)
+    std::vector<cnn::real> flat_emit_scores(len * CWSViterbiDecoder::TagNum);
+    for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression merge_out_expr = hidden_layer.build_graph(expr_cont1[i], expr_cont2[i]);
         cnn::expr::Expression nonlinear_expr = nonlinear_func(merge_out_expr);
         cnn::expr::Expression out_expr = output_layer.build_graph(nonlinear_expr);
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-
-        Index max_prob_tag_in_constrain = CWSTaggingSystem::static_select_tag_constrained(out_probs , i , pre_tag_id );
-        tmp_pred_out[i] = max_prob_tag_in_constrain ;
-        pre_tag_id = max_prob_tag_in_constrain ;
+        std::vector<cnn::real> out_scores = cnn::as_vector(pcg->get_value(out_expr));
+        std::copy(out_scores.cbegin(), out_scores.cend(), flat_emit_scores.begin() + i * CWSViterbiDecoder::TagNum);
     }
-    if( pre_tag_id == CWSTaggingSystem::STATIC_M_ID || 
-        pre_tag_id == CWSTaggingSystem::STATIC_B_ID )
-    { 
-        tmp_pred_out[len - 1] = CWSTaggingSystem::STATIC_E_ID ; 
-    }
-    else { tmp_pred_out[len - 1] = CWSTaggingSystem::STATIC_S_ID; }
+    IndexSeq tmp_pred_out;
+    CWSViterbiDecoder::decode(flat_emit_scores, tmp_pred_out);
     std::swap(pred_out_seq, tmp_pred_out);
 }
 
 /* CWS Simple Bare output */
 
-CWSSimpleBareOutput::CWSSimpleBareOutput(cnn::Model *m, unsigned input_dim, unsigned output_dim)
-    :SimpleBareOutput(m, input_dim, output_dim)
+CWSSimpleBareOutput::CWSSimpleBareOutput(cnn::Model *m, unsigned input_dim, unsigned output_dim, AffineWeights *affine_weights)
+    :SimpleBareOutput(m, input_dim, output_dim, affine_weights)
 {}
 
 void CWSSimpleBareOutput::build_output(const std::vector<cnn::expr::Expression> &input_expr_seq,
@@ -431,23 +443,15 @@ void CWSSimpleBareOutput::build_output(const std::vector<cnn::expr::Expression>
         predicted_seq = { CWSTaggingSystem::STATIC_S_ID };
         return ;
     }
-    std::vector<Index> tmp_pred_out(len);
-    Index pre_tag_id = CWSTaggingSystem::STATIC_NONE_ID ;
-    for (size_t i = 0; i < len - 1; ++i)
+    std::vector<cnn::real> flat_emit_scores(len * CWSViterbiDecoder::TagNum);
+    for (size_t i = 0; i < len; ++i)
     {
         cnn::expr::Expression out_expr = softmax_layer.build_graph(input_expr_seq[i]) ;
-        std::vector<cnn::real> out_probs = cnn::as_vector(pcg->get_value(out_expr));
-
-        Index max_prob_tag_in_constrain = CWSTaggingSystem::static_select_tag_constrained(out_probs , i , pre_tag_id );
-        tmp_pred_out[i] = max_prob_tag_in_constrain ;
-        pre_tag_id = max_prob_tag_in_constrain ;
-    }
-    if( pre_tag_id == CWSTaggingSystem::STATIC_M_ID || 
-        pre_tag_id == CWSTaggingSystem::STATIC_B_ID )
-    { 
-        tmp_pred_out[len - 1] = CWSTaggingSystem::STATIC_E_ID ; 
+        std::vector<cnn::real> out_scores = cnn::as_vector(pcg->get_value(out_expr));
+        std::copy(out_scores.cbegin(), out_scores.cend(), flat_emit_scores.begin() + i * CWSViterbiDecoder::TagNum);
     }
-    else { tmp_pred_out[len - 1] = CWSTaggingSystem::STATIC_S_ID; }
+    IndexSeq tmp_pred_out;
+    CWSViterbiDecoder::decode(flat_emit_scores, tmp_pred_out);
     std::swap(predicted_seq, tmp_pred_out);
 }
 
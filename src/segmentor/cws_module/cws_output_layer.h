@@ -20,10 +20,6 @@ struct CWSSimpleOutput : SimpleOutput
     void build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
                       const std::vector<cnn::expr::Expression> &expr_cont2,
                       IndexSeq &pred_out_seq);
-
-protected :
-    Index select_pred_tag_in_constrain(std::vector<cnn::real> &dist, size_t pos , Index pre_tag) ;
-
 };
 
 struct CWSPretagOutput : PretagOutput
@@ -39,8 +35,18 @@ struct CWSPretagOutput : PretagOutput
     void build_output(const std::vector<cnn::expr::Expression> &expr_1,
                       const std::vector<cnn::expr::Expression> &expr_2,
                       IndexSeq &pred_out_seq) ;
-protected :
-    Index select_pred_tag_in_constrain(std::vector<cnn::real> &dist, size_t pos , Index pre_tag) ;
+    // fill the (pre-tag, cur-tag) log-probability at every position , indexed by static tag id .
+    // `build_pair_scores` only supports the nonlinear functions of the beam search decoder .
+    void build_pair_scores(const std::vector<cnn::expr::Expression> &expr_1,
+                           const std::vector<cnn::expr::Expression> &expr_2,
+                           const Index *static2dynamic,
+                           cnn::real *init_scores,
+                           std::vector<cnn::real> &flat_pair_scores) ;
+    void build_pair_scores_in_graph(const std::vector<cnn::expr::Expression> &expr_1,
+                                    const std::vector<cnn::expr::Expression> &expr_2,
+                                    const Index *static2dynamic,
+                                    cnn::real *init_scores,
+                                    std::vector<cnn::real> &flat_pair_scores) ;
 };
 
 struct CWSCRFOutput : CRFOutput
@@ -70,7 +76,8 @@ struct CWSSimpleOutputWithFeature : SimpleOutputWithFeature
 {
     CWSSimpleOutputWithFeature(cnn::Model *m, unsigned input_dim1, unsigned input_dim2, unsigned feature_dim,
         unsigned hidden_dim, unsigned output_dim,
-        cnn::real dropout_rate=0.f, NonLinearFunc *nonlinear_func=&cnn::expr::rectify);
+        cnn::real dropout_rate=0.f, NonLinearFunc *nonlinear_func=&cnn::expr::rectify,
+        AffineWeights *affine_weights=nullptr);
     virtual void build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
         const std::vector<cnn::expr::Expression> &expr_cont2,
         const std::vector<cnn::expr::Expression> &feature_expr_cont,
@@ -86,7 +93,8 @@ struct CWSSimpleOutputNew : SimpleOutput
         unsigned input_dim1, unsigned input_dim2,
         unsigned hidden_dim, unsigned output_dim,
         cnn::real dropout_rate=0.f,
-        NonLinearFunc *nonlinear_func = &cnn::expr::rectify) ;
+        NonLinearFunc *nonlinear_func = &cnn::expr::rectify,
+        AffineWeights *affine_weights = nullptr) ;
     void build_output(const std::vector<cnn::expr::Expression> &expr_cont1,
         const std::vector<cnn::expr::Expression> &expr_cont2,
         IndexSeq &pred_out_seq) override ;
@@ -95,7 +103,7 @@ struct CWSSimpleOutputNew : SimpleOutput
 
 struct CWSSimpleBareOutput : public SimpleBareOutput
 {
-    CWSSimpleBareOutput(cnn::Model *m, unsigned input_dim, unsigned output_dim);
+    CWSSimpleBareOutput(cnn::Model *m, unsigned input_dim, unsigned output_dim, AffineWeights *affine_weights=nullptr);
     void build_output(const std::vector<cnn::expr::Expression> &input_expr_seq,
         IndexSeq &predicted_seq) override;
 };
@@ -0,0 +1,224 @@
+#ifndef SLNN_SEGMENTOR_CWS_MODULE_CWS_VITERBI_DECODER_H_
+#define SLNN_SEGMENTOR_CWS_MODULE_CWS_VITERBI_DECODER_H_
+
+#include <vector>
+#include <limits>
+
+#include "cnn/cnn.h"
+#include "utils/typedeclaration.h"
+#include "segmentor/cws_module/cws_tagging_system.h"
+
+namespace slnn{
+
+/**
+ * BMES lattice for CWS, fixed at compile time .
+ * every tag has exactly 2 valid predecessors (see `CWSTaggingSystem::static_can_trans`) :
+ *     B <- {E, S} , M <- {B, M} , E <- {B, M} , S <- {E, S}
+ * so the forbidden transitions never appear in the decoding loop .
+ */
+template <Index CurTag>
+struct BMESPredecessor;
+
+template <>
+struct BMESPredecessor<CWSTaggingSystem::STATIC_B_ID>
+{
+    static constexpr Index First = CWSTaggingSystem::STATIC_E_ID;
+    static constexpr Index Second = CWSTaggingSystem::STATIC_S_ID;
+};
+
+template <>
+struct BMESPredecessor<CWSTaggingSystem::STATIC_M_ID>
+{
+    static constexpr Index First = CWSTaggingSystem::STATIC_B_ID;
+    static constexpr Index Second = CWSTaggingSystem::STATIC_M_ID;
+};
+
+template <>
+struct BMESPredecessor<CWSTaggingSystem::STATIC_E_ID>
+{
+    static constexpr Index First = CWSTaggingSystem::STATIC_B_ID;
+    static constexpr Index Second = CWSTaggingSystem::STATIC_M_ID;
+};
+
+template <>
+struct BMESPredecessor<CWSTaggingSystem::STATIC_S_ID>
+{
+    static constexpr Index First = CWSTaggingSystem::STATIC_E_ID;
+    static constexpr Index Second = CWSTaggingSystem::STATIC_S_ID;
+};
+
+/**
+ * Constrained Viterbi decoder specialized for the 4-tag BMES lattice .
+ * All tag ids here are STATIC tag ids .
+ * Scores are given by a `ScoreFunc` , which should provide :
+ *     cnn::real init(Index cur) const;                         // only called for B, S
+ *     cnn::real emit(size_t time, Index cur) const;
+ *     cnn::real trans(size_t time, Index pre, Index cur) const; // only called for valid transitions , time >= 1
+ * the functor is inlined , so the per-position work is 8 add + 4 compare .
+ * back-pointer only needs 1 bit for every tag (which of the 2 predecessors) ,
+ * so every position costs 1 byte .
+ */
+struct CWSViterbiDecoder
+{
+    using Score = cnn::real;
+    static constexpr size_t TagNum = CWSTaggingSystem::get_tag_num();
+
+    template <typename ScoreFunc>
+    static void decode(size_t len, const ScoreFunc &score_func, IndexSeq &pred_seq);
+
+    /* CRF like : emit scores (flat , len * TagNum) + position-independent transition scores (TagNum * TagNum) */
+    static void decode(const std::vector<Score> &flat_emit_scores, const Score *trans_scores,
+        const Score *init_scores, IndexSeq &pred_seq);
+
+    /* classification like : only emit scores , transitions are only constrained (score 0) */
+    static void decode(const std::vector<Score> &flat_emit_scores, IndexSeq &pred_seq);
+
+    /* pretag like : score of (pre, cur) at every position (flat , (len - 1) * TagNum * TagNum) ,
+       and the initial scores for position 0 . */
+    static void decode_pair_scores(const Score *init_scores, const std::vector<Score> &flat_pair_scores,
+        size_t len, IndexSeq &pred_seq);
+
+private:
+    static Index predecessor(Index cur_tag, bool from_second);
+    template <Index CurTag, typename ScoreFunc>
+    static Score relax(const ScoreFunc &score_func, size_t time, const Score *pre_scores, unsigned char &back_bits);
+};
+
+namespace cws_viterbi_decoder_inner{
+
+struct FlatEmitScoreFunc
+{
+    const CWSViterbiDecoder::Score *emit_scores;
+    const CWSViterbiDecoder::Score *trans_scores; // nullptr for no transition scores
+    const CWSViterbiDecoder::Score *init_scores; // nullptr for no initial scores
+    CWSViterbiDecoder::Score init(Index cur) const
+    { return init_scores ? init_scores[cur] : 0.f; }
+    CWSViterbiDecoder::Score emit(size_t time, Index cur) const
+    { return emit_scores[time * CWSViterbiDecoder::TagNum + cur]; }
+    CWSViterbiDecoder::Score trans(size_t time, Index pre, Index cur) const
+    { return trans_scores ? trans_scores[pre * CWSViterbiDecoder::TagNum + cur] : 0.f; }
+};
+
+struct PairScoreFunc
+{
+    const CWSViterbiDecoder::Score *init_scores;
+    const CWSViterbiDecoder::Score *pair_scores;
+    CWSViterbiDecoder::Score init(Index cur) const { return init_scores[cur]; }
+    CWSViterbiDecoder::Score emit(size_t time, Index cur) const { return 0.f; }
+    CWSViterbiDecoder::Score trans(size_t time, Index pre, Index cur) const
+    {
+        constexpr size_t TagNum = CWSViterbiDecoder::TagNum;
+        return pair_scores[(time - 1) * TagNum * TagNum + pre * TagNum + cur];
+    }
+};
+
+} // end of namespace cws_viterbi_decoder_inner
+
+/*************** inline implementation ***************/
+
+inline
+Index CWSViterbiDecoder::predecessor(Index cur_tag, bool from_second)
+{
+    switch( cur_tag )
+    {
+    case CWSTaggingSystem::STATIC_B_ID:
+        if( from_second ){ return BMESPredecessor<CWSTaggingSystem::STATIC_B_ID>::Second; }
+        return BMESPredecessor<CWSTaggingSystem::STATIC_B_ID>::First;
+    case CWSTaggingSystem::STATIC_M_ID:
+        if( from_second ){ return BMESPredecessor<CWSTaggingSystem::STATIC_M_ID>::Second; }
+        return BMESPredecessor<CWSTaggingSystem::STATIC_M_ID>::First;
+    case CWSTaggingSystem::STATIC_E_ID:
+        if( from_second ){ return BMESPredecessor<CWSTaggingSystem::STATIC_E_ID>::Second; }
+        return BMESPredecessor<CWSTaggingSystem::STATIC_E_ID>::First;
+    default:
+        if( from_second ){ return BMESPredecessor<CWSTaggingSystem::STATIC_S_ID>::Second; }
+        return BMESPredecessor<CWSTaggingSystem::STATIC_S_ID>::First;
+    }
+}
+
+template <Index CurTag, typename ScoreFunc>
+inline
+CWSViterbiDecoder::Score
+CWSViterbiDecoder::relax(const ScoreFunc &score_func, size_t time, const Score *pre_scores, unsigned char &back_bits)
+{
+    constexpr Index First = BMESPredecessor<CurTag>::First;
+    constexpr Index Second = BMESPredecessor<CurTag>::Second;
+    Score first_score = pre_scores[First] + score_func.trans(time, First, CurTag),
+        second_score = pre_scores[Second] + score_func.trans(time, Second, CurTag);
+    Score emit_score = score_func.emit(time, CurTag);
+    if( first_score >= second_score ){ return first_score + emit_score; }
+    back_bits |= static_cast<unsigned char>(1U << CurTag);
+    return second_score + emit_score;
+}
+
+template <typename ScoreFunc>
+inline
+void CWSViterbiDecoder::decode(size_t len, const ScoreFunc &score_func, IndexSeq &pred_seq)
+{
+    using std::swap;
+    constexpr Index B = CWSTaggingSystem::STATIC_B_ID,
+        M = CWSTaggingSystem::STATIC_M_ID,
+        E = CWSTaggingSystem::STATIC_E_ID,
+        S = CWSTaggingSystem::STATIC_S_ID;
+    if( 0 == len ){ pred_seq.clear(); return; }
+    // Special condition : only `S` is valid for single character
+    if( 1 == len ){ pred_seq = { S }; return; }
+    // time 0 , only `B` or `S` can be emitted
+    Score scores[TagNum];
+    scores[B] = score_func.init(B) + score_func.emit(0, B);
+    scores[M] = std::numeric_limits<Score>::lowest();
+    scores[E] = std::numeric_limits<Score>::lowest();
+    scores[S] = score_func.init(S) + score_func.emit(0, S);
+    // continues time
+    std::vector<unsigned char> back_bits_seq(len, 0);
+    for( size_t time = 1; time < len; ++time )
+    {
+        unsigned char &back_bits = back_bits_seq[time];
+        Score b_score = relax<B>(score_func, time, scores, back_bits),
+            m_score = relax<M>(score_func, time, scores, back_bits),
+            e_score = relax<E>(score_func, time, scores, back_bits),
+            s_score = relax<S>(score_func, time, scores, back_bits);
+        scores[B] = b_score;
+        scores[M] = m_score;
+        scores[E] = e_score;
+        scores[S] = s_score;
+    }
+    // the last position , only `E` or `S` is valid
+    IndexSeq tmp_pred_seq(len);
+    Index cur_tag = scores[E] > scores[S] ? E : S;
+    tmp_pred_seq[len - 1] = cur_tag;
+    for( size_t time = len - 1; time >= 1; --time )
+    {
+        bool from_second = (back_bits_seq[time] >> cur_tag) & 1U;
+        cur_tag = predecessor(cur_tag, from_second);
+        tmp_pred_seq[time - 1] = cur_tag;
+    }
+    swap(pred_seq, tmp_pred_seq);
+}
+
+inline
+void CWSViterbiDecoder::decode(const std::vector<Score> &flat_emit_scores, const Score *trans_scores,
+    const Score *init_scores, IndexSeq &pred_seq)
+{
+    cws_viterbi_decoder_inner::FlatEmitScoreFunc score_func{ flat_emit_scores.data(), trans_scores, init_scores };
+    decode(flat_emit_scores.size() / TagNum, score_func, pred_seq);
+}
+
+inline
+void CWSViterbiDecoder::decode(const std::vector<Score> &flat_emit_scores, IndexSeq &pred_seq)
+{
+    cws_viterbi_decoder_inner::FlatEmitScoreFunc score_func{ flat_emit_scores.data(), nullptr, nullptr };
+    decode(flat_emit_scores.size() / TagNum, score_func, pred_seq);
+}
+
+inline
+void CWSViterbiDecoder::decode_pair_scores(const Score *init_scores, const std::vector<Score> &flat_pair_scores,
+    size_t len, IndexSeq &pred_seq)
+{
+    cws_viterbi_decoder_inner::PairScoreFunc score_func{ init_scores, flat_pair_scores.data() };
+    decode(len, score_func, pred_seq);
+}
+
+} // end of namespace slnn
+
+#endif
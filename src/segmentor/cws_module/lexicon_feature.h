@@ -14,6 +14,7 @@
 
 #include "utils/typedeclaration.h"
 #include "utils/utf8processing.hpp"
+#include "utils/corpus_cache.hpp"
 namespace slnn{
 
 struct LexiconFeatureData
@@ -76,6 +77,7 @@ public :
     unsigned get_feature_dim() const { return start_here_feature_dim + pass_here_feature_dim + end_here_feature_dim; }
 
     void count_word_frequency(const Seq &word_seq);
+    void add_word_count(const std::string &word, unsigned cnt){ word_count_dict[word] += cnt; } // merge counts from other threads
     void build_lexicon();
     void extract(const Seq &char_seq, LexiconFeatureDataSeq &lexicon_feature_seq) const ;
 
@@ -84,6 +86,11 @@ public :
     template<typename Archive>
     void serialize(Archive &ar, unsigned version);
 
+    // lexicon built from training data , without the (command line) dims . for corpus cache
+    template<typename Archive>
+    void serialize_lexicon(Archive &ar);
+    uint64_t get_lexicon_fingerprint(uint64_t seed) const;
+
     // DEBUG
     void debug_print_lexicon()
     {
@@ -126,5 +133,27 @@ void LexiconFeature::serialize(Archive &ar, unsigned version)
     ar & lexicon;
 }
 
+template<typename Archive>
+void LexiconFeature::serialize_lexicon(Archive &ar)
+{
+    ar & lexicon_word_max_len & freq_threshold;
+    ar & lexicon;
+}
+
+inline
+uint64_t LexiconFeature::get_lexicon_fingerprint(uint64_t seed) const
+{
+    // unordered_set iteration order is not stable , hash the sorted words
+    std::vector<std::string> words(lexicon.begin(), lexicon.end());
+    std::sort(words.begin(), words.end());
+    uint64_t h = seed;
+    for( const std::string &word : words )
+    {
+        h = CorpusCacheUtils::hash_string(word, h);
+        h = CorpusCacheUtils::hash_bytes("\n", 1, h);
+    }
+    return CorpusCacheUtils::hash_bytes(reinterpret_cast<const char*>(&lexicon_word_max_len), sizeof(lexicon_word_max_len), h);
+}
+
 } // end of namespace slnn
 #endif
\ No newline at end of file
@@ -7,7 +7,9 @@ LexiconFeatureLayer::LexiconFeatureLayer(cnn::Model * cnn_m, unsigned start_here
     unsigned end_here_dict_size, unsigned end_here_dim)
     : start_here_lookup_param(cnn_m->add_lookup_parameters(start_here_dict_size, { start_here_dim })),
     pass_here_lookup_param(cnn_m->add_lookup_parameters(pass_here_dict_size, { pass_here_dim })),
-    end_here_lookup_param(cnn_m->add_lookup_parameters(end_here_dict_size, {end_here_dim}))
+    end_here_lookup_param(cnn_m->add_lookup_parameters(end_here_dict_size, {end_here_dim})),
+    lexicon_lookup_params({ start_here_lookup_param, pass_here_lookup_param, end_here_lookup_param }),
+    pcg(nullptr)
 {}
 
 LexiconFeatureLayer::LexiconFeatureLayer(cnn::Model *cnn_m, const LexiconFeature &lexicon_feature)
@@ -3,6 +3,7 @@
 #include "lexicon_feature.h"
 #include "cnn/cnn.h"
 #include "cnn/expr.h"
+#include "modelmodule/multi_lookup_concat.h"
 namespace slnn{
 
 class LexiconFeatureLayer
@@ -21,6 +22,7 @@ private:
     cnn::LookupParameters *start_here_lookup_param;
     cnn::LookupParameters *pass_here_lookup_param;
     cnn::LookupParameters *end_here_lookup_param;
+    std::vector<cnn::LookupParameters*> lexicon_lookup_params; // start , pass , end , for the fused lookup
     cnn::ComputationGraph *pcg;
 };
 
@@ -33,25 +35,25 @@ void LexiconFeatureLayer::new_graph(cnn::ComputationGraph &cg)
 inline 
 cnn::expr::Expression LexiconFeatureLayer::build_lexicon_feature(const LexiconFeatureData &lexicon_feature_data)
 {
-    return cnn::expr::concatenate({
-        cnn::expr::lookup(*pcg, start_here_lookup_param, lexicon_feature_data.get_start_here_feature_index()),
-        cnn::expr::lookup(*pcg, pass_here_lookup_param, lexicon_feature_data.get_pass_here_feature_index()),
-        cnn::expr::lookup(*pcg, end_here_lookup_param, lexicon_feature_data.get_end_here_feature_index())
-    });
+    // one fused node instead of 3 lookups and a concatenate
+    const Index indices[] = {
+        lexicon_feature_data.get_start_here_feature_index(),
+        lexicon_feature_data.get_pass_here_feature_index(),
+        lexicon_feature_data.get_end_here_feature_index()
+    };
+    return MultiLookupConcat::build(*pcg, lexicon_lookup_params, indices);
 }
 
 inline
 void LexiconFeatureLayer::build_lexicon_feature(const LexiconFeatureDataSeq &lexicon_feature_seq,
     std::vector<cnn::expr::Expression> &lexicon_feature_exprs)
 {
-    using std::swap;
     size_t seq_len = lexicon_feature_seq.size();
-    std::vector<cnn::expr::Expression> tmp_lexicon_feature_exprs(seq_len);
+    lexicon_feature_exprs.resize(seq_len);
     for( size_t i = 0; i < seq_len; ++i )
     {
-        tmp_lexicon_feature_exprs[i] = build_lexicon_feature(lexicon_feature_seq[i]);
+        lexicon_feature_exprs[i] = build_lexicon_feature(lexicon_feature_seq[i]);
     }
-    swap(lexicon_feature_exprs, tmp_lexicon_feature_exprs);
 }
 
 } // end of namespace slnn
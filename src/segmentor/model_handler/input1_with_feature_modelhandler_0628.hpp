@@ -2,14 +2,21 @@
 #define SLNN_SEGMENTOR_INPUT1_WITH_FEATURE_MODELHANDLER_0628_H_
 
 #include <sstream>
+#include <functional>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include "segmentor/base_model/input1_with_feature_model_0628.hpp"
 #include "segmentor/cws_module/cws_feature.h"
 #include "segmentor/cws_module/cws_tagging_system.h"
 #include "utils/stat.hpp"
+#include "utils/memory_stat.hpp"
 #include "utils/stash_model.hpp"
 #include "segmentor/cws_module/cws_reader.h"
+#include "modelmodule/graph_recycler.h"
+#include "utils/flat_seqs.hpp"
+#include "utils/corpus_cache.hpp"
+#include "utils/parallel_reading.hpp"
+#include "utils/sentence_cache.hpp"
 namespace slnn{
 
 template <typename RNNDerived, typename I1Model>
@@ -27,42 +34,147 @@ public :
 
     // Reading data 
     void read_training_data(std::istream &is,
-        std::vector<IndexSeq> &sents,
-        std::vector<CWSFeatureDataSeq> &feature_data_seq,
-        std::vector<IndexSeq> &tag_seqs);
+        FlatIndexSeqs &sents,
+        CWSFeatureDataFlatSeqs &feature_data_seq,
+        FlatIndexSeqs &tag_seqs);
+    // split the file into `nr_threads` ranges and parse them in parallel .
+    // char dict is ordered by frequency then first occurrence , the same ids as `read_training_data`
+    // whatever `nr_threads` is .
+    void read_training_data_parallel(const std::string &path, unsigned nr_threads,
+        FlatIndexSeqs &sents,
+        CWSFeatureDataFlatSeqs &feature_data_seq,
+        FlatIndexSeqs &tag_seqs);
     void read_devel_data(std::istream &is,
-        std::vector<IndexSeq> &sents,
-        std::vector<CWSFeatureDataSeq> &feature_data_seq,
-        std::vector<IndexSeq> &tag_seqs);
+        FlatIndexSeqs &sents,
+        CWSFeatureDataFlatSeqs &feature_data_seq,
+        FlatIndexSeqs &tag_seqs);
     void read_test_data(std::istream &is,
         std::vector<Seq> &raw_test_sents, 
         std::vector<IndexSeq> &sents,
-        std::vector<CWSFeatureDataSeq> &feature_data_seq);
+        std::vector<CWSFeatureDataSeq> &feature_data_seq,
+        StageTimings *timings=nullptr); // extraction latency of every sentence is recorded if not null
 
     // After Reading Training data
     void set_model_param_after_reading_training_data();
     void build_model();
 
     // Train & devel & predict
-    void train(const std::vector<IndexSeq> &sents, 
-        const std::vector<CWSFeatureDataSeq> &feature_data_seqs,
-        const std::vector<IndexSeq> &tag_seqs,
+    void train(const FlatIndexSeqs &sents, 
+        const CWSFeatureDataFlatSeqs &feature_data_seqs,
+        const FlatIndexSeqs &tag_seqs,
         unsigned max_epoch,
-        const std::vector<IndexSeq> &dev_sents, 
-        const std::vector<CWSFeatureDataSeq> &dev_feature_data_seqs,
-        const std::vector<IndexSeq> &dev_tag_seqs,
+        const FlatIndexSeqs &dev_sents, 
+        const CWSFeatureDataFlatSeqs &dev_feature_data_seqs,
+        const FlatIndexSeqs &dev_tag_seqs,
         unsigned do_devel_freq,
         unsigned trivial_report_freq);
-    float devel(const std::vector<IndexSeq> &sents, 
-        const std::vector<CWSFeatureDataSeq> &feature_data_seq,
-        const std::vector<IndexSeq> &tag_seqs);
+    float devel(const FlatIndexSeqs &sents, 
+        const CWSFeatureDataFlatSeqs &feature_data_seq,
+        const FlatIndexSeqs &tag_seqs);
     void predict(std::istream &is, std::ostream &os);
+    // tag raw lines for the server , one output line (without '\n') for every input line ,
+    // in the same format as `predict` . nothing is logged , latencies and tags are counted to `stat`
+    void predict_lines(const std::vector<std::string> &lines, std::vector<std::string> &outputs, BasicStat &stat);
+    // segment sentences already split into chars and indexed by `i1m->char_seq2index_seq` , for in-process pipelines .
+    // an empty char sequence gets an empty word sequence . latencies and tags are counted to `stat`
+    void predict_word_seqs(const std::vector<Seq> &char_seqs, const std::vector<IndexSeq> &sents,
+        const std::vector<CWSFeatureDataSeq> &feature_seqs, std::vector<Seq> &word_seqs, BasicStat &stat);
+    // drop the recycled graph , so that another handler can build its graph (cnn permits one graph at a time)
+    void release_graph(){ graph_recycler.release(); }
+    // log the graph memory profile and merge it into the memory profile file of this model (if set)
+    void report_graph_memory(const std::string &info_header);
+    // resident bytes of the parameters : cnn parameters (values + gradients) and the int8 weights of an int8 model
+    size_t get_parameter_memory_bytes()
+    {
+        return MemoryStat::model_parameter_bytes(*i1m->get_cnn_model()) + i1m->get_int8_memory_bytes();
+    }
+    // the memory profile file of this model , nothing is written if empty (the default)
+    void set_mem_profile_path(const std::string &path){ mem_profile_path = path; }
+    // cache tags of repeated sentences for all predictions , `capacity_mb` = 0 disables it .
+    // `model_id` tells models apart , e.g. `SentenceCache::model_id_from_name(model_path)`
+    void set_sentence_cache(double capacity_mb, uint64_t model_id);
+    const SentenceCache& get_sentence_cache() const { return sentence_cache; }
+    // log hit rate and memory of the sentence cache (if enabled)
+    void report_sentence_cache(const std::string &info_header);
 
     // Save & Load
     void save_model(std::ostream &os);
+    // the affine layers' weights are written as int8 , a model loaded from it decodes with int8 weights (CPU)
+    void save_int8_model(std::ostream &os);
     void load_model(std::istream &is);
+
+    // Binary corpus cache (dicts , lexicon and indexed training/devel data) , keyed by the hash of source files
+    void set_feature_param_for_indexing(const boost::program_options::variables_map &varmap);
+    void write_corpus_cache(std::ostream &os,
+        const std::string &training_data_path, const std::string &devel_data_path,
+        const FlatIndexSeqs &sents, const CWSFeatureDataFlatSeqs &feature_data_seqs, const FlatIndexSeqs &tag_seqs,
+        const FlatIndexSeqs &dev_sents, const CWSFeatureDataFlatSeqs &dev_feature_data_seqs, const FlatIndexSeqs &dev_tag_seqs);
+    // return false (and nothing changed) if the cache doesn't match the source files or the feature parameters .
+    // if training data is sharded , `sents` ... are empty and `nr_train_shards` > 0 , use `train_from_shards` .
+    bool load_corpus_cache(std::istream &is,
+        const std::string &training_data_path, const std::string &devel_data_path,
+        FlatIndexSeqs &sents, CWSFeatureDataFlatSeqs &feature_data_seqs, FlatIndexSeqs &tag_seqs,
+        FlatIndexSeqs &dev_sents, CWSFeatureDataFlatSeqs &dev_feature_data_seqs, FlatIndexSeqs &dev_tag_seqs,
+        unsigned &nr_train_shards);
+    // for a loaded model , only the devel part , the cache should be built with the model's dicts
+    bool load_devel_corpus_cache(std::istream &is, const std::string &devel_data_path,
+        FlatIndexSeqs &dev_sents, CWSFeatureDataFlatSeqs &dev_feature_data_seqs, FlatIndexSeqs &dev_tag_seqs);
+
+    // Out-of-core training : training data is streamed (twice) from text and written to shard files
+    // beside the corpus cache , `shard_size` sentences for every shard . only dicts , lexicon and devel data are in memory .
+    void write_sharded_corpus_cache(const std::string &corpus_cache_path,
+        const std::string &training_data_path, const std::string &devel_data_path,
+        unsigned shard_size);
+    // every epoch streams shards in random order through a shuffle buffer of `shuffle_buffer_size` samples ,
+    // so at most one shard and the buffer are in memory .
+    void train_from_shards(const std::string &corpus_cache_path, unsigned nr_shards,
+        unsigned shuffle_buffer_size,
+        unsigned max_epoch,
+        const FlatIndexSeqs &dev_sents,
+        const CWSFeatureDataFlatSeqs &dev_feature_data_seqs,
+        const FlatIndexSeqs &dev_tag_seqs,
+        unsigned do_devel_freq,
+        unsigned trivial_report_freq);
 private:
+    void write_corpus_cache_head(CorpusCacheWriter &writer, uint64_t training_hash, uint64_t devel_hash,
+        unsigned nr_train_shards);
+    void write_shard(const std::string &corpus_cache_path, unsigned shard_idx, uint64_t training_hash,
+        const FlatIndexSeqs &sents, const CWSFeatureDataFlatSeqs &feature_data_seqs, const FlatIndexSeqs &tag_seqs);
+    void load_shard(const std::string &corpus_cache_path, unsigned shard_idx,
+        FlatIndexSeqs &sents, CWSFeatureDataFlatSeqs &feature_data_seqs, FlatIndexSeqs &tag_seqs);
+    // trains one sample of the epoch , returns false if training should stop
+    using SampleTrainer = std::function<bool(const IndexSeq&, const CWSFeatureDataSeq&, const IndexSeq&)>;
+    // passes the samples of one epoch in training order to the trainer , until it returns false
+    using EpochSampleSource = std::function<void(const SampleTrainer&)>;
+    // the epoch loop of `train` and `train_from_shards` : SGD , reports , devel , model stash and early stop
+    void train_epochs(const EpochSampleSource &epoch_samples,
+        unsigned max_epoch,
+        const FlatIndexSeqs &dev_sents,
+        const CWSFeatureDataFlatSeqs &dev_feature_data_seqs,
+        const FlatIndexSeqs &dev_tag_seqs,
+        unsigned do_devel_freq,
+        unsigned trivial_report_freq);
+    // one SGD step , returns the loss . stage latencies are recorded to `timings`
+    cnn::real train_one_sample(cnn::SimpleSGDTrainer &sgd,
+        const IndexSeq &sent, const CWSFeatureDataSeq &feature_data_seq, const IndexSeq &tag_seq,
+        StageTimings &timings);
+    void log_corpus_memory(const std::string &corpus_name,
+        const FlatIndexSeqs &sents, const CWSFeatureDataFlatSeqs &feature_data_seqs, const FlatIndexSeqs &tag_seqs);
+    // tags of one sentence from the cache , or from the network (and then cached)
+    void predict_sentence(const Seq &char_seq, const IndexSeq &sent, const CWSFeatureDataSeq &feature_seq,
+        IndexSeq &pred_tag_seq, StageTimings &timings);
+    // tags of one sentence from the network , then cached
+    void decode_sentence(const Seq &char_seq, const IndexSeq &sent, const CWSFeatureDataSeq &feature_seq,
+        IndexSeq &pred_tag_seq, StageTimings &timings);
+
     CNNModelStash model_stash;
+    GraphRecycler graph_recycler; // train , devel and predict share ONE recycled graph
+    IndexSeq replaced_sent; // scratch buffers for UNK replacement , reused by every training sample
+    CWSFeatureDataSeq replaced_feature_data;
+    GraphMemoryProfile graph_memory_profile; // peak graph memory by sentence length , of all graphs built
+    SentenceCache sentence_cache; // predicted tags keyed by the char sequence , disabled by default
+    std::string mem_profile_path; // measured graph memory is merged into it , if not empty
+    uint64_t cached_training_hash; // training data hash of the loaded corpus cache , to check shards
 };
 
 } // end of namespace slnn
@@ -78,8 +190,11 @@ const std::string CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::OutputD
 
 template <typename RNNDerived, typename I1Model>
 CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::CWSInput1WithFeatureModelHandler()
-    : i1m(new I1Model()) 
-{}
+    : i1m(new I1Model()),
+    cached_training_hash(0)
+{
+    i1m->set_graph_recycler(&graph_recycler);
+}
 
 template <typename RNNDerived, typename I1Model>
 CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::~CWSInput1WithFeatureModelHandler()
@@ -96,9 +211,9 @@ set_model_param_before_reading_training_data(const boost::program_options::varia
 
 template <typename RNNDerived, typename I1Model>
 void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::read_training_data(std::istream &is,
-    std::vector<IndexSeq> &sents,
-    std::vector<CWSFeatureDataSeq> &cws_feature_seqs,
-    std::vector<IndexSeq> &tag_seqs)
+    FlatIndexSeqs &sents,
+    CWSFeatureDataFlatSeqs &cws_feature_seqs,
+    FlatIndexSeqs &tag_seqs)
 {
     using std::swap;
     assert(!i1m->is_dict_frozen());
@@ -119,48 +234,174 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::read_training_data(s
     // translate word str to char index , extract feature
     BOOST_LOG_TRIVIAL(info) << "+ process training data.";
     unsigned dataset_size = dataset.size();
-    std::vector<IndexSeq> tmp_sents(dataset_size),
-        tmp_tag_seqs(dataset_size);
-    std::vector<CWSFeatureDataSeq> tmp_cws_feature_seqs(dataset_size);
+    FlatIndexSeqs tmp_sents,
+        tmp_tag_seqs;
+    CWSFeatureDataFlatSeqs tmp_cws_feature_seqs;
+    size_t nr_chars = 0;
+    for( const Seq &word_seq : dataset )
+    {
+        for( const std::string &word : word_seq ){ nr_chars += UTF8Processing::utf8_char_len(word); }
+    }
+    tmp_sents.reserve(dataset_size, nr_chars);
+    tmp_tag_seqs.reserve(dataset_size, nr_chars);
+    tmp_cws_feature_seqs.reserve(dataset_size, nr_chars);
+    IndexSeq char_seq, tag_seq;
+    CWSFeatureDataSeq cws_feature_seq;
     for( size_t i = 0; i < dataset_size; ++i )
     {
-        i1m->word_seq2index_seq(dataset[i], tmp_sents[i], tmp_tag_seqs[i], tmp_cws_feature_seqs[i]);
+        i1m->word_seq2index_seq(dataset[i], char_seq, tag_seq, cws_feature_seq);
+        tmp_sents.push_back(char_seq);
+        tmp_tag_seqs.push_back(tag_seq);
+        tmp_cws_feature_seqs.push_back(cws_feature_seq);
+        Seq().swap(dataset[i]); // release the string sentence as soon as it is indexed
         if( (i+1) % 10000 == 0 ){ BOOST_LOG_TRIVIAL(info) << i+1 << " instances has been processed." ; }
     }
-    i1m->freeze_dict();
+    // frequent chars take the leading rows of the lookup table , remap what has been indexed
+    IndexSeq old2new;
+    i1m->freeze_dict_in_frequency_order(old2new);
+    tmp_sents.transform_items([&old2new](Index char_id){ return old2new[char_id]; });
+    tmp_cws_feature_seqs.remap_context_ids(old2new);
+    tmp_sents.shrink_to_fit();
+    tmp_tag_seqs.shrink_to_fit();
+    tmp_cws_feature_seqs.shrink_to_fit();
     BOOST_LOG_TRIVIAL(info) << "- Training data processed done. totally " << dataset_size << " instances has been processed.";
     swap(sents, tmp_sents);
     swap(tag_seqs, tmp_tag_seqs);
     swap(cws_feature_seqs, tmp_cws_feature_seqs);
 }
 
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::read_training_data_parallel(const std::string &path,
+    unsigned nr_threads,
+    FlatIndexSeqs &sents,
+    CWSFeatureDataFlatSeqs &cws_feature_seqs,
+    FlatIndexSeqs &tag_seqs)
+{
+    using std::swap;
+    assert(!i1m->is_dict_frozen());
+    std::vector<ParallelReadingUtils::LineRange> ranges = ParallelReadingUtils::split_line_ranges(path, nr_threads);
+    unsigned nr_ranges = ranges.size();
+    BOOST_LOG_TRIVIAL(info) << "+ parse training data with " << nr_ranges << " threads .";
+    // 1. every worker tokenizes its range with local char ids , and counts words for lexicon
+    std::vector<LocalVocab> local_vocabs(nr_ranges);
+    std::vector<std::unordered_map<std::string, unsigned>> local_word_counts(nr_ranges);
+    std::vector<FlatIndexSeqs> local_sents(nr_ranges),
+        local_tag_seqs(nr_ranges);
+    ParallelReadingUtils::run_parallel(nr_ranges, [&](unsigned range_idx)
+    {
+        std::ifstream is(path);
+        if( !is ){ throw std::runtime_error("failed to open `" + path + "` ."); }
+        is.seekg(ranges[range_idx].first);
+        std::streamoff range_end = ranges[range_idx].second;
+        CWSReader reader(is);
+        LocalVocab &vocab = local_vocabs[range_idx];
+        Seq word_seq,
+            word_char_seq;
+        IndexSeq char_seq,
+            tag_seq,
+            word_tag_seq;
+        while( is.tellg() < range_end && reader.read_segmented_line(word_seq) )
+        {
+            if( word_seq.empty() ){ continue; }
+            char_seq.clear();
+            tag_seq.clear();
+            for( const std::string &word : word_seq )
+            {
+                ++local_word_counts[range_idx][word];
+                CWSTaggingSystem::static_parse_word2chars_indextag(word, word_char_seq, word_tag_seq);
+                for( size_t i = 0; i < word_char_seq.size(); ++i )
+                {
+                    char_seq.push_back(vocab.add(word_char_seq[i]));
+                    tag_seq.push_back(word_tag_seq[i]);
+                }
+            }
+            local_sents[range_idx].push_back(char_seq);
+            local_tag_seqs[range_idx].push_back(tag_seq);
+        }
+    });
+    // 2. merge lexicon counts and vocabularies , in range order
+    for( unsigned range_idx = 0; range_idx < nr_ranges; ++range_idx )
+    {
+        for( const auto &word_count : local_word_counts[range_idx] ){ i1m->add_word_count(word_count.first, word_count.second); }
+        std::unordered_map<std::string, unsigned>().swap(local_word_counts[range_idx]);
+    }
+    i1m->build_lexicon();
+    std::vector<IndexSeq> local2global;
+    ParallelReadingUtils::merge_vocabs(local_vocabs, i1m->get_word_dict_wrapper(), local2global);
+    // 3. remap char ids and extract features in parallel
+    std::vector<FlatIndexSeqs> range_sents(nr_ranges);
+    std::vector<CWSFeatureDataFlatSeqs> range_feature_seqs(nr_ranges);
+    ParallelReadingUtils::run_parallel(nr_ranges, [&](unsigned range_idx)
+    {
+        const LocalVocab &vocab = local_vocabs[range_idx];
+        const IndexSeq &id_map = local2global[range_idx];
+        const FlatIndexSeqs &local_sent_seqs = local_sents[range_idx];
+        Seq char_str_seq;
+        IndexSeq char_seq;
+        CWSFeatureDataSeq cws_feature_seq;
+        for( size_t i = 0; i < local_sent_seqs.size(); ++i )
+        {
+            SeqView<Index> local_sent = local_sent_seqs[i];
+            char_str_seq.resize(local_sent.size());
+            char_seq.resize(local_sent.size());
+            for( size_t pos = 0; pos < local_sent.size(); ++pos )
+            {
+                char_str_seq[pos] = vocab.words[local_sent[pos]];
+                char_seq[pos] = id_map[local_sent[pos]];
+            }
+            i1m->extract_feature(char_str_seq, char_seq, cws_feature_seq);
+            range_sents[range_idx].push_back(char_seq);
+            range_feature_seqs[range_idx].push_back(cws_feature_seq);
+        }
+    });
+    // `merge_vocabs` has assigned ids in frequency order already
+    i1m->freeze_dict();
+    // 4. concatenate ranges in file order
+    FlatIndexSeqs tmp_sents,
+        tmp_tag_seqs;
+    CWSFeatureDataFlatSeqs tmp_cws_feature_seqs;
+    for( unsigned range_idx = 0; range_idx < nr_ranges; ++range_idx )
+    {
+        tmp_sents.append(range_sents[range_idx]);
+        tmp_tag_seqs.append(local_tag_seqs[range_idx]);
+        tmp_cws_feature_seqs.append(range_feature_seqs[range_idx]);
+        // release every range as soon as it is copied
+        range_sents[range_idx] = FlatIndexSeqs();
+        local_tag_seqs[range_idx] = FlatIndexSeqs();
+        range_feature_seqs[range_idx] = CWSFeatureDataFlatSeqs();
+    }
+    BOOST_LOG_TRIVIAL(info) << "- Training data processed done. totally " << tmp_sents.size() << " instances has been processed.";
+    swap(sents, tmp_sents);
+    swap(tag_seqs, tmp_tag_seqs);
+    swap(cws_feature_seqs, tmp_cws_feature_seqs);
+}
+
 template <typename RNNDerived, typename I1Model>
 void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::read_devel_data(std::istream &is,
-    std::vector<IndexSeq> &sents,
-    std::vector<CWSFeatureDataSeq> &cws_feature_seqs,
-    std::vector<IndexSeq> &tag_seqs)
+    FlatIndexSeqs &sents,
+    CWSFeatureDataFlatSeqs &cws_feature_seqs,
+    FlatIndexSeqs &tag_seqs)
 {
     using std::swap;
     assert(i1m->is_dict_frozen());
     BOOST_LOG_TRIVIAL(info) << "+ process devel data .";
     CWSReader reader(is);
     size_t detected_line_cnt = reader.count_line();
-    std::vector<IndexSeq> tmp_sents,
+    FlatIndexSeqs tmp_sents,
         tmp_tag_seqs;
-    std::vector<CWSFeatureDataSeq> tmp_cws_feature_seqs;
-    tmp_sents.reserve(detected_line_cnt);
-    tmp_tag_seqs.reserve(detected_line_cnt);
-    tmp_cws_feature_seqs.reserve(detected_line_cnt);
+    CWSFeatureDataFlatSeqs tmp_cws_feature_seqs;
+    tmp_sents.reserve(detected_line_cnt, 0);
+    tmp_tag_seqs.reserve(detected_line_cnt, 0);
     size_t line_cnt = 0;
     Seq word_seq;
+    IndexSeq char_seq, tag_seq;
+    CWSFeatureDataSeq cws_feature_seq;
     while( reader.read_segmented_line(word_seq) )
     {
-        IndexSeq char_seq, tag_seq;
-        CWSFeatureDataSeq cws_feature_seq;
         i1m->word_seq2index_seq(word_seq, char_seq, tag_seq, cws_feature_seq);
-        tmp_sents.push_back(std::move(char_seq));
-        tmp_tag_seqs.push_back(std::move(tag_seq));
-        tmp_cws_feature_seqs.push_back(std::move(cws_feature_seq));
+        tmp_sents.push_back(char_seq);
+        tmp_tag_seqs.push_back(tag_seq);
+        tmp_cws_feature_seqs.push_back(cws_feature_seq);
         ++line_cnt;
         if( line_cnt % 10000 == 0 ){ BOOST_LOG_TRIVIAL(info) << line_cnt << " instances has been processed."; }
     }
@@ -174,7 +415,8 @@ template <typename RNNDerived, typename I1Model>
 void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::read_test_data(std::istream &is,
     std::vector<Seq> &raw_test_sents,
     std::vector<IndexSeq> &sents,
-    std::vector<CWSFeatureDataSeq> &cws_feature_seqs)
+    std::vector<CWSFeatureDataSeq> &cws_feature_seqs,
+    StageTimings *timings)
 {
     using std::swap;
     assert(i1m->is_dict_frozen());
@@ -194,7 +436,9 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::read_test_data(std::
     {
         IndexSeq sent;
         CWSFeatureDataSeq feature_seq;
+        uint64_t extract_start = StageTimings::now_ns();
         i1m->char_seq2index_seq(char_seq, sent, feature_seq);
+        if( timings ){ timings->record(StageTimings::Stage::Extract, StageTimings::now_ns() - extract_start); }
         tmp_raw_test_sents.push_back(std::move(char_seq));
         tmp_sents.push_back(std::move(sent));
         tmp_cws_feature_seqs.push_back(std::move(feature_seq));
@@ -222,22 +466,52 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::build_model()
 }
 
 template <typename RNNDerived, typename I1Model>
-void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train(const std::vector<IndexSeq> &sents,
-    const std::vector<CWSFeatureDataSeq> &cws_feature_seqs,
-    const std::vector<IndexSeq> &tag_seqs,
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train(const FlatIndexSeqs &sents,
+    const CWSFeatureDataFlatSeqs &cws_feature_seqs,
+    const FlatIndexSeqs &tag_seqs,
     unsigned max_epoch,
-    const std::vector<IndexSeq> &dev_sents,
-    const std::vector<CWSFeatureDataSeq> &dev_cws_feature_seqs,
-    const std::vector<IndexSeq> &dev_tag_seqs,
+    const FlatIndexSeqs &dev_sents,
+    const CWSFeatureDataFlatSeqs &dev_cws_feature_seqs,
+    const FlatIndexSeqs &dev_tag_seqs,
     unsigned do_devel_freq,
     unsigned trivial_report_freq)
 {
     unsigned nr_samples = sents.size();
 
     BOOST_LOG_TRIVIAL(info) << "+ Train at " << nr_samples << " instances .";
+    BOOST_LOG_TRIVIAL(info) << "memory of dicts : " << MemoryStat::format_bytes(i1m->get_dict_memory_bytes());
+    log_corpus_memory("training", sents, cws_feature_seqs, tag_seqs);
+    log_corpus_memory("devel", dev_sents, dev_cws_feature_seqs, dev_tag_seqs);
     std::vector<unsigned> access_order(nr_samples);
     for( unsigned i = 0; i < nr_samples; ++i ) access_order[i] = i;
+    // scratch buffers for the sample (copied out of the flat dataset) , reused by every sample
+    IndexSeq sent, tag_seq;
+    CWSFeatureDataSeq cws_feature_seq;
+    auto epoch_samples = [&](const SampleTrainer &train_sample)
+    {
+        // shuffle samples by random access order
+        shuffle(access_order.begin(), access_order.end(), *cnn::rndeng);
+        for( unsigned i = 0; i < nr_samples; ++i )
+        {
+            unsigned access_idx = access_order[i];
+            sents.at(access_idx).copy_to(sent);
+            tag_seqs.at(access_idx).copy_to(tag_seq);
+            cws_feature_seqs.get(access_idx, cws_feature_seq);
+            if( !train_sample(sent, cws_feature_seq, tag_seq) ){ break; }
+        }
+    };
+    train_epochs(epoch_samples, max_epoch, dev_sents, dev_cws_feature_seqs, dev_tag_seqs, do_devel_freq, trivial_report_freq);
+}
 
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train_epochs(const EpochSampleSource &epoch_samples,
+    unsigned max_epoch,
+    const FlatIndexSeqs &dev_sents,
+    const CWSFeatureDataFlatSeqs &dev_cws_feature_seqs,
+    const FlatIndexSeqs &dev_tag_seqs,
+    unsigned do_devel_freq,
+    unsigned trivial_report_freq)
+{
     cnn::SimpleSGDTrainer sgd(i1m->get_cnn_model());
 
     auto do_devel_in_training = [this, &dev_sents, &dev_cws_feature_seqs, &dev_tag_seqs](CNNModelStash &model_stash) 
@@ -252,37 +526,25 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train(const std::vec
     for( unsigned nr_epoch = 0; nr_epoch < max_epoch ; ++nr_epoch )
     {
         BOOST_LOG_TRIVIAL(info) << "++ Epoch " << nr_epoch + 1 << "/" << max_epoch << " start ";
-        // shuffle samples by random access order
-        shuffle(access_order.begin(), access_order.end(), *cnn::rndeng);
 
         // For loss , accuracy , time cost report
         BasicStat training_stat_per_epoch;
         training_stat_per_epoch.start_time_stat();
 
         // train for every Epoch 
-        for( unsigned i = 0; i < nr_samples; ++i )
+        unsigned nr_trained = 0;
+        epoch_samples([&](const IndexSeq &sent, const CWSFeatureDataSeq &cws_feature_seq, const IndexSeq &tag_seq) -> bool
         {
-            unsigned access_idx = access_order[i];
+            ScopedStageTimer sentence_timer(training_stat_per_epoch.stage_timings, StageTimings::Stage::Sentence);
             // using negative_loglikelihood loss to build model
-            const IndexSeq &sent = sents.at(access_idx),
-                &tag_seq = tag_seqs.at(access_idx);
-            const CWSFeatureDataSeq &cws_feature_seq = cws_feature_seqs.at(access_idx);
-            { // new scope , for only one Computatoin Graph can be exists in one scope at the same time .
-              // devel will creat another Computation Graph , so we need to create new scoce to release it before devel .
-                cnn::ComputationGraph cg ;
-                IndexSeq replaced_sent;
-                CWSFeatureDataSeq replaced_feature_data;
-                i1m->replace_word_with_unk(sent, cws_feature_seq, replaced_sent, replaced_feature_data);
-                i1m->build_loss(cg, replaced_sent, replaced_feature_data, tag_seq);
-                cnn::real loss = as_scalar(cg.forward());
-                cg.backward();
-                sgd.update(1.f);
-                training_stat_per_epoch.loss += loss;
-                training_stat_per_epoch.total_tags += sent.size() ;
-            }
-            if( 0 == (i + 1) % trivial_report_freq ) // Report 
+            training_stat_per_epoch.loss += train_one_sample(sgd, sent, cws_feature_seq, tag_seq,
+                training_stat_per_epoch.stage_timings);
+            training_stat_per_epoch.total_tags += sent.size() ;
+            sentence_timer.stop();
+            ++nr_trained;
+            if( 0 == nr_trained % trivial_report_freq ) // Report 
             {
-                std::string trivial_header = std::to_string(i + 1) + " instances have been trained.";
+                std::string trivial_header = std::to_string(nr_trained) + " instances have been trained.";
                 BOOST_LOG_TRIVIAL(trace) << training_stat_per_epoch.get_stat_str(trivial_header);
             }
 
@@ -291,9 +553,10 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train(const std::vec
             if( 0 == line_cnt_for_devel % do_devel_freq )
             {
                 do_devel_in_training(model_stash);
-                if( !model_stash.is_training_ok() ){ break;  }
+                return model_stash.is_training_ok();
             }
-        }
+            return true;
+        });
 
         // End of an epoch 
         sgd.update_epoch();
@@ -302,9 +565,11 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train(const std::vec
         // Output at end of every eopch
         std::ostringstream tmp_sos;
         tmp_sos << "- Epoch " << nr_epoch + 1 << "/" << std::to_string(max_epoch) << " finished .\n"
-            << nr_samples << " instances has been trained . ";
+            << nr_trained << " instances has been trained . ";
         std::string info_header = tmp_sos.str();
         BOOST_LOG_TRIVIAL(info) << training_stat_per_epoch.get_stat_str(info_header);
+        training_stat_per_epoch.stage_timings.report("stage latency of training epoch " + std::to_string(nr_epoch + 1) + " :");
+        report_graph_memory("graph memory till training epoch " + std::to_string(nr_epoch + 1) + " :");
         total_time_cost_in_seconds += training_stat_per_epoch.get_time_cost_in_seconds();
         // do validation at every ends of epoch
         if( model_stash.is_training_ok() )
@@ -319,9 +584,9 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train(const std::vec
 }
 
 template <typename RNNDerived, typename I1Model>
-float CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::devel(const std::vector<IndexSeq> &sents,
-    const std::vector<CWSFeatureDataSeq> &cws_feature_seqs,
-    const std::vector<IndexSeq> &tag_seqs)
+float CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::devel(const FlatIndexSeqs &sents,
+    const CWSFeatureDataFlatSeqs &cws_feature_seqs,
+    const FlatIndexSeqs &tag_seqs)
 {
     unsigned nr_samples = sents.size();
     BOOST_LOG_TRIVIAL(info) << "validation at " << nr_samples << " instances .";
@@ -329,12 +594,20 @@ float CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::devel(const std::ve
     CWSStatNew stat(true);
     stat.start_time_stat();
     std::vector<IndexSeq> predict_tag_seqs(tag_seqs.size());
+    IndexSeq sent;
+    CWSFeatureDataSeq feature_seq;
     for( unsigned access_idx = 0; access_idx < nr_samples; ++access_idx )
     {
-        cnn::ComputationGraph cg;
-        const IndexSeq &sent = sents.at(access_idx);
-        const CWSFeatureDataSeq &feature_seq = cws_feature_seqs.at(access_idx);
-        i1m->predict(cg, sent, feature_seq, predict_tag_seqs[access_idx]);
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        cnn::ComputationGraph &cg = graph_recycler.next_graph();
+        sents.at(access_idx).copy_to(sent);
+        cws_feature_seqs.get(access_idx, feature_seq);
+        {
+            // graph building and forward are interleaved with decoding in the output layer
+            ScopedStageTimer decode_timer(stat.stage_timings, StageTimings::Stage::Decode);
+            i1m->predict(cg, sent, feature_seq, predict_tag_seqs[access_idx]);
+        }
+        graph_memory_profile.record(sent.size(), cg, false);
         stat.total_tags += predict_tag_seqs[access_idx].size();
     }
     stat.end_time_stat();
@@ -347,6 +620,8 @@ float CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::devel(const std::ve
     tmp_sos << "validation finished .\n"
         << "Acc = " << Acc << "% , P = " << P << "% , R = " << R << "% , F1 = " << F1 << "%";
     BOOST_LOG_TRIVIAL(info) << stat.get_stat_str(tmp_sos.str()) ;
+    stat.stage_timings.report("stage latency of validation :");
+    report_graph_memory("graph memory till validation :");
     return F1;
 }
 
@@ -357,9 +632,12 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::predict(std::istream
     std::vector<Seq> raw_instances;
     std::vector<IndexSeq> sents ;
     std::vector<CWSFeatureDataSeq> cws_feature_seqs;
-    read_test_data(is, raw_instances, sents, cws_feature_seqs );
-    BOOST_LOG_TRIVIAL(info) << "do prediction on " << raw_instances.size() << " instances .";
     BasicStat stat(true);
+    {
+        ScopedStageTimer read_timer(stat.stage_timings, StageTimings::Stage::Read);
+        read_test_data(is, raw_instances, sents, cws_feature_seqs, &stat.stage_timings);
+    }
+    BOOST_LOG_TRIVIAL(info) << "do prediction on " << raw_instances.size() << " instances .";
     stat.start_time_stat();
     for (unsigned int i = 0; i < raw_instances.size(); ++i)
     {
@@ -369,11 +647,12 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::predict(std::istream
             os << "\n";
             continue;
         }
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
         IndexSeq &sent = sents.at(i) ;
         CWSFeatureDataSeq &cws_feature_seq = cws_feature_seqs.at(i);
         IndexSeq pred_tag_seq;
-        cnn::ComputationGraph cg;
-        i1m->predict(cg, sent, cws_feature_seq, pred_tag_seq);
+        predict_sentence(raw_sent, sent, cws_feature_seq, pred_tag_seq, stat.stage_timings);
+        ScopedStageTimer write_timer(stat.stage_timings, StageTimings::Stage::Write);
         Seq words ;
         CWSTaggingSystem::static_parse_chars_indextag2word_seq(raw_sent, pred_tag_seq, words) ;
         os << words[0] ;
@@ -383,6 +662,109 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::predict(std::istream
     }
     stat.end_time_stat() ;
     BOOST_LOG_TRIVIAL(info) << stat.get_stat_str("predict done.")  ;
+    stat.stage_timings.report("stage latency of prediction :");
+    report_graph_memory("graph memory of prediction :");
+    report_sentence_cache("sentence cache of prediction :");
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::predict_lines(const std::vector<std::string> &lines,
+    std::vector<std::string> &outputs, BasicStat &stat)
+{
+    assert(i1m->is_dict_frozen());
+    std::vector<std::string> tmp_outputs(lines.size());
+    Seq char_seq,
+        words;
+    IndexSeq sent,
+        pred_tag_seq;
+    CWSFeatureDataSeq cws_feature_seq;
+    for( size_t line_idx = 0; line_idx < lines.size(); ++line_idx )
+    {
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        {
+            // parsed by the reader , the same as `read_test_data`
+            std::istringstream line_is(lines[line_idx]);
+            CWSReader reader(line_is);
+            if( !reader.readline(char_seq) ){ char_seq.clear(); }
+        }
+        if( char_seq.empty() ){ continue; }
+        // a cached sentence skips feature extraction too
+        if( !sentence_cache.lookup(char_seq, pred_tag_seq) )
+        {
+            {
+                ScopedStageTimer extract_timer(stat.stage_timings, StageTimings::Stage::Extract);
+                i1m->char_seq2index_seq(char_seq, sent, cws_feature_seq);
+            }
+            decode_sentence(char_seq, sent, cws_feature_seq, pred_tag_seq, stat.stage_timings);
+        }
+        ScopedStageTimer write_timer(stat.stage_timings, StageTimings::Stage::Write);
+        CWSTaggingSystem::static_parse_chars_indextag2word_seq(char_seq, pred_tag_seq, words);
+        std::string &output = tmp_outputs[line_idx];
+        output = words[0];
+        for( size_t i = 1; i < words.size(); ++i ){ output += OutputDelimiter + words[i]; }
+        stat.total_tags += pred_tag_seq.size();
+    }
+    outputs.swap(tmp_outputs);
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::predict_word_seqs(const std::vector<Seq> &char_seqs,
+    const std::vector<IndexSeq> &sents, const std::vector<CWSFeatureDataSeq> &feature_seqs,
+    std::vector<Seq> &word_seqs, BasicStat &stat)
+{
+    std::vector<Seq> tmp_word_seqs(char_seqs.size());
+    IndexSeq pred_tag_seq;
+    for( size_t i = 0; i < char_seqs.size(); ++i )
+    {
+        if( char_seqs[i].empty() ){ continue; }
+        ScopedStageTimer sentence_timer(stat.stage_timings, StageTimings::Stage::Sentence);
+        predict_sentence(char_seqs[i], sents[i], feature_seqs[i], pred_tag_seq, stat.stage_timings);
+        CWSTaggingSystem::static_parse_chars_indextag2word_seq(char_seqs[i], pred_tag_seq, tmp_word_seqs[i]);
+        stat.total_tags += pred_tag_seq.size();
+    }
+    word_seqs.swap(tmp_word_seqs);
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::predict_sentence(const Seq &char_seq, const IndexSeq &sent,
+    const CWSFeatureDataSeq &feature_seq, IndexSeq &pred_tag_seq, StageTimings &timings)
+{
+    if( !sentence_cache.lookup(char_seq, pred_tag_seq) )
+    {
+        decode_sentence(char_seq, sent, feature_seq, pred_tag_seq, timings);
+    }
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::decode_sentence(const Seq &char_seq, const IndexSeq &sent,
+    const CWSFeatureDataSeq &feature_seq, IndexSeq &pred_tag_seq, StageTimings &timings)
+{
+    cnn::ComputationGraph &cg = graph_recycler.next_graph();
+    {
+        // graph building and forward are interleaved with decoding in the output layer
+        ScopedStageTimer decode_timer(timings, StageTimings::Stage::Decode);
+        i1m->predict(cg, sent, feature_seq, pred_tag_seq);
+    }
+    graph_memory_profile.record(sent.size(), cg, false);
+    sentence_cache.insert(char_seq, pred_tag_seq);
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::set_sentence_cache(double capacity_mb, uint64_t model_id)
+{
+    sentence_cache.set_capacity_mb(capacity_mb);
+    sentence_cache.set_model_id(model_id);
+    if( sentence_cache.is_enabled() )
+    {
+        BOOST_LOG_TRIVIAL(info) << "sentence cache is enabled , capacity = " << capacity_mb << " MB .";
+    }
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::report_sentence_cache(const std::string &info_header)
+{
+    if( !sentence_cache.is_enabled() ){ return; }
+    BOOST_LOG_TRIVIAL(info) << sentence_cache.get_report_str(info_header);
 }
 
 template <typename RNNDerived, typename I1Model>
@@ -395,13 +777,435 @@ void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::save_model(std::ostr
     BOOST_LOG_TRIVIAL(info) << "save model done .";
 }
 
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::save_int8_model(std::ostream &os)
+{
+    i1m->set_save_as_int8(true);
+    save_model(os);
+    i1m->set_save_as_int8(false);
+}
+
 template <typename RNNDerived, typename I1Model>
 void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::load_model(std::istream &is)
 {
     BOOST_LOG_TRIVIAL(info) << "loading model ...";
     boost::archive::text_iarchive ti(is) ;
     ti >> *(static_cast<I1Model*>(i1m));
+    i1m->build_frozen_dict();
     i1m->print_model_info() ;
+    if( i1m->is_int8() )
+    {
+        BOOST_LOG_TRIVIAL(info) << "int8 model , int8 weights of the affine layers : "
+            << MemoryStat::format_bytes(i1m->get_int8_memory_bytes());
+    }
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::
+set_feature_param_for_indexing(const boost::program_options::variables_map &varmap)
+{
+    i1m->set_feature_extract_param(varmap["context_left_size"].as<unsigned>(), varmap["context_right_size"].as<unsigned>());
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::write_corpus_cache(std::ostream &os,
+    const std::string &training_data_path, const std::string &devel_data_path,
+    const FlatIndexSeqs &sents, const CWSFeatureDataFlatSeqs &cws_feature_seqs, const FlatIndexSeqs &tag_seqs,
+    const FlatIndexSeqs &dev_sents, const CWSFeatureDataFlatSeqs &dev_cws_feature_seqs, const FlatIndexSeqs &dev_tag_seqs)
+{
+    assert(i1m->is_dict_frozen());
+    BOOST_LOG_TRIVIAL(info) << "+ write corpus cache .";
+    CorpusCacheWriter writer(os);
+    write_corpus_cache_head(writer, CorpusCacheUtils::hash_file(training_data_path), CorpusCacheUtils::hash_file(devel_data_path), 0);
+    writer.write_flat_seqs(sents);
+    writer.write_flat_seqs(tag_seqs);
+    cws_feature_seqs.save_cache(writer);
+    writer.write_flat_seqs(dev_sents);
+    writer.write_flat_seqs(dev_tag_seqs);
+    dev_cws_feature_seqs.save_cache(writer);
+    BOOST_LOG_TRIVIAL(info) << "- write corpus cache done .";
+}
+
+template <typename RNNDerived, typename I1Model>
+bool CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::load_corpus_cache(std::istream &is,
+    const std::string &training_data_path, const std::string &devel_data_path,
+    FlatIndexSeqs &sents, CWSFeatureDataFlatSeqs &cws_feature_seqs, FlatIndexSeqs &tag_seqs,
+    FlatIndexSeqs &dev_sents, CWSFeatureDataFlatSeqs &dev_cws_feature_seqs, FlatIndexSeqs &dev_tag_seqs,
+    unsigned &nr_train_shards)
+{
+    using std::swap;
+    assert(!i1m->is_dict_frozen());
+    BOOST_LOG_TRIVIAL(info) << "+ load corpus cache .";
+    CorpusCacheReader reader(is);
+    uint64_t training_hash,
+        devel_hash,
+        fingerprint,
+        nr_shards;
+    std::string extract_signature,
+        state_str;
+    reader.read_pod(training_hash);
+    reader.read_pod(devel_hash);
+    reader.read_string(extract_signature);
+    reader.read_pod(fingerprint);
+    reader.read_pod(nr_shards);
+    if( training_hash != CorpusCacheUtils::hash_file(training_data_path) ||
+        devel_hash != CorpusCacheUtils::hash_file(devel_data_path) )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "- corpus cache is out of date with the training or devel data , ignore it .";
+        return false;
+    }
+    if( extract_signature != i1m->get_extract_signature() )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "- corpus cache is built with `" << extract_signature << "` , but now it is `"
+            << i1m->get_extract_signature() << "` , ignore it .";
+        return false;
+    }
+    reader.read_string(state_str);
+    FlatIndexSeqs tmp_sents,
+        tmp_tag_seqs,
+        tmp_dev_sents,
+        tmp_dev_tag_seqs;
+    CWSFeatureDataFlatSeqs tmp_cws_feature_seqs,
+        tmp_dev_cws_feature_seqs;
+    reader.read_flat_seqs(tmp_sents);
+    reader.read_flat_seqs(tmp_tag_seqs);
+    tmp_cws_feature_seqs.load_cache(reader);
+    reader.read_flat_seqs(tmp_dev_sents);
+    reader.read_flat_seqs(tmp_dev_tag_seqs);
+    tmp_dev_cws_feature_seqs.load_cache(reader);
+    // model state is changed only after the whole cache is read
+    std::istringstream state_iss(state_str);
+    i1m->load_corpus_state(state_iss);
+    swap(sents, tmp_sents);
+    swap(tag_seqs, tmp_tag_seqs);
+    swap(cws_feature_seqs, tmp_cws_feature_seqs);
+    swap(dev_sents, tmp_dev_sents);
+    swap(dev_tag_seqs, tmp_dev_tag_seqs);
+    swap(dev_cws_feature_seqs, tmp_dev_cws_feature_seqs);
+    nr_train_shards = nr_shards;
+    cached_training_hash = training_hash;
+    if( nr_train_shards > 0 )
+    {
+        BOOST_LOG_TRIVIAL(info) << "- load corpus cache done . training data is in " << nr_train_shards << " shards , "
+            << dev_sents.size() << " devel instances .";
+    }
+    else
+    {
+        BOOST_LOG_TRIVIAL(info) << "- load corpus cache done . " << sents.size() << " training instances and "
+            << dev_sents.size() << " devel instances .";
+    }
+    return true;
+}
+
+template <typename RNNDerived, typename I1Model>
+bool CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::load_devel_corpus_cache(std::istream &is,
+    const std::string &devel_data_path,
+    FlatIndexSeqs &dev_sents, CWSFeatureDataFlatSeqs &dev_cws_feature_seqs, FlatIndexSeqs &dev_tag_seqs)
+{
+    using std::swap;
+    assert(i1m->is_dict_frozen());
+    BOOST_LOG_TRIVIAL(info) << "+ load devel data from corpus cache .";
+    CorpusCacheReader reader(is);
+    uint64_t training_hash,
+        devel_hash,
+        fingerprint,
+        nr_shards;
+    std::string extract_signature,
+        state_str;
+    reader.read_pod(training_hash);
+    reader.read_pod(devel_hash);
+    reader.read_string(extract_signature);
+    reader.read_pod(fingerprint);
+    reader.read_pod(nr_shards);
+    if( devel_hash != CorpusCacheUtils::hash_file(devel_data_path) )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "- corpus cache is out of date with the devel data , ignore it .";
+        return false;
+    }
+    if( extract_signature != i1m->get_extract_signature() || fingerprint != i1m->get_corpus_state_fingerprint() )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "- corpus cache is not built with the dicts of this model , ignore it .";
+        return false;
+    }
+    reader.read_string(state_str); // training part is not needed
+    reader.skip_flat_seqs<Index>();
+    reader.skip_flat_seqs<Index>();
+    CWSFeatureDataFlatSeqs::skip_cache(reader);
+    FlatIndexSeqs tmp_dev_sents,
+        tmp_dev_tag_seqs;
+    CWSFeatureDataFlatSeqs tmp_dev_cws_feature_seqs;
+    reader.read_flat_seqs(tmp_dev_sents);
+    reader.read_flat_seqs(tmp_dev_tag_seqs);
+    tmp_dev_cws_feature_seqs.load_cache(reader);
+    swap(dev_sents, tmp_dev_sents);
+    swap(dev_tag_seqs, tmp_dev_tag_seqs);
+    swap(dev_cws_feature_seqs, tmp_dev_cws_feature_seqs);
+    BOOST_LOG_TRIVIAL(info) << "- load devel data done . " << dev_sents.size() << " instances .";
+    return true;
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::write_corpus_cache_head(CorpusCacheWriter &writer,
+    uint64_t training_hash, uint64_t devel_hash, unsigned nr_train_shards)
+{
+    std::ostringstream state_oss;
+    i1m->save_corpus_state(state_oss);
+    writer.write_pod(training_hash);
+    writer.write_pod(devel_hash);
+    writer.write_string(i1m->get_extract_signature());
+    writer.write_pod(i1m->get_corpus_state_fingerprint());
+    writer.write_pod(static_cast<uint64_t>(nr_train_shards));
+    writer.write_string(state_oss.str());
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::write_shard(const std::string &corpus_cache_path,
+    unsigned shard_idx, uint64_t training_hash,
+    const FlatIndexSeqs &sents, const CWSFeatureDataFlatSeqs &cws_feature_seqs, const FlatIndexSeqs &tag_seqs)
+{
+    std::string shard_path = CorpusCacheUtils::get_shard_path(corpus_cache_path, shard_idx);
+    std::ofstream os(shard_path, std::ios::binary);
+    if( !os ){ throw std::runtime_error("failed to open shard `" + shard_path + "` ."); }
+    CorpusCacheWriter writer(os);
+    writer.write_pod(training_hash);
+    writer.write_pod(static_cast<uint64_t>(shard_idx));
+    writer.write_flat_seqs(sents);
+    writer.write_flat_seqs(tag_seqs);
+    cws_feature_seqs.save_cache(writer);
+    BOOST_LOG_TRIVIAL(info) << "shard " << shard_idx << " with " << sents.size() << " instances has been written .";
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::load_shard(const std::string &corpus_cache_path,
+    unsigned shard_idx,
+    FlatIndexSeqs &sents, CWSFeatureDataFlatSeqs &cws_feature_seqs, FlatIndexSeqs &tag_seqs)
+{
+    std::string shard_path = CorpusCacheUtils::get_shard_path(corpus_cache_path, shard_idx);
+    std::ifstream is(shard_path, std::ios::binary);
+    if( !is ){ throw std::runtime_error("failed to open shard `" + shard_path + "` ."); }
+    CorpusCacheReader reader(is);
+    uint64_t training_hash,
+        stored_shard_idx;
+    reader.read_pod(training_hash);
+    reader.read_pod(stored_shard_idx);
+    if( training_hash != cached_training_hash || stored_shard_idx != shard_idx )
+    {
+        throw std::runtime_error("shard `" + shard_path + "` doesn't belong to the corpus cache .");
+    }
+    reader.read_flat_seqs(sents);
+    reader.read_flat_seqs(tag_seqs);
+    cws_feature_seqs.load_cache(reader);
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::write_sharded_corpus_cache(const std::string &corpus_cache_path,
+    const std::string &training_data_path, const std::string &devel_data_path,
+    unsigned shard_size)
+{
+    assert(!i1m->is_dict_frozen() && shard_size > 0);
+    uint64_t training_hash = CorpusCacheUtils::hash_file(training_data_path);
+    // 1. build dict and lexicon . the same ids as `read_training_data` (frequency order)
+    BOOST_LOG_TRIVIAL(info) << "+ build dict and lexicon from training data (streaming) .";
+    {
+        std::ifstream is(training_data_path);
+        if( !is ){ throw std::runtime_error("failed to open `" + training_data_path + "` ."); }
+        CWSReader reader(is);
+        DictWrapper &word_dict_wrapper = i1m->get_word_dict_wrapper();
+        Seq word_seq,
+            word_char_seq;
+        IndexSeq word_tag_seq;
+        while( reader.read_segmented_line(word_seq) )
+        {
+            if( word_seq.empty() ){ continue; }
+            i1m->count_word_frequency(word_seq);
+            for( const std::string &word : word_seq )
+            {
+                CWSTaggingSystem::static_parse_word2chars_indextag(word, word_char_seq, word_tag_seq);
+                for( const std::string &u8char : word_char_seq ){ word_dict_wrapper.Convert(u8char); }
+            }
+        }
+    }
+    i1m->build_lexicon();
+    IndexSeq old2new; // nothing indexed yet
+    i1m->freeze_dict_in_frequency_order(old2new);
+    // 2. index training data and write shards
+    BOOST_LOG_TRIVIAL(info) << "+ index training data to shards of " << shard_size << " instances .";
+    unsigned nr_shards = 0;
+    size_t nr_instances = 0;
+    {
+        std::ifstream is(training_data_path);
+        if( !is ){ throw std::runtime_error("failed to open `" + training_data_path + "` ."); }
+        CWSReader reader(is);
+        FlatIndexSeqs shard_sents,
+            shard_tag_seqs;
+        CWSFeatureDataFlatSeqs shard_cws_feature_seqs;
+        Seq word_seq;
+        IndexSeq char_seq, tag_seq;
+        CWSFeatureDataSeq cws_feature_seq;
+        while( reader.read_segmented_line(word_seq) )
+        {
+            if( word_seq.empty() ){ continue; }
+            i1m->word_seq2index_seq(word_seq, char_seq, tag_seq, cws_feature_seq);
+            shard_sents.push_back(char_seq);
+            shard_tag_seqs.push_back(tag_seq);
+            shard_cws_feature_seqs.push_back(cws_feature_seq);
+            ++nr_instances;
+            if( shard_sents.size() == shard_size )
+            {
+                write_shard(corpus_cache_path, nr_shards++, training_hash, shard_sents, shard_cws_feature_seqs, shard_tag_seqs);
+                shard_sents.clear();
+                shard_tag_seqs.clear();
+                shard_cws_feature_seqs = CWSFeatureDataFlatSeqs();
+            }
+        }
+        if( shard_sents.size() > 0 )
+        {
+            write_shard(corpus_cache_path, nr_shards++, training_hash, shard_sents, shard_cws_feature_seqs, shard_tag_seqs);
+        }
+    }
+    BOOST_LOG_TRIVIAL(info) << "- " << nr_instances << " training instances in " << nr_shards << " shards .";
+    // 3. devel data and the corpus cache itself (without training data)
+    std::ifstream devel_is(devel_data_path);
+    if( !devel_is ){ throw std::runtime_error("failed to open `" + devel_data_path + "` ."); }
+    FlatIndexSeqs dev_sents,
+        dev_tag_seqs;
+    CWSFeatureDataFlatSeqs dev_cws_feature_seqs;
+    read_devel_data(devel_is, dev_sents, dev_cws_feature_seqs, dev_tag_seqs);
+    std::ofstream os(corpus_cache_path, std::ios::binary);
+    if( !os ){ throw std::runtime_error("failed to open `" + corpus_cache_path + "` ."); }
+    CorpusCacheWriter writer(os);
+    write_corpus_cache_head(writer, training_hash, CorpusCacheUtils::hash_file(devel_data_path), nr_shards);
+    writer.write_flat_seqs(FlatIndexSeqs());
+    writer.write_flat_seqs(FlatIndexSeqs());
+    CWSFeatureDataFlatSeqs().save_cache(writer);
+    writer.write_flat_seqs(dev_sents);
+    writer.write_flat_seqs(dev_tag_seqs);
+    dev_cws_feature_seqs.save_cache(writer);
+    BOOST_LOG_TRIVIAL(info) << "- write corpus cache done .";
+}
+
+template <typename RNNDerived, typename I1Model>
+cnn::real CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train_one_sample(cnn::SimpleSGDTrainer &sgd,
+    const IndexSeq &sent, const CWSFeatureDataSeq &cws_feature_seq, const IndexSeq &tag_seq,
+    StageTimings &timings)
+{
+    using Stage = StageTimings::Stage;
+    // only one Computation Graph can exist at the same time , so devel also uses the recycled graph .
+    cnn::ComputationGraph &cg = graph_recycler.next_graph();
+    uint64_t stage_start = StageTimings::now_ns(),
+        stage_end;
+    i1m->replace_word_with_unk(sent, cws_feature_seq, replaced_sent, replaced_feature_data);
+    stage_end = StageTimings::now_ns();
+    timings.record(Stage::Extract, stage_end - stage_start);
+    stage_start = stage_end;
+    i1m->build_loss(cg, replaced_sent, replaced_feature_data, tag_seq);
+    stage_end = StageTimings::now_ns();
+    timings.record(Stage::GraphBuild, stage_end - stage_start);
+    stage_start = stage_end;
+    cnn::real loss = as_scalar(cg.forward());
+    stage_end = StageTimings::now_ns();
+    timings.record(Stage::Forward, stage_end - stage_start);
+    stage_start = stage_end;
+    cg.backward();
+    stage_end = StageTimings::now_ns();
+    timings.record(Stage::Backward, stage_end - stage_start);
+    stage_start = stage_end;
+    sgd.update(1.f);
+    timings.record(Stage::Update, StageTimings::now_ns() - stage_start);
+    graph_memory_profile.record(replaced_sent.size(), cg, true);
+    return loss;
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::report_graph_memory(const std::string &info_header)
+{
+    if( graph_memory_profile.empty() ){ return; }
+    size_t parameter_bytes = MemoryStat::model_parameter_bytes(*i1m->get_cnn_model());
+    BOOST_LOG_TRIVIAL(info) << graph_memory_profile.get_report_str(info_header)
+        << "\nparameters (values + gradients) : " << MemoryStat::format_bytes(parameter_bytes)
+        << (i1m->is_int8() ? " , int8 weights : " + MemoryStat::format_bytes(i1m->get_int8_memory_bytes()) : "");
+    // int8 weights are not in the cnn parameter pool
+    CnnMemPlanner::update_profile(mem_profile_path, graph_memory_profile, parameter_bytes);
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::log_corpus_memory(const std::string &corpus_name,
+    const FlatIndexSeqs &sents, const CWSFeatureDataFlatSeqs &cws_feature_seqs, const FlatIndexSeqs &tag_seqs)
+{
+    BOOST_LOG_TRIVIAL(info) << "memory of " << corpus_name << " corpus : "
+        << MemoryStat::format_bytes(sents.get_memory_bytes() + cws_feature_seqs.get_memory_bytes() + tag_seqs.get_memory_bytes())
+        << " (chars " << MemoryStat::format_bytes(sents.get_memory_bytes())
+        << " , features " << MemoryStat::format_bytes(cws_feature_seqs.get_memory_bytes())
+        << " , tags " << MemoryStat::format_bytes(tag_seqs.get_memory_bytes()) << ")";
+}
+
+template <typename RNNDerived, typename I1Model>
+void CWSInput1WithFeatureModelHandler<RNNDerived, I1Model>::train_from_shards(const std::string &corpus_cache_path,
+    unsigned nr_shards,
+    unsigned shuffle_buffer_size,
+    unsigned max_epoch,
+    const FlatIndexSeqs &dev_sents,
+    const CWSFeatureDataFlatSeqs &dev_cws_feature_seqs,
+    const FlatIndexSeqs &dev_tag_seqs,
+    unsigned do_devel_freq,
+    unsigned trivial_report_freq)
+{
+    // a sample in the shuffle buffer , slots are overwritten in place so their capacity is reused
+    struct BufferedSample
+    {
+        IndexSeq sent;
+        IndexSeq tag_seq;
+        CWSFeatureDataSeq cws_feature_seq;
+    };
+    shuffle_buffer_size = std::max(shuffle_buffer_size, 1U);
+    BOOST_LOG_TRIVIAL(info) << "+ Train from " << nr_shards << " shards with shuffle buffer of " << shuffle_buffer_size << " instances .";
+    BOOST_LOG_TRIVIAL(info) << "memory of dicts : " << MemoryStat::format_bytes(i1m->get_dict_memory_bytes());
+    log_corpus_memory("devel", dev_sents, dev_cws_feature_seqs, dev_tag_seqs);
+    std::vector<unsigned> shard_order(nr_shards);
+    for( unsigned i = 0; i < nr_shards; ++i ) shard_order[i] = i;
+    std::vector<BufferedSample> shuffle_buffer(shuffle_buffer_size);
+    FlatIndexSeqs shard_sents,
+        shard_tag_seqs;
+    CWSFeatureDataFlatSeqs shard_cws_feature_seqs;
+    std::vector<unsigned> access_order;
+    auto epoch_samples = [&](const SampleTrainer &train_sample)
+    {
+        shuffle(shard_order.begin(), shard_order.end(), *cnn::rndeng);
+        unsigned nr_buffered = 0;
+        bool is_stopped = false;
+        for( unsigned shard_cnt = 0; shard_cnt < nr_shards && !is_stopped; ++shard_cnt )
+        {
+            load_shard(corpus_cache_path, shard_order[shard_cnt], shard_sents, shard_cws_feature_seqs, shard_tag_seqs);
+            unsigned nr_shard_samples = shard_sents.size();
+            access_order.resize(nr_shard_samples);
+            for( unsigned i = 0; i < nr_shard_samples; ++i ) access_order[i] = i;
+            shuffle(access_order.begin(), access_order.end(), *cnn::rndeng);
+            for( unsigned i = 0; i < nr_shard_samples && !is_stopped; ++i )
+            {
+                // fill the buffer first , then train a random buffered sample and put the incoming one in its slot
+                unsigned slot = nr_buffered;
+                if( nr_buffered < shuffle_buffer_size ){ ++nr_buffered; }
+                else
+                {
+                    slot = std::uniform_int_distribution<unsigned>(0, shuffle_buffer_size - 1)(*cnn::rndeng);
+                    const BufferedSample &sample = shuffle_buffer[slot];
+                    is_stopped = !train_sample(sample.sent, sample.cws_feature_seq, sample.tag_seq);
+                }
+                BufferedSample &incoming = shuffle_buffer[slot];
+                shard_sents[access_order[i]].copy_to(incoming.sent);
+                shard_tag_seqs[access_order[i]].copy_to(incoming.tag_seq);
+                shard_cws_feature_seqs.get(access_order[i], incoming.cws_feature_seq);
+            }
+        }
+        // drain the buffer
+        shuffle(shuffle_buffer.begin(), shuffle_buffer.begin() + nr_buffered, *cnn::rndeng);
+        for( unsigned slot = 0; slot < nr_buffered && !is_stopped; ++slot )
+        {
+            const BufferedSample &sample = shuffle_buffer[slot];
+            is_stopped = !train_sample(sample.sent, sample.cws_feature_seq, sample.tag_seq);
+        }
+    };
+    train_epochs(epoch_samples, max_epoch, dev_sents, dev_cws_feature_seqs, dev_tag_seqs, do_devel_freq, trivial_report_freq);
 }
 
 } // end of namespace slnn
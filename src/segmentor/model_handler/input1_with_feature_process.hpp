@@ -0,0 +1,214 @@
+#ifndef SLNN_SEGMENTOR_INPUT1_WITH_FEATURE_PROCESS_HPP_
+#define SLNN_SEGMENTOR_INPUT1_WITH_FEATURE_PROCESS_HPP_
+
+#include <string>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/log/trivial.hpp>
+#include "cnn/cnn.h"
+#include "utils/general.hpp"
+#include "utils/memory_stat.hpp"
+#include "utils/flat_seqs.hpp"
+#include "segmentor/cws_module/cws_feature.h"
+
+namespace slnn{
+
+/**
+ * processes shared by the CWS input1-with-feature mains (`CWSInput1WithFeatureModelHandler` of any model) .
+ *
+ * `index` : parse the training and devel data once and write the corpus cache , or the sharded cache
+ * (training data streamed to shards) with `--shard_size` . training data may be parsed by several threads .
+ * `quantize` : load the float model , write it as an int8 model to `--output` , load the written model back ,
+ * and report the devel F1 and the resident parameter memory of both .
+ */
+template <typename ModelHandler>
+int run_index(int argc, char *argv[], const std::string &program_header, const std::string &program_name);
+
+template <typename ModelHandler>
+int run_quantize(int argc, char *argv[], const std::string &program_header, const std::string &program_name);
+
+/*************** inline implementation ***************/
+
+template <typename ModelHandler>
+int run_index(int argc, char *argv[], const std::string &program_header, const std::string &program_name)
+{
+    namespace po = boost::program_options;
+    std::string description = program_header + "\n"
+        "Index process . parse the training and devel data once , and write dicts and indexed data to a binary corpus cache ,\n"
+        "then `train` / `devel` with `--corpus_cache` load it instead of parsing the text .\n"
+        "using `" + program_name + " index [rnn-type] <options>` to index . index options are as following";
+    po::options_description op_des = po::options_description(description);
+    std::string training_data_path, devel_data_path, corpus_cache_path;
+    op_des.add_options()
+        ("training_data", po::value<std::string>(&training_data_path), "[required] The path to training data")
+        ("reading_threads", po::value<unsigned>()->default_value(1), "The number of threads to parse training data .")
+        ("shard_size", po::value<unsigned>()->default_value(0), "If > 0 , training data is streamed to shard files of `shard_size`"
+            " instances beside the corpus cache , for training data larger than memory .")
+        ("devel_data", po::value<std::string>(&devel_data_path), "[required] The path to developing data")
+        ("corpus_cache", po::value<std::string>(&corpus_cache_path), "[required] The path to write the corpus cache")
+        ("context_left_size", po::value<unsigned>()->default_value(1), "The left size for context feature (should be the same as training)")
+        ("context_right_size", po::value<unsigned>()->default_value(1), "The right size for context feature (should be the same as training)")
+        ("help,h", "Show help information.");
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).allow_unregistered().run(), var_map);
+    po::notify(var_map);
+    if (var_map.count("help"))
+    {
+        std::cerr << op_des << std::endl;
+        return 0;
+    }
+    varmap_key_fatal_check(var_map, "training_data", "Error : Training data should be specified !");
+    varmap_key_fatal_check(var_map, "devel_data", "Error : devel data should be specified !");
+    varmap_key_fatal_check(var_map, "corpus_cache", "Error : corpus cache path should be specified !");
+
+    // Init , the dict wrapper needs cnn random engine
+    const int CNNRandomSeed = 1234;
+    int cnn_argc;
+    std::shared_ptr<char *> cnn_argv;
+    build_cnn_parameters(program_name, 0, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+    ModelHandler model_handler;
+    model_handler.set_feature_param_for_indexing(var_map);
+
+    unsigned shard_size = var_map["shard_size"].as<unsigned>();
+    if( shard_size > 0 )
+    {
+        if( !FileUtils::exists(training_data_path) ) fatal_error("Error : failed to find training data at `" + training_data_path + "`");
+        if( !FileUtils::exists(devel_data_path) ) fatal_error("Error : failed to find devel data at `" + devel_data_path + "`");
+        model_handler.write_sharded_corpus_cache(corpus_cache_path, training_data_path, devel_data_path, shard_size);
+        return 0;
+    }
+    std::ofstream cache_os(corpus_cache_path, std::ios::binary);
+    if( !cache_os ) fatal_error("failed to open corpus cache path at '" + corpus_cache_path + "'") ;
+
+    FlatIndexSeqs sents ,
+        tag_seqs;
+    CWSFeatureDataFlatSeqs feature_seqs;
+    unsigned reading_threads = var_map["reading_threads"].as<unsigned>();
+    if( reading_threads > 1 )
+    {
+        if( !FileUtils::exists(training_data_path) ) fatal_error("Error : failed to find training data at `" + training_data_path + "`");
+        model_handler.read_training_data_parallel(training_data_path, reading_threads, sents, feature_seqs, tag_seqs);
+    }
+    else
+    {
+        std::ifstream train_is(training_data_path);
+        if( !train_is ) fatal_error("Error : failed to open training: `" + training_data_path + "` .");
+        model_handler.read_training_data(train_is, sents ,feature_seqs, tag_seqs);
+        train_is.close();
+    }
+
+    std::ifstream devel_is(devel_data_path);
+    if( !devel_is ) fatal_error("Error : failed to open devel file: `" + devel_data_path + "`");
+    FlatIndexSeqs dev_sents, dev_tag_seqs ;
+    CWSFeatureDataFlatSeqs dev_feature_seqs ;
+    model_handler.read_devel_data(devel_is, dev_sents , dev_feature_seqs, dev_tag_seqs);
+    devel_is.close();
+
+    model_handler.write_corpus_cache(cache_os, training_data_path, devel_data_path,
+        sents, feature_seqs, tag_seqs, dev_sents, dev_feature_seqs, dev_tag_seqs);
+    cache_os.close();
+    return 0;
+}
+
+template <typename ModelHandler>
+int run_quantize(int argc, char *argv[], const std::string &program_header, const std::string &program_name)
+{
+    namespace po = boost::program_options;
+    std::string description = program_header + "\n"
+        "Quantize process . write an int8 model : weights of the dense / merge / MLP layers are stored as per-row int8 ,\n"
+        "embeddings , biases and the RNN parameters (owned by the RNN builders) stay float . `devel` / `predict` / `serve`\n"
+        "decode an int8 model with the int8 weights . the devel F1 and the resident parameter memory of both models are reported .\n"
+        "using `" + program_name + " quantize [rnn-type] <options>` to quantize . quantize options are as following";
+    po::options_description op_des = po::options_description(description);
+    // set params to receive the arguments
+    std::string devel_data_path, model_path, output_path ;
+    op_des.add_options()
+        ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("devel_data", po::value<std::string>(&devel_data_path), "The path to validation data .")
+        ("corpus_cache", po::value<std::string>(), "The path to corpus cache built by `index` with the model's training data .")
+        ("model", po::value<std::string>(&model_path), "Use to specify the model name(path)")
+        ("output", po::value<std::string>(&output_path), "The path to write the int8 model .")
+        ("help,h", "Show help information.");
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).allow_unregistered().run(), var_map);
+    po::notify(var_map);
+    if (var_map.count("help"))
+    {
+        std::cerr << op_des << std::endl;
+        return 0;
+    }
+
+    varmap_key_fatal_check(var_map, "devel_data", "Error : validation(develop) data should be specified !");
+    varmap_key_fatal_check(var_map, "model", "Error : model path should be specified !");
+    varmap_key_fatal_check(var_map, "output", "Error : int8 model path should be specified !");
+    if( !FileUtils::exists(devel_data_path) ) fatal_error("Error : failed to find devel data at `" + devel_data_path + "`") ;
+
+    // Init
+    const int CNNRandomSeed = 1234;
+    int cnn_argc;
+    std::shared_ptr<char *> cnn_argv;
+    unsigned cnn_mem = 0 ;
+    if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+    ModelHandler model_handler;
+    // Load model
+    std::ifstream model_is(model_path);
+    if (!model_is)
+    {
+        fatal_error("Error : failed to open model path at '" + model_path + "' .");
+    }
+    model_handler.load_model(model_is);
+    model_is.close();
+
+    // read devel data
+    FlatIndexSeqs sents,
+        tag_seqs ;
+    CWSFeatureDataFlatSeqs feature_seqs;
+    bool is_cache_loaded = false;
+    if( var_map.count("corpus_cache") != 0 )
+    {
+        std::string corpus_cache_path = var_map["corpus_cache"].as<std::string>();
+        std::ifstream cache_is(corpus_cache_path, std::ios::binary);
+        if( !cache_is ){ BOOST_LOG_TRIVIAL(warning) << "failed to open corpus cache `" << corpus_cache_path << "` , parse the text data ."; }
+        else{ is_cache_loaded = model_handler.load_devel_corpus_cache(cache_is, devel_data_path, sents, feature_seqs, tag_seqs); }
+    }
+    if( !is_cache_loaded )
+    {
+        std::ifstream devel_is(devel_data_path) ;
+        if( !devel_is ) fatal_error("Error : failed to open devel data at `" + devel_data_path + "`") ;
+        model_handler.read_devel_data(devel_is, sents, feature_seqs, tag_seqs);
+        devel_is.close();
+    }
+
+    // float baseline
+    float float_F1 = model_handler.devel(sents, feature_seqs, tag_seqs);
+    std::ofstream int8_os(output_path);
+    if( !int8_os ){ fatal_error("Error : failed to open int8 model path at '" + output_path + "' ."); }
+    model_handler.save_int8_model(int8_os);
+    int8_os.close();
+    model_handler.release_graph(); // cnn permits one graph at a time
+
+    // evaluate the written int8 model
+    ModelHandler int8_model_handler;
+    std::ifstream int8_is(output_path);
+    if( !int8_is ){ fatal_error("Error : failed to open int8 model path at '" + output_path + "' ."); }
+    int8_model_handler.load_model(int8_is);
+    int8_is.close();
+    float int8_F1 = int8_model_handler.devel(sents, feature_seqs, tag_seqs);
+    BOOST_LOG_TRIVIAL(info) << "resident parameters : float model " << MemoryStat::format_bytes(model_handler.get_parameter_memory_bytes())
+        << " -> int8 model " << MemoryStat::format_bytes(int8_model_handler.get_parameter_memory_bytes());
+    BOOST_LOG_TRIVIAL(info) << "devel F1 : float " << float_F1 << " , int8 " << int8_F1
+        << " , delta " << (int8_F1 - float_F1);
+
+    return 0;
+}
+
+} // end of namespace slnn
+
+#endif
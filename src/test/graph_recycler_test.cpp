@@ -0,0 +1,286 @@
+/**
+ * a recycled graph should compute exactly what fresh graphs compute .
+ * two different sentences are trained (loss -> backward -> update between them) and predicted ,
+ * once on the graph of a `GraphRecycler` and once on a new graph for every sentence , starting from the same parameters .
+ * losses , gradients of the second sentence (after the update) and predictions should be equal .
+ * the features are looked up by `MultiLookupConcat` , whose nodes are registered as parameter nodes ,
+ * so the trimming of `parameter_nodes` at recycling is covered (stale nodes would accumulate wrong gradients) .
+ */
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "cnn/cnn.h"
+#include "cnn/lstm.h"
+#include "cnn/training.h"
+#include "utils/general.hpp"
+#include "utils/typedeclaration.h"
+#include "modelmodule/layers.h"
+#include "modelmodule/hyper_layers.h"
+#include "modelmodule/hyper_output_layers.h"
+#include "modelmodule/graph_recycler.h"
+#include "modelmodule/multi_lookup_concat.h"
+
+using namespace std;
+using namespace slnn;
+
+namespace {
+
+const int CNNRandomSeed = 1234;
+const unsigned WordDim = 8,
+    FeatureTableSize = 10,
+    FeatureSlotDim = 2,
+    NrFeatureSlots = 2,
+    FeatureDim = FeatureSlotDim * NrFeatureSlots,
+    RNNHiddenDim = 8,
+    TagEmbeddingDim = 4,
+    OutputHiddenDim = 8,
+    TagNum = 4;
+const cnn::real Epsilon = 1e-6f;
+
+struct Sentence
+{
+    vector<vector<float>> word_values;
+    vector<IndexSeq> feature_indices; // `NrFeatureSlots` indices for every position
+    IndexSeq gold_seq;
+};
+
+/**
+ * what one run observes .
+ */
+struct RunResult
+{
+    vector<cnn::real> losses;
+    vector<cnn::real> grads;
+    vector<IndexSeq> pred_seqs;
+};
+
+/**
+ * the layers of a model , on a recycled graph or on a new graph for every sentence .
+ */
+struct SentencePath
+{
+    SentencePath()
+        :birnn_layer(&m, 1, WordDim + FeatureDim, RNNHiddenDim),
+        crf_layer(&m, TagEmbeddingDim, RNNHiddenDim, RNNHiddenDim, OutputHiddenDim, TagNum, 0.f),
+        is_recycling(true)
+    {
+        for( unsigned k = 0; k < NrFeatureSlots; ++k )
+        {
+            feature_tables.push_back(m.add_lookup_parameters(FeatureTableSize, { FeatureSlotDim }));
+        }
+    }
+
+    cnn::ComputationGraph& build(const Sentence &sentence)
+    {
+        cnn::ComputationGraph *pcg = nullptr;
+        if( is_recycling ){ pcg = &graph_recycler.next_graph(); }
+        else
+        {
+            fresh_graph.reset(); // only one graph at the same time
+            fresh_graph.reset(new cnn::ComputationGraph());
+            pcg = fresh_graph.get();
+        }
+        cnn::ComputationGraph &cg = *pcg;
+        GraphRecycler *recycler = is_recycling ? &graph_recycler : nullptr;
+        if( GraphRecycler::need_new_graph(recycler, cg) )
+        {
+            birnn_layer.new_graph(cg);
+            crf_layer.new_graph(cg);
+            GraphRecycler::mark_persistent(recycler, cg);
+        }
+        birnn_layer.start_new_sequence();
+        size_t len = sentence.word_values.size();
+        expr_buffers.word_exprs.resize(len);
+        expr_buffers.feature_exprs.resize(len);
+        for( size_t i = 0; i < len; ++i )
+        {
+            expr_buffers.word_exprs[i] = cnn::expr::input(cg, { WordDim }, sentence.word_values[i]);
+            expr_buffers.feature_exprs[i] = MultiLookupConcat::build(cg, feature_tables, sentence.feature_indices[i].data());
+        }
+        expr_buffers.expr_groups.assign({ &expr_buffers.word_exprs, &expr_buffers.feature_exprs });
+        StaticConcatenateLayer::concatenate_exprs(expr_buffers.expr_groups, expr_buffers.input_exprs, expr_buffers.concat_parts);
+        birnn_layer.build_graph(expr_buffers.input_exprs, expr_buffers.l2r_exprs, expr_buffers.r2l_exprs);
+        return cg;
+    }
+
+    cnn::real train(const Sentence &sentence)
+    {
+        cnn::ComputationGraph &cg = build(sentence);
+        crf_layer.build_output_loss(expr_buffers.l2r_exprs, expr_buffers.r2l_exprs, sentence.gold_seq);
+        cnn::real loss = cnn::as_scalar(cg.forward());
+        cg.backward();
+        return loss;
+    }
+
+    void predict(const Sentence &sentence, IndexSeq &pred_seq)
+    {
+        build(sentence);
+        crf_layer.build_output(expr_buffers.l2r_exprs, expr_buffers.r2l_exprs, pred_seq);
+    }
+
+    void release_graph()
+    {
+        graph_recycler.release();
+        fresh_graph.reset();
+    }
+
+    cnn::Model m;
+    BILSTMLayer birnn_layer;
+    CRFOutput crf_layer;
+    vector<cnn::LookupParameters*> feature_tables;
+    SentenceExprBuffers expr_buffers;
+    GraphRecycler graph_recycler;
+    unique_ptr<cnn::ComputationGraph> fresh_graph;
+    bool is_recycling;
+};
+
+/**
+ * parameter values , to start every run from the same parameters .
+ */
+struct ParameterSnapshot
+{
+    void save(const cnn::Model &m)
+    {
+        values.clear();
+        for( const cnn::Parameters *param : m.parameters_list() ){ append(param->values); }
+        for( const cnn::LookupParameters *lookup_param : m.lookup_parameters_list() )
+        {
+            for( const cnn::Tensor &row : lookup_param->values ){ append(row); }
+        }
+    }
+
+    void restore(cnn::Model &m) const
+    {
+        size_t offset = 0;
+        for( cnn::Parameters *param : m.parameters_list() )
+        {
+            offset = copy_to(param->values, offset);
+            param->clear();
+        }
+        for( cnn::LookupParameters *lookup_param : m.lookup_parameters_list() )
+        {
+            for( cnn::Tensor &row : lookup_param->values ){ offset = copy_to(row, offset); }
+            lookup_param->clear();
+        }
+    }
+
+    void append(const cnn::Tensor &t)
+    {
+        values.insert(values.end(), t.v, t.v + t.d.size());
+    }
+
+    size_t copy_to(cnn::Tensor &t, size_t offset) const
+    {
+        memcpy(t.v, &values[offset], sizeof(cnn::real) * t.d.size());
+        return offset + t.d.size();
+    }
+
+    vector<cnn::real> values;
+};
+
+// all gradients , including every row of the lookup parameters
+void append_grads(const cnn::Model &m, vector<cnn::real> &grads)
+{
+    for( const cnn::Parameters *param : m.parameters_list() )
+    {
+        grads.insert(grads.end(), param->g.v, param->g.v + param->g.d.size());
+    }
+    for( const cnn::LookupParameters *lookup_param : m.lookup_parameters_list() )
+    {
+        for( const cnn::Tensor &row : lookup_param->grads ){ grads.insert(grads.end(), row.v, row.v + row.d.size()); }
+    }
+}
+
+Sentence build_sentence(unsigned len, float offset, unsigned seed)
+{
+    Sentence sentence;
+    sentence.word_values.assign(len, vector<float>(WordDim));
+    sentence.feature_indices.assign(len, IndexSeq(NrFeatureSlots));
+    sentence.gold_seq.resize(len);
+    for( unsigned i = 0; i < len; ++i )
+    {
+        for( unsigned j = 0; j < WordDim; ++j )
+        {
+            sentence.word_values[i][j] = offset + 0.01f * static_cast<float>((i * WordDim + j + seed) % 17);
+        }
+        for( unsigned k = 0; k < NrFeatureSlots; ++k )
+        {
+            sentence.feature_indices[i][k] = static_cast<Index>((i * (k + 2) + seed) % FeatureTableSize);
+        }
+        sentence.gold_seq[i] = static_cast<Index>((i + seed) % TagNum);
+    }
+    // an empty feature slot (zeroes , no gradient)
+    sentence.feature_indices[len / 2][0] = -1;
+    return sentence;
+}
+
+RunResult run(SentencePath &sentence_path, const vector<Sentence> &sentences, bool is_recycling)
+{
+    sentence_path.is_recycling = is_recycling;
+    cnn::SimpleSGDTrainer sgd(&sentence_path.m);
+    RunResult result;
+    for( size_t i = 0; i < sentences.size(); ++i )
+    {
+        result.losses.push_back(sentence_path.train(sentences[i]));
+        if( i + 1 < sentences.size() ){ sgd.update(1.0); }
+    }
+    append_grads(sentence_path.m, result.grads);
+    result.pred_seqs.resize(sentences.size());
+    for( size_t i = 0; i < sentences.size(); ++i ){ sentence_path.predict(sentences[i], result.pred_seqs[i]); }
+    sentence_path.release_graph();
+    return result;
+}
+
+bool is_close(const vector<cnn::real> &lhs, const vector<cnn::real> &rhs, const string &name)
+{
+    if( lhs.size() != rhs.size() )
+    {
+        cout << name << " : size " << lhs.size() << " vs " << rhs.size() << endl;
+        return false;
+    }
+    for( size_t i = 0; i < lhs.size(); ++i )
+    {
+        if( std::fabs(lhs[i] - rhs[i]) > Epsilon * std::max<cnn::real>(1.f, std::fabs(rhs[i])) )
+        {
+            cout << name << " [" << i << "] : " << lhs[i] << " vs " << rhs[i] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    int cnn_argc;
+    shared_ptr<char *> cnn_argv;
+    build_cnn_parameters(argv[0], 64, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+
+    SentencePath sentence_path;
+    // different lengths , so the recycled graph has a different number of nodes for the second sentence
+    vector<Sentence> sentences = { build_sentence(12, -0.1f, 0), build_sentence(7, 0.1f, 5) };
+    ParameterSnapshot snapshot;
+    snapshot.save(sentence_path.m);
+    RunResult recycled_result = run(sentence_path, sentences, true);
+    snapshot.restore(sentence_path.m);
+    RunResult fresh_result = run(sentence_path, sentences, false);
+
+    int ret_status = 0;
+    if( !is_close(recycled_result.losses, fresh_result.losses, "loss") ){ ret_status = 1; }
+    if( !is_close(recycled_result.grads, fresh_result.grads, "gradient") ){ ret_status = 1; }
+    if( recycled_result.pred_seqs != fresh_result.pred_seqs )
+    {
+        cout << "predictions differ" << endl;
+        ret_status = 1;
+    }
+    cout << "recycled graph vs fresh graphs : " << (ret_status == 0 ? "equal" : "different") << endl;
+    return ret_status;
+}
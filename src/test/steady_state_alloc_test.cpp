@@ -0,0 +1,202 @@
+/**
+ * a repeated sentence should not allocate outside cnn .
+ * the sentence path (inputs -> concatenation -> BiLSTM -> CRF loss / viterbi decoding) is run on a recycled graph ,
+ * the first sentence grows the layers' buffers , then the `operator new` calls of the second identical sentence are counted .
+ * an allocation is cnn's (node objects , argument lists , forward scratch ...) if a `cnn::` function is on its call stack ,
+ * those are skipped , everything else is a buffer the layers failed to reuse .
+ */
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <execinfo.h>
+#include <dlfcn.h>
+
+#include "cnn/cnn.h"
+#include "cnn/lstm.h"
+#include "utils/general.hpp"
+#include "utils/typedeclaration.h"
+#include "modelmodule/layers.h"
+#include "modelmodule/hyper_layers.h"
+#include "modelmodule/hyper_output_layers.h"
+#include "modelmodule/graph_recycler.h"
+
+using namespace std;
+using namespace slnn;
+
+namespace {
+
+bool is_counting = false;
+bool is_in_hook = false; // `backtrace` may allocate
+size_t nr_allocations = 0;
+
+// mangled names of functions in namespace cnn , `cnn::f` or `cnn::C::f() const`
+bool is_cnn_symbol(const char *symbol)
+{
+    return symbol != nullptr && ( strncmp(symbol, "_ZN3cnn", 7) == 0 || strncmp(symbol, "_ZNK3cnn", 8) == 0 );
+}
+
+bool is_cnn_allocation()
+{
+    const int MaxDepth = 128;
+    void *frames[MaxDepth];
+    int depth = backtrace(frames, MaxDepth);
+    for( int i = 0; i < depth; ++i )
+    {
+        Dl_info info;
+        if( dladdr(frames[i], &info) != 0 && is_cnn_symbol(info.dli_sname) ){ return true; }
+    }
+    return false;
+}
+
+void count_allocation()
+{
+    if( !is_counting || is_in_hook ){ return; }
+    is_in_hook = true;
+    if( !is_cnn_allocation() ){ ++nr_allocations; }
+    is_in_hook = false;
+}
+
+const int CNNRandomSeed = 1234;
+const unsigned SentenceLen = 20,
+    WordDim = 8,
+    FeatureDim = 4,
+    RNNHiddenDim = 8,
+    TagEmbeddingDim = 4,
+    OutputHiddenDim = 8,
+    TagNum = 4;
+
+/**
+ * the layers and the buffers a model keeps for a worker .
+ */
+struct SentencePath
+{
+    SentencePath()
+        :birnn_layer(&m, 1, WordDim + FeatureDim, RNNHiddenDim),
+        crf_layer(&m, TagEmbeddingDim, RNNHiddenDim, RNNHiddenDim, OutputHiddenDim, TagNum, 0.f)
+    {}
+
+    cnn::ComputationGraph& build(const vector<vector<float>> &word_values, const vector<vector<float>> &feature_values)
+    {
+        cnn::ComputationGraph &cg = graph_recycler.next_graph();
+        if( GraphRecycler::need_new_graph(&graph_recycler, cg) )
+        {
+            birnn_layer.new_graph(cg);
+            crf_layer.new_graph(cg);
+            GraphRecycler::mark_persistent(&graph_recycler, cg);
+        }
+        birnn_layer.start_new_sequence();
+        // `cnn::expr::input` keeps a pointer to the values , so values should outlive the graph
+        build_input_exprs(cg, word_values, expr_buffers.word_exprs);
+        build_input_exprs(cg, feature_values, expr_buffers.feature_exprs);
+        expr_buffers.expr_groups.assign({ &expr_buffers.word_exprs, &expr_buffers.feature_exprs });
+        StaticConcatenateLayer::concatenate_exprs(expr_buffers.expr_groups, expr_buffers.input_exprs, expr_buffers.concat_parts);
+        birnn_layer.build_graph(expr_buffers.input_exprs, expr_buffers.l2r_exprs, expr_buffers.r2l_exprs);
+        return cg;
+    }
+
+    cnn::real loss(const vector<vector<float>> &word_values, const vector<vector<float>> &feature_values, const IndexSeq &gold_seq)
+    {
+        cnn::ComputationGraph &cg = build(word_values, feature_values);
+        crf_layer.build_output_loss(expr_buffers.l2r_exprs, expr_buffers.r2l_exprs, gold_seq);
+        return cnn::as_scalar(cg.forward());
+    }
+
+    void predict(const vector<vector<float>> &word_values, const vector<vector<float>> &feature_values, IndexSeq &pred_seq)
+    {
+        build(word_values, feature_values);
+        crf_layer.build_output(expr_buffers.l2r_exprs, expr_buffers.r2l_exprs, pred_seq);
+    }
+
+    static void build_input_exprs(cnn::ComputationGraph &cg, const vector<vector<float>> &values,
+        vector<cnn::expr::Expression> &exprs)
+    {
+        exprs.resize(values.size());
+        for( size_t i = 0; i < values.size(); ++i )
+        {
+            exprs[i] = cnn::expr::input(cg, { static_cast<unsigned>(values[i].size()) }, values[i]);
+        }
+    }
+
+    cnn::Model m;
+    BILSTMLayer birnn_layer;
+    CRFOutput crf_layer;
+    SentenceExprBuffers expr_buffers;
+    GraphRecycler graph_recycler;
+};
+
+vector<vector<float>> fixed_values(unsigned len, unsigned dim, float offset)
+{
+    vector<vector<float>> values(len, vector<float>(dim));
+    for( unsigned i = 0; i < len; ++i )
+    {
+        for( unsigned j = 0; j < dim; ++j ){ values[i][j] = offset + 0.01f * static_cast<float>((i * dim + j) % 17); }
+    }
+    return values;
+}
+
+} // end of anonymous namespace
+
+void* operator new(size_t size)
+{
+    count_allocation();
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if( ptr == nullptr ){ throw std::bad_alloc(); }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+int main(int argc, char *argv[])
+{
+    int cnn_argc;
+    shared_ptr<char *> cnn_argv;
+    build_cnn_parameters(argv[0], 64, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+    is_cnn_allocation(); // loads the unwinder before counting
+
+    SentencePath sentence_path;
+    vector<vector<float>> word_values = fixed_values(SentenceLen, WordDim, -0.1f),
+        feature_values = fixed_values(SentenceLen, FeatureDim, 0.1f);
+    IndexSeq gold_seq(SentenceLen);
+    for( unsigned i = 0; i < SentenceLen; ++i ){ gold_seq[i] = i % TagNum; }
+    IndexSeq pred_seq;
+
+    // the first sentence grows the buffers
+    sentence_path.loss(word_values, feature_values, gold_seq);
+    sentence_path.predict(word_values, feature_values, pred_seq);
+
+    int ret_status = 0;
+    is_counting = true;
+    nr_allocations = 0;
+    sentence_path.loss(word_values, feature_values, gold_seq);
+    is_counting = false;
+    cout << "allocations outside cnn of the repeated loss sentence : " << nr_allocations << endl;
+    if( nr_allocations != 0 ){ ret_status = 1; }
+
+    is_counting = true;
+    nr_allocations = 0;
+    sentence_path.predict(word_values, feature_values, pred_seq);
+    is_counting = false;
+    cout << "allocations outside cnn of the repeated predict sentence : " << nr_allocations << endl;
+    if( nr_allocations != 0 ){ ret_status = 1; }
+    return ret_status;
+}
@@ -0,0 +1,81 @@
+#ifndef SLNN_UTILS_BOUNDED_QUEUE_HPP_
+#define SLNN_UTILS_BOUNDED_QUEUE_HPP_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+namespace slnn{
+
+/**
+ * blocking FIFO with a capacity , to connect the threads of a pipeline .
+ * `push` blocks while full , `pop` blocks while empty . after `close` , `push` fails and
+ * `pop` fails once the remaining items are drained .
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) :capacity(capacity > 0 ? capacity : 1), is_closed(false){}
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // false if closed (item is not queued)
+    bool push(T item);
+    // false if closed and drained
+    bool pop(T &item);
+    void close();
+private:
+    size_t capacity;
+    bool is_closed;
+    std::deque<T> items;
+    std::mutex mtx;
+    std::condition_variable not_full_cv,
+        not_empty_cv;
+};
+
+/*************** inline implementation ***************/
+
+template <typename T>
+inline
+bool BoundedQueue<T>::push(T item)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    not_full_cv.wait(lock, [this]{ return is_closed || items.size() < capacity; });
+    if( is_closed ){ return false; }
+    items.push_back(std::move(item));
+    lock.unlock();
+    not_empty_cv.notify_one();
+    return true;
+}
+
+template <typename T>
+inline
+bool BoundedQueue<T>::pop(T &item)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    not_empty_cv.wait(lock, [this]{ return is_closed || !items.empty(); });
+    if( items.empty() ){ return false; }
+    item = std::move(items.front());
+    items.pop_front();
+    lock.unlock();
+    not_full_cv.notify_one();
+    return true;
+}
+
+template <typename T>
+inline
+void BoundedQueue<T>::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        is_closed = true;
+    }
+    not_full_cv.notify_all();
+    not_empty_cv.notify_all();
+}
+
+} // end of namespace slnn
+
+#endif
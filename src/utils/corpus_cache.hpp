@@ -0,0 +1,255 @@
+#ifndef SLNN_UTILS_CORPUS_CACHE_HPP_
+#define SLNN_UTILS_CORPUS_CACHE_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include "flat_seqs.hpp"
+
+namespace slnn{
+
+/**
+ * binary corpus cache I/O .
+ * a cache is the magic header followed by sections , every section starts at an 8-bytes aligned position :
+ *   POD value ,
+ *   string : uint64 length + bytes ,
+ *   `FlatSeqs<T>` : uint64 nr_seqs + uint64 nr_items + raw uint64 offsets + raw items .
+ * raw arrays are stored in native byte order and layout , so the file can be mapped directly ,
+ * and a cache is only valid on the platform which builds it .
+ * T of `FlatSeqs<T>` should be a plain struct (no pointer inside) .
+ */
+struct CorpusCacheUtils
+{
+    static constexpr uint64_t FNVOffset = 14695981039346656037ULL;
+    static constexpr uint64_t FNVPrime = 1099511628211ULL;
+    static constexpr size_t Alignment = 8;
+
+    // FNV-1a , `seed` is used to chain several pieces
+    static uint64_t hash_bytes(const char *data, size_t len, uint64_t seed = FNVOffset);
+    static uint64_t hash_string(const std::string &str, uint64_t seed = FNVOffset){ return hash_bytes(str.data(), str.size(), seed); }
+    // hash of the file content and size , throw if the file can't be opened
+    static uint64_t hash_file(const std::string &path);
+    // training data shards are stored beside the corpus cache
+    static std::string get_shard_path(const std::string &corpus_cache_path, unsigned shard_idx)
+    {
+        return corpus_cache_path + ".shard" + std::to_string(shard_idx);
+    }
+};
+
+class CorpusCacheWriter
+{
+public:
+    explicit CorpusCacheWriter(std::ostream &os);
+    template <typename T>
+    void write_pod(const T &val);
+    void write_string(const std::string &str);
+    template <typename T>
+    void write_flat_seqs(const FlatSeqs<T> &seqs);
+private:
+    void write_raw(const char *data, size_t len);
+    void align();
+    std::ostream &os;
+    uint64_t pos;
+};
+
+class CorpusCacheReader
+{
+public:
+    // throw if the magic header doesn't match
+    explicit CorpusCacheReader(std::istream &is);
+    template <typename T>
+    void read_pod(T &val);
+    void read_string(std::string &str);
+    template <typename T>
+    void read_flat_seqs(FlatSeqs<T> &seqs);
+    template <typename T>
+    void skip_flat_seqs();
+private:
+    void read_raw(char *data, size_t len);
+    void skip(uint64_t len);
+    void align();
+    std::istream &is;
+    uint64_t pos;
+};
+
+/*************** inline implementation ***************/
+
+namespace corpus_cache_inner{
+const char Magic[8] = { 'S', 'L', 'N', 'N', 'C', 'C', '0', '2' };
+} // end of namespace corpus_cache_inner
+
+inline
+uint64_t CorpusCacheUtils::hash_bytes(const char *data, size_t len, uint64_t seed)
+{
+    uint64_t h = seed;
+    for( size_t i = 0; i < len; ++i )
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= FNVPrime;
+    }
+    return h;
+}
+
+inline
+uint64_t CorpusCacheUtils::hash_file(const std::string &path)
+{
+    std::ifstream is(path, std::ios::binary);
+    if( !is ){ throw std::runtime_error("failed to open `" + path + "` for hashing ."); }
+    std::vector<char> buf(1 << 16);
+    uint64_t h = FNVOffset,
+        file_size = 0;
+    while( is )
+    {
+        is.read(buf.data(), buf.size());
+        std::streamsize nr_read = is.gcount();
+        h = hash_bytes(buf.data(), static_cast<size_t>(nr_read), h);
+        file_size += nr_read;
+    }
+    return hash_bytes(reinterpret_cast<const char*>(&file_size), sizeof(file_size), h);
+}
+
+inline
+CorpusCacheWriter::CorpusCacheWriter(std::ostream &os)
+    :os(os), pos(0)
+{
+    write_raw(corpus_cache_inner::Magic, sizeof(corpus_cache_inner::Magic));
+}
+
+inline
+void CorpusCacheWriter::write_raw(const char *data, size_t len)
+{
+    os.write(data, len);
+    if( !os ){ throw std::runtime_error("failed to write corpus cache ."); }
+    pos += len;
+}
+
+inline
+void CorpusCacheWriter::align()
+{
+    static const char Padding[CorpusCacheUtils::Alignment] = { 0 };
+    size_t remain = pos % CorpusCacheUtils::Alignment;
+    if( remain != 0 ){ write_raw(Padding, CorpusCacheUtils::Alignment - remain); }
+}
+
+template <typename T>
+inline
+void CorpusCacheWriter::write_pod(const T &val)
+{
+    align();
+    write_raw(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+inline
+void CorpusCacheWriter::write_string(const std::string &str)
+{
+    write_pod(static_cast<uint64_t>(str.size()));
+    write_raw(str.data(), str.size());
+}
+
+template <typename T>
+inline
+void CorpusCacheWriter::write_flat_seqs(const FlatSeqs<T> &seqs)
+{
+    write_pod(static_cast<uint64_t>(seqs.size()));
+    write_pod(static_cast<uint64_t>(seqs.total_items()));
+    align();
+    for( size_t offset : seqs.get_offsets() )
+    {
+        uint64_t val = offset;
+        write_raw(reinterpret_cast<const char*>(&val), sizeof(val));
+    }
+    align();
+    write_raw(reinterpret_cast<const char*>(seqs.get_items().data()), seqs.total_items() * sizeof(T));
+}
+
+inline
+CorpusCacheReader::CorpusCacheReader(std::istream &is)
+    :is(is), pos(0)
+{
+    char magic[sizeof(corpus_cache_inner::Magic)];
+    read_raw(magic, sizeof(magic));
+    if( std::memcmp(magic, corpus_cache_inner::Magic, sizeof(magic)) != 0 )
+    {
+        throw std::runtime_error("not a corpus cache , or built by an incompatible version .");
+    }
+}
+
+inline
+void CorpusCacheReader::read_raw(char *data, size_t len)
+{
+    is.read(data, len);
+    if( !is ){ throw std::runtime_error("corpus cache is truncated or broken ."); }
+    pos += len;
+}
+
+inline
+void CorpusCacheReader::skip(uint64_t len)
+{
+    is.seekg(len, std::ios::cur);
+    if( !is ){ throw std::runtime_error("corpus cache is truncated or broken ."); }
+    pos += len;
+}
+
+inline
+void CorpusCacheReader::align()
+{
+    size_t remain = pos % CorpusCacheUtils::Alignment;
+    if( remain != 0 ){ skip(CorpusCacheUtils::Alignment - remain); }
+}
+
+template <typename T>
+inline
+void CorpusCacheReader::read_pod(T &val)
+{
+    align();
+    read_raw(reinterpret_cast<char*>(&val), sizeof(T));
+}
+
+inline
+void CorpusCacheReader::read_string(std::string &str)
+{
+    uint64_t len;
+    read_pod(len);
+    str.resize(len);
+    if( len > 0 ){ read_raw(&str[0], len); }
+}
+
+template <typename T>
+inline
+void CorpusCacheReader::read_flat_seqs(FlatSeqs<T> &seqs)
+{
+    uint64_t nr_seqs,
+        nr_items;
+    read_pod(nr_seqs);
+    read_pod(nr_items);
+    align();
+    std::vector<uint64_t> raw_offsets(nr_seqs + 1);
+    read_raw(reinterpret_cast<char*>(raw_offsets.data()), raw_offsets.size() * sizeof(uint64_t));
+    std::vector<size_t> offsets(raw_offsets.begin(), raw_offsets.end());
+    align();
+    std::vector<T> items(nr_items);
+    read_raw(reinterpret_cast<char*>(items.data()), nr_items * sizeof(T));
+    seqs.assign(std::move(offsets), std::move(items));
+}
+
+template <typename T>
+inline
+void CorpusCacheReader::skip_flat_seqs()
+{
+    uint64_t nr_seqs,
+        nr_items;
+    read_pod(nr_seqs);
+    read_pod(nr_items);
+    align();
+    skip((nr_seqs + 1) * sizeof(uint64_t));
+    align();
+    skip(nr_items * sizeof(T));
+}
+
+} // end of namespace slnn
+
+#endif
@@ -34,12 +34,48 @@ namespace slnn {
             }
             return word_idx;
         }
+        // insert a word with the frequency counted outside (e.g. merged from thread-local vocabularies)
+        Index add_word_with_frequency(const std::string& word, int freq)
+        {
+            assert(!rd.is_frozen());
+            Index word_idx = rd.Convert(word);
+            if (static_cast<unsigned>(word_idx) + 1U > freq_records.size()) freq_records.resize(word_idx + 1, 0);
+            freq_records[word_idx] += freq;
+            return word_idx;
+        }
         void SetUnk(const std::string& word)
         {
             rd.SetUnk(word);
             UNK = rd.Convert(word);
         }
         void Freeze() { rd.Freeze(); }
+        // freeze the dict with ids re-assigned by frequency (descending , ties keep the first-seen order) , then set UNK .
+        // hot words get the leading ids , so their embedding rows are packed together .
+        // `old2new[old_id]` is the new id , for remapping the data indexed before freezing .
+        void freeze_in_frequency_order(const std::string& unk_str, IndexSeq& old2new)
+        {
+            assert(!rd.is_frozen());
+            unsigned dict_size = rd.size();
+            freq_records.resize(dict_size, 0);
+            IndexSeq order(dict_size);
+            for (unsigned i = 0; i < dict_size; ++i) order[i] = static_cast<Index>(i);
+            std::stable_sort(order.begin(), order.end(),
+                [this](Index lhs, Index rhs){ return freq_records[lhs] > freq_records[rhs]; });
+            cnn::Dict ordered_dict;
+            std::vector<int> ordered_freq_records(dict_size);
+            IndexSeq tmp_old2new(dict_size);
+            for (unsigned i = 0; i < dict_size; ++i)
+            {
+                Index old_id = order[i];
+                tmp_old2new[old_id] = ordered_dict.Convert(rd.Convert(old_id));
+                ordered_freq_records[i] = freq_records[old_id];
+            }
+            ordered_dict.Freeze();
+            rd = ordered_dict;
+            freq_records.swap(ordered_freq_records);
+            SetUnk(unk_str);
+            old2new.swap(tmp_old2new);
+        }
         bool is_frozen() { return rd.is_frozen(); }
         int ConvertProbability(Index word_idx)
         {
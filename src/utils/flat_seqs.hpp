@@ -0,0 +1,154 @@
+#ifndef SLNN_UTILS_FLAT_SEQS_HPP_
+#define SLNN_UTILS_FLAT_SEQS_HPP_
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include "typedeclaration.h"
+
+namespace slnn{
+
+/**
+ * read-only view of one sequence in `FlatSeqs` .
+ */
+template <typename T>
+struct SeqView
+{
+    SeqView(const T *first, size_t len) : first(first), len(len){}
+    size_t size() const { return len; }
+    bool empty() const { return 0 == len; }
+    const T& operator[](size_t i) const { return first[i]; }
+    const T* begin() const { return first; }
+    const T* end() const { return first + len; }
+    // copy to a (reused) container , no allocation once its capacity is enough
+    void copy_to(std::vector<T> &out) const { out.assign(first, first + len); }
+private:
+    const T *first;
+    size_t len;
+};
+
+/**
+ * CSR-style storage of a dataset stream (sentences , tags , features ...) :
+ * one offsets array and one flat items array , instead of one heap vector for every sentence .
+ * shuffling should permute sentence indices , the storage is never moved .
+ */
+template <typename T>
+class FlatSeqs
+{
+public:
+    FlatSeqs() : offsets(1, 0){}
+    void reserve(size_t nr_seqs, size_t nr_items);
+    template <typename Container>
+    void push_back(const Container &seq);
+    void push_back(const T *first, size_t len);
+    void append(const FlatSeqs &other);
+    // rewrite every item in place (e.g. remap ids) , the layout is unchanged
+    template <typename Fn>
+    void transform_items(Fn fn);
+    // take over raw storage (e.g. loaded from cache) , throw if offsets are inconsistent with items
+    void assign(std::vector<size_t> &&offsets, std::vector<T> &&items);
+    size_t size() const { return offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+    size_t total_items() const { return items.size(); }
+    SeqView<T> operator[](size_t i) const { return SeqView<T>(items.data() + offsets[i], offsets[i + 1] - offsets[i]); }
+    SeqView<T> at(size_t i) const;
+    void clear();
+    void shrink_to_fit();
+    const std::vector<size_t>& get_offsets() const { return offsets; }
+    const std::vector<T>& get_items() const { return items; }
+    size_t get_memory_bytes() const { return offsets.capacity() * sizeof(size_t) + items.capacity() * sizeof(T); }
+private:
+    std::vector<size_t> offsets; // size() + 1 , offsets[i] is the start of sequence i
+    std::vector<T> items;
+};
+
+using FlatIndexSeqs = FlatSeqs<Index>;
+
+/*************** inline implementation ***************/
+
+template <typename T>
+inline
+void FlatSeqs<T>::reserve(size_t nr_seqs, size_t nr_items)
+{
+    offsets.reserve(nr_seqs + 1);
+    items.reserve(nr_items);
+}
+
+template <typename T>
+template <typename Container>
+inline
+void FlatSeqs<T>::push_back(const Container &seq)
+{
+    items.insert(items.end(), seq.begin(), seq.end());
+    offsets.push_back(items.size());
+}
+
+template <typename T>
+inline
+void FlatSeqs<T>::push_back(const T *first, size_t len)
+{
+    items.insert(items.end(), first, first + len);
+    offsets.push_back(items.size());
+}
+
+template <typename T>
+inline
+void FlatSeqs<T>::append(const FlatSeqs &other)
+{
+    size_t base = items.size();
+    offsets.reserve(offsets.size() + other.size());
+    for( size_t i = 1; i < other.offsets.size(); ++i ){ offsets.push_back(base + other.offsets[i]); }
+    items.insert(items.end(), other.items.begin(), other.items.end());
+}
+
+template <typename T>
+template <typename Fn>
+inline
+void FlatSeqs<T>::transform_items(Fn fn)
+{
+    for( T &item : items ){ item = fn(item); }
+}
+
+template <typename T>
+inline
+void FlatSeqs<T>::assign(std::vector<size_t> &&offsets, std::vector<T> &&items)
+{
+    if( offsets.empty() || offsets.front() != 0 || offsets.back() != items.size() )
+    {
+        throw std::runtime_error("flat sequences offsets are inconsistent with items .");
+    }
+    for( size_t i = 1; i < offsets.size(); ++i )
+    {
+        if( offsets[i] < offsets[i - 1] ){ throw std::runtime_error("flat sequences offsets are not ascending ."); }
+    }
+    this->offsets = std::move(offsets);
+    this->items = std::move(items);
+}
+
+template <typename T>
+inline
+SeqView<T> FlatSeqs<T>::at(size_t i) const
+{
+    if( i >= size() ){ throw std::out_of_range("flat sequences index out of range ."); }
+    return (*this)[i];
+}
+
+template <typename T>
+inline
+void FlatSeqs<T>::clear()
+{
+    offsets.assign(1, 0);
+    items.clear();
+}
+
+template <typename T>
+inline
+void FlatSeqs<T>::shrink_to_fit()
+{
+    offsets.shrink_to_fit();
+    items.shrink_to_fit();
+}
+
+} // end of namespace slnn
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SLNN_UTILS_FROZEN_DICT_HPP_
+#define SLNN_UTILS_FROZEN_DICT_HPP_
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "typedeclaration.h"
+#include "corpus_cache.hpp"
+#include "cnn/dict.h"
+
+namespace slnn{
+
+/**
+ * read-only word -> id table built from a frozen `cnn::Dict` , for inference .
+ * all words live in one string arena , the table is open addressing (load factor <= 0.5) over 8-bytes slots ,
+ * every slot keeps the high bits of the hash so a probe mostly rejects without touching the arena .
+ * `convert` takes (pointer , length) , so a token can be looked up from the raw line without building a string .
+ */
+class FrozenDict
+{
+public:
+    FrozenDict() : mask(0), unk_id(-1){}
+    // `unk_id` is returned for unknown words , < 0 means throw as `cnn::Dict` without UNK
+    void build(const cnn::Dict &dict, Index unk_id);
+    bool empty() const { return slots.empty(); }
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    Index convert(const char *data, size_t len) const;
+    Index convert(const std::string &word) const { return convert(word.data(), word.size()); }
+    size_t get_memory_bytes() const
+    {
+        return arena.capacity() * sizeof(char) + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(Slot);
+    }
+private:
+    struct Slot
+    {
+        uint32_t hash_tag;
+        Index id; // -1 for empty slot
+    };
+    static uint64_t hash(const char *data, size_t len){ return CorpusCacheUtils::hash_bytes(data, len); }
+    bool is_equal(Index id, const char *data, size_t len) const;
+    std::vector<char> arena;
+    std::vector<uint32_t> offsets; // size() + 1 , word i is arena[offsets[i] , offsets[i+1])
+    std::vector<Slot> slots;
+    size_t mask;
+    Index unk_id;
+};
+
+/*************** inline implementation ***************/
+
+inline
+bool FrozenDict::is_equal(Index id, const char *data, size_t len) const
+{
+    uint32_t begin = offsets[id],
+        word_len = offsets[id + 1] - begin;
+    return word_len == len && std::memcmp(arena.data() + begin, data, len) == 0;
+}
+
+inline
+void FrozenDict::build(const cnn::Dict &dict, Index unk_id)
+{
+    unsigned dict_size = dict.size();
+    std::vector<char> tmp_arena;
+    std::vector<uint32_t> tmp_offsets;
+    tmp_offsets.reserve(dict_size + 1);
+    tmp_offsets.push_back(0);
+    for( unsigned i = 0; i < dict_size; ++i )
+    {
+        const std::string &word = dict.Convert(static_cast<int>(i));
+        tmp_arena.insert(tmp_arena.end(), word.begin(), word.end());
+        tmp_offsets.push_back(static_cast<uint32_t>(tmp_arena.size()));
+    }
+    size_t nr_slots = 2;
+    while( nr_slots < 2 * static_cast<size_t>(dict_size) ){ nr_slots <<= 1; }
+    std::vector<Slot> tmp_slots(nr_slots, Slot{ 0, -1 });
+    size_t tmp_mask = nr_slots - 1;
+    for( unsigned i = 0; i < dict_size; ++i )
+    {
+        uint64_t h = hash(tmp_arena.data() + tmp_offsets[i], tmp_offsets[i + 1] - tmp_offsets[i]);
+        size_t pos = h & tmp_mask;
+        while( tmp_slots[pos].id != -1 ){ pos = (pos + 1) & tmp_mask; }
+        tmp_slots[pos] = Slot{ static_cast<uint32_t>(h >> 32), static_cast<Index>(i) };
+    }
+    arena.swap(tmp_arena);
+    offsets.swap(tmp_offsets);
+    slots.swap(tmp_slots);
+    mask = tmp_mask;
+    this->unk_id = unk_id;
+}
+
+inline
+Index FrozenDict::convert(const char *data, size_t len) const
+{
+    assert(!empty());
+    uint64_t h = hash(data, len);
+    uint32_t hash_tag = static_cast<uint32_t>(h >> 32);
+    for( size_t pos = h & mask; slots[pos].id != -1; pos = (pos + 1) & mask )
+    {
+        const Slot &slot = slots[pos];
+        if( slot.hash_tag == hash_tag && is_equal(slot.id, data, len) ){ return slot.id; }
+    }
+    if( unk_id < 0 ){ throw std::runtime_error("unknown word `" + std::string(data, len) + "` in frozen dict without UNK ."); }
+    return unk_id;
+}
+
+} // end of namespace slnn
+
+#endif
@@ -0,0 +1,537 @@
+#ifndef SLNN_UTILS_MEMORY_STAT_HPP_
+#define SLNN_UTILS_MEMORY_STAT_HPP_
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+
+#include "cnn/cnn.h"
+#include "cnn/dict.h"
+
+namespace slnn{
+
+/**
+ * memory accounting helpers .
+ * graph sizes are computed from the nodes , the same quantity cnn allocates from its pools :
+ * forward pool holds the value (and auxiliary storage) of every node , backward pool holds the gradient of every node ,
+ * parameter pool holds the values and gradients of every parameter .
+ */
+struct MemoryStat
+{
+    static const size_t PoolAlignment = 32; // cnn pools round every allocation up to the alignment
+
+    static size_t align(size_t bytes){ return (bytes + PoolAlignment - 1) / PoolAlignment * PoolAlignment; }
+    static size_t graph_forward_bytes(const cnn::ComputationGraph &cg);
+    static size_t graph_backward_bytes(const cnn::ComputationGraph &cg);
+    // values + gradients
+    static size_t parameter_bytes(const cnn::ParametersBase *param){ return 2 * align(param->size() * sizeof(float)); }
+    static size_t model_parameter_bytes(const cnn::Model &m);
+    // estimated : words are kept in a vector and as the keys of a hash map
+    static size_t dict_bytes(const cnn::Dict &dict);
+    template <typename T>
+    static size_t vector_bytes(const std::vector<T> &vec){ return vec.capacity() * sizeof(T); }
+    static std::string format_bytes(size_t bytes);
+};
+
+/**
+ * parameter bytes of every layer , filled while building the model structure :
+ *     ledger.start(m);
+ *     input_layer = new ...; ledger.mark("input layer");
+ * parameters added to `m` since the last mark belong to the marked layer .
+ */
+class ParameterMemoryLedger
+{
+public:
+    ParameterMemoryLedger() : m(nullptr), nr_marked_params(0){}
+    void start(const cnn::Model *m);
+    void mark(const std::string &layer_name);
+    size_t get_total_bytes() const;
+    std::string get_report_str() const;
+private:
+    struct Entry
+    {
+        std::string layer_name;
+        size_t nr_params;
+        size_t nr_floats;
+        size_t bytes;
+    };
+    const cnn::Model *m;
+    size_t nr_marked_params;
+    std::vector<Entry> entries;
+};
+
+/**
+ * peak graph memory of every sentence length , recorded after the graph of a sentence is built .
+ */
+class GraphMemoryProfile
+{
+public:
+    void record(unsigned sent_len, const cnn::ComputationGraph &cg, bool has_backward);
+    void merge(const GraphMemoryProfile &other);
+    void clear(){ peaks_by_len.clear(); }
+    bool empty() const { return peaks_by_len.empty(); }
+    unsigned get_max_len() const { return empty() ? 0 : peaks_by_len.rbegin()->first; }
+    size_t get_peak_forward_bytes() const;
+    size_t get_peak_backward_bytes() const;
+    // upper linear envelope of the peaks : bytes(len) <= base_bytes + bytes_per_token * len for every recorded length
+    void fit(bool is_backward, double &base_bytes, double &bytes_per_token) const;
+    // peaks of length buckets [1, 8] , [9, 16] , [17, 32] ...
+    std::string get_report_str(const std::string &info_header) const;
+private:
+    struct Peak
+    {
+        size_t forward_bytes;
+        size_t backward_bytes;
+        unsigned long long count;
+    };
+    std::map<unsigned, Peak> peaks_by_len;
+};
+
+/**
+ * sizing of `--cnn-mem` .
+ * cnn allocates every pool (forward , backward , parameters) with the `--cnn-mem` size , so the size has to hold the
+ * largest of them . graph memory is linear in the sentence length , the coefficients are measured by previous runs
+ * and kept in a small text profile , then the size is computed from the longest sentence of the input plus headroom .
+ */
+struct CnnMemoryProfile
+{
+    double forward_base_bytes;
+    double forward_bytes_per_token;
+    double backward_base_bytes;
+    double backward_bytes_per_token;
+    size_t parameter_bytes;
+    unsigned max_len; // longest sentence measured
+
+    CnnMemoryProfile() : forward_base_bytes(0.), forward_bytes_per_token(0.),
+        backward_base_bytes(0.), backward_bytes_per_token(0.), parameter_bytes(0), max_len(0){}
+    CnnMemoryProfile(const GraphMemoryProfile &graph_profile, size_t parameter_bytes);
+    // keep the larger coefficients , so a profile only grows
+    void merge(const CnnMemoryProfile &other);
+    size_t estimate_bytes(unsigned sent_len, bool has_backward) const;
+    // return false if the file doesn't exist or is broken
+    bool load(const std::string &path);
+    void save(const std::string &path) const;
+};
+
+class CnnMemPlanner
+{
+public:
+    enum class LengthUnit
+    {
+        Char, // utf8 characters except spaces (CWS)
+        Token // space separated tokens (POS)
+    };
+    static unsigned scan_max_sentence_len(const std::string &path, LengthUnit unit);
+    // MB for `--cnn-mem` , `default_mb` is returned if the profile can't be loaded .
+    // empty paths (stdin) are skipped , the longest sentence of the profile is used if no path is scanned
+    static unsigned plan_cnn_mem_mb(const std::string &profile_path, const std::vector<std::string> &data_paths,
+        LengthUnit unit, bool has_backward, float headroom, unsigned default_mb);
+    // MB for `--cnn-mem` of models resident in one process , decoding only . their graphs are built one at a time ,
+    // but the parameters of all are in the parameter pool . `default_mb` is returned if any profile can't be loaded
+    static unsigned plan_resident_cnn_mem_mb(const std::vector<std::string> &profile_paths, float headroom, unsigned default_mb);
+    // merge the measured profile of a model into the profile at `profile_path` (nothing is done if empty)
+    static void update_profile(const std::string &profile_path, const GraphMemoryProfile &graph_profile, size_t parameter_bytes);
+private:
+    static bool load_profile(const std::string &profile_path, CnnMemoryProfile &profile);
+    static unsigned bytes2mb(size_t bytes, unsigned max_len, float headroom);
+};
+
+/*************** inline implementation ***************/
+
+inline
+size_t MemoryStat::graph_forward_bytes(const cnn::ComputationGraph &cg)
+{
+    size_t bytes = 0;
+    for( const cnn::Node *node : cg.nodes )
+    {
+        bytes += align(node->dim.size() * sizeof(float));
+        size_t aux_bytes = node->aux_storage_size();
+        if( aux_bytes > 0 ){ bytes += align(aux_bytes); }
+    }
+    return bytes;
+}
+
+inline
+size_t MemoryStat::graph_backward_bytes(const cnn::ComputationGraph &cg)
+{
+    size_t bytes = 0;
+    for( const cnn::Node *node : cg.nodes ){ bytes += align(node->dim.size() * sizeof(float)); }
+    return bytes;
+}
+
+inline
+size_t MemoryStat::model_parameter_bytes(const cnn::Model &m)
+{
+    size_t bytes = 0;
+    for( const cnn::ParametersBase *param : m.all_parameters_list() ){ bytes += parameter_bytes(param); }
+    return bytes;
+}
+
+inline
+size_t MemoryStat::dict_bytes(const cnn::Dict &dict)
+{
+    // std::string object + heap buffer (out of small string optimization) , twice ;
+    // hash node (next pointer , cached hash , value) and a bucket pointer
+    const size_t SmallStringCapacity = 15;
+    const size_t HashNodeOverhead = 2 * sizeof(void*) + sizeof(int) + sizeof(void*);
+    unsigned dict_size = dict.size();
+    size_t bytes = 0;
+    for( unsigned i = 0; i < dict_size; ++i )
+    {
+        const std::string &word = dict.Convert(static_cast<int>(i));
+        size_t string_bytes = sizeof(std::string) + (word.capacity() > SmallStringCapacity ? word.capacity() + 1 : 0);
+        bytes += 2 * string_bytes + HashNodeOverhead;
+    }
+    return bytes;
+}
+
+inline
+std::string MemoryStat::format_bytes(size_t bytes)
+{
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    if( bytes >= (1ULL << 30) ){ oss << bytes / static_cast<double>(1ULL << 30) << " GB"; }
+    else if( bytes >= (1ULL << 20) ){ oss << bytes / static_cast<double>(1ULL << 20) << " MB"; }
+    else if( bytes >= (1ULL << 10) ){ oss << bytes / static_cast<double>(1ULL << 10) << " KB"; }
+    else{ oss << bytes << " B"; }
+    return oss.str();
+}
+
+inline
+void ParameterMemoryLedger::start(const cnn::Model *m)
+{
+    this->m = m;
+    nr_marked_params = 0;
+    entries.clear();
+}
+
+inline
+void ParameterMemoryLedger::mark(const std::string &layer_name)
+{
+    if( nullptr == m ){ throw std::runtime_error("parameter memory ledger is marked before started ."); }
+    const std::vector<cnn::ParametersBase*> &params = m->all_parameters_list();
+    Entry entry{ layer_name, params.size() - nr_marked_params, 0, 0 };
+    for( size_t i = nr_marked_params; i < params.size(); ++i )
+    {
+        entry.nr_floats += params[i]->size();
+        entry.bytes += MemoryStat::parameter_bytes(params[i]);
+    }
+    nr_marked_params = params.size();
+    entries.push_back(entry);
+}
+
+inline
+size_t ParameterMemoryLedger::get_total_bytes() const
+{
+    size_t total_bytes = 0;
+    for( const Entry &entry : entries ){ total_bytes += entry.bytes; }
+    return total_bytes;
+}
+
+inline
+std::string ParameterMemoryLedger::get_report_str() const
+{
+    std::ostringstream oss;
+    oss << "parameter memory (values + gradients) :";
+    for( const Entry &entry : entries )
+    {
+        oss << "\n  " << std::left << std::setw(20) << entry.layer_name << std::right
+            << std::setw(4) << entry.nr_params << " params , "
+            << std::setw(10) << entry.nr_floats << " floats , "
+            << MemoryStat::format_bytes(entry.bytes);
+    }
+    oss << "\n  total : " << MemoryStat::format_bytes(get_total_bytes());
+    return oss.str();
+}
+
+inline
+void GraphMemoryProfile::record(unsigned sent_len, const cnn::ComputationGraph &cg, bool has_backward)
+{
+    Peak &peak = peaks_by_len[sent_len];
+    peak.forward_bytes = std::max(peak.forward_bytes, MemoryStat::graph_forward_bytes(cg));
+    if( has_backward ){ peak.backward_bytes = std::max(peak.backward_bytes, MemoryStat::graph_backward_bytes(cg)); }
+    ++peak.count;
+}
+
+inline
+void GraphMemoryProfile::merge(const GraphMemoryProfile &other)
+{
+    for( const std::pair<const unsigned, Peak> &len2peak : other.peaks_by_len )
+    {
+        Peak &peak = peaks_by_len[len2peak.first];
+        peak.forward_bytes = std::max(peak.forward_bytes, len2peak.second.forward_bytes);
+        peak.backward_bytes = std::max(peak.backward_bytes, len2peak.second.backward_bytes);
+        peak.count += len2peak.second.count;
+    }
+}
+
+inline
+size_t GraphMemoryProfile::get_peak_forward_bytes() const
+{
+    size_t peak_bytes = 0;
+    for( const std::pair<const unsigned, Peak> &len2peak : peaks_by_len )
+    {
+        peak_bytes = std::max(peak_bytes, len2peak.second.forward_bytes);
+    }
+    return peak_bytes;
+}
+
+inline
+size_t GraphMemoryProfile::get_peak_backward_bytes() const
+{
+    size_t peak_bytes = 0;
+    for( const std::pair<const unsigned, Peak> &len2peak : peaks_by_len )
+    {
+        peak_bytes = std::max(peak_bytes, len2peak.second.backward_bytes);
+    }
+    return peak_bytes;
+}
+
+inline
+void GraphMemoryProfile::fit(bool is_backward, double &base_bytes, double &bytes_per_token) const
+{
+    base_bytes = 0.;
+    bytes_per_token = 0.;
+    std::vector<std::pair<double, double>> points;
+    for( const std::pair<const unsigned, Peak> &len2peak : peaks_by_len )
+    {
+        size_t bytes = is_backward ? len2peak.second.backward_bytes : len2peak.second.forward_bytes;
+        if( bytes > 0 ){ points.emplace_back(len2peak.first, static_cast<double>(bytes)); }
+    }
+    if( points.empty() ){ return; }
+    // least squares slope , then the intercept is raised until the line is above every point
+    double mean_len = 0., mean_bytes = 0.;
+    for( const std::pair<double, double> &point : points ){ mean_len += point.first; mean_bytes += point.second; }
+    mean_len /= points.size();
+    mean_bytes /= points.size();
+    double cov = 0., var = 0.;
+    for( const std::pair<double, double> &point : points )
+    {
+        cov += (point.first - mean_len) * (point.second - mean_bytes);
+        var += (point.first - mean_len) * (point.first - mean_len);
+    }
+    if( var > 0. ){ bytes_per_token = std::max(0., cov / var); }
+    else{ bytes_per_token = points.front().first > 0. ? points.front().second / points.front().first : 0.; }
+    for( const std::pair<double, double> &point : points )
+    {
+        base_bytes = std::max(base_bytes, point.second - bytes_per_token * point.first);
+    }
+}
+
+inline
+std::string GraphMemoryProfile::get_report_str(const std::string &info_header) const
+{
+    std::ostringstream oss;
+    oss << info_header << "\n"
+        << std::left << std::setw(14) << "length" << std::right
+        << std::setw(12) << "count" << std::setw(16) << "peak forward" << std::setw(16) << "peak backward";
+    auto bucket_upper = [](unsigned len) -> unsigned
+    {
+        unsigned upper = 8;
+        while( upper < len ){ upper *= 2; }
+        return upper;
+    };
+    std::map<unsigned, Peak> peaks_by_bucket;
+    for( const std::pair<const unsigned, Peak> &len2peak : peaks_by_len )
+    {
+        Peak &peak = peaks_by_bucket[bucket_upper(len2peak.first)];
+        peak.forward_bytes = std::max(peak.forward_bytes, len2peak.second.forward_bytes);
+        peak.backward_bytes = std::max(peak.backward_bytes, len2peak.second.backward_bytes);
+        peak.count += len2peak.second.count;
+    }
+    for( const std::pair<const unsigned, Peak> &upper2peak : peaks_by_bucket )
+    {
+        unsigned upper = upper2peak.first,
+            lower = upper == 8 ? 1 : upper / 2 + 1;
+        const Peak &peak = upper2peak.second;
+        oss << "\n" << std::left << std::setw(14) << ("[" + std::to_string(lower) + ", " + std::to_string(upper) + "]")
+            << std::right << std::setw(12) << peak.count
+            << std::setw(16) << MemoryStat::format_bytes(peak.forward_bytes)
+            << std::setw(16) << (peak.backward_bytes > 0 ? MemoryStat::format_bytes(peak.backward_bytes) : "-");
+    }
+    oss << "\nlongest sentence : " << get_max_len()
+        << " , peak forward : " << MemoryStat::format_bytes(get_peak_forward_bytes())
+        << " , peak backward : " << MemoryStat::format_bytes(get_peak_backward_bytes());
+    return oss.str();
+}
+
+inline
+CnnMemoryProfile::CnnMemoryProfile(const GraphMemoryProfile &graph_profile, size_t parameter_bytes)
+    :parameter_bytes(parameter_bytes),
+    max_len(graph_profile.get_max_len())
+{
+    graph_profile.fit(false, forward_base_bytes, forward_bytes_per_token);
+    graph_profile.fit(true, backward_base_bytes, backward_bytes_per_token);
+}
+
+inline
+void CnnMemoryProfile::merge(const CnnMemoryProfile &other)
+{
+    forward_base_bytes = std::max(forward_base_bytes, other.forward_base_bytes);
+    forward_bytes_per_token = std::max(forward_bytes_per_token, other.forward_bytes_per_token);
+    backward_base_bytes = std::max(backward_base_bytes, other.backward_base_bytes);
+    backward_bytes_per_token = std::max(backward_bytes_per_token, other.backward_bytes_per_token);
+    parameter_bytes = std::max(parameter_bytes, other.parameter_bytes);
+    max_len = std::max(max_len, other.max_len);
+}
+
+inline
+size_t CnnMemoryProfile::estimate_bytes(unsigned sent_len, bool has_backward) const
+{
+    double forward_bytes = forward_base_bytes + forward_bytes_per_token * sent_len;
+    double pool_bytes = std::max(forward_bytes, static_cast<double>(parameter_bytes));
+    if( has_backward )
+    {
+        // a profile measured without training has no backward part , gradients are never larger than values
+        double backward_bytes = backward_bytes_per_token > 0. ? backward_base_bytes + backward_bytes_per_token * sent_len
+            : forward_bytes;
+        pool_bytes = std::max(pool_bytes, backward_bytes);
+    }
+    return static_cast<size_t>(std::ceil(pool_bytes));
+}
+
+inline
+bool CnnMemoryProfile::load(const std::string &path)
+{
+    std::ifstream is(path);
+    if( !is ){ return false; }
+    CnnMemoryProfile tmp_profile;
+    std::string key;
+    unsigned nr_keys = 0;
+    while( is >> key )
+    {
+        if( key == "forward_base_bytes" ){ is >> tmp_profile.forward_base_bytes; }
+        else if( key == "forward_bytes_per_token" ){ is >> tmp_profile.forward_bytes_per_token; }
+        else if( key == "backward_base_bytes" ){ is >> tmp_profile.backward_base_bytes; }
+        else if( key == "backward_bytes_per_token" ){ is >> tmp_profile.backward_bytes_per_token; }
+        else if( key == "parameter_bytes" ){ is >> tmp_profile.parameter_bytes; }
+        else if( key == "max_len" ){ is >> tmp_profile.max_len; }
+        else{ return false; }
+        if( !is ){ return false; }
+        ++nr_keys;
+    }
+    if( nr_keys == 0 ){ return false; }
+    *this = tmp_profile;
+    return true;
+}
+
+inline
+void CnnMemoryProfile::save(const std::string &path) const
+{
+    std::ofstream os(path);
+    if( !os )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "failed to open `" << path << "` for memory profile .";
+        return;
+    }
+    os << std::fixed << std::setprecision(1)
+        << "forward_base_bytes " << forward_base_bytes << "\n"
+        << "forward_bytes_per_token " << forward_bytes_per_token << "\n"
+        << "backward_base_bytes " << backward_base_bytes << "\n"
+        << "backward_bytes_per_token " << backward_bytes_per_token << "\n"
+        << "parameter_bytes " << parameter_bytes << "\n"
+        << "max_len " << max_len << "\n";
+}
+
+inline
+unsigned CnnMemPlanner::scan_max_sentence_len(const std::string &path, LengthUnit unit)
+{
+    std::ifstream is(path);
+    if( !is ){ throw std::runtime_error("failed to open `" + path + "` to scan sentence length ."); }
+    unsigned max_len = 0;
+    std::string line;
+    while( std::getline(is, line) )
+    {
+        unsigned len = 0;
+        bool in_token = false;
+        for( char c : line )
+        {
+            unsigned char byte = static_cast<unsigned char>(c);
+            bool is_space = (c == ' ' || c == '\t' || c == '\r');
+            if( unit == LengthUnit::Char )
+            {
+                // count utf8 leading bytes
+                if( !is_space && (byte & 0xC0) != 0x80 ){ ++len; }
+            }
+            else
+            {
+                if( !is_space && !in_token ){ ++len; }
+                in_token = !is_space;
+            }
+        }
+        max_len = std::max(max_len, len);
+    }
+    return max_len;
+}
+
+inline
+unsigned CnnMemPlanner::plan_cnn_mem_mb(const std::string &profile_path, const std::vector<std::string> &data_paths,
+    LengthUnit unit, bool has_backward, float headroom, unsigned default_mb)
+{
+    CnnMemoryProfile profile;
+    if( !load_profile(profile_path, profile) ){ return default_mb; }
+    unsigned max_len = 0;
+    for( const std::string &path : data_paths )
+    {
+        if( !path.empty() ){ max_len = std::max(max_len, scan_max_sentence_len(path, unit)); }
+    }
+    if( 0 == max_len ){ max_len = profile.max_len; }
+    return bytes2mb(profile.estimate_bytes(max_len, has_backward), max_len, headroom);
+}
+
+inline
+unsigned CnnMemPlanner::plan_resident_cnn_mem_mb(const std::vector<std::string> &profile_paths, float headroom, unsigned default_mb)
+{
+    CnnMemoryProfile merged_profile;
+    size_t total_parameter_bytes = 0;
+    for( const std::string &profile_path : profile_paths )
+    {
+        CnnMemoryProfile profile;
+        if( !load_profile(profile_path, profile) ){ return default_mb; }
+        merged_profile.merge(profile);
+        total_parameter_bytes += profile.parameter_bytes;
+    }
+    merged_profile.parameter_bytes = total_parameter_bytes;
+    return bytes2mb(merged_profile.estimate_bytes(merged_profile.max_len, false), merged_profile.max_len, headroom);
+}
+
+inline
+bool CnnMemPlanner::load_profile(const std::string &profile_path, CnnMemoryProfile &profile)
+{
+    if( profile.load(profile_path) ){ return true; }
+    BOOST_LOG_TRIVIAL(warning) << "memory profile `" << profile_path << "` is not available , "
+        "run once with a large enough `cnn-mem` to measure it . keep the cnn memory setting .";
+    return false;
+}
+
+inline
+unsigned CnnMemPlanner::bytes2mb(size_t bytes, unsigned max_len, float headroom)
+{
+    unsigned mb = static_cast<unsigned>(std::ceil(bytes * (1. + std::max(headroom, 0.f)) / (1ULL << 20)));
+    mb = std::max(mb, 1U);
+    BOOST_LOG_TRIVIAL(info) << "cnn memory is sized from the longest sentence (" << max_len << ") : "
+        << MemoryStat::format_bytes(bytes) << " with headroom " << headroom << " , cnn-mem = " << mb << " MB .";
+    return mb;
+}
+
+inline
+void CnnMemPlanner::update_profile(const std::string &profile_path, const GraphMemoryProfile &graph_profile,
+    size_t parameter_bytes)
+{
+    if( profile_path.empty() || graph_profile.empty() ){ return; }
+    CnnMemoryProfile profile(graph_profile, parameter_bytes),
+        existing_profile;
+    if( existing_profile.load(profile_path) ){ profile.merge(existing_profile); }
+    profile.save(profile_path);
+}
+
+} // end of namespace slnn
+
+#endif
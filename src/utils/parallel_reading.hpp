@@ -0,0 +1,177 @@
+#ifndef SLNN_UTILS_PARALLEL_READING_HPP_
+#define SLNN_UTILS_PARALLEL_READING_HPP_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include "typedeclaration.h"
+#include "dict_wrapper.hpp"
+
+namespace slnn{
+
+/**
+ * thread-local vocabulary , local id is the order of first occurrence in the range .
+ */
+struct LocalVocab
+{
+    std::unordered_map<std::string, Index> word2id;
+    Seq words;
+    std::vector<int> freqs;
+
+    Index add(const std::string &word);
+};
+
+/**
+ * helpers for parsing a corpus file in parallel :
+ * the file is split into line-aligned byte ranges , every range is parsed by a worker with a `LocalVocab` ,
+ * then vocabularies are merged into the real dict and local ids are remapped .
+ */
+struct ParallelReadingUtils
+{
+    using LineRange = std::pair<std::streamoff, std::streamoff>; // [begin , end)
+
+    // split the file into at most `nr_parts` non-empty ranges , every range begins at a line head
+    static std::vector<LineRange> split_line_ranges(const std::string &path, unsigned nr_parts);
+
+    // merge local vocabularies into `dict_wrapper` , ordered by total frequency (descending) then first occurrence .
+    // the order doesn't depend on how the file is split . frequency records are accumulated to the wrapper .
+    // `local2global[range_idx][local_id]` is the merged id .
+    static void merge_vocabs(const std::vector<LocalVocab> &local_vocabs, DictWrapper &dict_wrapper,
+        std::vector<IndexSeq> &local2global);
+
+    // run `fn(task_idx)` for every task on its own thread , the first exception is re-thrown after all joined
+    template <typename Fn>
+    static void run_parallel(unsigned nr_tasks, Fn fn);
+};
+
+/*************** inline implementation ***************/
+
+inline
+Index LocalVocab::add(const std::string &word)
+{
+    auto iter = word2id.find(word);
+    if( iter != word2id.end() )
+    {
+        ++freqs[iter->second];
+        return iter->second;
+    }
+    Index local_id = static_cast<Index>(words.size());
+    word2id.emplace(word, local_id);
+    words.push_back(word);
+    freqs.push_back(1);
+    return local_id;
+}
+
+inline
+std::vector<ParallelReadingUtils::LineRange>
+ParallelReadingUtils::split_line_ranges(const std::string &path, unsigned nr_parts)
+{
+    std::ifstream is(path, std::ios::binary);
+    if( !is ){ throw std::runtime_error("failed to open `" + path + "` ."); }
+    is.seekg(0, std::ios::end);
+    std::streamoff file_size = is.tellg();
+    nr_parts = std::max(nr_parts, 1U);
+    std::vector<LineRange> ranges;
+    std::streamoff range_begin = 0;
+    for( unsigned part = 1; part <= nr_parts && range_begin < file_size; ++part )
+    {
+        std::streamoff range_end = file_size;
+        if( part < nr_parts )
+        {
+            // move the split point to the head of next line
+            range_end = std::max(range_begin, file_size / nr_parts * part);
+            is.clear();
+            is.seekg(range_end);
+            std::string rest_of_line;
+            std::getline(is, rest_of_line);
+            range_end = ( is && !is.eof() ) ? static_cast<std::streamoff>(is.tellg()) : file_size;
+        }
+        if( range_end > range_begin ){ ranges.emplace_back(range_begin, range_end); }
+        range_begin = range_end;
+    }
+    return ranges;
+}
+
+inline
+void ParallelReadingUtils::merge_vocabs(const std::vector<LocalVocab> &local_vocabs, DictWrapper &dict_wrapper,
+    std::vector<IndexSeq> &local2global)
+{
+    // range_idx , local_id of the first occurrence for every word , and the total frequency
+    struct MergedWord
+    {
+        unsigned range_idx;
+        Index local_id;
+        long long freq;
+    };
+    std::unordered_map<std::string, size_t> word2merged;
+    std::vector<MergedWord> merged;
+    for( unsigned range_idx = 0; range_idx < local_vocabs.size(); ++range_idx )
+    {
+        const LocalVocab &vocab = local_vocabs[range_idx];
+        for( size_t local_id = 0; local_id < vocab.words.size(); ++local_id )
+        {
+            auto ret = word2merged.emplace(vocab.words[local_id], merged.size());
+            if( ret.second ){ merged.push_back({ range_idx, static_cast<Index>(local_id), vocab.freqs[local_id] }); }
+            else{ merged[ret.first->second].freq += vocab.freqs[local_id]; }
+        }
+    }
+    // ranges are in file order and local ids are in first-occurrence order ,
+    // so (range_idx , local_id) is the global first occurrence
+    std::sort(merged.begin(), merged.end(), [](const MergedWord &lhs, const MergedWord &rhs)
+    {
+        if( lhs.freq != rhs.freq ){ return lhs.freq > rhs.freq; }
+        if( lhs.range_idx != rhs.range_idx ){ return lhs.range_idx < rhs.range_idx; }
+        return lhs.local_id < rhs.local_id;
+    });
+    using std::swap;
+    std::vector<IndexSeq> tmp_local2global(local_vocabs.size());
+    for( unsigned range_idx = 0; range_idx < local_vocabs.size(); ++range_idx )
+    {
+        tmp_local2global[range_idx].resize(local_vocabs[range_idx].words.size());
+    }
+    for( const MergedWord &word : merged )
+    {
+        const std::string &word_str = local_vocabs[word.range_idx].words[word.local_id];
+        Index global_id = dict_wrapper.add_word_with_frequency(word_str, static_cast<int>(word.freq));
+        // the word may appear in several ranges
+        for( unsigned range_idx = word.range_idx; range_idx < local_vocabs.size(); ++range_idx )
+        {
+            const LocalVocab &vocab = local_vocabs[range_idx];
+            auto iter = vocab.word2id.find(word_str);
+            if( iter != vocab.word2id.end() ){ tmp_local2global[range_idx][iter->second] = global_id; }
+        }
+    }
+    swap(local2global, tmp_local2global);
+}
+
+template <typename Fn>
+inline
+void ParallelReadingUtils::run_parallel(unsigned nr_tasks, Fn fn)
+{
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(nr_tasks);
+    workers.reserve(nr_tasks);
+    for( unsigned task_idx = 0; task_idx < nr_tasks; ++task_idx )
+    {
+        workers.emplace_back([&fn, &errors, task_idx]()
+        {
+            try{ fn(task_idx); }
+            catch( ... ){ errors[task_idx] = std::current_exception(); }
+        });
+    }
+    for( std::thread &worker : workers ){ worker.join(); }
+    for( const std::exception_ptr &error : errors )
+    {
+        if( error ){ std::rethrow_exception(error); }
+    }
+}
+
+} // end of namespace slnn
+
+#endif
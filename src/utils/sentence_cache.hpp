@@ -0,0 +1,177 @@
+#ifndef SLNN_UTILS_SENTENCE_CACHE_HPP_
+#define SLNN_UTILS_SENTENCE_CACHE_HPP_
+
+#include <cstdint>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <sstream>
+#include "utils/typedeclaration.h"
+#include "utils/corpus_cache.hpp"
+#include "utils/memory_stat.hpp"
+
+namespace slnn{
+
+/**
+ * bounded LRU cache of predicted tag sequences , for repetitive inputs (titles , queries , boilerplate lines) .
+ * key is the FNV-1a hash of the model id and the normalized sentence (tokens after the reader's splitting ,
+ * joined by `\t` , so spacing and line endings dropped by the reader don't matter) . the normalized sentence is
+ * kept in the entry , so a hash collision is a miss instead of a wrong result .
+ * memory of entries (sentence , tags and bookkeeping) is capped , the least recently used entries are evicted .
+ * not thread-safe , every model handler owns one .
+ */
+class SentenceCache
+{
+public:
+    SentenceCache()
+        :capacity_bytes(0), model_id(0), used_bytes(0), nr_lookups(0), nr_hits(0), nr_evictions(0)
+    {}
+    SentenceCache(const SentenceCache&) = delete;
+    SentenceCache& operator=(const SentenceCache&) = delete;
+
+    // 0 disables the cache . entries are dropped
+    void set_capacity_mb(double capacity_mb);
+    // id of the model the tags come from , entries are dropped
+    void set_model_id(uint64_t model_id){ this->model_id = model_id; clear(); }
+    bool is_enabled() const { return capacity_bytes > 0; }
+
+    // true if cached , and `tag_seq` is filled
+    bool lookup(const Seq &sent, IndexSeq &tag_seq);
+    void insert(const Seq &sent, const IndexSeq &tag_seq);
+    void clear();
+
+    size_t size() const { return key2entry.size(); }
+    size_t get_memory_bytes() const { return used_bytes; }
+    uint64_t get_nr_lookups() const { return nr_lookups; }
+    uint64_t get_nr_hits() const { return nr_hits; }
+    double get_hit_rate() const { return nr_lookups > 0 ? static_cast<double>(nr_hits) / nr_lookups : 0.; }
+    std::string get_report_str(const std::string &info_header) const;
+
+    static uint64_t model_id_from_name(const std::string &model_name){ return CorpusCacheUtils::hash_string(model_name); }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        std::string normalized_sent;
+        IndexSeq tag_seq;
+    };
+    using EntryList = std::list<Entry>;
+
+    uint64_t make_key(const std::string &normalized_sent) const;
+    static void normalize(const Seq &sent, std::string &normalized_sent);
+    // entry , list node and hash node
+    static size_t entry_bytes(const Entry &entry)
+    {
+        return sizeof(Entry) + 2 * sizeof(void*) + entry.normalized_sent.capacity() + MemoryStat::vector_bytes(entry.tag_seq)
+            + sizeof(uint64_t) + sizeof(EntryList::iterator) + 2 * sizeof(void*);
+    }
+    void erase(EntryList::iterator iter);
+
+    size_t capacity_bytes;
+    uint64_t model_id;
+    EntryList lru_entries; // the most recently used at front
+    std::unordered_map<uint64_t, EntryList::iterator> key2entry;
+    std::string normalized_buf;
+    size_t used_bytes;
+    uint64_t nr_lookups,
+        nr_hits,
+        nr_evictions;
+};
+
+/*************** inline implementation ***************/
+
+inline
+void SentenceCache::set_capacity_mb(double capacity_mb)
+{
+    capacity_bytes = capacity_mb > 0. ? static_cast<size_t>(capacity_mb * (1ULL << 20)) : 0;
+    clear();
+}
+
+inline
+void SentenceCache::normalize(const Seq &sent, std::string &normalized_sent)
+{
+    normalized_sent.clear();
+    for( size_t i = 0; i < sent.size(); ++i )
+    {
+        if( i > 0 ){ normalized_sent.push_back('\t'); }
+        normalized_sent += sent[i];
+    }
+}
+
+inline
+uint64_t SentenceCache::make_key(const std::string &normalized_sent) const
+{
+    uint64_t h = CorpusCacheUtils::hash_bytes(reinterpret_cast<const char*>(&model_id), sizeof(model_id));
+    return CorpusCacheUtils::hash_string(normalized_sent, h);
+}
+
+inline
+bool SentenceCache::lookup(const Seq &sent, IndexSeq &tag_seq)
+{
+    if( !is_enabled() ){ return false; }
+    ++nr_lookups;
+    normalize(sent, normalized_buf);
+    auto key_iter = key2entry.find(make_key(normalized_buf));
+    if( key_iter == key2entry.end() || key_iter->second->normalized_sent != normalized_buf ){ return false; }
+    // move to front
+    lru_entries.splice(lru_entries.begin(), lru_entries, key_iter->second);
+    tag_seq = key_iter->second->tag_seq;
+    ++nr_hits;
+    return true;
+}
+
+inline
+void SentenceCache::insert(const Seq &sent, const IndexSeq &tag_seq)
+{
+    if( !is_enabled() ){ return; }
+    normalize(sent, normalized_buf);
+    uint64_t key = make_key(normalized_buf);
+    auto key_iter = key2entry.find(key);
+    if( key_iter != key2entry.end() ){ erase(key_iter->second); } // stale or colliding entry
+    lru_entries.push_front(Entry{ key, normalized_buf, tag_seq });
+    size_t bytes = entry_bytes(lru_entries.front());
+    if( bytes > capacity_bytes )
+    {
+        lru_entries.pop_front();
+        return;
+    }
+    key2entry[key] = lru_entries.begin();
+    used_bytes += bytes;
+    while( used_bytes > capacity_bytes )
+    {
+        erase(std::prev(lru_entries.end()));
+        ++nr_evictions;
+    }
+}
+
+inline
+void SentenceCache::erase(EntryList::iterator iter)
+{
+    used_bytes -= entry_bytes(*iter);
+    key2entry.erase(iter->key);
+    lru_entries.erase(iter);
+}
+
+inline
+void SentenceCache::clear()
+{
+    lru_entries.clear();
+    key2entry.clear();
+    used_bytes = 0;
+}
+
+inline
+std::string SentenceCache::get_report_str(const std::string &info_header) const
+{
+    std::ostringstream oss;
+    oss << info_header << "\n"
+        << "lookups = " << nr_lookups << " , hits = " << nr_hits << " , hit rate = " << get_hit_rate() * 100. << "%\n"
+        << "entries = " << size() << " , memory = " << MemoryStat::format_bytes(used_bytes)
+        << " / " << MemoryStat::format_bytes(capacity_bytes) << " , evictions = " << nr_evictions;
+    return oss.str();
+}
+
+} // end of namespace slnn
+
+#endif
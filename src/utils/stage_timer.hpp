@@ -0,0 +1,329 @@
+#ifndef SLNN_UTILS_STAGE_TIMER_HPP_
+#define SLNN_UTILS_STAGE_TIMER_HPP_
+
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <chrono>
+#include <string>
+#include <limits>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <boost/log/trivial.hpp>
+
+namespace slnn{
+
+/**
+ * latency histogram in nanoseconds .
+ * log-linear buckets : values < 16 ns are exact , every power-of-2 range above is split into 16 equal sub-buckets ,
+ * so a percentile is within ~6% of the real value , with fixed memory and O(1) recording .
+ */
+class LatencyHistogram
+{
+public:
+    static const unsigned SubBucketBits = 4;
+    static const unsigned NrSubBuckets = 1U << SubBucketBits;
+    static const unsigned NrBuckets = NrSubBuckets + (64 - SubBucketBits) * NrSubBuckets;
+
+    LatencyHistogram(){ clear(); }
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram &other);
+    void clear();
+    uint64_t get_count() const { return count; }
+    uint64_t get_total_ns() const { return total_ns; }
+    uint64_t get_min_ns() const { return count > 0 ? min_ns : 0; }
+    uint64_t get_max_ns() const { return max_ns; }
+    double get_mean_ns() const { return count > 0 ? static_cast<double>(total_ns) / count : 0.; }
+    // p in [0 , 100]
+    uint64_t get_percentile_ns(double p) const;
+private:
+    static unsigned bucket_index(uint64_t ns);
+    static uint64_t bucket_lower_bound(unsigned idx);
+    std::array<uint64_t, NrBuckets> buckets;
+    uint64_t count,
+        total_ns,
+        min_ns,
+        max_ns;
+};
+
+/**
+ * latency histograms of the pipeline stages .
+ * `Sentence` is the whole processing time of one sentence , other stages are parts of it
+ * (`Read` is usually measured once for the whole input) .
+ */
+struct StageTimings
+{
+    enum class Stage : unsigned
+    {
+        Read = 0,
+        Extract, // index and feature extraction
+        GraphBuild,
+        Forward,
+        Backward,
+        Update,
+        Decode,
+        Write,
+        Sentence,
+        NrStages
+    };
+    static const unsigned NrStages = static_cast<unsigned>(Stage::NrStages);
+
+    std::array<LatencyHistogram, NrStages> histograms;
+
+    void record(Stage stage, uint64_t ns){ histograms[static_cast<unsigned>(stage)].record(ns); }
+    const LatencyHistogram& get(Stage stage) const { return histograms[static_cast<unsigned>(stage)]; }
+    void merge(const StageTimings &other);
+    void clear();
+    bool empty() const;
+    // one line for every stage which has samples , latency in microseconds
+    std::string get_report_str(const std::string &info_header) const;
+    // one JSON object in one line : {"header": ..., "stages": {<stage>: {"count": ..., "p50_ns": ...}, ...}}
+    void write_json(std::ostream &os, const std::string &info_header) const;
+    // log the report , and append it as one JSON line to the path set by `set_json_path`
+    void report(const std::string &info_header) const;
+
+    static const char* get_stage_name(Stage stage);
+    // the file is truncated , then every report of the process is appended (JSON lines)
+    static void set_json_path(const std::string &path);
+    static const std::string& get_json_path(){ return get_json_path_ref(); }
+    static uint64_t now_ns()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+private:
+    static std::string& get_json_path_ref()
+    {
+        static std::string json_path;
+        return json_path;
+    }
+};
+
+/**
+ * record the life time of the scope to a stage . `stop()` records earlier .
+ */
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(StageTimings &timings, StageTimings::Stage stage)
+        :timings(timings), stage(stage), start_ns(StageTimings::now_ns()), is_stopped(false){}
+    ~ScopedStageTimer(){ stop(); }
+    void stop()
+    {
+        if( is_stopped ){ return; }
+        timings.record(stage, StageTimings::now_ns() - start_ns);
+        is_stopped = true;
+    }
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+private:
+    StageTimings &timings;
+    StageTimings::Stage stage;
+    uint64_t start_ns;
+    bool is_stopped;
+};
+
+/*************** inline implementation ***************/
+
+inline
+unsigned LatencyHistogram::bucket_index(uint64_t ns)
+{
+    if( ns < NrSubBuckets ){ return static_cast<unsigned>(ns); }
+    // position of the highest set bit , >= SubBucketBits
+#if defined(__GNUC__)
+    unsigned exponent = 63U - static_cast<unsigned>(__builtin_clzll(ns));
+#else
+    unsigned exponent = 0;
+    while( (ns >> exponent) > 1 ){ ++exponent; }
+#endif
+    unsigned sub_bucket = static_cast<unsigned>(ns >> (exponent - SubBucketBits)) & (NrSubBuckets - 1);
+    return NrSubBuckets + (exponent - SubBucketBits) * NrSubBuckets + sub_bucket;
+}
+
+inline
+uint64_t LatencyHistogram::bucket_lower_bound(unsigned idx)
+{
+    if( idx < NrSubBuckets ){ return idx; }
+    unsigned exponent = (idx - NrSubBuckets) / NrSubBuckets + SubBucketBits,
+        sub_bucket = (idx - NrSubBuckets) % NrSubBuckets;
+    return (static_cast<uint64_t>(NrSubBuckets + sub_bucket)) << (exponent - SubBucketBits);
+}
+
+inline
+void LatencyHistogram::record(uint64_t ns)
+{
+    ++buckets[bucket_index(ns)];
+    ++count;
+    total_ns += ns;
+    min_ns = std::min(min_ns, ns);
+    max_ns = std::max(max_ns, ns);
+}
+
+inline
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for( unsigned i = 0; i < NrBuckets; ++i ){ buckets[i] += other.buckets[i]; }
+    count += other.count;
+    total_ns += other.total_ns;
+    min_ns = std::min(min_ns, other.min_ns);
+    max_ns = std::max(max_ns, other.max_ns);
+}
+
+inline
+void LatencyHistogram::clear()
+{
+    buckets.fill(0);
+    count = 0;
+    total_ns = 0;
+    min_ns = std::numeric_limits<uint64_t>::max();
+    max_ns = 0;
+}
+
+inline
+uint64_t LatencyHistogram::get_percentile_ns(double p) const
+{
+    if( count == 0 ){ return 0; }
+    // rank of the sample , 1-based
+    uint64_t rank = static_cast<uint64_t>(std::max(1., std::ceil(p / 100. * count)));
+    uint64_t accumulated = 0;
+    for( unsigned i = 0; i < NrBuckets; ++i )
+    {
+        accumulated += buckets[i];
+        if( accumulated >= rank )
+        {
+            // middle of the bucket , clipped by the real extremes
+            uint64_t lower = bucket_lower_bound(i),
+                upper = i + 1 < NrBuckets ? bucket_lower_bound(i + 1) : max_ns + 1;
+            uint64_t mid = lower + (upper - lower) / 2;
+            return std::min(std::max(mid, get_min_ns()), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+inline
+void StageTimings::merge(const StageTimings &other)
+{
+    for( unsigned i = 0; i < NrStages; ++i ){ histograms[i].merge(other.histograms[i]); }
+}
+
+inline
+void StageTimings::clear()
+{
+    for( LatencyHistogram &histogram : histograms ){ histogram.clear(); }
+}
+
+inline
+bool StageTimings::empty() const
+{
+    for( const LatencyHistogram &histogram : histograms )
+    {
+        if( histogram.get_count() > 0 ){ return false; }
+    }
+    return true;
+}
+
+inline
+const char* StageTimings::get_stage_name(Stage stage)
+{
+    switch( stage )
+    {
+    case Stage::Read: return "read";
+    case Stage::Extract: return "extract";
+    case Stage::GraphBuild: return "graph_build";
+    case Stage::Forward: return "forward";
+    case Stage::Backward: return "backward";
+    case Stage::Update: return "update";
+    case Stage::Decode: return "decode";
+    case Stage::Write: return "write";
+    case Stage::Sentence: return "sentence";
+    default: return "unknown";
+    }
+}
+
+inline
+std::string StageTimings::get_report_str(const std::string &info_header) const
+{
+    std::ostringstream oss;
+    oss << info_header << "\n"
+        << std::left << std::setw(12) << "stage" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "total(ms)" << std::setw(12) << "mean(us)"
+        << std::setw(12) << "p50(us)" << std::setw(12) << "p95(us)" << std::setw(12) << "p99(us)"
+        << std::setw(12) << "max(us)";
+    oss << std::fixed << std::setprecision(1);
+    for( unsigned i = 0; i < NrStages; ++i )
+    {
+        const LatencyHistogram &histogram = histograms[i];
+        if( histogram.get_count() == 0 ){ continue; }
+        oss << "\n" << std::left << std::setw(12) << get_stage_name(static_cast<Stage>(i)) << std::right
+            << std::setw(10) << histogram.get_count()
+            << std::setw(12) << histogram.get_total_ns() / 1e6
+            << std::setw(12) << histogram.get_mean_ns() / 1e3
+            << std::setw(12) << histogram.get_percentile_ns(50.) / 1e3
+            << std::setw(12) << histogram.get_percentile_ns(95.) / 1e3
+            << std::setw(12) << histogram.get_percentile_ns(99.) / 1e3
+            << std::setw(12) << histogram.get_max_ns() / 1e3;
+    }
+    return oss.str();
+}
+
+inline
+void StageTimings::write_json(std::ostream &os, const std::string &info_header) const
+{
+    std::string escaped_header;
+    for( char c : info_header )
+    {
+        if( c == '"' || c == '\\' ){ escaped_header += '\\'; }
+        if( c == '\n' ){ escaped_header += "\\n"; continue; }
+        escaped_header += c;
+    }
+    os << "{\"header\": \"" << escaped_header << "\", \"stages\": {";
+    bool is_first = true;
+    for( unsigned i = 0; i < NrStages; ++i )
+    {
+        const LatencyHistogram &histogram = histograms[i];
+        if( histogram.get_count() == 0 ){ continue; }
+        os << (is_first ? "" : ", ")
+            << "\"" << get_stage_name(static_cast<Stage>(i)) << "\": {"
+            << "\"count\": " << histogram.get_count()
+            << ", \"total_ns\": " << histogram.get_total_ns()
+            << ", \"mean_ns\": " << static_cast<uint64_t>(histogram.get_mean_ns())
+            << ", \"min_ns\": " << histogram.get_min_ns()
+            << ", \"p50_ns\": " << histogram.get_percentile_ns(50.)
+            << ", \"p95_ns\": " << histogram.get_percentile_ns(95.)
+            << ", \"p99_ns\": " << histogram.get_percentile_ns(99.)
+            << ", \"max_ns\": " << histogram.get_max_ns() << "}";
+        is_first = false;
+    }
+    os << "}}\n";
+}
+
+inline
+void StageTimings::set_json_path(const std::string &path)
+{
+    get_json_path_ref() = path;
+    std::ofstream os(path, std::ios::trunc);
+    if( !os ){ BOOST_LOG_TRIVIAL(warning) << "failed to open `" << path << "` for stage timings ."; }
+}
+
+inline
+void StageTimings::report(const std::string &info_header) const
+{
+    if( empty() ){ return; }
+    BOOST_LOG_TRIVIAL(info) << get_report_str(info_header);
+    const std::string &json_path = get_json_path();
+    if( json_path.empty() ){ return; }
+    std::ofstream os(json_path, std::ios::app);
+    if( !os )
+    {
+        BOOST_LOG_TRIVIAL(warning) << "failed to open `" << json_path << "` for stage timings .";
+        return;
+    }
+    write_json(os, info_header);
+}
+
+} // end of namespace slnn
+
+#endif
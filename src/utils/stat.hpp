@@ -23,6 +23,7 @@
 
 #include "cnn/dict.h"
 #include "segmentor/cws_module/cws_tagging_system.h"
+#include "stage_timer.hpp"
 
 /*************************************
  * Stat 
@@ -38,6 +39,7 @@ struct BasicStat
     std::chrono::high_resolution_clock::time_point time_start;
     std::chrono::high_resolution_clock::time_point time_end;
     bool is_predict ;
+    StageTimings stage_timings; // per-sentence / per-stage latency , filled by the model handler
     std::chrono::high_resolution_clock::time_point start_time_stat() 
     {
         time_clock_locked = false;
@@ -50,23 +52,34 @@ struct BasicStat
     }
     BasicStat(bool is_predict=false) :loss(0.f) , total_tags(0) , is_predict(is_predict) , time_clock_locked(false){};
     float get_sum_E(){ return loss ; }
-    long long get_time_cost_in_seconds()
+    // elapsed time at nanosecond resolution , the clock keeps running if not ended
+    double get_time_cost_in_seconds_precise()
     {
         if (!time_clock_locked) 
         {
             end_time_stat();
             time_clock_locked = false;
         }
-        std::chrono::seconds du = std::chrono::duration_cast<std::chrono::seconds>(time_end - time_start);
-        return du.count();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time_end - time_start).count() / 1e9;
+    }
+    long long get_time_cost_in_seconds()
+    {
+        return static_cast<long long>(get_time_cost_in_seconds_precise());
+    }
+    // 0 if no time has elapsed (clock resolution) , instead of dividing by zero
+    float get_speed_as_kilo_per_second(unsigned long count)
+    {
+        double seconds = get_time_cost_in_seconds_precise();
+        return seconds > 0. ? static_cast<float>(count / 1000. / seconds) : 0.f;
     }
     float get_speed_as_kilo_tokens_per_sencond()
     {
-        return static_cast<float>(static_cast<long double>(total_tags) / 1000. / get_time_cost_in_seconds());
+        return get_speed_as_kilo_per_second(total_tags);
     }
     BasicStat &operator+=(const BasicStat &other)
     {
         loss += other.loss;
+        stage_timings.merge(other.stage_timings);
         return *this;
     }
     BasicStat operator+(const BasicStat &other) { BasicStat tmp = *this;  tmp += other;  return tmp; }
@@ -75,7 +88,7 @@ struct BasicStat
         std::ostringstream str_os;
         str_os << info_header << "\n" ;
         if( !is_predict ){ str_os << "Total E = " << get_sum_E() << "\n" ; }
-        str_os << "Time cost = " << get_time_cost_in_seconds() << " s\n"
+        str_os << "Time cost = " << get_time_cost_in_seconds_precise() << " s\n"
             << "Speed = " << get_speed_as_kilo_tokens_per_sencond() << " K tags/s";
         return str_os.str();
     }
@@ -98,6 +111,7 @@ struct PostagStat : public BasicStat
         correct_tags += other.correct_tags;
         total_tags += other.total_tags;
         loss += other.loss;
+        stage_timings.merge(other.stage_timings);
         return *this;
     }
     PostagStat operator+(const PostagStat &other) { PostagStat tmp = *this;  tmp += other;  return tmp; }
@@ -107,7 +121,7 @@ struct PostagStat : public BasicStat
         str_os << info_header << "\n" ;
         if( !is_predict ){ str_os << "Average E = " << get_E() << "\n" ; }
         str_os << "Acc = " << get_acc() * 100 << "% \n" 
-            << "Time cost = " << get_time_cost_in_seconds() << " s\n"
+            << "Time cost = " << get_time_cost_in_seconds_precise() << " s\n"
             << "Speed = " << get_speed_as_kilo_tokens_per_sencond() << " K tags/s\n"
             << "Total tags = " << total_tags << " , Correct tags = " << correct_tags ;
         return str_os.str();
@@ -217,9 +231,9 @@ struct CWSStat : public BasicStat
         std::ostringstream str_os;
         str_os << info_header << "\n" ;
         if( !is_predict ){ str_os << "Sum E = " << get_sum_E() << "\n" ; }
-        str_os << "Time cost = " << get_time_cost_in_seconds() << " s\n"
+        str_os << "Time cost = " << get_time_cost_in_seconds_precise() << " s\n"
             << "Speed(tag) = " << get_speed_as_kilo_tokens_per_sencond() << " K tags/s\n"
-            << "Speed(token) = " << total_tokens / 1000.f / get_time_cost_in_seconds() << " K Tokens/s" ;
+            << "Speed(token) = " << get_speed_as_kilo_per_second(total_tokens) << " K Tokens/s" ;
         return str_os.str();
     }
 
@@ -325,15 +339,17 @@ struct CWSStatNew : public BasicStat
         std::ostringstream str_os;
         str_os << info_header << "\n" ;
         if( !is_predict ){ str_os << "Sum E = " << get_sum_E() << "\n" ; }
-        str_os << "Time cost = " << get_time_cost_in_seconds() << " s\n"
+        str_os << "Time cost = " << get_time_cost_in_seconds_precise() << " s\n"
             << "Speed(tag) = " << get_speed_as_kilo_tokens_per_sencond() << " K tags/s\n"
-            << "Speed(token) = " << total_tokens / 1000.f / get_time_cost_in_seconds() << " K Tokens/s" ;
+            << "Speed(token) = " << get_speed_as_kilo_per_second(total_tokens) << " K Tokens/s" ;
         return str_os.str();
     }
 
     // return : {Acc , P , R , F1} ( percent ! )
+    // GoldSeqs : `std::vector<IndexSeq>` or `FlatIndexSeqs`
+    template <typename GoldSeqs>
     std::array<float , 4>
-        eval(const std::vector<IndexSeq> &gold_seqs, const std::vector<IndexSeq> &pred_seqs)
+        eval(const GoldSeqs &gold_seqs, const std::vector<IndexSeq> &pred_seqs)
     {
         size_t seq_num = gold_seqs.size() ;
         unsigned gold_tokens = 0,
@@ -341,16 +357,18 @@ struct CWSStatNew : public BasicStat
             correct_tokens = 0 ; // P , R , F1
         unsigned total_tags = 0,
             correct_tags = 0 ; // ACC
+        IndexSeq gold_seq;
         for( size_t i = 0 ; i < seq_num ; ++i )
         {
-            std::array<unsigned, 3> result = eval_one_seq(gold_seqs[i], pred_seqs[i]) ;
+            gold_seq.assign(gold_seqs[i].begin(), gold_seqs[i].end());
+            std::array<unsigned, 3> result = eval_one_seq(gold_seq, pred_seqs[i]) ;
             correct_tokens += result[0] ;
             gold_tokens += result[1] ;
             found_tokens += result[2] ;
-            total_tags += gold_seqs[i].size() ;
-            for( size_t pos = 0 ; pos < gold_seqs[i].size() ; ++pos )
+            total_tags += gold_seq.size() ;
+            for( size_t pos = 0 ; pos < gold_seq.size() ; ++pos )
             {
-                if( gold_seqs[i][pos] == pred_seqs[i][pos] ) ++correct_tags ;
+                if( gold_seq[pos] == pred_seqs[i][pos] ) ++correct_tags ;
             }
         }
         float Acc = (total_tags == 0) ? 0.f : static_cast<float>(correct_tags) / total_tags * 100.f ;
@@ -0,0 +1,587 @@
+#ifndef SLNN_UTILS_TAGGING_SERVER_HPP_
+#define SLNN_UTILS_TAGGING_SERVER_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <boost/log/trivial.hpp>
+#include "utils/stat.hpp"
+#include "utils/stage_timer.hpp"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+namespace slnn{
+
+struct TaggingServerConfig
+{
+    enum class Protocol
+    {
+        Line, // a request is one line , the response is one line
+        LengthPrefixed // 4-byte big-endian length + payload , for both request and response
+    };
+    std::string unix_socket_path; // listen on the unix domain socket if not empty , else TCP on 127.0.0.1
+    unsigned short tcp_port;
+    Protocol protocol;
+    unsigned max_batch_size;
+    // how long the oldest queued request may wait for its batch to fill . sentences of a batch are tagged one after
+    // another , so waiting adds latency without throughput , it only matters once a batch runs as one forward pass
+    unsigned batch_latency_us;
+    unsigned max_queue_size; // requests queued over it are refused
+    unsigned max_request_bytes;
+    unsigned report_interval_sec; // 0 : report only at shutdown
+
+    TaggingServerConfig()
+        :tcp_port(0), protocol(Protocol::Line), max_batch_size(32), batch_latency_us(0),
+        max_queue_size(4096), max_request_bytes(1U << 20), report_interval_sec(300)
+    {}
+};
+
+/**
+ * long-running tagging server . models are loaded once and stay resident , requests come from
+ * a unix domain socket or TCP on 127.0.0.1 (POSIX only) .
+ *
+ * protocol :
+ *     a request payload is a raw sentence in the `predict` input format , the response payload is the
+ *     `predict` output line of it (empty for an empty sentence) . with more than one model , the payload should
+ *     be `<model-name>\t<sentence>` . errors are answered with `!ERR <reason>` .
+ *     framing is a line (`\n` terminated , `\r` stripped) or a 4-byte big-endian length prefix .
+ *     responses of a connection are in the order of its requests , so a client may pipeline requests .
+ *
+ * dynamic batching :
+ *     requests of all connections are queued . when the inference thread is free , it takes the queued requests of
+ *     the oldest request's model (at most `max_batch_size`) and tags them in one call . with `batch_latency_us` > 0
+ *     it first waits up to that long for the batch to fill . cnn permits one computation graph at a time , so ONLY the inference thread touches cnn ,
+ *     sentences of a batch run one after another on the recycled graph , and the graph of the previous model
+ *     is released when the model switches .
+ */
+class TaggingServer
+{
+public:
+    // tag raw lines , one output for every line
+    using TagFunc = std::function<void(const std::vector<std::string>&, std::vector<std::string>&, BasicStat&)>;
+    using ReleaseFunc = std::function<void()>;
+
+    explicit TaggingServer(const TaggingServerConfig &config);
+    TaggingServer(const TaggingServer&) = delete;
+    TaggingServer& operator=(const TaggingServer&) = delete;
+
+    // the first model is the default one
+    void add_model(const std::string &name, TagFunc tag, ReleaseFunc release);
+    // serve until SIGINT / SIGTERM , return 0 if shut down normally
+    int run();
+    // called by the signal handler , or by another thread
+    static void request_stop(){ get_stop_flag() = 1; }
+
+private:
+    struct Request
+    {
+        size_t model_idx;
+        std::string sentence;
+        uint64_t enqueue_ns;
+        std::promise<std::string> result;
+    };
+    struct Model
+    {
+        std::string name;
+        TagFunc tag;
+        ReleaseFunc release;
+    };
+    // responses of a connection , in request order
+    struct Connection
+    {
+        int fd;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::deque<std::future<std::string>> responses;
+        bool is_reading_done;
+        explicit Connection(int fd) :fd(fd), is_reading_done(false){}
+    };
+    static const unsigned MaxInflightPerConnection = 1024;
+    static const char* ErrorPrefix(){ return "!ERR "; }
+
+    int open_listen_socket();
+    void serve_connection(int fd);
+    void write_responses(std::shared_ptr<Connection> conn);
+    bool read_request(int fd, std::string &buffer, std::string &payload, bool &is_too_large);
+    bool write_response(int fd, const std::string &payload);
+    std::future<std::string> submit(const std::string &payload);
+    void inference_loop();
+    void report(const std::string &info_header);
+    static bool read_exact(int fd, char *data, size_t len);
+    static bool write_exact(int fd, const char *data, size_t len);
+    static std::future<std::string> ready_response(const std::string &response);
+    static void on_signal(int){ request_stop(); }
+    static volatile std::sig_atomic_t& get_stop_flag()
+    {
+        static volatile std::sig_atomic_t stop_flag = 0;
+        return stop_flag;
+    }
+
+    TaggingServerConfig config;
+    std::vector<Model> models;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque<std::shared_ptr<Request>> pending;
+    std::vector<size_t> nr_pending_of_model;
+    bool is_stopping;
+
+    std::mutex conn_mutex;
+    std::condition_variable conn_cv;
+    std::set<int> live_fds;
+
+    // touched by the inference thread only
+    BasicStat stat; // taggers record their per-sentence stages here
+    StageTimings request_timings; // `Sentence` is the request latency , queueing included
+    uint64_t nr_requests,
+        nr_batches;
+};
+
+/*************** inline implementation ***************/
+
+inline
+TaggingServer::TaggingServer(const TaggingServerConfig &config)
+    :config(config),
+    is_stopping(false),
+    stat(true),
+    nr_requests(0),
+    nr_batches(0)
+{
+    this->config.max_batch_size = std::max(this->config.max_batch_size, 1U);
+}
+
+inline
+void TaggingServer::add_model(const std::string &name, TagFunc tag, ReleaseFunc release)
+{
+    for( const Model &model : models )
+    {
+        if( model.name == name ){ throw std::runtime_error("duplicated model name : `" + name + "`"); }
+    }
+    models.push_back(Model{ name, tag, release });
+    nr_pending_of_model.push_back(0);
+}
+
+inline
+std::future<std::string> TaggingServer::ready_response(const std::string &response)
+{
+    std::promise<std::string> result;
+    result.set_value(response);
+    return result.get_future();
+}
+
+inline
+std::future<std::string> TaggingServer::submit(const std::string &payload)
+{
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->model_idx = 0;
+    if( models.size() > 1 )
+    {
+        std::string::size_type delim_pos = payload.find('\t');
+        std::string name = payload.substr(0, delim_pos);
+        size_t model_idx = 0;
+        while( model_idx < models.size() && models[model_idx].name != name ){ ++model_idx; }
+        if( model_idx == models.size() )
+        {
+            return ready_response(std::string(ErrorPrefix()) + "unknown model `" + name + "` , payload should be `<model-name>\\t<sentence>`");
+        }
+        request->model_idx = model_idx;
+        request->sentence = delim_pos == std::string::npos ? std::string() : payload.substr(delim_pos + 1);
+    }
+    else { request->sentence = payload; }
+    std::future<std::string> response = request->result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if( is_stopping ){ return ready_response(std::string(ErrorPrefix()) + "server is shutting down"); }
+        if( pending.size() >= config.max_queue_size ){ return ready_response(std::string(ErrorPrefix()) + "server is busy"); }
+        request->enqueue_ns = StageTimings::now_ns();
+        ++nr_pending_of_model[request->model_idx];
+        pending.push_back(std::move(request));
+    }
+    queue_cv.notify_one();
+    return response;
+}
+
+inline
+void TaggingServer::inference_loop()
+{
+    const uint64_t latency_budget_ns = static_cast<uint64_t>(config.batch_latency_us) * 1000U;
+    const uint64_t report_interval_ns = static_cast<uint64_t>(config.report_interval_sec) * 1000000000ULL;
+    uint64_t last_report_ns = StageTimings::now_ns();
+    size_t last_model_idx = models.size();
+    std::vector<std::shared_ptr<Request>> batch;
+    std::vector<std::string> lines,
+        outputs;
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]{ return is_stopping || !pending.empty(); });
+            if( pending.empty() ){ break; } // stopping and drained
+            size_t model_idx = pending.front()->model_idx;
+            uint64_t deadline_ns = pending.front()->enqueue_ns + latency_budget_ns;
+            while( latency_budget_ns > 0 && !is_stopping && nr_pending_of_model[model_idx] < config.max_batch_size )
+            {
+                uint64_t now_ns = StageTimings::now_ns();
+                if( now_ns >= deadline_ns ){ break; }
+                queue_cv.wait_for(lock, std::chrono::nanoseconds(deadline_ns - now_ns));
+            }
+            // take the requests of the model in arrival order , others keep their places
+            batch.clear();
+            for( auto iter = pending.begin(); iter != pending.end() && batch.size() < config.max_batch_size; )
+            {
+                if( (*iter)->model_idx == model_idx )
+                {
+                    batch.push_back(std::move(*iter));
+                    iter = pending.erase(iter);
+                }
+                else { ++iter; }
+            }
+            nr_pending_of_model[model_idx] -= batch.size();
+        }
+        size_t model_idx = batch.front()->model_idx;
+        if( last_model_idx != model_idx && last_model_idx < models.size() ){ models[last_model_idx].release(); }
+        last_model_idx = model_idx;
+        lines.clear();
+        for( const std::shared_ptr<Request> &request : batch ){ lines.push_back(request->sentence); }
+        try
+        {
+            models[model_idx].tag(lines, outputs, stat);
+            if( outputs.size() != lines.size() ){ throw std::runtime_error("tagger returned a wrong number of outputs"); }
+            uint64_t done_ns = StageTimings::now_ns();
+            for( size_t i = 0; i < batch.size(); ++i )
+            {
+                batch[i]->result.set_value(std::move(outputs[i]));
+                request_timings.record(StageTimings::Stage::Sentence, done_ns - batch[i]->enqueue_ns);
+            }
+        }
+        catch( const std::exception &e )
+        {
+            BOOST_LOG_TRIVIAL(error) << "failed to tag a batch of model `" << models[model_idx].name << "` : " << e.what();
+            for( const std::shared_ptr<Request> &request : batch )
+            {
+                request->result.set_value(std::string(ErrorPrefix()) + e.what());
+            }
+        }
+        nr_requests += batch.size();
+        ++nr_batches;
+        if( report_interval_ns > 0 && StageTimings::now_ns() - last_report_ns >= report_interval_ns )
+        {
+            report("tagging server statistics :");
+            last_report_ns = StageTimings::now_ns();
+        }
+    }
+    if( last_model_idx < models.size() ){ models[last_model_idx].release(); }
+}
+
+inline
+void TaggingServer::report(const std::string &info_header)
+{
+    if( 0 == nr_batches ){ return; }
+    BOOST_LOG_TRIVIAL(info) << stat.get_stat_str(info_header) << "\n"
+        << nr_requests << " requests in " << nr_batches << " batches , "
+        << static_cast<double>(nr_requests) / nr_batches << " requests per batch on average .";
+    stat.stage_timings.report("stage latency of tagging in the server :");
+    request_timings.report("request latency of the tagging server (`sentence` , queueing included) :");
+}
+
+#if !defined(_WIN32)
+
+inline
+bool TaggingServer::read_exact(int fd, char *data, size_t len)
+{
+    while( len > 0 )
+    {
+        ssize_t nr_read = ::recv(fd, data, len, 0);
+        if( nr_read < 0 && errno == EINTR ){ continue; }
+        if( nr_read <= 0 ){ return false; }
+        data += nr_read;
+        len -= static_cast<size_t>(nr_read);
+    }
+    return true;
+}
+
+inline
+bool TaggingServer::write_exact(int fd, const char *data, size_t len)
+{
+    while( len > 0 )
+    {
+        ssize_t nr_written = ::send(fd, data, len, MSG_NOSIGNAL);
+        if( nr_written < 0 && errno == EINTR ){ continue; }
+        if( nr_written <= 0 ){ return false; }
+        data += nr_written;
+        len -= static_cast<size_t>(nr_written);
+    }
+    return true;
+}
+
+inline
+bool TaggingServer::read_request(int fd, std::string &buffer, std::string &payload, bool &is_too_large)
+{
+    is_too_large = false;
+    if( config.protocol == TaggingServerConfig::Protocol::LengthPrefixed )
+    {
+        unsigned char header[4];
+        if( !read_exact(fd, reinterpret_cast<char*>(header), 4) ){ return false; }
+        uint32_t len = (static_cast<uint32_t>(header[0]) << 24) | (static_cast<uint32_t>(header[1]) << 16)
+            | (static_cast<uint32_t>(header[2]) << 8) | static_cast<uint32_t>(header[3]);
+        if( len > config.max_request_bytes )
+        {
+            is_too_large = true;
+            return false;
+        }
+        payload.resize(len);
+        return len == 0 || read_exact(fd, &payload[0], len);
+    }
+    // line : `buffer` keeps the bytes received after the last line
+    std::string::size_type newline_pos;
+    while( (newline_pos = buffer.find('\n')) == std::string::npos )
+    {
+        if( buffer.size() > config.max_request_bytes )
+        {
+            is_too_large = true;
+            return false;
+        }
+        char chunk[4096];
+        ssize_t nr_read = ::recv(fd, chunk, sizeof(chunk), 0);
+        if( nr_read < 0 && errno == EINTR ){ continue; }
+        if( nr_read <= 0 )
+        {
+            // the last line without `\n`
+            if( buffer.empty() ){ return false; }
+            newline_pos = buffer.size();
+            buffer.push_back('\n');
+            break;
+        }
+        buffer.append(chunk, static_cast<size_t>(nr_read));
+    }
+    payload.assign(buffer, 0, newline_pos);
+    buffer.erase(0, newline_pos + 1);
+    if( !payload.empty() && payload.back() == '\r' ){ payload.pop_back(); }
+    return true;
+}
+
+inline
+bool TaggingServer::write_response(int fd, const std::string &payload)
+{
+    if( config.protocol == TaggingServerConfig::Protocol::LengthPrefixed )
+    {
+        uint32_t len = static_cast<uint32_t>(payload.size());
+        char header[4] = { static_cast<char>(len >> 24), static_cast<char>(len >> 16),
+            static_cast<char>(len >> 8), static_cast<char>(len) };
+        return write_exact(fd, header, 4) && write_exact(fd, payload.data(), payload.size());
+    }
+    std::string line = payload;
+    line.push_back('\n');
+    return write_exact(fd, line.data(), line.size());
+}
+
+inline
+void TaggingServer::write_responses(std::shared_ptr<Connection> conn)
+{
+    bool is_writable = true;
+    while( true )
+    {
+        std::future<std::string> response;
+        {
+            std::unique_lock<std::mutex> lock(conn->mtx);
+            conn->cv.wait(lock, [&conn]{ return conn->is_reading_done || !conn->responses.empty(); });
+            if( conn->responses.empty() ){ break; }
+            response = std::move(conn->responses.front());
+            conn->responses.pop_front();
+        }
+        conn->cv.notify_all();
+        // keep waiting the futures after a failed write , requests are still referenced by the inference thread
+        std::string payload = response.get();
+        if( is_writable && !write_response(conn->fd, payload) )
+        {
+            is_writable = false;
+            ::shutdown(conn->fd, SHUT_RD); // stop the reader too
+        }
+    }
+}
+
+inline
+void TaggingServer::serve_connection(int fd)
+{
+    std::shared_ptr<Connection> conn = std::make_shared<Connection>(fd);
+    std::thread writer(&TaggingServer::write_responses, this, conn);
+    std::string buffer,
+        payload;
+    bool is_too_large = false;
+    while( read_request(fd, buffer, payload, is_too_large) )
+    {
+        std::future<std::string> response = submit(payload);
+        std::unique_lock<std::mutex> lock(conn->mtx);
+        // back pressure for a client pipelining faster than it reads
+        conn->cv.wait(lock, [&conn]{ return conn->responses.size() < MaxInflightPerConnection; });
+        conn->responses.push_back(std::move(response));
+        lock.unlock();
+        conn->cv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(conn->mtx);
+        if( is_too_large )
+        {
+            conn->responses.push_back(ready_response(std::string(ErrorPrefix()) + "request is too large"));
+        }
+        conn->is_reading_done = true;
+    }
+    conn->cv.notify_all();
+    writer.join();
+    ::close(fd);
+    // notify under the lock : `run` may return (and the server be destroyed) as soon as the lock is released
+    std::lock_guard<std::mutex> lock(conn_mutex);
+    live_fds.erase(fd);
+    conn_cv.notify_all();
+}
+
+inline
+int TaggingServer::open_listen_socket()
+{
+    int listen_fd = -1;
+    if( !config.unix_socket_path.empty() )
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if( config.unix_socket_path.size() >= sizeof(addr.sun_path) )
+        {
+            BOOST_LOG_TRIVIAL(error) << "unix socket path is too long : `" << config.unix_socket_path << "`";
+            return -1;
+        }
+        std::strncpy(addr.sun_path, config.unix_socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(config.unix_socket_path.c_str()); // the stale socket file of the last run
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if( listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 )
+        {
+            BOOST_LOG_TRIVIAL(error) << "failed to bind unix socket `" << config.unix_socket_path << "` : " << std::strerror(errno);
+            if( listen_fd >= 0 ){ ::close(listen_fd); }
+            return -1;
+        }
+    }
+    else
+    {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.tcp_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // localhost only
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if( listen_fd >= 0 ){ ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)); }
+        if( listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 )
+        {
+            BOOST_LOG_TRIVIAL(error) << "failed to bind 127.0.0.1:" << config.tcp_port << " : " << std::strerror(errno);
+            if( listen_fd >= 0 ){ ::close(listen_fd); }
+            return -1;
+        }
+    }
+    if( ::listen(listen_fd, 128) != 0 )
+    {
+        BOOST_LOG_TRIVIAL(error) << "failed to listen : " << std::strerror(errno);
+        ::close(listen_fd);
+        return -1;
+    }
+    return listen_fd;
+}
+
+inline
+int TaggingServer::run()
+{
+    if( models.empty() ){ throw std::runtime_error("no model is added to the tagging server"); }
+    int listen_fd = open_listen_socket();
+    if( listen_fd < 0 ){ return -1; }
+    get_stop_flag() = 0;
+    std::signal(SIGINT, &TaggingServer::on_signal);
+    std::signal(SIGTERM, &TaggingServer::on_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::ostringstream model_names;
+    for( const Model &model : models ){ model_names << " `" << model.name << "`"; }
+    BOOST_LOG_TRIVIAL(info) << "tagging server is listening on "
+        << (config.unix_socket_path.empty() ? "127.0.0.1:" + std::to_string(config.tcp_port) : config.unix_socket_path)
+        << " (" << (config.protocol == TaggingServerConfig::Protocol::Line ? "line" : "length-prefixed") << " protocol) ,"
+        << " models :" << model_names.str() << " , max batch size " << config.max_batch_size
+        << " , batch latency " << config.batch_latency_us << " us .";
+    stat.start_time_stat();
+    std::thread inference_thread(&TaggingServer::inference_loop, this);
+
+    while( !get_stop_flag() )
+    {
+        pollfd listen_poll = { listen_fd, POLLIN, 0 };
+        int nr_ready = ::poll(&listen_poll, 1, 200); // wake up to check the stop flag
+        if( nr_ready <= 0 ){ continue; }
+        int conn_fd = ::accept(listen_fd, nullptr, nullptr);
+        if( conn_fd < 0 ){ continue; }
+        if( config.unix_socket_path.empty() )
+        {
+            int no_delay = 1;
+            ::setsockopt(conn_fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        }
+        {
+            std::lock_guard<std::mutex> lock(conn_mutex);
+            live_fds.insert(conn_fd);
+        }
+        std::thread(&TaggingServer::serve_connection, this, conn_fd).detach();
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "tagging server is shutting down .";
+    ::close(listen_fd);
+    if( !config.unix_socket_path.empty() ){ ::unlink(config.unix_socket_path.c_str()); }
+    {
+        // unblock readers , queued requests are still answered
+        std::unique_lock<std::mutex> lock(conn_mutex);
+        for( int fd : live_fds ){ ::shutdown(fd, SHUT_RD); }
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        is_stopping = true;
+    }
+    queue_cv.notify_all();
+    inference_thread.join();
+    {
+        std::unique_lock<std::mutex> lock(conn_mutex);
+        conn_cv.wait(lock, [this]{ return live_fds.empty(); });
+    }
+    report("tagging server done .");
+    return 0;
+}
+
+#else
+
+inline
+int TaggingServer::run()
+{
+    BOOST_LOG_TRIVIAL(error) << "tagging server is not supported on Windows .";
+    return -1;
+}
+
+#endif // !defined(_WIN32)
+
+} // end of namespace slnn
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef SLNN_UTILS_TAGGING_SERVER_PROCESS_HPP_
+#define SLNN_UTILS_TAGGING_SERVER_PROCESS_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <boost/program_options.hpp>
+#include "cnn/cnn.h"
+#include "utils/general.hpp"
+#include "utils/memory_stat.hpp"
+#include "utils/stage_timer.hpp"
+#include "utils/sentence_cache.hpp"
+#include "utils/tagging_server.hpp"
+
+namespace slnn{
+
+/**
+ * the `serve` process shared by the tagger mains : parse the serve options , initialize cnn ,
+ * load every `--model` into its own `ModelHandler` (they all stay resident) and run the `TaggingServer` .
+ */
+template <typename ModelHandler>
+int run_tagging_server(int argc, char *argv[], const std::string &program_header, const std::string &program_name);
+
+/*************** inline implementation ***************/
+
+template <typename ModelHandler>
+int run_tagging_server(int argc, char *argv[], const std::string &program_header, const std::string &program_name)
+{
+    namespace po = boost::program_options;
+    std::string description = program_header + "\n"
+        "Serve process .\n"
+        "using `" + program_name + " serve [rnn-type] <options>` to keep models resident and tag requests from a socket ."
+        " serve options are as following";
+    po::options_description op_des = po::options_description(description);
+    op_des.add_options()
+        ("cnn-mem", po::value<unsigned>(), "pre-allocated memory pool for CNN library (MB) .")
+        ("stage_stats_json", po::value<std::string>(), "Write the per-stage latency histograms (p50 / p95 / p99) of every report to the path , one JSON object per line .")
+        ("cnn_mem_auto", po::value<float>(), "Size `cnn-mem` from the longest sentence of the memory profile plus this headroom ratio (e.g. 0.3) .")
+        ("mem_profile", po::value<std::vector<std::string>>(), "The memory profile of a model , updated with its measured graph and parameter memory"
+            " and read by `cnn_mem_auto` . repeat it in the order of `model` , `<model path>.memprofile` if not specified ."
+            " they are only written if this or `cnn_mem_auto` is specified .")
+        ("model", po::value<std::vector<std::string>>(), "The model to keep resident , `<name>=<path>` or `<path>` (named by the path) ."
+            " repeat it to serve more models , then the request should be `<name>\\t<sentence>` .")
+        ("socket", po::value<std::string>(), "The unix domain socket path to listen on .")
+        ("port", po::value<unsigned>(), "The TCP port to listen on 127.0.0.1 , if `socket` is not specified .")
+        ("protocol", po::value<std::string>()->default_value("line"), "`line` : one line for every request and response ;"
+            " `length` : 4-byte big-endian length prefixed .")
+        ("max_batch_size", po::value<unsigned>()->default_value(32), "The most requests to tag in one batch .")
+        ("batch_latency_us", po::value<unsigned>()->default_value(0), "How long (microseconds) a request may wait for its batch to fill ."
+            " sentences of a batch are tagged one after another , so keep it 0 : waiting only adds latency .")
+        ("sentence_cache_mb", po::value<float>()->default_value(0.f), "Cache the tags of repeated sentences in at most N MB for every model ,"
+            " the least recently used are dropped . 0 disables it .")
+        ("max_queue_size", po::value<unsigned>()->default_value(4096), "Requests over the queued ones are refused .")
+        ("report_interval", po::value<unsigned>()->default_value(300), "Log the serving statistics every N seconds , 0 for only at shutdown .")
+        ("help,h", "Show help information.");
+    po::variables_map var_map;
+    po::store(po::command_line_parser(argc, argv).options(op_des).allow_unregistered().run(), var_map);
+    po::notify(var_map);
+    if (var_map.count("help"))
+    {
+        std::cerr << op_des << std::endl;
+        return 0;
+    }
+
+    //set params
+
+    varmap_key_fatal_check(var_map, "model", "Error : model path should be specified ! ");
+    if( var_map.count("socket") == 0 && var_map.count("port") == 0 )
+    {
+        fatal_error("Error : `socket` or `port` should be specified .");
+    }
+    std::vector<std::pair<std::string, std::string>> name2path;
+    for( const std::string &model_spec : var_map["model"].as<std::vector<std::string>>() )
+    {
+        std::string::size_type delim_pos = model_spec.find('=');
+        if( delim_pos == std::string::npos ){ name2path.emplace_back(model_spec, model_spec); }
+        else { name2path.emplace_back(model_spec.substr(0, delim_pos), model_spec.substr(delim_pos + 1)); }
+    }
+    TaggingServerConfig server_config;
+    if( var_map.count("socket") != 0 ){ server_config.unix_socket_path = var_map["socket"].as<std::string>(); }
+    if( var_map.count("port") != 0 ){ server_config.tcp_port = static_cast<unsigned short>(var_map["port"].as<unsigned>()); }
+    std::string protocol = var_map["protocol"].as<std::string>();
+    if( protocol == "length" ){ server_config.protocol = TaggingServerConfig::Protocol::LengthPrefixed; }
+    else if( protocol != "line" ){ fatal_error("Error : unknown protocol `" + protocol + "` ."); }
+    server_config.max_batch_size = var_map["max_batch_size"].as<unsigned>();
+    server_config.batch_latency_us = var_map["batch_latency_us"].as<unsigned>();
+    server_config.max_queue_size = var_map["max_queue_size"].as<unsigned>();
+    server_config.report_interval_sec = var_map["report_interval"].as<unsigned>();
+
+    // Init
+    const int CNNRandomSeed = 1234;
+    int cnn_argc;
+    std::shared_ptr<char *> cnn_argv;
+    unsigned cnn_mem = 0 ;
+    if( var_map.count("cnn-mem") != 0 ){ cnn_mem = var_map["cnn-mem"].as<unsigned>();}
+    std::vector<std::string> mem_profile_paths;
+    if( var_map.count("mem_profile") != 0 )
+    {
+        mem_profile_paths = var_map["mem_profile"].as<std::vector<std::string>>();
+        if( mem_profile_paths.size() != name2path.size() )
+        {
+            fatal_error("Error : " + std::to_string(mem_profile_paths.size()) + " `mem_profile` for "
+                + std::to_string(name2path.size()) + " `model` , one for every model is expected .");
+        }
+    }
+    else
+    {
+        for( const std::pair<std::string, std::string> &model_name2path : name2path )
+        {
+            mem_profile_paths.push_back(model_name2path.second + ".memprofile");
+        }
+    }
+    bool is_mem_profile_written = var_map.count("mem_profile") != 0 || var_map.count("cnn_mem_auto") != 0;
+    if( var_map.count("cnn_mem_auto") != 0 )
+    {
+        // requests are unknown , the longest sentence measured in the profiles is used
+        cnn_mem = CnnMemPlanner::plan_resident_cnn_mem_mb(mem_profile_paths, var_map["cnn_mem_auto"].as<float>(), cnn_mem);
+    }
+    build_cnn_parameters(program_name, cnn_mem, cnn_argc, cnn_argv);
+    char **cnn_argv_ptr = cnn_argv.get();
+    cnn::Initialize(cnn_argc, cnn_argv_ptr, CNNRandomSeed);
+    if( var_map.count("stage_stats_json") != 0 ){ StageTimings::set_json_path(var_map["stage_stats_json"].as<std::string>()); }
+
+    // load models , all stay resident
+    TaggingServer server(server_config);
+    std::vector<std::shared_ptr<ModelHandler>> model_handlers;
+    for( size_t i = 0; i < name2path.size(); ++i )
+    {
+        const std::pair<std::string, std::string> &model_name2path = name2path[i];
+        std::ifstream is(model_name2path.second);
+        if (!is)
+        {
+            fatal_error("Error : failed to open model path at '" + model_name2path.second + "' . ");
+        }
+        std::shared_ptr<ModelHandler> model_handler(new ModelHandler());
+        if( is_mem_profile_written ){ model_handler->set_mem_profile_path(mem_profile_paths[i]); }
+        model_handler->load_model(is);
+        is.close();
+        model_handler->set_sentence_cache(var_map["sentence_cache_mb"].as<float>(),
+            SentenceCache::model_id_from_name(model_name2path.second));
+        server.add_model(model_name2path.first,
+            [model_handler](const std::vector<std::string> &lines, std::vector<std::string> &outputs, BasicStat &stat)
+            { model_handler->predict_lines(lines, outputs, stat); },
+            [model_handler](){ model_handler->release_graph(); });
+        model_handlers.push_back(model_handler);
+    }
+    int ret_status = server.run();
+    for( size_t i = 0; i < model_handlers.size(); ++i )
+    {
+        model_handlers[i]->report_graph_memory("graph memory of model `" + name2path[i].first + "` :");
+        model_handlers[i]->report_sentence_cache("sentence cache of model `" + name2path[i].first + "` :");
+    }
+    return ret_status;
+}
+
+} // end of namespace slnn
+
+#endif
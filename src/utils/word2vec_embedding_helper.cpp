@@ -59,6 +59,15 @@ void Word2vecEmbeddingHelper::load_fixed_embedding(std::ifstream &is, cnn::Dict
 {
     // set lookup parameters from outer word embedding
     // using words_loopup_param.Initialize( word_id , value_vector )
+    load_fixed_embedding(is, fixed_dict, fixed_word_dim, [fixed_lookup_param](int word_id, const std::vector<cnn::real> &embedding_vec)
+    {
+        fixed_lookup_param->Initialize(word_id, embedding_vec);
+    });
+}
+
+void Word2vecEmbeddingHelper::load_fixed_embedding(std::ifstream &is, cnn::Dict &fixed_dict, unsigned fixed_word_dim,
+    const std::function<void(int, const std::vector<cnn::real>&)> &set_row)
+{
     BOOST_LOG_TRIVIAL(info) << "load pre-trained word embedding .";
     std::string line;
     std::vector<std::string> split_cont;
@@ -81,7 +90,7 @@ void Word2vecEmbeddingHelper::load_fixed_embedding(std::ifstream &is, cnn::Dict
         {
             embedding_vec[idx - 1] = std::stof(split_cont[idx]);
         }
-        fixed_lookup_param->Initialize(word_id, embedding_vec);
+        set_row(word_id, embedding_vec);
     }
     BOOST_LOG_TRIVIAL(info) << "load fixed embedding done ." ;
 }
@@ -2,6 +2,8 @@
 #define UTILS_WORD2VEC_EMBEDDING_HELPER_H_
 
 #include <fstream>
+#include <vector>
+#include <functional>
 
 #include "cnn/cnn.h"
 #include "cnn/dict.h"
@@ -48,6 +50,10 @@ struct Word2vecEmbeddingHelper
     */
     static
         void load_fixed_embedding(std::ifstream &is, cnn::Dict &fixed_dict, unsigned fixed_word_dim, cnn::LookupParameters *fixed_lookup_param);
+    // same as above , but every row is passed to `set_row(word_id , values)` (e.g. a compact table)
+    static
+        void load_fixed_embedding(std::ifstream &is, cnn::Dict &fixed_dict, unsigned fixed_word_dim,
+            const std::function<void(int, const std::vector<cnn::real>&)> &set_row);
 
     static float calc_hit_rate(cnn::Dict &fixed_dict, cnn::Dict &dynamic_dict, const std::string &fixed_dict_unk_str);
 };